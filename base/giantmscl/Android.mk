@@ -28,7 +28,7 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
 LOCAL_HEADER_LIBRARIES += libexynos_headers
 
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
-LOCAL_SRC_FILES := giant_mscl.cpp giant_mscl_impl.cpp buffer.cpp debug.cpp
+LOCAL_SRC_FILES := giant_mscl.cpp giant_mscl_impl.cpp buffer.cpp debug.cpp planner.cpp
 
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE := libgiantmscl
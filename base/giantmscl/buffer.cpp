@@ -5,7 +5,11 @@
 #include <unistd.h>
 
 #include <system/graphics.h>
+#ifdef USE_GIANT_MSCL_EMULATOR
+#include <sys/mman.h>
+#else
 #include <hardware/exynos/ion.h>
+#endif
 
 #include "log.h"
 #include "buffer.h"
@@ -37,10 +41,6 @@ void Buffer::init(int buffer[], unsigned int count, unsigned int fmt, unsigned i
 // multi-planar format.
 int Buffer::alloc(unsigned int fmt, unsigned int width, unsigned int height)
 {
-    int devfd = exynos_ion_open();
-    if (devfd < 0)
-        return -1;
-
     // MSCL may read extra 128 pixels after the image region of interest due to its performance.
     // So, we should feed MSCL H/W more memory not to cause buffer overrun.
     size_t len = width * height + NR_EXTRA_PIXELS;
@@ -50,11 +50,26 @@ int Buffer::alloc(unsigned int fmt, unsigned int width, unsigned int height)
         len += len / 2;
     }
 
+#ifdef USE_GIANT_MSCL_EMULATOR
+    // the emulator maps any file descriptor that supports mmap()
+    int buffd = memfd_create("giantmscl", MFD_CLOEXEC);
+    if ((buffd >= 0) && (ftruncate(buffd, len) < 0)) {
+        close(buffd);
+        buffd = -1;
+    }
+    if (buffd < 0)
+        ALOGERR("failed to allocate for %ux%u (fmt %#x)", width, height ,fmt);
+#else
+    int devfd = exynos_ion_open();
+    if (devfd < 0)
+        return -1;
+
     int buffd = exynos_ion_alloc(devfd, len, 1, 0);
     if (buffd < 0)
         ALOGERR("failed to allocate for %ux%u (fmt %#x)", width, height ,fmt);
 
     exynos_ion_close(devfd);
+#endif
 
     return buffd;
 }
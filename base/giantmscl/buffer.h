@@ -61,7 +61,24 @@ public:
     int getByteOffset(unsigned int idx, unsigned int x_offset, unsigned int y_offset, unsigned int pixel_stride) const;
     int operator[](unsigned int idx) { return get(idx); }
     unsigned int count() const { return mCount; }
+
+    // returns a buffer that refers the same memory without owning it.
+    Buffer borrow() const {
+        Buffer buf;
+
+        for (unsigned int i = 0; i < 2; i++) {
+            buf.mBuffer[i] = mBuffer[i];
+            buf.mOffset[i] = mOffset[i];
+            buf.mHBitPP[i] = mHBitPP[i];
+            buf.mVBitPP[i] = mVBitPP[i];
+        }
+        buf.mCount = mCount;
+
+        return buf;
+    }
 private:
+    Buffer(): mAllocated(false) { }
+
     int mBuffer[2] = {-1, -1};
     int mOffset[2] = {0, 0};
     unsigned char mHBitPP[2] = {8, 8}; // NV12
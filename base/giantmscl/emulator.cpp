@@ -0,0 +1,268 @@
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include <log/log.h>
+
+#include "log.h"
+#include "emulator.h"
+
+const static unsigned int FRACTION_BITS = 20;
+const static unsigned int MSCL_ROTATE_MASK = 3;
+const static unsigned int MSCL_ROTATE_270CCW = 3;
+const static unsigned int MSCL_FLIP_SHIFT = 2;
+const static unsigned int MSCL_FLIP_H = 1;
+const static unsigned int MSCL_FLIP_V = 2;
+const static int N_HTAPS = 8;
+const static int N_VTAPS = 4;
+
+enum { CHANNEL_Y, CHANNEL_CB, CHANNEL_CR, NR_CHANNELS };
+
+struct Mapping {
+    Mapping(int fd) {
+        off_t len = ::lseek(fd, 0, SEEK_END);
+        if (len <= 0) {
+            ALOGERR("failed to get the size of dmabuf %d", fd);
+            return;
+        }
+
+        void *addr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGERR("failed to map dmabuf %d", fd);
+            return;
+        }
+
+        mAddr = reinterpret_cast<uint8_t *>(addr);
+        mLen = static_cast<size_t>(len);
+    }
+
+    ~Mapping() {
+        if (mAddr)
+            ::munmap(mAddr, mLen);
+    }
+
+    uint8_t *mAddr = nullptr;
+    size_t mLen = 0;
+};
+
+struct Channel {
+    uint8_t *mBase = nullptr;
+    size_t mLimit = 0;
+    unsigned int mStep = 1;
+    unsigned int mStride = 0;
+    unsigned int mWidth = 0;
+    unsigned int mHeight = 0;
+    unsigned int mHSub = 1;
+    unsigned int mVSub = 1;
+
+    uint8_t &at(unsigned int x, unsigned int y) { return mBase[y * mStride + x * mStep]; }
+    bool valid() const {
+        return mBase && (mWidth > 0) && (mHeight > 0) &&
+               ((mHeight - 1) * static_cast<size_t>(mStride) + (mWidth - 1) * mStep < mLimit);
+    }
+};
+
+using Mappings = std::vector<std::unique_ptr<Mapping>>;
+
+static bool setPlane(const mscl_buffer &buf, unsigned int idx, Mappings &maps, uint8_t *&base, size_t &limit)
+{
+    if ((idx >= buf.count) || (buf.offset[idx] < 0)) {
+        ALOGE("invalid plane %u of %u planes with offset %d", idx, buf.count, buf.offset[idx]);
+        return false;
+    }
+
+    maps.emplace_back(std::make_unique<Mapping>(buf.dmabuf[idx]));
+    if (!maps.back()->mAddr)
+        return false;
+
+    if (static_cast<size_t>(buf.offset[idx]) >= maps.back()->mLen) {
+        ALOGE("offset %d of plane %u is beyond the buffer of %zu bytes", buf.offset[idx], idx, maps.back()->mLen);
+        return false;
+    }
+
+    base = maps.back()->mAddr + buf.offset[idx];
+    limit = maps.back()->mLen - buf.offset[idx];
+
+    return true;
+}
+
+static bool getChannels(uint32_t fmt, uint32_t wh, uint32_t span, const mscl_buffer &buf,
+                        Mappings &maps, Channel channels[NR_CHANNELS])
+{
+    unsigned int width = wh >> 16;
+    unsigned int height = wh & 0xFFFF;
+    uint8_t *base;
+    size_t limit;
+
+    if (!setPlane(buf, 0, maps, base, limit))
+        return false;
+
+    if (fmt == MSCL_FMT_YUYV) {
+        unsigned int stride = (span & 0xFFFF) * 2;
+
+        channels[CHANNEL_Y] = {base, limit, 2, stride, width, height, 1, 1};
+        channels[CHANNEL_CB] = {base + 1, limit - 1, 4, stride, width / 2, height, 2, 1};
+        channels[CHANNEL_CR] = {base + 3, limit - 3, 4, stride, width / 2, height, 2, 1};
+    } else if ((fmt == MSCL_FMT_NV12) || (fmt == MSCL_FMT_NV21)) {
+        channels[CHANNEL_Y] = {base, limit, 1, span & 0xFFFF, width, height, 1, 1};
+
+        if (!setPlane(buf, 1, maps, base, limit))
+            return false;
+
+        unsigned int cb = (fmt == MSCL_FMT_NV12) ? 0 : 1;
+        channels[CHANNEL_CB] = {base + cb, limit - cb, 2, span >> 16, width / 2, height / 2, 2, 2};
+        channels[CHANNEL_CR] = {base + 1 - cb, limit - 1 + cb, 2, span >> 16, width / 2, height / 2, 2, 2};
+    } else {
+        ALOGE("unknown format %u", fmt);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < NR_CHANNELS; i++) {
+        if (!channels[i].valid()) {
+            ALOGE("channel %u of %ux%u image (fmt %u) overruns the buffer", i, width, height, fmt);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static inline double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return std::sin(x) / x;
+}
+
+// Returns the indices and the weights of @taps source samples around @pos.
+static void getWeights(double pos, int taps, int limit, std::vector<int> &indices, std::vector<double> &weights)
+{
+    int first = static_cast<int>(std::floor(pos)) - taps / 2 + 1;
+    double sum = 0.0;
+
+    indices.resize(taps);
+    weights.resize(taps);
+
+    for (int i = 0; i < taps; i++) {
+        double distance = pos - (first + i);
+
+        weights[i] = sinc(distance) * sinc(distance * 2 / taps);
+        indices[i] = std::clamp(first + i, 0, limit - 1);
+        sum += weights[i];
+    }
+
+    for (auto &weight: weights)
+        weight /= sum;
+}
+
+bool MsclEmulator::run(const mscl_task &task)
+{
+    Mappings maps;
+    Channel src[NR_CHANNELS];
+    Channel dst[NR_CHANNELS];
+
+    if (!getChannels(task.cmd[MSCL_SRC_CFG], task.cmd[MSCL_SRC_WH], task.cmd[MSCL_SRC_SPAN], task.buf[MSCL_SRC], maps, src))
+        return false;
+    if (!getChannels(task.cmd[MSCL_DST_CFG], task.cmd[MSCL_DST_WH], task.cmd[MSCL_DST_SPAN], task.buf[MSCL_DST], maps, dst))
+        return false;
+
+    bool rotate = (task.cmd[MSCL_ROT_CFG] & MSCL_ROTATE_MASK) == MSCL_ROTATE_270CCW;
+    unsigned int flip = task.cmd[MSCL_ROT_CFG] >> MSCL_FLIP_SHIFT;
+    // the ratio registers are in the orientation of the target
+    uint32_t hRatio = rotate ? task.cmd[MSCL_V_RATIO] : task.cmd[MSCL_H_RATIO];
+    uint32_t vRatio = rotate ? task.cmd[MSCL_H_RATIO] : task.cmd[MSCL_V_RATIO];
+    double hScale = static_cast<double>(hRatio) / (1 << FRACTION_BITS);
+    double vScale = static_cast<double>(vRatio) / (1 << FRACTION_BITS);
+    // the size of the scaled image before rotation
+    int scaledWidth = rotate ? dst[CHANNEL_Y].mHeight : dst[CHANNEL_Y].mWidth;
+    int scaledHeight = rotate ? dst[CHANNEL_Y].mWidth : dst[CHANNEL_Y].mHeight;
+
+    if ((hRatio == 0) || (vRatio == 0)) {
+        ALOGE("invalid scaling ratio %#x, %#x", hRatio, vRatio);
+        return false;
+    }
+
+    for (int c = 0; c < NR_CHANNELS; c++) {
+        uint32_t hPhase = task.cmd[(c == CHANNEL_Y) ? MSCL_SRC_YH_IPHASE : MSCL_SRC_CH_IPHASE];
+        uint32_t vPhase = task.cmd[(c == CHANNEL_Y) ? MSCL_SRC_YV_IPHASE : MSCL_SRC_CV_IPHASE];
+        double hOrigin = static_cast<double>(hPhase) / (1 << FRACTION_BITS);
+        double vOrigin = static_cast<double>(vPhase) / (1 << FRACTION_BITS);
+
+        if ((c != CHANNEL_Y) && (task.cmd[MSCL_SRC_CFG] != MSCL_FMT_YUYV))
+            hOrigin /= 2;
+
+        int width = scaledWidth / src[c].mHSub;
+        int height = scaledHeight / src[c].mVSub;
+        int srcWidth = src[c].mWidth;
+        int srcHeight = src[c].mHeight;
+        std::vector<double> horizontal(static_cast<size_t>(width) * srcHeight);
+        std::vector<double> scaled(static_cast<size_t>(width) * height);
+        std::vector<int> indices;
+        std::vector<double> weights;
+
+        for (int x = 0; x < width; x++) {
+            getWeights(hOrigin + x * hScale, N_HTAPS, srcWidth, indices, weights);
+            for (int y = 0; y < srcHeight; y++) {
+                double sum = 0.0;
+                for (int i = 0; i < N_HTAPS; i++)
+                    sum += weights[i] * src[c].at(indices[i], y);
+                horizontal[static_cast<size_t>(y) * width + x] = sum;
+            }
+        }
+
+        for (int y = 0; y < height; y++) {
+            getWeights(vOrigin + y * vScale, N_VTAPS, srcHeight, indices, weights);
+            for (int x = 0; x < width; x++) {
+                double sum = 0.0;
+                for (int i = 0; i < N_VTAPS; i++)
+                    sum += weights[i] * horizontal[static_cast<size_t>(indices[i]) * width + x];
+                scaled[static_cast<size_t>(y) * width + x] = sum;
+            }
+        }
+
+        // flip and then rotate clockwise by 90 degrees
+        for (unsigned int dy = 0; dy < dst[c].mHeight; dy++) {
+            for (unsigned int dx = 0; dx < dst[c].mWidth; dx++) {
+                double x = (dx + 0.5) * dst[c].mHSub - 0.5;
+                double y = (dy + 0.5) * dst[c].mVSub - 0.5;
+                double u = rotate ? y : x;
+                double v = rotate ? (scaledHeight - 1 - x) : y;
+
+                if (flip & MSCL_FLIP_H)
+                    u = scaledWidth - 1 - u;
+                if (flip & MSCL_FLIP_V)
+                    v = scaledHeight - 1 - v;
+
+                int sx = std::clamp(static_cast<int>(std::lround((u + 0.5) / src[c].mHSub - 0.5)), 0, width - 1);
+                int sy = std::clamp(static_cast<int>(std::lround((v + 0.5) / src[c].mVSub - 0.5)), 0, height - 1);
+                double value = std::lround(scaled[static_cast<size_t>(sy) * width + sx]);
+
+                dst[c].at(dx, dy) = static_cast<uint8_t>(std::clamp(value, 0.0, 255.0));
+            }
+        }
+
+        mStats.mBytesRead += static_cast<uint64_t>(srcWidth) * srcHeight;
+        mStats.mBytesWritten += static_cast<uint64_t>(dst[c].mWidth) * dst[c].mHeight;
+    }
+
+    mStats.mTasks++;
+
+    return true;
+}
+
+bool MsclEmulator::run(const mscl_job &job)
+{
+    for (unsigned int i = 0; i < job.taskcount; i++) {
+        if (!run(job.tasks[i])) {
+            ALOGE("failed to emulate task %u of %u", i, job.taskcount);
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef _GIANT_MSCL_EMULATOR_H_
+#define _GIANT_MSCL_EMULATOR_H_
+
+#include <cinttypes>
+#include <vector>
+
+#include "uapi.h"
+
+// MsclEmulator executes the tasks of a MSCL job with CPU.
+// It maps the dmabufs in the tasks with mmap() and produces the pixels of the
+// target images so that the task lists generated by GiantMsclImpl can be
+// validated without MSCL. The interpolation filter is a windowed sinc with
+// N_HTAPS and N_VTAPS taps. It is not bit-exact to MSCL but the position of
+// every sample follows the registers of the task:
+//   position = initial phase + (index of the target sample) * ratio
+// where the initial phase of the chroma is given in the units of chroma samples
+// except the horizontal phase of YCbCr420 semi-planar that is given in pixels.
+// The samples out of the source window are replaced with the samples at the
+// edge of the window like MSCL does.
+class MsclEmulator {
+public:
+    struct Stats {
+        uint64_t mTasks = 0;
+        uint64_t mBytesRead = 0;
+        uint64_t mBytesWritten = 0;
+    };
+
+    bool run(const mscl_job &job);
+    bool run(const mscl_task &task);
+
+    const Stats &stats() const { return mStats; }
+    void resetStats() { mStats = Stats(); }
+
+private:
+    Stats mStats;
+};
+
+#endif //_GIANT_MSCL_EMULATOR_H_
@@ -41,6 +41,16 @@ bool GiantMscl::run(int src_buffer[], int dst_buffer[])
     return mImpl && mImpl->run(src_buffer, dst_buffer);
 }
 
+int GiantMscl::runAsync(int src_buffer[], int dst_buffer[])
+{
+    return mImpl ? mImpl->runAsync(src_buffer, dst_buffer) : -1;
+}
+
+bool GiantMscl::wait()
+{
+    return mImpl && mImpl->wait();
+}
+
 bool GiantMscl::okay()
 {
     return mImpl && mImpl->available();
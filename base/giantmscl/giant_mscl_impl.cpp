@@ -1,10 +1,14 @@
 #include <fcntl.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <log/log.h>
 
+#include <algorithm>
+#include <memory>
+
 #include <exynos_format.h> // hardware/smasung_slsi/exynos/include
 
 #include "log.h"
@@ -12,14 +16,9 @@
 
 #include "debug.h"
 
-#define MSCL_FMT_NV12 0
-#define MSCL_FMT_NV21 16
-#define MSCL_FMT_YUYV 10
-
-const static unsigned int NR_PIXELS_8K = 8192;
-const static unsigned int NR_PIXELS_16K = 16384;
-
+#ifndef USE_GIANT_MSCL_EMULATOR
 const static char *giant_mscl_dev = "/dev/scaler_ext";
+#endif
 
 unsigned int hal_to_dev_format_table[][2] = {
     {HAL_PIXEL_FORMAT_YCBCR_422_I, MSCL_FMT_YUYV},
@@ -101,13 +100,20 @@ GiantMsclImpl::GiantMsclImpl(bool suppress_error)
     mSrcImage = std::make_tuple(16, 16, HAL_PIXEL_FORMAT_YCRCB_420_SP);
     mDstImage = std::make_tuple(4, 4, HAL_PIXEL_FORMAT_YCRCB_420_SP);
 
+#ifdef USE_GIANT_MSCL_EMULATOR
+    (void)suppress_error;
+    mFdDev = -1;
+#else
     mFdDev = ::open(giant_mscl_dev, O_WRONLY);
     if (!suppress_error && (mFdDev < 0))
         ALOGERR("failed to open %s", giant_mscl_dev);
+#endif
 }
 
 GiantMsclImpl::~GiantMsclImpl()
 {
+    wait();
+
     if (mFdDev >= 0)
         ::close(mFdDev);
 }
@@ -123,6 +129,7 @@ bool GiantMsclImpl::setSrc(unsigned int srcw, unsigned int srch, unsigned int fm
 
     mSrcImage = std::make_tuple(srcw, srch, fmt);
     mTransform = transform;
+    mPlan.clear();
     return true;
 }
 
@@ -131,135 +138,201 @@ bool GiantMsclImpl::setDst(unsigned int dstw, unsigned int dsth, unsigned int fm
         return false;
 
     mDstImage = std::make_tuple(dstw, dsth, fmt);
+    mPlan.clear();
     return true;
 }
 
 bool GiantMsclImpl::run(int src_buffer[], int dst_buffer[])
 {
-    mscl_job job;
-    mscl_task task[6];
-    job.tasks = task;
+    Job job;
+
+    if (!prepare(job, src_buffer, dst_buffer))
+        return false;
+
+    finishPendingJob();
+    trimBufferCache();
+
+    return submit(job);
+}
+
+// Returns a file descriptor that becomes readable when the job is completed.
+// The caller should close the returned file descriptor and call wait() to get
+// the result of the job. If the previous job is not waited for, its failure is
+// reported by the next wait(). The buffers in @src_buffer and @dst_buffer should be
+// valid until the job is completed.
+int GiantMsclImpl::runAsync(int src_buffer[], int dst_buffer[])
+{
+    auto job = std::make_shared<Job>();
+
+    // preparing a job is overlapped with the processing of the previous job
+    if (!prepare(*job, src_buffer, dst_buffer))
+        return -1;
+
+    int fence = ::eventfd(0, EFD_CLOEXEC);
+    if (fence < 0) {
+        ALOGERR("failed to create a completion fence");
+        return -1;
+    }
+
+    // the caller is allowed to close the fence before the job is completed.
+    int signal = ::dup(fence);
+    if (signal < 0) {
+        ALOGERR("failed to duplicate the completion fence");
+        ::close(fence);
+        return -1;
+    }
+
+    finishPendingJob();
+    trimBufferCache();
 
+    mPendingJob = std::async(std::launch::async, [this, job, signal] {
+        bool result = submit(*job);
+        uint64_t completed = 1;
+
+        if (::write(signal, &completed, sizeof(completed)) < 0)
+            ALOGERR("failed to signal the completion fence");
+        ::close(signal);
+
+        return result;
+    });
+
+    return fence;
+}
+
+bool GiantMsclImpl::wait()
+{
+    finishPendingJob();
+
+    bool result = !mJobFailed;
+    mJobFailed = false;
+    return result;
+}
+
+void GiantMsclImpl::finishPendingJob()
+{
+    if (mPendingJob.valid() && !mPendingJob.get())
+        mJobFailed = true;
+}
+
+bool GiantMsclImpl::prepare(Job &job, int src_buffer[], int dst_buffer[])
+{
     mBufferStore.clear();
+    mRunCount++;
 
-    job.taskcount = generate(task, 6, src_buffer, dst_buffer);
-    if (job.taskcount < 1) {
+    int count = generate(job.mTasks, MAX_TASKS, src_buffer, dst_buffer);
+    if (count < 1)
         return false;
-    }
 
-    job.version = 0;
+    job.mTaskCount = static_cast<unsigned int>(count);
 
-    showJob(&job);
-    if (::ioctl(mFdDev, MSCL_IOC_JOB, &job) < 0) {
+    return true;
+}
+
+bool GiantMsclImpl::submit(Job &job)
+{
+    mscl_job desc;
+
+    desc.version = 0;
+    desc.taskcount = job.mTaskCount;
+    desc.tasks = job.mTasks;
+
+    showJob(&desc);
+#ifdef USE_GIANT_MSCL_EMULATOR
+    if (!mEmulator.run(desc)) {
+        ALOGE("failed to emulate Giant MSCL");
+        return false;
+    }
+#else
+    if (::ioctl(mFdDev, MSCL_IOC_JOB, &desc) < 0) {
         ALOGERR("failed to run Giant MSCL");
         return false;
     }
+#endif
 
     return true;
 }
 
-static inline unsigned int round_up(unsigned int val, unsigned int factor)
+const Buffer *GiantMsclImpl::getIntermediateBuffer(const Image &img)
 {
-    // factor & (factor - 1) == 0.
-    //return ((val + factor - 1) / factor) * factor;
-    return (val + factor - 1) & ~(factor - 1);
+    for (auto &ent: mBufferCache) {
+        // a buffer should not be shared by the stages of a job
+        if ((ent.mImage == img) && (ent.mLastUsed != mRunCount)) {
+            ent.mLastUsed = mRunCount;
+            return &ent.mBuffer;
+        }
+    }
+
+    mBufferCache.emplace_back(img);
+    if (mBufferCache.back().mBuffer.get(0) < 0) {
+        mBufferCache.pop_back();
+        return nullptr;
+    }
+
+    mBufferCache.back().mLastUsed = mRunCount;
+
+    return &mBufferCache.back().mBuffer;
 }
-static inline bool is_aligned(unsigned int val, unsigned int factor)
+
+// It should be called when no job is in flight except the one prepared the last.
+void GiantMsclImpl::trimBufferCache()
 {
-    // factor & (factor - 1) == 0.
-    return !(val & (factor - 1));
+    while (mBufferCache.size() > MAX_CACHED_BUFFERS) {
+        auto victim = std::min_element(mBufferCache.begin(), mBufferCache.end(),
+                                       [] (const CachedBuffer &a, const CachedBuffer &b) {
+                                           return a.mLastUsed < b.mLastUsed;
+                                       });
+        if (victim->mLastUsed == mRunCount)
+            break;
+
+        mBufferCache.erase(victim);
+    }
 }
 
 int GiantMsclImpl::generate(mscl_task tasks[], unsigned int count, int src_buffer[], int dst_buffer[])
 {
     unsigned int task_count = 0;
-    unsigned int srcBufferIdx = 0;
-    Image target = mSrcImage;
+
+    if (mPlan.empty() && (mPlanner.plan(mSrcImage, mDstImage, mTransform, mPlan) == 0)) {
+        ALOGE("no stages found to scale %ux%u to %ux%u with transform %#x",
+              width(mSrcImage), height(mSrcImage), width(mDstImage), height(mDstImage), mTransform);
+        return -1;
+    }
 
     mBufferStore.emplace_back(src_buffer, format(mSrcImage), width(mSrcImage), height(mSrcImage));
     // last element of mBufferStore is always the destination buffer.
     mBufferStore.emplace_back(dst_buffer, format(mDstImage), width(mDstImage), height(mDstImage));
 
-    do {
-        Image source = target;
-
-        unsigned int srcWidth = width(source);
-        unsigned int srcHeight = height(source);
-
-        if (rotate90(mTransform))
-            std::swap(srcWidth, srcHeight);
-
-        unsigned int targetWidth, targetHeight;
-
-        if (srcWidth > width(mDstImage)) {
-            targetWidth = std::max(makeEven(round_up(srcWidth, 4) / 4), width(mDstImage));
-            if (srcWidth > NR_PIXELS_8K)
-                targetWidth = round_up(targetWidth, 4);
-        } else {
-            targetWidth = std::min(srcWidth * 8, width(mDstImage));
-            // if targetWidth is larger than 8K, the restriction by partitioned processing is checked by setDst().
-            // if srcWidth is not proper for partitioned procesing, insert an upscaling without partitioning.
-            if (targetWidth > NR_PIXELS_8K) {
-                unsigned int factor = 4;
-                if (rotate90(mTransform) && (format(source) == HAL_PIXEL_FORMAT_YCBCR_422_I))
-                    factor = 2;
-                if (!is_aligned(srcWidth, factor))
-                    targetWidth = NR_PIXELS_8K;
-            }
-        }
-
-        if (srcHeight > height(mDstImage)) {
-            targetHeight = std::max(makeEven(round_up(srcHeight, 4) / 4), height(mDstImage));
-            if (srcHeight > NR_PIXELS_8K) {
-                if (format(mDstImage) == HAL_PIXEL_FORMAT_YCBCR_422_I)
-                    targetHeight = round_up(targetHeight, 2);
-                else
-                    targetHeight = round_up(targetHeight, 4);
-            }
-        } else {
-            targetHeight = std::min(srcHeight * 8, height(mDstImage));
-            if (targetHeight > NR_PIXELS_8K) {
-                unsigned int factor = 4;
-                if (!rotate90(mTransform) && (format(source) == HAL_PIXEL_FORMAT_YCBCR_422_I))
-                    factor = 2;
-                if (!is_aligned(srcHeight, factor))
-                    targetHeight = NR_PIXELS_8K;
-            }
-        }
-
-        target = std::make_tuple(targetWidth, targetHeight, format(mDstImage));
-
+    for (unsigned int i = 0; i < mPlan.size(); i++) {
+        const auto &stage = mPlan[i];
         unsigned int targetBufferIdx = mBufferStore.size() - 1;
-        if (target != mDstImage) {
-            targetBufferIdx = srcBufferIdx + 1;
-            auto iter = mBufferStore.emplace(mBufferStore.begin() + targetBufferIdx,
-                                             format(target), width(target), height(target));
-            if (iter->get(0) < 0)
+
+        if (i + 1 < mPlan.size()) {
+            const Buffer *buffer = getIntermediateBuffer(stage.mTarget);
+            if (!buffer)
                 return -1;
+
+            targetBufferIdx = i + 1;
+            mBufferStore.emplace(mBufferStore.begin() + targetBufferIdx, buffer->borrow());
         }
 
-        int ret = generateTask(source, target, srcBufferIdx, targetBufferIdx, &tasks[task_count], count - task_count);
+        int ret = generateTask(stage.mSource, stage.mTarget, i, targetBufferIdx, stage.mTransform,
+                               &tasks[task_count], count - task_count);
         if (ret < 1)
             return ret;
 
         task_count += ret;
-        srcBufferIdx++;
-    } while (target != mDstImage);
+    }
 
     return static_cast<int>(task_count);
 }
 
 int GiantMsclImpl::generateTask(const Image &source, const Image &target,
                             unsigned int src_buf_idx, unsigned int dst_buf_idx,
-                            mscl_task tasks[], unsigned int count) {
+                            unsigned int transform, mscl_task tasks[], unsigned int count) {
     unsigned int task_count = 0;
 
-    // TODO: We rotate/flip image at the first stage for the simple design.
-    //       It is efficient unless the destination size is smaller than source/4.
-    //       To tackle this unefficiency in extreme downscaling with rotation/flip,
-    //       we should introduce an improved design to defer roation/flip until the
-    //       last stage of downscaling.
-    Task task(source, target, mBufferStore[src_buf_idx], mBufferStore[dst_buf_idx], mTransform);
+    // StagePlanner decides the stage to rotate/flip the image.
+    Task task(source, target, mBufferStore[src_buf_idx], mBufferStore[dst_buf_idx], transform);
 
     do {
         if (task_count >= count)
@@ -268,8 +341,6 @@ int GiantMsclImpl::generateTask(const Image &source, const Image &target,
         task.fill(tasks[task_count++]);
     } while (task.next());
 
-    mTransform = 0;
-
     return task_count;
 }
 
@@ -406,12 +477,11 @@ void GiantMsclImpl::Task::fill(mscl_task &task_desc) {
         task_desc.buf[MSCL_SRC].offset[i] = mSrcBuffer.getByteOffset(
             i, srcHOffset - horizontalDisplacement, srcVOffset - verticalDisplacement, hStride(mSource));
         // We only support YCbCr422 interleaved (YUYV) and YCbCr420 semi-planar(nv12/nv21)
-        // Chage to displacement is only applicable to planar formats
-        // because it is aplied to buffer offset calculations.
-        // But horizontalDisplacement is not divided for semi-planar format
-        // because the stride of chroma is the same as luma.
-        // See the fact below that vertical initial phase of chroma of nv12/nv21 is also divided by 2.
-        verticalDisplacement /= 2;
+        // The displacements are given in luma pixels to the buffer offset calculations
+        // that already consider the subsampling of chroma. So, the displacements are the same
+        // for all planes while the vertical initial phase of chroma of nv12/nv21 is divided by 2
+        // because it is given in chroma lines. Dividing verticalDisplacement for chroma makes
+        // the offset point to the middle of a chroma line.
     }
 
     if (needHorizontalInterpolation && (srcHOffset > 0)) {	// NOTE: if the source plane is on the right
@@ -430,8 +500,8 @@ void GiantMsclImpl::Task::fill(mscl_task &task_desc) {
     if (needVerticalInterpolation && (srcVOffset > 0)) {
         task_desc.cmd[MSCL_SRC_YV_IPHASE] = (N_VTAPS / 2) << FRACTION_BITS;
         task_desc.cmd[MSCL_SRC_CV_IPHASE] = task_desc.cmd[MSCL_SRC_YV_IPHASE];
-        // Chroma of nv12/nv21 is horizontally subsampled.
-        if ((getDeviceFormat(format(mSource)) == MSCL_FMT_NV12) || (getDeviceFormat(format(mSource)) == MSCL_FMT_NV12))
+        // Chroma of nv12/nv21 is vertically subsampled.
+        if ((getDeviceFormat(format(mSource)) == MSCL_FMT_NV12) || (getDeviceFormat(format(mSource)) == MSCL_FMT_NV21))
             task_desc.cmd[MSCL_SRC_CV_IPHASE] /= 2;
     }
 
@@ -2,6 +2,8 @@
 #define _GIANT_MSCL_IMPL_H_
 
 #include <cinttypes>
+#include <future>
+#include <list>
 #include <vector>
 #include <tuple>
 
@@ -9,6 +11,10 @@
 
 #include "uapi.h"
 #include "buffer.h"
+#include "planner.h"
+#ifdef USE_GIANT_MSCL_EMULATOR
+#include "emulator.h"
+#endif
 
 using TransformCoord = std::tuple<int, int>;
 
@@ -20,13 +26,44 @@ public:
     bool setSrc(unsigned int srcw, unsigned int srch, unsigned int fmt, unsigned int transform = 0);
     bool setDst(unsigned int dstw, unsigned int dsth, unsigned int fmt);
     bool run(int src_buffer[], int dst_buffer[]);
+    int runAsync(int src_buffer[], int dst_buffer[]);
+    bool wait();
+#ifdef USE_GIANT_MSCL_EMULATOR
+    bool available() { return true; }
+#else
     bool available() { return !(mFdDev < 0); }
+#endif
 
 private:
-    using Image = std::tuple<unsigned int, unsigned int, unsigned int>;
+    using Image = StagePlanner::Image;
 
+    const static unsigned int MAX_TASKS = 6;
+    // The number of intermediate buffers kept after a job is completed.
+    // A job with the largest scaling ratio needs at most three intermediate buffers.
+    const static size_t MAX_CACHED_BUFFERS = 4;
+
+    struct Job {
+        mscl_task mTasks[MAX_TASKS];
+        unsigned int mTaskCount = 0;
+    };
+
+    struct CachedBuffer {
+        CachedBuffer(const Image &img)
+            : mImage(img), mBuffer(format(img), width(img), height(img)) { }
+
+        Image mImage;
+        Buffer mBuffer;
+        unsigned long mLastUsed = 0;
+    };
+
+    bool prepare(Job &job, int src_buffer[], int dst_buffer[]);
+    bool submit(Job &job);
+    // waits for the job of runAsync() and latches its failure for wait()
+    void finishPendingJob();
     // -1: error 0: @count is not sufficient, > 0: okay.
     int generate(mscl_task tasks[], unsigned int count, int src_buffer[], int dst_buffer[]);
+    const Buffer *getIntermediateBuffer(const Image &img);
+    void trimBufferCache();
 
     static inline unsigned int width(const Image &img) { return std::get<0>(img); }
     static inline unsigned int height(const Image &img) { return std::get<1>(img); }
@@ -34,11 +71,10 @@ private:
     static inline bool rotate90(unsigned int transform) { return (transform & HAL_TRANSFORM_ROT_90) != 0; }
     static inline bool vFlip(unsigned int transform) { return (transform & HAL_TRANSFORM_FLIP_V) != 0; }
     static inline bool hFlip(unsigned int transform) { return (transform & HAL_TRANSFORM_FLIP_H) != 0; }
-    static inline unsigned int makeEven(unsigned int val) { return (val + 1) & ~1; }
 
     int generateTask(const Image &source, const Image &target,
                      unsigned int src_buf_idx, unsigned int dst_buf_idx,
-                     mscl_task tasks[], unsigned int count);
+                     unsigned int transform, mscl_task tasks[], unsigned int count);
 
     struct Task {
         const static uint32_t FRACTION_BITS = 20;
@@ -84,7 +120,18 @@ private:
         std::vector<TransformCoord> mDstPlaneCoord;
     };
 
+    StagePlanner mPlanner{MAX_TASKS};
+    // the plan is valid until the source or the destination image is changed.
+    StagePlanner::Plan mPlan;
     std::vector<Buffer> mBufferStore;
+    // std::list does not invalidate the references to the buffers on insertion and removal.
+    std::list<CachedBuffer> mBufferCache;
+    unsigned long mRunCount = 0;
+    std::future<bool> mPendingJob;
+    bool mJobFailed = false;
+#ifdef USE_GIANT_MSCL_EMULATOR
+    MsclEmulator mEmulator;
+#endif
     Image mSrcImage;
     Image mDstImage;
     unsigned int mTransform = 0;
@@ -13,6 +13,12 @@ public:
     bool setSrc(unsigned int srcw, unsigned int srch, unsigned int fmt, unsigned int transform = 0);
     bool setDst(unsigned int dstw, unsigned int dsth, unsigned int fmt);
     bool run(int src_buffer[], int dst_buffer[]);
+    // Returns a file descriptor that is readable after the job completes or -1 on failure.
+    // The caller owns the returned file descriptor. wait() returns the result of the job.
+    // A job that is not waited for before the next run is still reported: wait() returns
+    // false if any job of runAsync() has failed since the last wait().
+    int runAsync(int src_buffer[], int dst_buffer[]);
+    bool wait();
     operator bool() { return okay(); }
     bool okay();
 private:
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+
+#include "planner.h"
+
+// The intermediate images are aligned by 4 if they are larger than 8K
+// because they are partitioned into two images of the same size.
+const static unsigned int PARTITION_ALIGN = 4;
+// the number of stages tried more than the minimum number of stages
+const static unsigned int NR_EXTRA_STAGES = 2;
+
+const static unsigned int N_HTAPS = 8;
+const static unsigned int N_VTAPS = 4;
+
+// The cost is the estimated number of bytes transferred by MSCL.
+// The overhead to configure a task and to wait for its completion is
+// regarded as 256KiB of memory traffic.
+const static uint64_t TASK_OVERHEAD_BYTES = 256 * 1024;
+// Rotation by 90 degrees makes the write DMA access the memory in columns
+// which halves the bandwidth of the write.
+const static uint64_t ROTATION_WRITE_PENALTY = 2;
+
+static inline unsigned int round_up(unsigned int val, unsigned int factor)
+{
+    return (val + factor - 1) & ~(factor - 1);
+}
+
+static inline unsigned int round_down(unsigned int val, unsigned int factor)
+{
+    return val & ~(factor - 1);
+}
+
+static inline unsigned int makeEven(unsigned int val)
+{
+    return round_up(val, 2);
+}
+
+static inline unsigned int verticalAlign(unsigned int format)
+{
+    // YCbCr422 interleaved has no vertical chroma subsampling
+    return (format == HAL_PIXEL_FORMAT_YCBCR_422_I) ? 2 : 4;
+}
+
+static inline unsigned int bitsPerPixel(unsigned int format)
+{
+    return (format == HAL_PIXEL_FORMAT_YCBCR_422_I) ? 16 : 12;
+}
+
+static unsigned int countStages(unsigned int from, unsigned int to)
+{
+    unsigned int count = 0;
+
+    while (from > to * StagePlanner::MAX_DOWNSCALE) {
+        to *= StagePlanner::MAX_DOWNSCALE;
+        count++;
+    }
+
+    while (from * StagePlanner::MAX_UPSCALE < to) {
+        from *= StagePlanner::MAX_UPSCALE;
+        count++;
+    }
+
+    return count + 1;
+}
+
+// Rounds @val towards @from that the scaling factor from @from is not increased.
+static unsigned int alignIntermediate(unsigned int val, unsigned int from, unsigned int align)
+{
+    bool down = val < from;
+
+    val = down ? makeEven(val) : round_down(val, 2);
+    if (val > NR_PIXELS_8K)
+        val = down ? round_up(val, align) : round_down(val, align);
+
+    return val;
+}
+
+bool StagePlanner::distribute(Distribution dist, unsigned int from, unsigned int to,
+                              unsigned int count, unsigned int align, Sizes &sizes)
+{
+    sizes.assign(count + 1, to);
+    sizes[0] = from;
+
+    if (dist == FRONT) {
+        for (unsigned int i = 1; i < count; i++) {
+            unsigned int prev = sizes[i - 1];
+
+            if (prev > to) {
+                sizes[i] = std::max(makeEven(round_up(prev, 4) / MAX_DOWNSCALE), to);
+                if (prev > NR_PIXELS_8K)
+                    sizes[i] = round_up(sizes[i], align);
+            } else if (prev < to) {
+                sizes[i] = std::min(prev * MAX_UPSCALE, to);
+                // the partitioned processing requires the aligned source
+                if ((sizes[i] > NR_PIXELS_8K) && (prev % align))
+                    sizes[i] = NR_PIXELS_8K;
+            } else {
+                sizes[i] = to;
+            }
+        }
+    } else if (dist == BACK) {
+        for (unsigned int i = count - 1; i > 0; i--) {
+            unsigned int next = sizes[i + 1];
+
+            if (from > to)
+                sizes[i] = std::min(next * MAX_DOWNSCALE, from);
+            else
+                sizes[i] = std::max((next + MAX_UPSCALE - 1) / MAX_UPSCALE, from);
+
+            sizes[i] = alignIntermediate(sizes[i], next, align);
+        }
+    } else {
+        double ratio = static_cast<double>(to) / from;
+
+        for (unsigned int i = 1; i < count; i++) {
+            double size = from * std::pow(ratio, static_cast<double>(i) / count);
+
+            if (from > to)
+                sizes[i] = alignIntermediate(static_cast<unsigned int>(std::ceil(size)), from, align);
+            else
+                sizes[i] = alignIntermediate(static_cast<unsigned int>(size), from, align);
+        }
+    }
+
+    for (unsigned int i = 1; i < count; i++) {
+        if ((sizes[i] < 4) || (sizes[i] > NR_PIXELS_16K))
+            return false;
+        // the sizes should change monotonically
+        if ((from > to) ? (sizes[i] > sizes[i - 1]) : (sizes[i] < sizes[i - 1]))
+            return false;
+    }
+
+    return true;
+}
+
+unsigned int StagePlanner::validate(const Stage &stage)
+{
+    unsigned int srcWidth = width(stage.mSource);
+    unsigned int srcHeight = height(stage.mSource);
+    unsigned int srcFormat = format(stage.mSource);
+    unsigned int dstWidth = width(stage.mTarget);
+    unsigned int dstHeight = height(stage.mTarget);
+    unsigned int dstFormat = format(stage.mTarget);
+    bool rotate = rotate90(stage.mTransform);
+
+    if ((srcWidth & 1) || (dstWidth & 1))
+        return 0;
+    if ((srcFormat != HAL_PIXEL_FORMAT_YCBCR_422_I) && (srcHeight & 1))
+        return 0;
+    if ((dstFormat != HAL_PIXEL_FORMAT_YCBCR_422_I) && (dstHeight & 1))
+        return 0;
+    if ((std::max(srcWidth, srcHeight) > NR_PIXELS_16K) || (std::max(dstWidth, dstHeight) > NR_PIXELS_16K))
+        return 0;
+    if ((std::min(srcWidth, srcHeight) < 4) || (std::min(dstWidth, dstHeight) < 4))
+        return 0;
+
+    // the alignment of the target in the orientation of the source
+    unsigned int dstHAlign = rotate ? verticalAlign(dstFormat) : PARTITION_ALIGN;
+    unsigned int dstVAlign = rotate ? PARTITION_ALIGN : verticalAlign(dstFormat);
+
+    if (rotate)
+        std::swap(dstWidth, dstHeight);
+
+    if ((srcWidth > dstWidth * MAX_DOWNSCALE) || (dstWidth > srcWidth * MAX_UPSCALE))
+        return 0;
+    if ((srcHeight > dstHeight * MAX_DOWNSCALE) || (dstHeight > srcHeight * MAX_UPSCALE))
+        return 0;
+
+    unsigned int count = 1;
+
+    if ((srcWidth > NR_PIXELS_8K) || (dstWidth > NR_PIXELS_8K)) {
+        if ((srcWidth % PARTITION_ALIGN) || (dstWidth % dstHAlign))
+            return 0;
+        count *= 2;
+    }
+
+    if ((srcHeight > NR_PIXELS_8K) || (dstHeight > NR_PIXELS_8K)) {
+        if ((srcHeight % verticalAlign(srcFormat)) || (dstHeight % dstVAlign))
+            return 0;
+        count *= 2;
+    }
+
+    return count;
+}
+
+uint64_t StagePlanner::cost(const Stage &stage)
+{
+    uint64_t srcWidth = width(stage.mSource);
+    uint64_t srcHeight = height(stage.mSource);
+    uint64_t srcBpp = bitsPerPixel(format(stage.mSource));
+    uint64_t dstPixels = static_cast<uint64_t>(width(stage.mTarget)) * height(stage.mTarget);
+
+    uint64_t read = srcWidth * srcHeight;
+    // partitioned images read the pixels of the neighbor for the interpolation
+    if ((stage.mTaskCount > 1) && (srcWidth > NR_PIXELS_8K))
+        read += N_HTAPS * srcHeight;
+    if ((stage.mTaskCount > 1) && (srcHeight > NR_PIXELS_8K))
+        read += N_VTAPS * srcWidth;
+    read = read * srcBpp / 8;
+
+    uint64_t write = dstPixels * bitsPerPixel(format(stage.mTarget)) / 8;
+    if (rotate90(stage.mTransform))
+        write *= ROTATION_WRITE_PENALTY;
+
+    return read + write + stage.mTaskCount * TASK_OVERHEAD_BYTES;
+}
+
+uint64_t StagePlanner::cost(const Plan &plan)
+{
+    uint64_t sum = 0;
+
+    for (auto &stage: plan)
+        sum += cost(stage);
+
+    return sum;
+}
+
+bool StagePlanner::build(const Image &src, const Image &dst, unsigned int transform,
+                         const Sizes &widths, const Sizes &heights, unsigned int rotstage, Plan &plan) const
+{
+    unsigned int count = widths.size() - 1;
+    unsigned int nr_tasks = 0;
+    Image source = src;
+
+    plan.clear();
+
+    for (unsigned int i = 0; i < count; i++) {
+        // @widths and @heights are in the orientation of the source image
+        bool rotated = rotate90(transform) && (i >= rotstage);
+        Image target = dst;
+
+        if (i + 1 < count) {
+            if (rotated)
+                target = std::make_tuple(heights[i + 1], widths[i + 1], format(dst));
+            else
+                target = std::make_tuple(widths[i + 1], heights[i + 1], format(dst));
+        }
+
+        Stage stage{source, target, (i == rotstage) ? transform : 0, 0};
+
+        stage.mTaskCount = validate(stage);
+        if (stage.mTaskCount == 0)
+            return false;
+
+        nr_tasks += stage.mTaskCount;
+        if (nr_tasks > mMaxTasks)
+            return false;
+
+        plan.push_back(stage);
+        source = target;
+    }
+
+    return true;
+}
+
+std::vector<StagePlanner::Plan> StagePlanner::enumerate(const Image &src, const Image &dst, unsigned int transform) const
+{
+    std::vector<Plan> plans;
+    unsigned int dstWidth = rotate90(transform) ? height(dst) : width(dst);
+    unsigned int dstHeight = rotate90(transform) ? width(dst) : height(dst);
+    unsigned int minStages = std::max(countStages(width(src), dstWidth), countStages(height(src), dstHeight));
+    unsigned int maxStages = std::min(minStages + NR_EXTRA_STAGES, mMaxTasks);
+
+    for (unsigned int count = minStages; count <= maxStages; count++) {
+        for (int wdist = FRONT; wdist < NR_DISTRIBUTIONS; wdist++) {
+            Sizes widths;
+
+            if (!distribute(static_cast<Distribution>(wdist), width(src), dstWidth, count, PARTITION_ALIGN, widths))
+                continue;
+
+            for (int hdist = FRONT; hdist < NR_DISTRIBUTIONS; hdist++) {
+                Sizes heights;
+
+                if (!distribute(static_cast<Distribution>(hdist), height(src), dstHeight, count, PARTITION_ALIGN, heights))
+                    continue;
+
+                // flip without rotation costs nothing at any stage
+                unsigned int nr_rotstages = rotate90(transform) ? count : 1;
+                for (unsigned int rotstage = 0; rotstage < nr_rotstages; rotstage++) {
+                    Plan plan;
+
+                    if (build(src, dst, transform, widths, heights, rotstage, plan))
+                        plans.push_back(std::move(plan));
+                }
+            }
+        }
+    }
+
+    return plans;
+}
+
+void StagePlanner::legacy(const Image &src, const Image &dst, unsigned int transform, Plan &plan) const
+{
+    unsigned int dstWidth = rotate90(transform) ? height(dst) : width(dst);
+    unsigned int dstHeight = rotate90(transform) ? width(dst) : height(dst);
+    unsigned int minStages = std::max(countStages(width(src), dstWidth), countStages(height(src), dstHeight));
+
+    for (unsigned int count = minStages; count <= mMaxTasks; count++) {
+        Sizes widths, heights;
+
+        if (distribute(FRONT, width(src), dstWidth, count, PARTITION_ALIGN, widths) &&
+            distribute(FRONT, height(src), dstHeight, count, PARTITION_ALIGN, heights) &&
+            build(src, dst, transform, widths, heights, 0, plan))
+            return;
+    }
+
+    plan.clear();
+}
+
+uint64_t StagePlanner::plan(const Image &src, const Image &dst, unsigned int transform, Plan &plan) const
+{
+    uint64_t best = 0;
+
+    plan.clear();
+
+    // the candidates with less stages are enumerated earlier and preferred on a tie
+    for (auto &candidate: enumerate(src, dst, transform)) {
+        uint64_t sum = cost(candidate);
+        if ((best == 0) || (sum < best)) {
+            best = sum;
+            plan = std::move(candidate);
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,73 @@
+#ifndef _GIANT_MSCL_PLANNER_H_
+#define _GIANT_MSCL_PLANNER_H_
+
+#include <cinttypes>
+#include <vector>
+#include <tuple>
+
+#include <system/graphics.h>
+
+const static unsigned int NR_PIXELS_8K = 8192;
+const static unsigned int NR_PIXELS_16K = 16384;
+
+// StagePlanner splits a scaling job into stages that MSCL can process.
+// It enumerates the candidate stage sequences with different number of stages,
+// distribution of scaling factors and the stage where rotation/flip is applied,
+// and chooses the one with the lowest estimated memory traffic.
+class StagePlanner {
+public:
+    using Image = std::tuple<unsigned int, unsigned int, unsigned int>;
+
+    struct Stage {
+        Image mSource;
+        Image mTarget;
+        unsigned int mTransform;
+        // 1: no partition, 2: partitioned horizontally or vertically, 4: both
+        unsigned int mTaskCount;
+    };
+
+    using Plan = std::vector<Stage>;
+
+    const static unsigned int MAX_DOWNSCALE = 4;
+    const static unsigned int MAX_UPSCALE = 8;
+
+    StagePlanner(unsigned int max_tasks) : mMaxTasks(max_tasks) { }
+
+    // Returns the estimated cost of @plan or 0 if no plan is found.
+    uint64_t plan(const Image &src, const Image &dst, unsigned int transform, Plan &plan) const;
+    // Returns all valid candidate plans. It is exposed for the tests.
+    std::vector<Plan> enumerate(const Image &src, const Image &dst, unsigned int transform) const;
+    // Returns the plan of the former fixed strategy that scales by up to x4 down/x8 up
+    // per stage and rotates at the first stage. @plan is empty if it is invalid.
+    void legacy(const Image &src, const Image &dst, unsigned int transform, Plan &plan) const;
+
+    static uint64_t cost(const Plan &plan);
+    static uint64_t cost(const Stage &stage);
+    // Returns the number of tasks of the stage or 0 if MSCL cannot process the stage.
+    static unsigned int validate(const Stage &stage);
+
+    static inline unsigned int width(const Image &img) { return std::get<0>(img); }
+    static inline unsigned int height(const Image &img) { return std::get<1>(img); }
+    static inline unsigned int format(const Image &img) { return std::get<2>(img); }
+    static inline bool rotate90(unsigned int transform) { return (transform & HAL_TRANSFORM_ROT_90) != 0; }
+
+private:
+    enum Distribution {
+        FRONT,  // scale by the maximum factors at the earlier stages
+        BACK,   // scale by the maximum factors at the later stages
+        EVEN,   // scale by the same factor at every stage
+        NR_DISTRIBUTIONS,
+    };
+
+    using Sizes = std::vector<unsigned int>;
+
+    // @sizes has @count + 1 elements including @from and @to on success.
+    static bool distribute(Distribution dist, unsigned int from, unsigned int to,
+                           unsigned int count, unsigned int align, Sizes &sizes);
+    bool build(const Image &src, const Image &dst, unsigned int transform,
+               const Sizes &widths, const Sizes &heights, unsigned int rotstage, Plan &plan) const;
+
+    unsigned int mMaxTasks;
+};
+
+#endif //_GIANT_MSCL_PLANNER_H_
@@ -46,3 +46,23 @@ LOCAL_MODULE := $(GIANTMSCL_EXE_PREFIX)32
 #LOCAL_MODULE_PATH := $(TARGET_OUT_OPTIONAL_EXECUTABLES)
 LOCAL_PROPRIETARY_MODULE := true
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += $(GIANTMSCL_CLFAGS)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_HEADER_LIBRARIES += libsystem_headers
+LOCAL_SRC_FILES := planner_test.cpp ../planner.cpp
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := $(GIANTMSCL_EXE_PREFIX)_planner_test
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += $(GIANTMSCL_CLFAGS) -DUSE_GIANT_MSCL -DUSE_GIANT_MSCL_EMULATOR
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/.. $(LOCAL_PATH)/../include
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_HEADER_LIBRARIES += libsystem_headers libexynos_headers
+LOCAL_SRC_FILES := emulator_test.cpp \
+    ../giant_mscl.cpp ../giant_mscl_impl.cpp ../buffer.cpp ../debug.cpp ../planner.cpp ../emulator.cpp
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := $(GIANTMSCL_EXE_PREFIX)_emulator_test
+include $(BUILD_HOST_NATIVE_TEST)
@@ -0,0 +1,263 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <ostream>
+
+#include <gtest/gtest.h>
+
+#include <system/graphics.h>
+#include <exynos_format.h> // hardware/smasung_slsi/exynos/include
+
+#include <hardware/exynos/giant_mscl.h>
+
+// Runs GiantMscl with the CPU emulator of MSCL and compares the result with
+// the ideal resampling of smooth functions. Incorrect offsets or initial phases
+// of the partitioned images make seams that exceed the tolerance.
+
+const static unsigned int NR_EXTRA_BYTES = 512;
+const static int TOLERANCE = 6;
+
+enum { CHANNEL_Y, CHANNEL_CB, CHANNEL_CR, NR_CHANNELS };
+
+// the functions of the normalized coordinates
+static double sampleFunction(int channel, double x, double y)
+{
+    switch (channel) {
+    case CHANNEL_Y:
+        return 128 + 50 * std::sin(2 * M_PI * x) + 40 * std::cos(2 * M_PI * y);
+    case CHANNEL_CB:
+        return 128 + 70 * (x - 0.5) + 30 * std::sin(2 * M_PI * y);
+    default:
+        return 128 - 70 * (y - 0.5) + 30 * std::sin(2 * M_PI * x);
+    }
+}
+
+class TestImage {
+public:
+    TestImage(unsigned int width, unsigned int height, unsigned int format)
+        : mWidth(width), mHeight(height), mFormat(format) {
+        size_t luma = static_cast<size_t>(width) * height;
+
+        if (format == HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M) {
+            allocate(0, luma + NR_EXTRA_BYTES);
+            allocate(1, luma / 2 + NR_EXTRA_BYTES);
+        } else if (format == HAL_PIXEL_FORMAT_YCBCR_422_I) {
+            allocate(0, luma * 2 + NR_EXTRA_BYTES);
+        } else {
+            allocate(0, luma * 3 / 2 + NR_EXTRA_BYTES);
+        }
+    }
+
+    ~TestImage() {
+        for (unsigned int i = 0; i < 2; i++) {
+            if (mAddr[i])
+                munmap(mAddr[i], mLen[i]);
+            if (mFd[i] >= 0)
+                close(mFd[i]);
+        }
+    }
+
+    bool okay() const { return mAddr[0] != nullptr; }
+    int *fds() { return mFd; }
+
+    unsigned int width(int channel) const { return (channel == CHANNEL_Y) ? mWidth : mWidth / 2; }
+    unsigned int height(int channel) const {
+        return ((channel == CHANNEL_Y) || (mFormat == HAL_PIXEL_FORMAT_YCBCR_422_I)) ? mHeight : mHeight / 2;
+    }
+
+    uint8_t &at(int channel, unsigned int x, unsigned int y) {
+        if (mFormat == HAL_PIXEL_FORMAT_YCBCR_422_I) {
+            uint8_t *row = mAddr[0] + static_cast<size_t>(y) * mWidth * 2;
+            return (channel == CHANNEL_Y) ? row[x * 2] : row[x * 4 + ((channel == CHANNEL_CB) ? 1 : 3)];
+        }
+
+        if (channel == CHANNEL_Y)
+            return mAddr[0][static_cast<size_t>(y) * mWidth + x];
+
+        uint8_t *chroma = (mFormat == HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M)
+                              ? mAddr[1] : mAddr[0] + static_cast<size_t>(mWidth) * mHeight;
+        // YCrCb_420_SP stores Cr first
+        unsigned int cb = (mFormat == HAL_PIXEL_FORMAT_YCRCB_420_SP) ? 1 : 0;
+        return chroma[static_cast<size_t>(y) * mWidth + x * 2 + ((channel == CHANNEL_CB) ? cb : 1 - cb)];
+    }
+
+    void fill() {
+        for (int c = 0; c < NR_CHANNELS; c++)
+            for (unsigned int y = 0; y < height(c); y++)
+                for (unsigned int x = 0; x < width(c); x++)
+                    at(c, x, y) = static_cast<uint8_t>(std::lround(
+                        sampleFunction(c, (x + 0.5) / width(c), (y + 0.5) / height(c))));
+    }
+
+    // Returns the largest difference from the ideal image that is transformed by @transform
+    int compare(unsigned int transform, int &channel, unsigned int &errx, unsigned int &erry) {
+        bool rotate = (transform & HAL_TRANSFORM_ROT_90) != 0;
+        double scaledWidth = rotate ? mHeight : mWidth;
+        double scaledHeight = rotate ? mWidth : mHeight;
+        int maxdiff = 0;
+
+        for (int c = 0; c < NR_CHANNELS; c++) {
+            double hsub = static_cast<double>(mWidth) / width(c);
+            double vsub = static_cast<double>(mHeight) / height(c);
+
+            for (unsigned int y = 0; y < height(c); y++) {
+                for (unsigned int x = 0; x < width(c); x++) {
+                    double dx = (x + 0.5) * hsub;
+                    double dy = (y + 0.5) * vsub;
+                    double u = rotate ? dy : dx;
+                    double v = rotate ? (scaledHeight - dx) : dy;
+
+                    if (transform & HAL_TRANSFORM_FLIP_H)
+                        u = scaledWidth - u;
+                    if (transform & HAL_TRANSFORM_FLIP_V)
+                        v = scaledHeight - v;
+
+                    int expected = static_cast<int>(std::lround(sampleFunction(c, u / scaledWidth, v / scaledHeight)));
+                    int diff = std::abs(expected - at(c, x, y));
+                    if (diff > maxdiff) {
+                        maxdiff = diff;
+                        channel = c;
+                        errx = x;
+                        erry = y;
+                    }
+                }
+            }
+        }
+
+        return maxdiff;
+    }
+
+private:
+    void allocate(unsigned int idx, size_t len) {
+        mFd[idx] = memfd_create("giantmscl-test", MFD_CLOEXEC);
+        if ((mFd[idx] < 0) || (ftruncate(mFd[idx], len) < 0))
+            return;
+
+        void *addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, mFd[idx], 0);
+        if (addr != MAP_FAILED) {
+            mAddr[idx] = reinterpret_cast<uint8_t *>(addr);
+            mLen[idx] = len;
+        }
+    }
+
+    unsigned int mWidth;
+    unsigned int mHeight;
+    unsigned int mFormat;
+    int mFd[2] = {-1, -1};
+    uint8_t *mAddr[2] = {nullptr, nullptr};
+    size_t mLen[2] = {0, 0};
+};
+
+struct EmulatorTestParam {
+    unsigned int mSrcWidth;
+    unsigned int mSrcHeight;
+    unsigned int mDstWidth;
+    unsigned int mDstHeight;
+    unsigned int mTransform;
+};
+
+std::ostream &operator<<(std::ostream &os, const EmulatorTestParam &param)
+{
+    return os << param.mSrcWidth << "x" << param.mSrcHeight << " -> "
+              << param.mDstWidth << "x" << param.mDstHeight << " transform " << param.mTransform;
+}
+
+class GiantMsclEmulatorTest : public testing::TestWithParam<EmulatorTestParam> {
+};
+
+static void runAndCompare(const EmulatorTestParam &param, unsigned int format)
+{
+    TestImage src(param.mSrcWidth, param.mSrcHeight, format);
+    TestImage dst(param.mDstWidth, param.mDstHeight, format);
+    GiantMscl mscl;
+
+    ASSERT_TRUE(src.okay());
+    ASSERT_TRUE(dst.okay());
+    ASSERT_TRUE(mscl.okay());
+
+    src.fill();
+
+    ASSERT_TRUE(mscl.setSrc(param.mSrcWidth, param.mSrcHeight, format, param.mTransform));
+    ASSERT_TRUE(mscl.setDst(param.mDstWidth, param.mDstHeight, format));
+    ASSERT_TRUE(mscl.run(src.fds(), dst.fds()));
+
+    int channel = 0;
+    unsigned int x = 0, y = 0;
+    int diff = dst.compare(param.mTransform, channel, x, y);
+    EXPECT_LE(diff, TOLERANCE) << "format " << format << ": channel " << channel << " at (" << x << ", " << y << ")";
+}
+
+TEST_P(GiantMsclEmulatorTest, YCrCb420SemiPlanar) {
+    runAndCompare(GetParam(), HAL_PIXEL_FORMAT_YCRCB_420_SP);
+}
+
+TEST_P(GiantMsclEmulatorTest, YCbCr420SemiPlanarMultiBuffer) {
+    runAndCompare(GetParam(), HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M);
+}
+
+TEST_P(GiantMsclEmulatorTest, YCbCr422Interleaved) {
+    runAndCompare(GetParam(), HAL_PIXEL_FORMAT_YCBCR_422_I);
+}
+
+INSTANTIATE_TEST_SUITE_P(NoPartition, GiantMsclEmulatorTest, testing::Values(
+    EmulatorTestParam{1920, 1080, 480, 270, 0},
+    EmulatorTestParam{1920, 1080, 270, 480, HAL_TRANSFORM_ROT_90},
+    EmulatorTestParam{1920, 1080, 960, 540, HAL_TRANSFORM_FLIP_H},
+    EmulatorTestParam{4000, 3000, 160, 120, HAL_TRANSFORM_ROT_180}));
+
+INSTANTIATE_TEST_SUITE_P(HorizontalPartition, GiantMsclEmulatorTest, testing::Values(
+    EmulatorTestParam{8200, 1024, 2050, 256, 0},
+    EmulatorTestParam{8200, 1024, 2050, 256, HAL_TRANSFORM_FLIP_H},
+    EmulatorTestParam{8200, 1024, 256, 2050, HAL_TRANSFORM_ROT_90},
+    EmulatorTestParam{2048, 256, 8200, 512, 0}));
+
+INSTANTIATE_TEST_SUITE_P(VerticalPartition, GiantMsclEmulatorTest, testing::Values(
+    EmulatorTestParam{1024, 8200, 256, 2050, 0},
+    EmulatorTestParam{1024, 8200, 256, 2050, HAL_TRANSFORM_FLIP_V},
+    EmulatorTestParam{1024, 8200, 2050, 256, HAL_TRANSFORM_ROT_270}));
+
+INSTANTIATE_TEST_SUITE_P(BothPartition, GiantMsclEmulatorTest, testing::Values(
+    EmulatorTestParam{8200, 8200, 2050, 2050, 0},
+    EmulatorTestParam{8200, 8200, 2050, 2050, HAL_TRANSFORM_ROT_90},
+    EmulatorTestParam{8200, 8200, 240, 320, HAL_TRANSFORM_ROT_90}));
+
+TEST(GiantMsclAsyncTest, FailureOfUnwaitedJobIsReported) {
+    const unsigned int format = HAL_PIXEL_FORMAT_YCRCB_420_SP;
+    TestImage src(1920, 1080, format);
+    TestImage dst(480, 270, format);
+    // too small for the destination image, so the emulator rejects the job
+    TestImage small(64, 64, format);
+    GiantMscl mscl;
+
+    ASSERT_TRUE(src.okay());
+    ASSERT_TRUE(dst.okay());
+    ASSERT_TRUE(small.okay());
+    ASSERT_TRUE(mscl.okay());
+
+    src.fill();
+
+    ASSERT_TRUE(mscl.setSrc(1920, 1080, format));
+    ASSERT_TRUE(mscl.setDst(480, 270, format));
+
+    int fence = mscl.runAsync(src.fds(), small.fds());
+    ASSERT_GE(fence, 0);
+    close(fence);
+
+    // the failed job is consumed by the next run without wait()
+    fence = mscl.runAsync(src.fds(), dst.fds());
+    ASSERT_GE(fence, 0);
+    close(fence);
+    EXPECT_FALSE(mscl.wait());
+
+    fence = mscl.runAsync(src.fds(), dst.fds());
+    ASSERT_GE(fence, 0);
+    close(fence);
+    EXPECT_TRUE(mscl.wait());
+
+    int channel = 0;
+    unsigned int x = 0, y = 0;
+    EXPECT_LE(dst.compare(0, channel, x, y), TOLERANCE);
+}
@@ -0,0 +1,145 @@
+#include <set>
+#include <tuple>
+
+#include <gtest/gtest.h>
+
+#include <system/graphics.h>
+
+#include "planner.h"
+
+using Image = StagePlanner::Image;
+
+const static unsigned int MAX_TASKS = 6;
+
+static const unsigned int test_formats[] = {
+    HAL_PIXEL_FORMAT_YCRCB_420_SP,
+    HAL_PIXEL_FORMAT_YCBCR_422_I,
+};
+
+static const unsigned int test_transforms[] = {
+    0,
+    HAL_TRANSFORM_FLIP_H,
+    HAL_TRANSFORM_ROT_90,
+    HAL_TRANSFORM_ROT_180,
+    HAL_TRANSFORM_ROT_270,
+    HAL_TRANSFORM_ROT_90 | HAL_TRANSFORM_FLIP_H,
+};
+
+// sizes below, at and above NR_PIXELS_8K including ones not aligned by 4
+static const unsigned int test_src_sizes[] = {16, 1000, 4002, 8190, 8192, 8196, 12240, 16320, 16384};
+static const unsigned int test_dst_sizes[] = {4, 320, 1920, 8192, 8200, 16384};
+
+static bool isValidImage(unsigned int width, unsigned int height, unsigned int minsize, unsigned int format)
+{
+    // same restrictions as checkImageType() in giant_mscl_impl.cpp
+    if ((width & 1) || ((format != HAL_PIXEL_FORMAT_YCBCR_422_I) && (height & 1)))
+        return false;
+    if ((width > NR_PIXELS_16K) || (height > NR_PIXELS_16K) || (width < minsize) || (height < minsize))
+        return false;
+    if ((width > NR_PIXELS_8K) && (width % 4))
+        return false;
+    if ((height > NR_PIXELS_8K) && (height % ((format == HAL_PIXEL_FORMAT_YCBCR_422_I) ? 2 : 4)))
+        return false;
+    return true;
+}
+
+static void checkPlan(const StagePlanner::Plan &plan, const Image &src, const Image &dst, unsigned int transform)
+{
+    ASSERT_FALSE(plan.empty());
+    EXPECT_EQ(plan.front().mSource, src);
+    EXPECT_EQ(plan.back().mTarget, dst);
+
+    unsigned int tasks = 0;
+    unsigned int transformed = 0;
+    for (unsigned int i = 0; i < plan.size(); i++) {
+        EXPECT_EQ(StagePlanner::validate(plan[i]), plan[i].mTaskCount);
+        if (i > 0) {
+            EXPECT_EQ(plan[i - 1].mTarget, plan[i].mSource);
+        }
+        if (plan[i].mTransform != 0) {
+            EXPECT_EQ(plan[i].mTransform, transform);
+            transformed++;
+        }
+        tasks += plan[i].mTaskCount;
+    }
+
+    EXPECT_EQ(transformed, (transform != 0) ? 1U : 0U);
+    EXPECT_LE(tasks, MAX_TASKS);
+}
+
+TEST(StagePlannerTest, PartitionCoverage) {
+    StagePlanner planner(MAX_TASKS);
+    // (task count, rotated) of every stage of every enumerated plan
+    std::set<std::tuple<unsigned int, bool>> partitions;
+
+    for (auto format: test_formats) {
+        for (auto transform: test_transforms) {
+            for (auto srcw: test_src_sizes) {
+                for (auto srch: test_src_sizes) {
+                    if (!isValidImage(srcw, srch, 16, format))
+                        continue;
+
+                    for (auto dstw: test_dst_sizes) {
+                        for (auto dsth: test_dst_sizes) {
+                            if (!isValidImage(dstw, dsth, 4, format))
+                                continue;
+
+                            Image src{srcw, srch, format};
+                            Image dst{dstw, dsth, format};
+
+                            for (auto &plan: planner.enumerate(src, dst, transform)) {
+                                checkPlan(plan, src, dst, transform);
+                                for (auto &stage: plan)
+                                    partitions.emplace(stage.mTaskCount, StagePlanner::rotate90(stage.mTransform));
+                            }
+
+                            StagePlanner::Plan legacy;
+                            planner.legacy(src, dst, transform, legacy);
+                            if (legacy.empty())
+                                continue;
+
+                            // the planner never chooses a plan worse than the fixed strategy
+                            StagePlanner::Plan plan;
+                            uint64_t cost = planner.plan(src, dst, transform, plan);
+                            ASSERT_NE(cost, 0U) << srcw << "x" << srch << " -> " << dstw << "x" << dsth;
+                            EXPECT_EQ(cost, StagePlanner::cost(plan));
+                            EXPECT_LE(cost, StagePlanner::cost(legacy));
+                            checkPlan(plan, src, dst, transform);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (unsigned int count: {1U, 2U, 4U}) {
+        EXPECT_EQ(partitions.count(std::make_tuple(count, false)), 1U) << "no stage with " << count << " tasks";
+        EXPECT_EQ(partitions.count(std::make_tuple(count, true)), 1U) << "no rotated stage with " << count << " tasks";
+    }
+}
+
+TEST(StagePlannerTest, DeferRotationOnExtremeDownscale) {
+    StagePlanner planner(MAX_TASKS);
+    Image src{16320, 12240, HAL_PIXEL_FORMAT_YCRCB_420_SP};
+    Image dst{240, 320, HAL_PIXEL_FORMAT_YCRCB_420_SP};
+    StagePlanner::Plan plan, legacy;
+
+    uint64_t cost = planner.plan(src, dst, HAL_TRANSFORM_ROT_90, plan);
+    planner.legacy(src, dst, HAL_TRANSFORM_ROT_90, legacy);
+
+    ASSERT_NE(cost, 0U);
+    ASSERT_FALSE(legacy.empty());
+    EXPECT_LT(cost, StagePlanner::cost(legacy));
+    EXPECT_EQ(plan.back().mTransform, static_cast<unsigned int>(HAL_TRANSFORM_ROT_90));
+}
+
+TEST(StagePlannerTest, UpscaleByLargerFactorLater) {
+    StagePlanner planner(MAX_TASKS);
+    Image src{100, 100, HAL_PIXEL_FORMAT_YCRCB_420_SP};
+    Image dst{1600, 1600, HAL_PIXEL_FORMAT_YCRCB_420_SP};
+    StagePlanner::Plan plan;
+
+    ASSERT_NE(planner.plan(src, dst, 0, plan), 0U);
+    ASSERT_EQ(plan.size(), 2U);
+    EXPECT_LT(StagePlanner::width(plan[0].mTarget), 800U);
+}
@@ -26,6 +26,10 @@ enum mscl_cmd {
 
 #define MSCL_MAX_PLANES 3
 
+#define MSCL_FMT_NV12 0
+#define MSCL_FMT_NV21 16
+#define MSCL_FMT_YUYV 10
+
 enum mscl_dir {
     MSCL_SRC = 0,
     MSCL_DST,
@@ -71,6 +71,8 @@ int32_t ComposerCommandEngine::execute(const std::vector<DisplayCommand>& comman
 }
 
 void ComposerCommandEngine::dispatchDisplayCommand(const DisplayCommand& command) {
+    // The per-frame layer properties are set at once, the rest per command
+    executeSetLayerProperties(command.display, command.layers);
     for (const auto& layerCmd : command.layers) {
         dispatchLayerCommand(command.display, layerCmd);
     }
@@ -89,19 +91,7 @@ void ComposerCommandEngine::dispatchDisplayCommand(const DisplayCommand& command
 
 void ComposerCommandEngine::dispatchLayerCommand(int64_t display, const LayerCommand& command) {
     DISPATCH_LAYER_COMMAND(display, command, cursorPosition, CursorPosition);
-    DISPATCH_LAYER_COMMAND(display, command, buffer, Buffer);
-    DISPATCH_LAYER_COMMAND(display, command, damage, SurfaceDamage);
-    DISPATCH_LAYER_COMMAND(display, command, blendMode, BlendMode);
-    DISPATCH_LAYER_COMMAND(display, command, color, Color);
-    DISPATCH_LAYER_COMMAND(display, command, composition, Composition);
-    DISPATCH_LAYER_COMMAND(display, command, dataspace, Dataspace);
-    DISPATCH_LAYER_COMMAND(display, command, displayFrame, DisplayFrame);
-    DISPATCH_LAYER_COMMAND(display, command, planeAlpha, PlaneAlpha);
     DISPATCH_LAYER_COMMAND(display, command, sidebandStream, SidebandStream);
-    DISPATCH_LAYER_COMMAND(display, command, sourceCrop, SourceCrop);
-    DISPATCH_LAYER_COMMAND(display, command, transform, Transform);
-    DISPATCH_LAYER_COMMAND(display, command, visibleRegion, VisibleRegion);
-    DISPATCH_LAYER_COMMAND(display, command, z, ZOrder);
     DISPATCH_LAYER_COMMAND(display, command, colorTransform, ColorTransform);
     // TODO: (b/196171661) add support for mixed composition
     // DISPATCH_LAYER_COMMAND(display, command, whitePointNits, WhitePointNits);
@@ -246,94 +236,51 @@ int ComposerCommandEngine::executePresentDisplay(int64_t display) {
     return err;
 }
 
-void ComposerCommandEngine::executeSetLayerCursorPosition(int64_t display, int64_t layer,
-                                       const common::Point& cursorPosition) {
-    auto err = mHal->setLayerCursorPosition(display, layer, cursorPosition.x, cursorPosition.y);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
+void ComposerCommandEngine::executeSetLayerProperties(int64_t display,
+                                                      const std::vector<LayerCommand>& commands) {
+    if (commands.empty()) {
+        return;
     }
-}
 
-void ComposerCommandEngine::executeSetLayerBuffer(int64_t display, int64_t layer,
-                                                  const Buffer& buffer) {
-    bool useCache = !buffer.handle;
-    buffer_handle_t handle = useCache
-                             ? nullptr
-                             : ::android::makeFromAidl(*buffer.handle);
-    buffer_handle_t hwcBuffer;
-    auto bufferReleaser = mResources->createReleaser(true);
-    auto err = mResources->getLayerBuffer(display, layer, buffer.slot, useCache,
-                                          handle, hwcBuffer, bufferReleaser.get());
-    if (!err) {
-        err = mHal->setLayerBuffer(display, layer, hwcBuffer, buffer.fence);
-        if (err) {
-            LOG(ERROR) << __func__ << ": setLayerBuffer err " << err;
-            mWriter->setError(mCommandIndex, err);
+    std::vector<IComposerHal::LayerProperties> layers;
+    // keep the cached buffers until the layers are set
+    std::vector<std::unique_ptr<IBufferReleaser>> bufferReleasers;
+    layers.reserve(commands.size());
+    for (const auto& command : commands) {
+        IComposerHal::LayerProperties layer{&command, false, nullptr};
+        if (command.buffer) {
+            const Buffer& buffer = *command.buffer;
+            bool useCache = !buffer.handle;
+            buffer_handle_t handle = useCache
+                                     ? nullptr
+                                     : ::android::makeFromAidl(*buffer.handle);
+            auto bufferReleaser = mResources->createReleaser(true);
+            auto err = mResources->getLayerBuffer(display, command.layer, buffer.slot, useCache,
+                                                  handle, layer.buffer, bufferReleaser.get());
+            if (!err) {
+                layer.hasBuffer = true;
+                bufferReleasers.push_back(std::move(bufferReleaser));
+            } else {
+                LOG(ERROR) << __func__ << ": getLayerBuffer err " << err;
+                mWriter->setError(mCommandIndex, err);
+            }
         }
-    } else {
-        LOG(ERROR) << __func__ << ": getLayerBuffer err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerSurfaceDamage(int64_t display, int64_t layer,
-                              const std::vector<std::optional<common::Rect>>& damage) {
-    auto err = mHal->setLayerSurfaceDamage(display, layer, damage);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerBlendMode(int64_t display, int64_t layer,
-                                                     const ParcelableBlendMode& blendMode) {
-    auto err = mHal->setLayerBlendMode(display, layer, blendMode.blendMode);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerColor(int64_t display, int64_t layer,
-                                                 const Color& color) {
-    auto err = mHal->setLayerColor(display, layer, color);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerComposition(int64_t display, int64_t layer,
-                                                       const ParcelableComposition& composition) {
-    auto err = mHal->setLayerCompositionType(display, layer, composition.composition);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
+        layers.push_back(layer);
     }
-}
 
-void ComposerCommandEngine::executeSetLayerDataspace(int64_t display, int64_t layer,
-                                                     const ParcelableDataspace& dataspace) {
-    auto err = mHal->setLayerDataspace(display, layer, dataspace.dataspace);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerDisplayFrame(int64_t display, int64_t layer,
-                                                        const common::Rect& rect) {
-    auto err = mHal->setLayerDisplayFrame(display, layer, rect);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
+    std::vector<int32_t> errors;
+    mHal->setLayerProperties(display, layers, &errors);
+    for (auto err : errors) {
+        if (err) {
+            LOG(ERROR) << __func__ << ": err " << err;
+            mWriter->setError(mCommandIndex, err);
+        }
     }
 }
 
-void ComposerCommandEngine::executeSetLayerPlaneAlpha(int64_t display, int64_t layer,
-                                                      const PlaneAlpha& planeAlpha) {
-    auto err = mHal->setLayerPlaneAlpha(display, layer, planeAlpha.alpha);
+void ComposerCommandEngine::executeSetLayerCursorPosition(int64_t display, int64_t layer,
+                                       const common::Point& cursorPosition) {
+    auto err = mHal->setLayerCursorPosition(display, layer, cursorPosition.x, cursorPosition.y);
     if (err) {
         LOG(ERROR) << __func__ << ": err " << err;
         mWriter->setError(mCommandIndex, err);
@@ -357,42 +304,6 @@ void ComposerCommandEngine::executeSetLayerSidebandStream(int64_t display, int64
     }
 }
 
-void ComposerCommandEngine::executeSetLayerSourceCrop(int64_t display, int64_t layer,
-                                                      const common::FRect& sourceCrop) {
-    auto err = mHal->setLayerSourceCrop(display, layer, sourceCrop);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerTransform(int64_t display, int64_t layer,
-                                                     const ParcelableTransform& transform) {
-    auto err = mHal->setLayerTransform(display, layer, transform.transform);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerVisibleRegion(int64_t display, int64_t layer,
-                          const std::vector<std::optional<common::Rect>>& visibleRegion) {
-    auto err = mHal->setLayerVisibleRegion(display, layer, visibleRegion);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
-void ComposerCommandEngine::executeSetLayerZOrder(int64_t display, int64_t layer,
-                                                  const ZOrder& zOrder) {
-    auto err = mHal->setLayerZOrder(display, layer, zOrder.z);
-    if (err) {
-        LOG(ERROR) << __func__ << ": err " << err;
-        mWriter->setError(mCommandIndex, err);
-    }
-}
-
 void ComposerCommandEngine::executeSetLayerPerFrameMetadata(int64_t display, int64_t layer,
                 const std::vector<std::optional<PerFrameMetadata>>& perFrameMetadata) {
     auto err = mHal->setLayerPerFrameMetadata(display, layer, perFrameMetadata);
@@ -53,30 +53,11 @@ class ComposerCommandEngine {
       void executeAcceptDisplayChanges(int64_t display);
       int executePresentDisplay(int64_t display);
 
+      void executeSetLayerProperties(int64_t display, const std::vector<LayerCommand>& commands);
       void executeSetLayerCursorPosition(int64_t display, int64_t layer,
                                          const common::Point& cursorPosition);
-      void executeSetLayerBuffer(int64_t display, int64_t layer, const Buffer& buffer);
-      void executeSetLayerSurfaceDamage(int64_t display, int64_t layer,
-                                        const std::vector<std::optional<common::Rect>>& damage);
-      void executeSetLayerBlendMode(int64_t display, int64_t layer,
-                                    const ParcelableBlendMode& blendMode);
-      void executeSetLayerColor(int64_t display, int64_t layer, const Color& color);
-      void executeSetLayerComposition(int64_t display, int64_t layer,
-                                      const ParcelableComposition& composition);
-      void executeSetLayerDataspace(int64_t display, int64_t layer,
-                                    const ParcelableDataspace& dataspace);
-      void executeSetLayerDisplayFrame(int64_t display, int64_t layer, const common::Rect& rect);
-      void executeSetLayerPlaneAlpha(int64_t display, int64_t layer, const PlaneAlpha& planeAlpha);
       void executeSetLayerSidebandStream(int64_t display, int64_t layer,
                                          const AidlNativeHandle& sidebandStream);
-      void executeSetLayerSourceCrop(int64_t display, int64_t layer,
-                                     const common::FRect& sourceCrop);
-      void executeSetLayerTransform(int64_t display, int64_t layer,
-                                    const ParcelableTransform& transform);
-      void executeSetLayerVisibleRegion(
-              int64_t display, int64_t layer,
-              const std::vector<std::optional<common::Rect>>& visibleRegion);
-      void executeSetLayerZOrder(int64_t display, int64_t layer, const ZOrder& zOrder);
       void executeSetLayerPerFrameMetadata(
               int64_t display, int64_t layer,
               const std::vector<std::optional<PerFrameMetadata>>& perFrameMetadata);
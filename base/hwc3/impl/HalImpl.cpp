@@ -866,6 +866,83 @@ int32_t HalImpl::setLayerZOrder(int64_t display, int64_t layer, uint32_t z) {
     return mDevice->setLayerZOrder(halLayer, z);
 }
 
+void HalImpl::setLayerProperties(int64_t display, const std::vector<LayerProperties>& layers,
+                                 std::vector<int32_t>* outErrors) {
+    ExynosDisplay* halDisplay;
+    if (getHalDisplay(display, halDisplay) != HWC2_ERROR_NONE) {
+        outErrors->assign(layers.size(), HWC2_ERROR_BAD_DISPLAY);
+        return;
+    }
+
+    std::vector<ExynosLayerProperties> halLayers(layers.size());
+    // the regions of halLayers point to these
+    std::vector<std::vector<hwc_rect_t>> damages(layers.size());
+    std::vector<std::vector<hwc_rect_t>> visibles(layers.size());
+
+    for (size_t ix = 0; ix < layers.size(); ++ix) {
+        const LayerCommand& command = *layers[ix].command;
+        ExynosLayerProperties& halLayer = halLayers[ix];
+
+        a2h::translate(command.layer, halLayer.layer);
+        if (layers[ix].hasBuffer) {
+            halLayer.hasBuffer = true;
+            halLayer.buffer = layers[ix].buffer;
+            a2h::translate(command.buffer->fence, halLayer.acquireFence);
+        }
+        if (command.damage) {
+            a2h::translate(*command.damage, damages[ix]);
+            halLayer.surfaceDamage = hwc_region_t{damages[ix].size(), damages[ix].data()};
+        }
+        if (command.blendMode) {
+            int32_t hwcMode;
+            a2h::translate(command.blendMode->blendMode, hwcMode);
+            halLayer.blendMode = hwcMode;
+        }
+        if (command.color) {
+            hwc_color_t hwcColor;
+            a2h::translate(*command.color, hwcColor);
+            halLayer.color = hwcColor;
+        }
+        if (command.composition) {
+            int32_t hwcType;
+            a2h::translate(command.composition->composition, hwcType);
+            halLayer.compositionType = hwcType;
+        }
+        if (command.dataspace) {
+            int32_t hwcDataspace;
+            a2h::translate(command.dataspace->dataspace, hwcDataspace);
+            halLayer.dataspace = hwcDataspace;
+        }
+        if (command.displayFrame) {
+            hwc_rect_t hwcFrame;
+            a2h::translate(*command.displayFrame, hwcFrame);
+            halLayer.displayFrame = hwcFrame;
+        }
+        if (command.planeAlpha) {
+            halLayer.planeAlpha = command.planeAlpha->alpha;
+        }
+        if (command.sourceCrop) {
+            hwc_frect_t hwcCrop;
+            a2h::translate(*command.sourceCrop, hwcCrop);
+            halLayer.sourceCrop = hwcCrop;
+        }
+        if (command.transform) {
+            int32_t hwcTransform;
+            a2h::translate(command.transform->transform, hwcTransform);
+            halLayer.transform = hwcTransform;
+        }
+        if (command.visibleRegion) {
+            a2h::translate(*command.visibleRegion, visibles[ix]);
+            halLayer.visibleRegion = hwc_region_t{visibles[ix].size(), visibles[ix].data()};
+        }
+        if (command.z) {
+            halLayer.zOrder = command.z->z;
+        }
+    }
+
+    mDevice->setLayerProperties(halDisplay, halLayers, *outErrors);
+}
+
 int32_t HalImpl::setOutputBuffer(int64_t display, buffer_handle_t buffer,
                                  const ndk::ScopedFileDescriptor& releaseFence) {
     ExynosDisplay* halDisplay;
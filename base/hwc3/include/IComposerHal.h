@@ -193,6 +193,19 @@ class IComposerHal {
     virtual int32_t setLayerVisibleRegion(int64_t display, int64_t layer,
                                  const std::vector<std::optional<common::Rect>>& visible) = 0;
     virtual int32_t setLayerZOrder(int64_t display, int64_t layer, uint32_t z) = 0;
+
+    // A layer command whose per-frame properties are set by setLayerProperties
+    struct LayerProperties {
+        const LayerCommand* command;
+        // command->buffer resolved by the resource manager, set if hasBuffer
+        bool hasBuffer;
+        buffer_handle_t buffer;
+    };
+    // Sets buffer, damage, blend mode, color, composition, dataspace, display frame,
+    // plane alpha, source crop, transform, visible region and z order of the layers
+    // at once. outErrors gets the first error of each layer.
+    virtual void setLayerProperties(int64_t display, const std::vector<LayerProperties>& layers,
+                                    std::vector<int32_t>* outErrors) = 0; // cmd
     virtual int32_t setOutputBuffer(int64_t display, buffer_handle_t buffer,
                                     const ndk::ScopedFileDescriptor& releaseFence) = 0;
     virtual int32_t setPowerMode(int64_t display, PowerMode mode) = 0;
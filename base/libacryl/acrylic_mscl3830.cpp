@@ -1,3 +1,4 @@
+#include <climits>
 #include <cstring>
 #include <new>
 
@@ -48,13 +49,26 @@ static const char *__dirname[AcrylicCompositorMSCL3830::NUM_IMAGES] = {"source",
 
 AcrylicCompositorMSCL3830::AcrylicCompositorMSCL3830(const HW2DCapability &capability)
     : Acrylic(capability), mPreCompositor(), mDev("/dev/video50"),
-      mCurrentTransform(0), mProtectedContent(false),
-      mTransformChanged(false), mBlendingBefore(HWC2_BLEND_MODE_NONE), mCurrentPixFmt{0, 0},
-      mCurrentTypeMem{0, 0}, mDeviceState{0, 0}, mUseFenceFlag(V4L2_BUF_FLAG_USE_SYNC)
+      mBlendingBefore(HWC2_BLEND_MODE_NONE),
+      mCurrentTypeMem{0, 0}, mDeviceState{0, 0}, mUseFenceFlag(V4L2_BUF_FLAG_USE_SYNC),
+      mQueueDepth(1), mRequestedBufferCount(0), mBufferCount{0, 0}, mQueuedCount{0, 0},
+      mQueueHead(0), mFrameHandle{0, }, mLastHandle(0)
 {
+    memset(&mCurrentFormat, 0, sizeof(mCurrentFormat));
     memset(&mCurrentCrop, 0, sizeof(mCurrentCrop));
     memset(&mCurrentCropBlend, 0, sizeof(mCurrentCropBlend));
 
+    // The driver starts without flip, rotation and content protection.
+    // The others are configured at the first frame.
+    mControls[CTRL_HFLIP] = {V4L2_CID_HFLIP, 0, 0, true};
+    mControls[CTRL_VFLIP] = {V4L2_CID_VFLIP, 0, 0, true};
+    mControls[CTRL_ROTATE] = {V4L2_CID_ROTATE, 0, 0, true};
+    mControls[CTRL_CSC_EQ] = {V4L2_CID_CSC_EQ, 0, 0, false};
+    mControls[CTRL_CSC_RANGE] = {V4L2_CID_CSC_RANGE, 0, 0, false};
+    mControls[CTRL_CONTENT_PROTECTION] = {V4L2_CID_CONTENT_PROTECTION, 0, 0, true};
+    mControls[CTRL_BLEND_OP] = {V4L2_CID_2D_BLEND_OP, 0, 0, false};
+    mControls[CTRL_FRAMERATE] = {SC_CID_FRAMERATE, 0, 0, false};
+
     v4l2_capability cap;
     memset(&cap, 0, sizeof(cap));
     if (mDev.ioctl(VIDIOC_QUERYCAP, &cap) == 0) {
@@ -110,6 +124,13 @@ bool AcrylicCompositorMSCL3830::resetMode(AcrylicCanvas &canvas, BUFDIRECTION di
         ALOGD_TEST("VIDIOC_REQBUFS: count=%d, type=%d, memory=%d", reqbufs.count, reqbufs.type, reqbufs.memory);
 
         clearDeviceState(dir, STATE_REQBUFS);
+        // STREAMOFF returns all the queued buffers
+        mQueuedCount[dir] = 0;
+        mBufferCount[dir] = 0;
+        // S_FMT and S_CROP are applied again after the reset so that the driver
+        // checks them against the new transform and protection
+        memset(&mCurrentFormat[dir], 0, sizeof(mCurrentFormat[dir]));
+        memset(&mCurrentCrop[dir], 0, sizeof(mCurrentCrop[dir]));
     }
 
     return true;
@@ -133,42 +154,101 @@ bool AcrylicCompositorMSCL3830::isBlendingChanged()
     return false;
 }
 
+bool AcrylicCompositorMSCL3830::isModeChanged(AcrylicCanvas &canvas, BUFDIRECTION dir)
+{
+    v4l2_buf_type buftype = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
+                                            : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    v4l2_format fmt;
+
+    if (!makeFormat(canvas, buftype, fmt))
+        return true;
+
+    if (memcmp(&fmt, &mCurrentFormat[dir], sizeof(fmt)) != 0)
+        return true;
+
+    if (getCropRect(dir) != mCurrentCrop[dir])
+        return true;
+
+    // The memory type of the buffers is decided by reqbufs
+    if (testDeviceState(dir, STATE_REQBUFS) && (canvas.getBufferType() != mCurrentTypeMem[dir]))
+        return true;
+
+    return false;
+}
+
 bool AcrylicCompositorMSCL3830::resetMode()
 {
     bool reset_required = false;
-    hw2d_rect_t crop = getLayer(0)->getTargetRect();
-    int mod_flags = AcrylicCanvas::SETTING_TYPE_MODIFIED | AcrylicCanvas::SETTING_DIMENSION_MODIFIED;
 
     // If crop size, dimension, format is changed in any direction,
     // MSCL driver needs reqbufs(0) to the both directions.
-    if (area_is_zero(crop))
-        crop.size = getCanvas().getImageDimension();
-
-    if ((crop != mCurrentCrop[TARGET]) || (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE]))
-        reset_required = true;
-
-    if (((getLayer(0)->getSettingFlags() | getCanvas().getSettingFlags()) & mod_flags) != 0)
+    // The settings of the layers are compared with the last applied ones rather than
+    // the modified flags because the users configure the same settings again and again.
+    if (isModeChanged(*getLayer(0), SOURCE) || isModeChanged(getCanvas(), TARGET))
         reset_required = true;
 
     if (isBlendingChanged())
         reset_required = true;
 
-    if (mTransformChanged) {
+    setTransform();
+    configureCSC();
+    setControl(CTRL_CONTENT_PROTECTION, getCanvas().isProtected());
+    if (!setBlendOp())
+        return false;
+
+    // The number of buffers is decided by reqbufs
+    if (testDeviceState(SOURCE, STATE_REQBUFS) && (mRequestedBufferCount != mQueueDepth))
         reset_required = true;
-        mTransformChanged = false;
+
+    bool ctrl_changed = false;
+
+    for (unsigned int i = 0; i < NUM_CONTROLS; i++) {
+        if (isControlChanged(i)) {
+            ctrl_changed = true;
+            if (i < CTRL_CONTENT_PROTECTION)
+                reset_required = true;
+        }
+    }
+
+    // The device is reconfigured after all the frames in flight complete.
+    if (reset_required || ctrl_changed) {
+        if (!waitQueue(0)) {
+            ALOGE("Error occurred in the previous image processing");
+            return false;
+        }
     }
 
     if (reset_required) {
         // Ignore the return value because we have no choice when it is false.
         resetMode(*getLayer(0), SOURCE);
         resetMode(getCanvas(), TARGET);
+        mQueueHead = 0;
 
-        // It is alright to configure CSC before S_FMT.
-        if (!configureCSC())
-            return false;
+        // The blending controls are configured with S_FMT of the source and
+        // the crop of the blending source is checked by S_CROP of the target.
+        if (getLayer(1)) {
+            memset(&mCurrentFormat[SOURCE], 0, sizeof(mCurrentFormat[SOURCE]));
+            memset(&mCurrentCrop[TARGET], 0, sizeof(mCurrentCrop[TARGET]));
+        }
     }
 
-    return true;
+    // It is alright to configure the controls before S_FMT.
+    return applyControls();
+}
+
+hw2d_rect_t AcrylicCompositorMSCL3830::getCropRect(BUFDIRECTION dir)
+{
+    hw2d_rect_t rect;
+
+    if (dir == SOURCE) {
+        rect = getLayer(0)->getImageRect();
+    } else {
+        rect = getLayer(0)->getTargetRect();
+        if (area_is_zero(rect))
+            rect.size = getCanvas().getImageDimension();
+    }
+
+    return rect;
 }
 
 bool AcrylicCompositorMSCL3830::changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir)
@@ -178,27 +258,26 @@ bool AcrylicCompositorMSCL3830::changeMode(AcrylicCanvas &canvas, BUFDIRECTION d
 
     v4l2_buf_type buftype = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
                                             : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    v4l2_format fmt;
 
-    if (!setFormat(canvas, buftype))
+    if (!makeFormat(canvas, buftype, fmt))
         return false;
 
-    mCurrentPixFmt[dir] = canvas.getFormat();
-    mCurrentCrop[dir].size = canvas.getImageDimension();
-    mCurrentCrop[dir].pos = {0, 0};
-
-    hw2d_rect_t rect;
-    if (dir == SOURCE) {
-        rect = getLayer(0)->getImageRect();
-    } else {
-        rect = getLayer(0)->getTargetRect();
-        if (area_is_zero(rect))
-            rect.size = getCanvas().getImageDimension();
+    if (memcmp(&fmt, &mCurrentFormat[dir], sizeof(fmt)) != 0) {
+        if (!setFormat(fmt, dir))
+            return false;
     }
 
-    if (!setCrop(rect, buftype))
-        return false;
+    hw2d_rect_t rect = getCropRect(dir);
+
+    if (rect != mCurrentCrop[dir]) {
+        if (!setCrop(rect, buftype)) {
+            memset(&mCurrentCrop[dir], 0, sizeof(mCurrentCrop[dir]));
+            return false;
+        }
 
-    mCurrentCrop[dir] = rect;
+        mCurrentCrop[dir] = rect;
+    }
 
     return true;
 }
@@ -322,66 +401,51 @@ bool AcrylicCompositorMSCL3830::setBlend()
 
 bool AcrylicCompositorMSCL3830::setBlendOp()
 {
-    v4l2_control ctrl;
+    int32_t blend_op;
 
-    ctrl.id = V4L2_CID_2D_BLEND_OP;
     if (getLayer(1)) {
         switch (getLayer(1)->getCompositingMode()) {
             // no blending
             case HWC_BLENDING_NONE:
             case HWC2_BLEND_MODE_NONE:
-                ctrl.value = BL_OP_DST;
+                blend_op = BL_OP_DST;
                 break;
             // blending with premulti
             case HWC_BLENDING_PREMULT:
             case HWC2_BLEND_MODE_PREMULTIPLIED:
-                ctrl.value = BL_OP_DST_OVER;
+                blend_op = BL_OP_DST_OVER;
                 break;
             // blending with non-premulti
             case HWC_BLENDING_COVERAGE:
             case HWC2_BLEND_MODE_COVERAGE:
-                ctrl.value = BL_OP_DST_OVER;
+                blend_op = BL_OP_DST_OVER;
                 break;
             default:
                 ALOGERR("CompositingMode is invalid : %d", getLayer(1)->getCompositingMode());
                 return false;
         }
     } else
-        ctrl.value = 0;
+        blend_op = 0;
 
-    ALOGD_TEST("VIDIOC_S_CTRL: BLEND OP=%d", ctrl.value);
-    if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-        ALOGERR("Failed to configure BLEND OP to %d", ctrl.value);
-        return false;
-    }
+    setControl(CTRL_BLEND_OP, blend_op);
 
     return true;
 }
-bool AcrylicCompositorMSCL3830::setFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype)
+
+bool AcrylicCompositorMSCL3830::makeFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype, v4l2_format &fmt)
 {
     hw2d_coord_t coord = canvas.getImageDimension();
     uint32_t pixfmt = halfmt_to_v4l2_deprecated(canvas.getFormat());
-    v4l2_format fmt;
 
+    // cleared to compare with mCurrentFormat by memcmp()
     memset(&fmt, 0, sizeof(fmt));
 
-    if (buftype == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) {
-        if (!setBlend())
+    if ((buftype == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) && getLayer(1)) {
+        pixfmt = v4l2_fmt_with_blend(pixfmt, getLayer(1)->getFormat());
+        if (!pixfmt)
             return false;
-
-        if (getLayer(1)) {
-            pixfmt = v4l2_fmt_with_blend(pixfmt, getLayer(1)->getFormat());
-            if (!pixfmt)
-                return false;
-
-            mCurrentCropBlend = getLayer(1)->getTargetRect();
-        } else
-            memset(&mCurrentCropBlend, 0, sizeof(mCurrentCropBlend));
-
-        mBlendingBefore = !!getLayer(1);
     }
 
-    // S_FMT always successes unless type is invalid.
     fmt.type = buftype;
 
     if (V4L2_TYPE_IS_MULTIPLANAR(buftype)) {
@@ -392,11 +456,6 @@ bool AcrylicCompositorMSCL3830::setFormat(AcrylicCanvas &canvas, v4l2_buf_type b
         fmt.fmt.pix_mp.ycbcr_enc = V4L2_YCBCR_ENC_DEFAULT;
         fmt.fmt.pix_mp.quantization = V4L2_QUANTIZATION_DEFAULT;
         fmt.fmt.pix_mp.xfer_func = V4L2_XFER_FUNC_DEFAULT;
-        ALOGD_TEST("VIDIOC_S_FMT: v4l2_fmt/mp .type=%d, .width=%d, .height=%d, .pixelformat=%#x, .colorspace=%d\n"
-                   "                          .ycbcr_enc=%d, quantization=%d, .xfer_func=%d",
-                   fmt.type, fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height, fmt.fmt.pix_mp.pixelformat,
-                   fmt.fmt.pix_mp.colorspace, fmt.fmt.pix_mp.ycbcr_enc, fmt.fmt.pix_mp.quantization,
-                   fmt.fmt.pix_mp.xfer_func);
     } else {
         fmt.fmt.pix.width = coord.hori;
         fmt.fmt.pix.height = coord.vert;
@@ -405,6 +464,37 @@ bool AcrylicCompositorMSCL3830::setFormat(AcrylicCanvas &canvas, v4l2_buf_type b
         fmt.fmt.pix.ycbcr_enc = V4L2_YCBCR_ENC_DEFAULT;
         fmt.fmt.pix.quantization = V4L2_QUANTIZATION_DEFAULT;
         fmt.fmt.pix.xfer_func = V4L2_XFER_FUNC_DEFAULT;
+    }
+
+    return true;
+}
+
+bool AcrylicCompositorMSCL3830::setFormat(v4l2_format &fmt, BUFDIRECTION dir)
+{
+    // S_FMT updates fmt with the format accepted by the driver
+    v4l2_format current;
+
+    memcpy(&current, &fmt, sizeof(current));
+
+    if (dir == SOURCE) {
+        if (!setBlend())
+            return false;
+
+        if (getLayer(1))
+            mCurrentCropBlend = getLayer(1)->getTargetRect();
+        else
+            memset(&mCurrentCropBlend, 0, sizeof(mCurrentCropBlend));
+
+        mBlendingBefore = !!getLayer(1);
+    }
+
+    if (V4L2_TYPE_IS_MULTIPLANAR(fmt.type)) {
+        ALOGD_TEST("VIDIOC_S_FMT: v4l2_fmt/mp .type=%d, .width=%d, .height=%d, .pixelformat=%#x, .colorspace=%d\n"
+                   "                          .ycbcr_enc=%d, quantization=%d, .xfer_func=%d",
+                   fmt.type, fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height, fmt.fmt.pix_mp.pixelformat,
+                   fmt.fmt.pix_mp.colorspace, fmt.fmt.pix_mp.ycbcr_enc, fmt.fmt.pix_mp.quantization,
+                   fmt.fmt.pix_mp.xfer_func);
+    } else {
         ALOGD_TEST("VIDIOC_S_FMT: v4l2_fmt .type=%d, .width=%d, .height=%d, .pixelformat=%#x, .colorspace=%d\n"
                    "                       .ycbcr_enc=%d, quantization=%d, .xfer_func=%d",
                    fmt.type, fmt.fmt.pix.width, fmt.fmt.pix.height, fmt.fmt.pix.pixelformat,
@@ -412,61 +502,32 @@ bool AcrylicCompositorMSCL3830::setFormat(AcrylicCanvas &canvas, v4l2_buf_type b
                    fmt.fmt.pix.xfer_func);
     }
 
+    // S_FMT always successes unless type is invalid.
     if (mDev.ioctl(VIDIOC_S_FMT, &fmt) < 0) {
         ALOGERR("Failed VIDIOC_S_FMT .type=%d, .width=%d, .height=%d, .pixelformat=%#x",
                 fmt.type, fmt.fmt.pix.width, fmt.fmt.pix.height, fmt.fmt.pix.pixelformat);
+        memset(&mCurrentFormat[dir], 0, sizeof(mCurrentFormat[dir]));
         return false;
     }
 
+    memcpy(&mCurrentFormat[dir], &current, sizeof(current));
+    // S_FMT may reset the crop
+    memset(&mCurrentCrop[dir], 0, sizeof(mCurrentCrop[dir]));
+
     return true;
 }
 
-bool AcrylicCompositorMSCL3830::setTransform()
+void AcrylicCompositorMSCL3830::setTransform()
 {
-    uint32_t trdiff = mCurrentTransform ^ getLayer(0)->getTransform();
-    v4l2_control ctrl;
+    uint32_t transform = getLayer(0)->getTransform();
 
-    mTransformChanged = !!trdiff;
+    LOGASSERT((transform & ~(HAL_TRANSFORM_FLIP_H | HAL_TRANSFORM_FLIP_V | HAL_TRANSFORM_ROT_90)) == 0,
+              "Unexpected transform option is specified: %#x", transform);
 
     // TODO: consider to use rot 180 and 270
-    if (trdiff & HAL_TRANSFORM_FLIP_H) {
-        ctrl.id = V4L2_CID_HFLIP;
-        ctrl.value = !!(getLayer(0)->getTransform() & HAL_TRANSFORM_FLIP_H);
-        ALOGD_TEST("VIDIOC_S_CTRL: HFLIP=%d, (transform=%d)", ctrl.value, getLayer(0)->getTransform());
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure HFLIP to %d", ctrl.value);
-            return false;
-        }
-        trdiff &= ~HAL_TRANSFORM_FLIP_H;
-    }
-
-    if (trdiff & HAL_TRANSFORM_FLIP_V) {
-        ctrl.id = V4L2_CID_VFLIP;
-        ctrl.value = !!(getLayer(0)->getTransform() & HAL_TRANSFORM_FLIP_V);
-        ALOGD_TEST("VIDIOC_S_CTRL: VFLIP=%d, (transform=%d)", ctrl.value, getLayer(0)->getTransform());
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure VFLIP to %d", ctrl.value);
-            return false;
-        }
-        trdiff &= ~HAL_TRANSFORM_FLIP_V;
-    }
-
-    if (trdiff & HAL_TRANSFORM_ROT_90) {
-        ctrl.id = V4L2_CID_ROTATE;
-        ctrl.value = !(getLayer(0)->getTransform() & HAL_TRANSFORM_ROT_90) ? 0 : 90;
-        ALOGD_TEST("VIDIOC_S_CTRL: ROTATE=%d, (transform=%d)", ctrl.value, getLayer(0)->getTransform());
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure Rotation of 90");
-            return false;
-        }
-        trdiff &= ~HAL_TRANSFORM_ROT_90;
-    }
-
-    LOGASSERT(trdiff == 0, "Unexpected transform option is changed: %#x", trdiff);
-
-    mCurrentTransform = getLayer(0)->getTransform();
-
-    return true;
+    setControl(CTRL_HFLIP, !!(transform & HAL_TRANSFORM_FLIP_H));
+    setControl(CTRL_VFLIP, !!(transform & HAL_TRANSFORM_FLIP_V));
+    setControl(CTRL_ROTATE, !(transform & HAL_TRANSFORM_ROT_90) ? 0 : 90);
 }
 
 bool AcrylicCompositorMSCL3830::setCrop(hw2d_rect_t rect, v4l2_buf_type buftype)
@@ -506,7 +567,7 @@ bool AcrylicCompositorMSCL3830::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
 
     v4l2_requestbuffers reqbufs;
 
-    reqbufs.count = 1;
+    reqbufs.count = mQueueDepth;
     reqbufs.type = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
                                     : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     reqbufs.memory = (canvas.getBufferType() == AcrylicCanvas::MT_DMABUF)
@@ -520,6 +581,11 @@ bool AcrylicCompositorMSCL3830::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
         return false;
     }
 
+    if (reqbufs.count == 0) {
+        ALOGE("No buffer is allocated by VIDIOC_REQBUFS: type=%d, memory=%d", reqbufs.type, reqbufs.memory);
+        return false;
+    }
+
     if (mDev.ioctl(VIDIOC_STREAMON, &reqbufs.type) < 0) {
         ALOGERR("Failed VIDIOC_STREAMON with type %d", reqbufs.type);
         // we don't need to cancel the previous s_fmt and reqbufs
@@ -532,6 +598,9 @@ bool AcrylicCompositorMSCL3830::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
     ALOGD_TEST("VIDIOC_STREAMON: type=%d", reqbufs.type);
 
     mCurrentTypeMem[dir] = canvas.getBufferType();
+    // The driver may allocate more or less buffers than requested
+    mBufferCount[dir] = reqbufs.count;
+    mRequestedBufferCount = mQueueDepth;
 
     setDeviceState(dir, STATE_REQBUFS);
 
@@ -540,24 +609,11 @@ bool AcrylicCompositorMSCL3830::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
 
 bool AcrylicCompositorMSCL3830::prepareExecute()
 {
-    if (getCanvas().isProtected() != mProtectedContent) {
-        v4l2_control ctrl;
-
-        ctrl.id = V4L2_CID_CONTENT_PROTECTION;
-        ctrl.value = getCanvas().isProtected();
-        ALOGD_TEST("VIDIOC_S_CTRL: V4L2_CID_CONTENT_PROTECTION=%d", ctrl.value);
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure content protection to %d", ctrl.value);
-            return false;
-        }
-
-        mProtectedContent = getCanvas().isProtected();
-    }
-
     return prepareExecute(*getLayer(0), SOURCE) && prepareExecute(getCanvas(), TARGET);
 }
 
-bool AcrylicCompositorMSCL3830::queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION dir, int *fence, bool needReleaseFence)
+bool AcrylicCompositorMSCL3830::queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION dir, unsigned int index,
+                                            int *fence, bool needReleaseFence)
 {
     bool output = (dir == SOURCE);
     bool dmabuf = canvas.getBufferType() == AcrylicCanvas::MT_DMABUF;
@@ -566,6 +622,7 @@ bool AcrylicCompositorMSCL3830::queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION
 
     memset(&buffer, 0, sizeof(buffer));
 
+    buffer.index = index;
     buffer.type = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE :
                                     V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     buffer.memory = dmabuf ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_USERPTR;
@@ -629,8 +686,8 @@ bool AcrylicCompositorMSCL3830::queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION
     }
     buffer.m.planes = plane;
 
-    ALOGD_TEST("             .type=%d, .memory=%d, .flags=%d, .length=%d, .reserved=%d, .reserved2=%d",
-               buffer.type, buffer.memory, buffer.flags, buffer.length, buffer.reserved, buffer.reserved2);
+    ALOGD_TEST("             .index=%d, .type=%d, .memory=%d, .flags=%d, .length=%d, .reserved=%d, .reserved2=%d",
+               buffer.index, buffer.type, buffer.memory, buffer.flags, buffer.length, buffer.reserved, buffer.reserved2);
 
     if (mDev.ioctl(VIDIOC_QBUF, &buffer) < 0) {
         canvas.setFence(-1);
@@ -663,12 +720,20 @@ bool AcrylicCompositorMSCL3830::queueBuffer(int fence[], unsigned int num_fences
         return false;
     }
 
-    success = queueBuffer(*getLayer(0), SOURCE, &release_fence[SOURCE], (fence_count > 0));
+    // The source and the target buffers of a frame have the same index
+    unsigned int index = (mQueueHead + mQueuedCount[TARGET]) % getBufferCount();
+
+    success = queueBuffer(*getLayer(0), SOURCE, index, &release_fence[SOURCE], (fence_count > 0));
     if (success) {
-        if (!queueBuffer(getCanvas(), TARGET, &release_fence[TARGET], (--fence_count > 0))) {
-            // reset the state of the output path.
+        mQueuedCount[SOURCE]++;
+
+        if (!queueBuffer(getCanvas(), TARGET, index, &release_fence[TARGET], (--fence_count > 0))) {
+            // reset the state of the output path after the frames in flight complete.
             // ignore even though resetMode() is failed. Nothing to do any more.
-            resetMode();
+            waitQueue(0);
+            resetMode(*getLayer(0), SOURCE);
+            resetMode(getCanvas(), TARGET);
+            mQueueHead = 0;
             if (release_fence[SOURCE] >= 0)
                 close(release_fence[SOURCE]);
             success = false;
@@ -676,8 +741,9 @@ bool AcrylicCompositorMSCL3830::queueBuffer(int fence[], unsigned int num_fences
     }
 
     if (success) {
-        setDeviceState(SOURCE, STATE_QBUF);
-        setDeviceState(TARGET, STATE_QBUF);
+        mQueuedCount[TARGET]++;
+        mLastHandle = (mLastHandle == INT_MAX) ? 1 : mLastHandle + 1;
+        mFrameHandle[index] = mLastHandle;
 
         unsigned int j;
         for (j = 0; j < num_fences; j++) {
@@ -706,7 +772,7 @@ bool AcrylicCompositorMSCL3830::queueBuffer(int fence[], unsigned int num_fences
     return success;
 }
 
-bool AcrylicCompositorMSCL3830::configureCSC()
+void AcrylicCompositorMSCL3830::configureCSC()
 {
     bool csc_req = false;
     uint32_t csc_sel = 0;
@@ -752,23 +818,67 @@ bool AcrylicCompositorMSCL3830::configureCSC()
                 break;
         }
 
-        v4l2_control ctrl;
+        setControl(CTRL_CSC_EQ, csc_sel);
+        setControl(CTRL_CSC_RANGE, csc_range);
+    }
+}
 
-        ctrl.id = V4L2_CID_CSC_EQ;
-        ctrl.value = csc_sel;
-        ALOGD_TEST("VIDIOC_S_CTRL: csc_matrix_sel=%d", ctrl.value);
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure csc matrix to %d", ctrl.value);
-            return false;
+bool AcrylicCompositorMSCL3830::applyControls()
+{
+    v4l2_ext_controls ext_ctrls;
+    v4l2_ext_control ext_ctrl[NUM_CONTROLS];
+    unsigned int index[NUM_CONTROLS];
+    unsigned int count = 0;
+
+    memset(&ext_ctrls, 0, sizeof(ext_ctrls));
+    memset(ext_ctrl, 0, sizeof(ext_ctrl));
+
+    for (unsigned int i = 0; i < NUM_CONTROLS; i++) {
+        if (isControlChanged(i)) {
+            ext_ctrl[count].id = mControls[i].id;
+            ext_ctrl[count].value = mControls[i].value;
+            ALOGD_TEST("VIDIOC_S_EXT_CTRLS: id=%#x, value=%d", ext_ctrl[count].id, ext_ctrl[count].value);
+            index[count++] = i;
+        }
+    }
+
+    if (count == 0)
+        return true;
+
+    ext_ctrls.ctrl_class = V4L2_CTRL_CLASS_USER;
+    ext_ctrls.count = count;
+    ext_ctrls.controls = ext_ctrl;
+
+    if (mDev.ioctl(VIDIOC_S_EXT_CTRLS, &ext_ctrls) == 0) {
+        for (unsigned int i = 0; i < count; i++) {
+            mControls[index[i]].applied = mControls[index[i]].value;
+            mControls[index[i]].valid = true;
         }
 
-        ctrl.id = V4L2_CID_CSC_RANGE;
-        ctrl.value = csc_range;
-        ALOGD_TEST("VIDIOC_S_CTRL: csc_range=%d", ctrl.value);
+        return true;
+    }
+
+    // The controls are configured one by one to find the one that failed.
+    for (unsigned int i = 0; i < count; i++) {
+        ControlState &state = mControls[index[i]];
+        v4l2_control ctrl;
+
+        ctrl.id = state.id;
+        ctrl.value = state.value;
+        ALOGD_TEST("VIDIOC_S_CTRL: id=%#x, value=%d", ctrl.id, ctrl.value);
         if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure csc range to %d", ctrl.value);
-            return false;
+            /* For compatiblity, error of framerate is not returned. */
+            if (index[i] != CTRL_FRAMERATE) {
+                ALOGERR("Failed VIDIOC_S_CTRL: id=%#x, value=%d", ctrl.id, ctrl.value);
+                state.valid = false;
+                return false;
+            }
+
+            ALOGD("Trying set frame rate is failed, but ignored");
         }
+
+        state.applied = state.value;
+        state.valid = true;
     }
 
     return true;
@@ -788,26 +898,21 @@ bool AcrylicCompositorMSCL3830::execute(int fence[], unsigned int num_fences)
 
     LOGASSERT(layerCount() == 1 || layerCount() == 2, "Number of layer is not 1 or 2 but %d", layerCount());
 
-    if (!waitExecution(0)) {
-        ALOGE("Error occurred in the previous image processing");
-        return false;
-    }
-
-    if (!setTransform())
-        return false;
-
     if (!resetMode())
         return false;
 
-    if (!setBlendOp())
-        return false;
-
     if (!changeMode(*getLayer(0), SOURCE) || !changeMode(getCanvas(), TARGET))
         return false;
 
     if (!prepareExecute())
         return false;
 
+    // Wait for the oldest frame if all the buffers are in flight
+    if (!waitQueue(getBufferCount() - 1)) {
+        ALOGE("Error occurred in the previous image processing");
+        return false;
+    }
+
     return queueBuffer(fence, num_fences);
 }
 
@@ -817,9 +922,9 @@ bool AcrylicCompositorMSCL3830::execute(int *handle)
 
     if (success) {
         if (handle != NULL)
-            *handle = 1; /* dummy handle */
+            *handle = mLastHandle;
         else
-            success = waitExecution(0);
+            success = waitExecution(mLastHandle);
     }
 
     return success;
@@ -827,9 +932,13 @@ bool AcrylicCompositorMSCL3830::execute(int *handle)
 
 bool AcrylicCompositorMSCL3830::dequeueBuffer()
 {
-    LOGASSERT(testDeviceState(SOURCE, STATE_QBUF) == testDeviceState(TARGET, STATE_QBUF),
-              "State of the device is different: source %#x, target %#x",
-              mDeviceState[SOURCE], mDeviceState[TARGET]);
+    // The source has one more buffer only if queueing the target failed
+    LOGASSERT(mQueuedCount[SOURCE] >= mQueuedCount[TARGET],
+              "Number of the queued buffers is different: source %u, target %u",
+              mQueuedCount[SOURCE], mQueuedCount[TARGET]);
+
+    if (mQueuedCount[TARGET] == 0)
+        return true;
 
     v4l2_buffer buffer;
     memset(&buffer, 0, sizeof(buffer));
@@ -840,12 +949,15 @@ bool AcrylicCompositorMSCL3830::dequeueBuffer()
     if (!dequeueBuffer(TARGET, &buffer))
         return false;
 
+    // The buffers are processed in the order of queueing
+    mQueueHead = (mQueueHead + 1) % getBufferCount();
+
     return true;
 }
 
 bool AcrylicCompositorMSCL3830::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buffer)
 {
-    if (testDeviceState(dir, STATE_QBUF)) {
+    if (mQueuedCount[dir] > 0) {
         buffer->type = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE :
                                         V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
         buffer->memory = (mCurrentTypeMem[dir] == AcrylicCanvas::MT_DMABUF) ? V4L2_MEMORY_DMABUF
@@ -870,7 +982,7 @@ bool AcrylicCompositorMSCL3830::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buf
             ALOGI("Error during streaming: type=%d, memory=%d", buffer->type, buffer->memory);
         }
 
-        clearDeviceState(dir, STATE_QBUF);
+        mQueuedCount[dir]--;
 
         // The clients of V4L2 capture/m2m device should identify and verify the payload
         // written by the device and the expected payload but MSCL driver does not specify
@@ -884,9 +996,41 @@ bool AcrylicCompositorMSCL3830::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buf
 
 }
 
-bool AcrylicCompositorMSCL3830::waitExecution(int __unused handle)
+bool AcrylicCompositorMSCL3830::waitQueue(unsigned int count)
 {
-    return dequeueBuffer();
+    while (mQueuedCount[TARGET] > count) {
+        if (!dequeueBuffer())
+            return false;
+    }
+
+    return true;
+}
+
+bool AcrylicCompositorMSCL3830::waitExecution(int handle)
+{
+    if (handle <= 0)
+        return waitQueue(0);
+
+    for (unsigned int i = 0; i < mQueuedCount[TARGET]; i++) {
+        if (mFrameHandle[(mQueueHead + i) % getBufferCount()] == handle)
+            return waitQueue(mQueuedCount[TARGET] - i - 1);
+    }
+
+    // The frame of the handle is already completed
+    return true;
+}
+
+bool AcrylicCompositorMSCL3830::setQueueDepth(unsigned int depth)
+{
+    if ((depth == 0) || (depth > MAX_QUEUE_DEPTH)) {
+        ALOGE("Queue depth %u is not in the range of 1 ~ %u", depth, MAX_QUEUE_DEPTH);
+        return false;
+    }
+
+    // applied by reqbufs at the next frame
+    mQueueDepth = depth;
+
+    return true;
 }
 
 bool AcrylicCompositorMSCL3830::requestPerformanceQoS(AcrylicPerformanceRequest *request)
@@ -898,14 +1042,8 @@ bool AcrylicCompositorMSCL3830::requestPerformanceQoS(AcrylicPerformanceRequest
     else
         framerate = request->getFrame(0)->mFrameRate;
 
-    v4l2_control ctrl;
-
-    ctrl.id = SC_CID_FRAMERATE;
-    ctrl.value = framerate;
-    ALOGD_TEST("VIDIOC_S_CTRL: framerate=%d", ctrl.value);
-    /* For compatiblity, error is not returned. */
-    if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0)
-        ALOGD("Trying set frame rate is failed, but ignored");
+    // configured with the other controls at the next frame
+    setControl(CTRL_FRAMERATE, framerate);
 
     return true;
 }
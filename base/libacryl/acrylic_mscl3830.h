@@ -35,14 +35,34 @@ public:
     virtual bool execute(int *handle = NULL);
     virtual bool waitExecution(int handle);
     virtual bool requestPerformanceQoS(AcrylicPerformanceRequest *request);
+    virtual bool setQueueDepth(unsigned int depth);
 private:
-    enum { STATE_REQBUFS = 1, STATE_QBUF = 2, STATE_PROCESSING = STATE_REQBUFS | STATE_QBUF };
+    enum { STATE_REQBUFS = 1 };
+    static constexpr unsigned int MAX_QUEUE_DEPTH = 4;
+
+    enum {
+        // The changes of the controls before CTRL_CONTENT_PROTECTION need reqbufs(0) to the both directions
+        CTRL_HFLIP, CTRL_VFLIP, CTRL_ROTATE, CTRL_CSC_EQ, CTRL_CSC_RANGE,
+        CTRL_CONTENT_PROTECTION, CTRL_BLEND_OP, CTRL_FRAMERATE,
+        NUM_CONTROLS,
+    };
+
+    // The value of a control for the next frame and the value last applied to the device
+    struct ControlState {
+        uint32_t id;
+        int32_t value;
+        int32_t applied;
+        bool valid; // false if the value of the device is unknown
+    };
 
     bool resetMode(AcrylicCanvas &canvas, BUFDIRECTION dir);
     bool resetMode();
+    bool isModeChanged(AcrylicCanvas &canvas, BUFDIRECTION dir);
     bool changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir);
-    bool setFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype);
-    bool setTransform();
+    bool makeFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype, v4l2_format &fmt);
+    hw2d_rect_t getCropRect(BUFDIRECTION dir);
+    bool setFormat(v4l2_format &fmt, BUFDIRECTION dir);
+    void setTransform();
     bool isBlendingChanged();
     bool setBlend(hw2d_coord_t RdPos, hw2d_coord_t BufSize, bool is_premulti);
     bool setBlend();
@@ -50,11 +70,25 @@ private:
     bool setCrop(hw2d_rect_t rect, v4l2_buf_type buftype);
     bool prepareExecute();
     bool prepareExecute(AcrylicCanvas &canvas, BUFDIRECTION dir);
-    bool configureCSC();
-    bool queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION dir, int *fence, bool needReleaseFence);
+    void configureCSC();
+    bool applyControls();
+    void setControl(unsigned int idx, int32_t value) { mControls[idx].value = value; }
+    bool isControlChanged(unsigned int idx) {
+        return !mControls[idx].valid || (mControls[idx].value != mControls[idx].applied);
+    }
+    bool queueBuffer(AcrylicCanvas &canvas, BUFDIRECTION dir, unsigned int index,
+                     int *fence, bool needReleaseFence);
     bool queueBuffer(int fence[], unsigned int num_fences);
     bool dequeueBuffer();
     bool dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buffer);
+    bool waitQueue(unsigned int count);
+    // The number of the buffers available to the both directions. It is at most the queue
+    // depth of the last reqbufs even if the driver allocated more buffers.
+    unsigned int getBufferCount() {
+        unsigned int count = (mBufferCount[SOURCE] < mBufferCount[TARGET]) ? mBufferCount[SOURCE]
+                                                                           : mBufferCount[TARGET];
+        return (count < mRequestedBufferCount) ? count : mRequestedBufferCount;
+    }
 
     void setDeviceState(BUFDIRECTION dir, int state) { mDeviceState[dir] |= state; }
     void clearDeviceState(BUFDIRECTION dir, int state) { mDeviceState[dir] &= ~state; }
@@ -62,15 +96,21 @@ private:
 
     AcrylicCompositorMSCL3830Pre	mPreCompositor;
     AcrylicDevice   mDev;
-    uint32_t        mCurrentTransform;
-    bool            mProtectedContent;
-    bool            mTransformChanged;
+    ControlState    mControls[NUM_CONTROLS];
     uint32_t        mBlendingBefore;
-    uint32_t        mCurrentPixFmt[NUM_IMAGES];
+    // The format and the crop last applied to the device. Zero if unknown.
+    v4l2_format     mCurrentFormat[NUM_IMAGES];
     hw2d_rect_t     mCurrentCrop[NUM_IMAGES];
     hw2d_rect_t     mCurrentCropBlend;
     int             mCurrentTypeMem[NUM_IMAGES]; // AcrylicCanvas::memory_type
     int             mDeviceState[NUM_IMAGES];
     uint32_t        mUseFenceFlag;
+    unsigned int    mQueueDepth;           // configured by setQueueDepth()
+    unsigned int    mRequestedBufferCount; // the count of the last reqbufs
+    unsigned int    mBufferCount[NUM_IMAGES]; // the buffers allocated by the driver
+    unsigned int    mQueuedCount[NUM_IMAGES]; // the buffers queued and not dequeued yet
+    unsigned int    mQueueHead;            // the index of the buffer of the oldest frame in flight
+    int             mFrameHandle[MAX_QUEUE_DEPTH]; // the handle of the frame of each buffer index
+    int             mLastHandle;
 };
 #endif //__HARDWARE_EXYNOS_HW2DCOMPOSITOR_MSCL3830_LEGACY_H__
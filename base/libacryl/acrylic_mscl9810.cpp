@@ -1,3 +1,4 @@
+#include <climits>
 #include <cstring>
 
 #include <log/log.h>
@@ -36,13 +37,25 @@ struct sc_ioctl_ppc_arg {
 static const char *__dirname[AcrylicCompositorMSCL9810::NUM_IMAGES] = {"source", "target"};
 
 AcrylicCompositorMSCL9810::AcrylicCompositorMSCL9810(const HW2DCapability &capability)
-    : Acrylic(capability), mDev("/dev/video50"), mCurrentTransform(0), mProtectedContent(false),
-      mTransformChanged(false), mCurrentPixFmt{0, 0},
+    : Acrylic(capability), mDev("/dev/video50"),
       mCurrentTypeBuf{V4L2_BUF_TYPE_VIDEO_OUTPUT, V4L2_BUF_TYPE_VIDEO_CAPTURE},
-      mCurrentTypeMem{0, 0}, mDeviceState{0, 0}, mUseFenceFlag(V4L2_BUF_FLAG_USE_SYNC)
+      mCurrentTypeMem{0, 0}, mDeviceState{0, 0}, mUseFenceFlag(V4L2_BUF_FLAG_USE_SYNC),
+      mQueueDepth(1), mRequestedBufferCount(0), mBufferCount{0, 0}, mQueuedCount{0, 0},
+      mQueueHead(0), mFrameHandle{0, }, mLastHandle(0)
 {
+    memset(&mCurrentFormat, 0, sizeof(mCurrentFormat));
     memset(&mCurrentCrop, 0, sizeof(mCurrentCrop));
 
+    // The driver starts without flip, rotation, content protection and framerate.
+    // CSC is configured at the first frame.
+    mControls[CTRL_HFLIP] = {V4L2_CID_HFLIP, 0, 0, true};
+    mControls[CTRL_VFLIP] = {V4L2_CID_VFLIP, 0, 0, true};
+    mControls[CTRL_ROTATE] = {V4L2_CID_ROTATE, 0, 0, true};
+    mControls[CTRL_CSC_EQ] = {V4L2_CID_CSC_EQ, 0, 0, false};
+    mControls[CTRL_CSC_RANGE] = {V4L2_CID_CSC_RANGE, 0, 0, false};
+    mControls[CTRL_CONTENT_PROTECTION] = {V4L2_CID_CONTENT_PROTECTION, 0, 0, true};
+    mControls[CTRL_FRAMERATE] = {SC_CID_FRAMERATE, 0, 0, true};
+
     v4l2_capability cap;
     memset(&cap, 0, sizeof(cap));
     if (mDev.ioctl(VIDIOC_QUERYCAP, &cap) == 0) {
@@ -99,49 +112,100 @@ bool AcrylicCompositorMSCL9810::resetMode(AcrylicCanvas &canvas, BUFDIRECTION di
         ALOGD_TEST("VIDIOC_REQBUFS: count=%d, type=%d, memory=%d", reqbufs.count, reqbufs.type, reqbufs.memory);
 
         clearDeviceState(dir, STATE_REQBUFS);
+        // STREAMOFF returns all the queued buffers
+        mQueuedCount[dir] = 0;
+        mBufferCount[dir] = 0;
+        // S_FMT and S_CROP are applied again after the reset so that the driver
+        // checks them against the new transform and protection
+        memset(&mCurrentFormat[dir], 0, sizeof(mCurrentFormat[dir]));
+        memset(&mCurrentCrop[dir], 0, sizeof(mCurrentCrop[dir]));
     }
 
     return true;
 }
 
+bool AcrylicCompositorMSCL9810::isModeChanged(AcrylicCanvas &canvas, BUFDIRECTION dir)
+{
+    v4l2_buf_type buftype = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
+                                            : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    v4l2_format fmt;
+
+    makeFormat(canvas, buftype, fmt);
+
+    if (memcmp(&fmt, &mCurrentFormat[dir], sizeof(fmt)) != 0)
+        return true;
+
+    if (getCropRect(dir) != mCurrentCrop[dir])
+        return true;
+
+    // The memory type of the buffers is decided by reqbufs
+    if (testDeviceState(dir, STATE_REQBUFS) && (canvas.getBufferType() != mCurrentTypeMem[dir]))
+        return true;
+
+    return false;
+}
+
 bool AcrylicCompositorMSCL9810::resetMode()
 {
     bool reset_required = false;
-    hw2d_rect_t crop = getLayer(0)->getTargetRect();
-    int mod_flags = AcrylicCanvas::SETTING_TYPE_MODIFIED |
-                    AcrylicCanvas::SETTING_DIMENSION_MODIFIED |
-                    AcrylicCanvas::SETTING_STRIDE_MODIFIED;
 
     // If crop size, dimension, format is changed in any direction,
     // MSCL driver needs reqbufs(0) to the both directions.
-    if (area_is_zero(crop))
-        crop.size = getCanvas().getImageDimension();
-
-    if ((crop != mCurrentCrop[TARGET]) || (getLayer(0)->getImageRect() != mCurrentCrop[SOURCE]))
+    // The settings of the layers are compared with the last applied ones rather than
+    // the modified flags because the users configure the same settings again and again.
+    if (isModeChanged(*getLayer(0), SOURCE) || isModeChanged(getCanvas(), TARGET))
         reset_required = true;
 
-    if (((getLayer(0)->getSettingFlags() | getCanvas().getSettingFlags()) & mod_flags) != 0)
-        reset_required = true;
+    setTransform();
+    configureCSC();
+    setControl(CTRL_CONTENT_PROTECTION, getCanvas().isProtected());
 
-    if (getCanvas().isProtected() != mProtectedContent)
+    // The number of buffers is decided by reqbufs
+    if (testDeviceState(SOURCE, STATE_REQBUFS) && (mRequestedBufferCount != mQueueDepth))
         reset_required = true;
 
-    if (mTransformChanged) {
-        reset_required = true;
-        mTransformChanged = false;
+    bool ctrl_changed = false;
+
+    for (unsigned int i = 0; i < NUM_CONTROLS; i++) {
+        if (isControlChanged(i)) {
+            ctrl_changed = true;
+            if (i < CTRL_FRAMERATE)
+                reset_required = true;
+        }
+    }
+
+    // The device is reconfigured after all the frames in flight complete.
+    if (reset_required || ctrl_changed) {
+        if (!waitQueue(0)) {
+            ALOGE("Error occurred in the previous image processing");
+            return false;
+        }
     }
 
     if (reset_required) {
         // Ignore the return value because we have no choice when it is false.
         resetMode(*getLayer(0), SOURCE);
         resetMode(getCanvas(), TARGET);
+        mQueueHead = 0;
+    }
 
-        // It is alright to configure CSC before S_FMT.
-        if (!configureCSC())
-            return false;
+    // It is alright to configure the controls before S_FMT.
+    return applyControls();
+}
+
+hw2d_rect_t AcrylicCompositorMSCL9810::getCropRect(BUFDIRECTION dir)
+{
+    hw2d_rect_t rect;
+
+    if (dir == SOURCE) {
+        rect = getLayer(0)->getImageRect();
+    } else {
+        rect = getLayer(0)->getTargetRect();
+        if (area_is_zero(rect))
+            rect.size = getCanvas().getImageDimension();
     }
 
-    return true;
+    return rect;
 }
 
 bool AcrylicCompositorMSCL9810::changeMode(AcrylicCanvas &canvas, BUFDIRECTION dir)
@@ -151,39 +215,33 @@ bool AcrylicCompositorMSCL9810::changeMode(AcrylicCanvas &canvas, BUFDIRECTION d
 
     v4l2_buf_type buftype = (dir == SOURCE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE
                                             : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    v4l2_format fmt;
 
-    if (!setFormat(canvas, buftype))
-        return false;
+    makeFormat(canvas, buftype, fmt);
+    if (memcmp(&fmt, &mCurrentFormat[dir], sizeof(fmt)) != 0) {
+        if (!setFormat(fmt, dir))
+            return false;
+    }
 
-    mCurrentPixFmt[dir] = canvas.getFormat();
-    mCurrentCrop[dir].size = canvas.getImageDimension();
-    mCurrentCrop[dir].pos = {0, 0};
+    hw2d_rect_t rect = getCropRect(dir);
 
-    hw2d_rect_t rect;
-    if (dir == SOURCE) {
-        rect = getLayer(0)->getImageRect();
-    } else {
-        rect = getLayer(0)->getTargetRect();
-        if (area_is_zero(rect))
-            rect.size = getCanvas().getImageDimension();
+    if (rect != mCurrentCrop[dir]) {
+        if (!setCrop(rect, buftype, mCurrentCrop[dir]))
+            return false;
     }
 
-    if (!setCrop(rect, buftype, mCurrentCrop[dir]))
-        return false;
-
     return true;
 }
 
-bool AcrylicCompositorMSCL9810::setFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype)
+void AcrylicCompositorMSCL9810::makeFormat(AcrylicCanvas &canvas, v4l2_buf_type buftype, v4l2_format &fmt)
 {
     hw2d_coord_t coord = canvas.getImageDimension();
     uint32_t pixfmt = halfmt_to_v4l2_deprecated(canvas.getFormat());
     uint8_t blocksize = get_block_size_from_halfmt(canvas.getFormat());
-    v4l2_format fmt;
 
+    // cleared to compare with mCurrentFormat by memcmp()
     memset(&fmt, 0, sizeof(fmt));
 
-    // S_FMT always successes unless type is invalid.
     fmt.type = buftype;
 
     fmt.fmt.pix_mp.width = coord.hori;
@@ -197,6 +255,14 @@ bool AcrylicCompositorMSCL9810::setFormat(AcrylicCanvas &canvas, v4l2_buf_type b
 
     for (int i = 0; i < MAX_HW2D_PLANES; i++)
         fmt.fmt.pix_mp.plane_fmt[i].bytesperline = canvas.getStride(i);
+}
+
+bool AcrylicCompositorMSCL9810::setFormat(v4l2_format &fmt, BUFDIRECTION dir)
+{
+    // S_FMT updates fmt with the format accepted by the driver
+    v4l2_format current;
+
+    memcpy(&current, &fmt, sizeof(current));
 
     ALOGD_TEST("VIDIOC_S_FMT: v4l2_fmt/mp .type=%d, .width=%d, .height=%d, .pixelformat=%#x, .colorspace=%d\n"
                "                          .ycbcr_enc=%d, quantization=%d, .xfer_func=%d",
@@ -204,61 +270,32 @@ bool AcrylicCompositorMSCL9810::setFormat(AcrylicCanvas &canvas, v4l2_buf_type b
                fmt.fmt.pix_mp.colorspace, fmt.fmt.pix_mp.ycbcr_enc, fmt.fmt.pix_mp.quantization,
                fmt.fmt.pix_mp.xfer_func);
 
+    // S_FMT always successes unless type is invalid.
     if (mDev.ioctl(VIDIOC_S_FMT, &fmt) < 0) {
         ALOGERR("Failed VIDIOC_S_FMT .type=%d, .width=%d, .height=%d, .pixelformat=%#x",
                 fmt.type, fmt.fmt.pix.width, fmt.fmt.pix.height, fmt.fmt.pix.pixelformat);
+        memset(&mCurrentFormat[dir], 0, sizeof(mCurrentFormat[dir]));
         return false;
     }
 
+    memcpy(&mCurrentFormat[dir], &current, sizeof(current));
+    // S_FMT may reset the crop
+    memset(&mCurrentCrop[dir], 0, sizeof(mCurrentCrop[dir]));
+
     return true;
 }
 
-bool AcrylicCompositorMSCL9810::setTransform()
+void AcrylicCompositorMSCL9810::setTransform()
 {
-    uint32_t trdiff = mCurrentTransform ^ getLayer(0)->getTransform();
-    v4l2_control ctrl;
+    uint32_t transform = getLayer(0)->getTransform();
 
-    mTransformChanged = !!trdiff;
+    LOGASSERT((transform & ~(HAL_TRANSFORM_FLIP_H | HAL_TRANSFORM_FLIP_V | HAL_TRANSFORM_ROT_90)) == 0,
+              "Unexpected transform option is specified: %#x", transform);
 
     // TODO: consider to use rot 180 and 270
-    if (trdiff & HAL_TRANSFORM_FLIP_H) {
-        ctrl.id = V4L2_CID_HFLIP;
-        ctrl.value = !!(getLayer(0)->getTransform() & HAL_TRANSFORM_FLIP_H);
-        ALOGD_TEST("VIDIOC_S_CTRL: HFLIP=%d, (transform=%d)", ctrl.value, getLayer(0)->getTransform());
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure HFLIP to %d", ctrl.value);
-            return false;
-        }
-        trdiff &= ~HAL_TRANSFORM_FLIP_H;
-    }
-
-    if (trdiff & HAL_TRANSFORM_FLIP_V) {
-        ctrl.id = V4L2_CID_VFLIP;
-        ctrl.value = !!(getLayer(0)->getTransform() & HAL_TRANSFORM_FLIP_V);
-        ALOGD_TEST("VIDIOC_S_CTRL: VFLIP=%d, (transform=%d)", ctrl.value, getLayer(0)->getTransform());
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure VFLIP to %d", ctrl.value);
-            return false;
-        }
-        trdiff &= ~HAL_TRANSFORM_FLIP_V;
-    }
-
-    if (trdiff & HAL_TRANSFORM_ROT_90) {
-        ctrl.id = V4L2_CID_ROTATE;
-        ctrl.value = !(getLayer(0)->getTransform() & HAL_TRANSFORM_ROT_90) ? 0 : 90;
-        ALOGD_TEST("VIDIOC_S_CTRL: ROTATE=%d, (transform=%d)", ctrl.value, getLayer(0)->getTransform());
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure Rotation of 90");
-            return false;
-        }
-        trdiff &= ~HAL_TRANSFORM_ROT_90;
-    }
-
-    LOGASSERT(trdiff == 0, "Unexpected transform option is changed: %#x", trdiff);
-
-    mCurrentTransform = getLayer(0)->getTransform();
-
-    return true;
+    setControl(CTRL_HFLIP, !!(transform & HAL_TRANSFORM_FLIP_H));
+    setControl(CTRL_VFLIP, !!(transform & HAL_TRANSFORM_FLIP_V));
+    setControl(CTRL_ROTATE, !(transform & HAL_TRANSFORM_ROT_90) ? 0 : 90);
 }
 
 bool AcrylicCompositorMSCL9810::setCrop(hw2d_rect_t rect, v4l2_buf_type buftype, hw2d_rect_t &save_rect)
@@ -275,6 +312,7 @@ bool AcrylicCompositorMSCL9810::setCrop(hw2d_rect_t rect, v4l2_buf_type buftype,
     if (mDev.ioctl(VIDIOC_S_CROP, &crop) < 0) {
         ALOGERR("Failed to set crop of type %d to %dx%d@%dx%d", buftype,
                 rect.size.hori, rect.size.vert, rect.pos.hori, rect.pos.vert);
+        memset(&save_rect, 0, sizeof(save_rect));
         return false;
     }
 
@@ -292,7 +330,7 @@ bool AcrylicCompositorMSCL9810::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
                                             : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     v4l2_requestbuffers reqbufs;
 
-    reqbufs.count = 1;
+    reqbufs.count = mQueueDepth;
     reqbufs.type = buftype;
     reqbufs.memory = (canvas.getBufferType() == AcrylicCanvas::MT_DMABUF)
                      ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_USERPTR;
@@ -305,6 +343,11 @@ bool AcrylicCompositorMSCL9810::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
         return false;
     }
 
+    if (reqbufs.count == 0) {
+        ALOGE("No buffer is allocated by VIDIOC_REQBUFS: type=%d, memory=%d", reqbufs.type, reqbufs.memory);
+        return false;
+    }
+
     if (mDev.ioctl(VIDIOC_STREAMON, &reqbufs.type) < 0) {
         ALOGERR("Failed VIDIOC_STREAMON with type %d", reqbufs.type);
         // we don't need to cancel the previous s_fmt and reqbufs
@@ -318,6 +361,9 @@ bool AcrylicCompositorMSCL9810::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
 
     mCurrentTypeMem[dir] = canvas.getBufferType();
     mCurrentTypeBuf[dir] = buftype;
+    // The driver may allocate more or less buffers than requested
+    mBufferCount[dir] = reqbufs.count;
+    mRequestedBufferCount = mQueueDepth;
 
     setDeviceState(dir, STATE_REQBUFS);
 
@@ -326,42 +372,6 @@ bool AcrylicCompositorMSCL9810::prepareExecute(AcrylicCanvas &canvas, BUFDIRECTI
 
 bool AcrylicCompositorMSCL9810::prepareExecute()
 {
-    if (getCanvas().isProtected() != mProtectedContent) {
-        v4l2_control ctrl;
-
-        ctrl.id = V4L2_CID_CONTENT_PROTECTION;
-        ctrl.value = getCanvas().isProtected();
-        ALOGD_TEST("VIDIOC_S_CTRL: V4L2_CID_CONTENT_PROTECTION=%d", ctrl.value);
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure content protection to %d", ctrl.value);
-            return false;
-        }
-
-        mProtectedContent = getCanvas().isProtected();
-    }
-
-    if (mFramerateChanged) {
-        v4l2_control ctrl;
-
-        ctrl.id = SC_CID_FRAMERATE;
-        ctrl.value = mFramerate;
-
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            /*
-             * It doesn't return EINVAL by value.
-             * But in case of not supporting SC_CID_FRAMERATE it returns EINVAL.
-             * Some chips don't support this feature.So, just keep running.
-             */
-            if (errno != EINVAL) {
-                ALOGERR("Failed VIDIOC_S_CTRL: framerate=%d", ctrl.value);
-                return false;
-            }
-        }
-
-        ALOGD_TEST("VIDIOC_S_CTRL: framerate=%d", ctrl.value);
-        mFramerateChanged = false;
-    }
-
     return prepareExecute(*getLayer(0), SOURCE) && prepareExecute(getCanvas(), TARGET);
 }
 
@@ -374,7 +384,8 @@ bool isVotf(AcrylicLayer *layer)
     return false;
 }
 
-bool AcrylicCompositorMSCL9810::queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type buftype, int *fence, bool needReleaseFence)
+bool AcrylicCompositorMSCL9810::queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type buftype, unsigned int index,
+                                            int *fence, bool needReleaseFence)
 {
     bool output = V4L2_TYPE_IS_OUTPUT(buftype);
     bool dmabuf = canvas.getBufferType() == AcrylicCanvas::MT_DMABUF;
@@ -383,6 +394,7 @@ bool AcrylicCompositorMSCL9810::queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type
 
     memset(&buffer, 0, sizeof(buffer));
 
+    buffer.index = index;
     buffer.type = buftype;
     buffer.memory = dmabuf ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_USERPTR;
     if (canvas.getFence() >= 0) {
@@ -445,8 +457,8 @@ bool AcrylicCompositorMSCL9810::queueBuffer(AcrylicCanvas &canvas, v4l2_buf_type
     buffer.length = canvas.getBufferCount();
     buffer.m.planes = plane;
 
-    ALOGD_TEST("             .type=%d, .memory=%d, .flags=%d, .length=%d, .reserved=%d, .reserved2=%d",
-               buffer.type, buffer.memory, buffer.flags, buffer.length, buffer.reserved, buffer.reserved2);
+    ALOGD_TEST("             .index=%d, .type=%d, .memory=%d, .flags=%d, .length=%d, .reserved=%d, .reserved2=%d",
+               buffer.index, buffer.type, buffer.memory, buffer.flags, buffer.length, buffer.reserved, buffer.reserved2);
 
     if (mDev.ioctl(VIDIOC_QBUF, &buffer) < 0) {
         canvas.setFence(-1);
@@ -472,14 +484,21 @@ bool AcrylicCompositorMSCL9810::queueBuffer(int fence[], unsigned int num_fences
     int release_fence[NUM_IMAGES] = {-1, -1};
     int fence_count = num_fences;
     unsigned int i = 0;
+    // The source and the target buffers of a frame have the same index
+    unsigned int index = (mQueueHead + mQueuedCount[TARGET]) % getBufferCount();
     bool success;
 
-    success = queueBuffer(*getLayer(0), mCurrentTypeBuf[SOURCE], &release_fence[SOURCE], (fence_count > 0));
+    success = queueBuffer(*getLayer(0), mCurrentTypeBuf[SOURCE], index, &release_fence[SOURCE], (fence_count > 0));
     if (success) {
-        if (!queueBuffer(getCanvas(), mCurrentTypeBuf[TARGET], &release_fence[TARGET], (--fence_count > 0))) {
-            // reset the state of the output path.
+        mQueuedCount[SOURCE]++;
+
+        if (!queueBuffer(getCanvas(), mCurrentTypeBuf[TARGET], index, &release_fence[TARGET], (--fence_count > 0))) {
+            // reset the state of the output path after the frames in flight complete.
             // ignore even though resetMode() is failed. Nothing to do any more.
-            resetMode();
+            waitQueue(0);
+            resetMode(*getLayer(0), SOURCE);
+            resetMode(getCanvas(), TARGET);
+            mQueueHead = 0;
             if (release_fence[SOURCE] >= 0)
                 close(release_fence[SOURCE]);
             success = false;
@@ -487,8 +506,9 @@ bool AcrylicCompositorMSCL9810::queueBuffer(int fence[], unsigned int num_fences
     }
 
     if (success) {
-        setDeviceState(SOURCE, STATE_QBUF);
-        setDeviceState(TARGET, STATE_QBUF);
+        mQueuedCount[TARGET]++;
+        mLastHandle = (mLastHandle == INT_MAX) ? 1 : mLastHandle + 1;
+        mFrameHandle[index] = mLastHandle;
 
         unsigned int max_fences = num_fences < NUM_IMAGES ? num_fences : NUM_IMAGES;
 
@@ -516,7 +536,7 @@ bool AcrylicCompositorMSCL9810::queueBuffer(int fence[], unsigned int num_fences
 
 #define DATASPACE_RANGE_FULL        1
 #define DATASPACE_RANGE_LIMITED     0
-bool AcrylicCompositorMSCL9810::configureCSC()
+void AcrylicCompositorMSCL9810::configureCSC()
 {
     bool csc_req = false;
     AcrylicCanvas *cscCanvas;
@@ -556,23 +576,69 @@ bool AcrylicCompositorMSCL9810::configureCSC()
 
         cscRange = haldataspace_to_range(cscCanvas->getDataspace(), coord.hori, coord.vert);
 
-        v4l2_control ctrl;
+        setControl(CTRL_CSC_EQ, cscSel);
+        setControl(CTRL_CSC_RANGE, cscRange);
+    }
+}
 
-        ctrl.id = V4L2_CID_CSC_EQ;
-        ctrl.value = cscSel;
-        ALOGD_TEST("VIDIOC_S_CTRL: csc_matrix_sel=%d", ctrl.value);
-        if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure csc matrix to %d", ctrl.value);
-            return false;
+bool AcrylicCompositorMSCL9810::applyControls()
+{
+    v4l2_ext_controls ext_ctrls;
+    v4l2_ext_control ext_ctrl[NUM_CONTROLS];
+    unsigned int index[NUM_CONTROLS];
+    unsigned int count = 0;
+
+    memset(&ext_ctrls, 0, sizeof(ext_ctrls));
+    memset(ext_ctrl, 0, sizeof(ext_ctrl));
+
+    for (unsigned int i = 0; i < NUM_CONTROLS; i++) {
+        if (isControlChanged(i)) {
+            ext_ctrl[count].id = mControls[i].id;
+            ext_ctrl[count].value = mControls[i].value;
+            ALOGD_TEST("VIDIOC_S_EXT_CTRLS: id=%#x, value=%d", ext_ctrl[count].id, ext_ctrl[count].value);
+            index[count++] = i;
+        }
+    }
+
+    if (count == 0)
+        return true;
+
+    ext_ctrls.ctrl_class = V4L2_CTRL_CLASS_USER;
+    ext_ctrls.count = count;
+    ext_ctrls.controls = ext_ctrl;
+
+    if (mDev.ioctl(VIDIOC_S_EXT_CTRLS, &ext_ctrls) == 0) {
+        for (unsigned int i = 0; i < count; i++) {
+            mControls[index[i]].applied = mControls[index[i]].value;
+            mControls[index[i]].valid = true;
         }
 
-        ctrl.id = V4L2_CID_CSC_RANGE;
-        ctrl.value = cscRange;
-        ALOGD_TEST("VIDIOC_S_CTRL: csc_range=%d", ctrl.value);
+        return true;
+    }
+
+    // The controls are configured one by one to find the one that failed.
+    for (unsigned int i = 0; i < count; i++) {
+        ControlState &state = mControls[index[i]];
+        v4l2_control ctrl;
+
+        ctrl.id = state.id;
+        ctrl.value = state.value;
+        ALOGD_TEST("VIDIOC_S_CTRL: id=%#x, value=%d", ctrl.id, ctrl.value);
         if (mDev.ioctl(VIDIOC_S_CTRL, &ctrl) < 0) {
-            ALOGERR("Failed to configure csc range to %d", ctrl.value);
-            return false;
+            /*
+             * It doesn't return EINVAL by value.
+             * But in case of not supporting SC_CID_FRAMERATE it returns EINVAL.
+             * Some chips don't support this feature.So, just keep running.
+             */
+            if ((index[i] != CTRL_FRAMERATE) || (errno != EINVAL)) {
+                ALOGERR("Failed VIDIOC_S_CTRL: id=%#x, value=%d", ctrl.id, ctrl.value);
+                state.valid = false;
+                return false;
+            }
         }
+
+        state.applied = state.value;
+        state.valid = true;
     }
 
     return true;
@@ -585,14 +651,6 @@ bool AcrylicCompositorMSCL9810::execute(int fence[], unsigned int num_fences)
 
     LOGASSERT(layerCount() == 1, "Number of layer is not 1 but %d", layerCount());
 
-    if (!waitExecution(0)) {
-        ALOGE("Error occurred in the previous image processing");
-        return false;
-    }
-
-    if (!setTransform())
-        return false;
-
     if (!resetMode())
         return false;
 
@@ -602,6 +660,12 @@ bool AcrylicCompositorMSCL9810::execute(int fence[], unsigned int num_fences)
     if (!prepareExecute())
         return false;
 
+    // Wait for the oldest frame if all the buffers are in flight
+    if (!waitQueue(getBufferCount() - 1)) {
+        ALOGE("Error occurred in the previous image processing");
+        return false;
+    }
+
     return queueBuffer(fence, num_fences);
 }
 
@@ -611,9 +675,9 @@ bool AcrylicCompositorMSCL9810::execute(int *handle)
 
     if (success) {
         if (handle != NULL)
-            *handle = 1; /* dummy handle */
+            *handle = mLastHandle;
         else
-            success = waitExecution(0);
+            success = waitExecution(mLastHandle);
     }
 
     return success;
@@ -621,9 +685,13 @@ bool AcrylicCompositorMSCL9810::execute(int *handle)
 
 bool AcrylicCompositorMSCL9810::dequeueBuffer()
 {
-    LOGASSERT(testDeviceState(SOURCE, STATE_QBUF) == testDeviceState(TARGET, STATE_QBUF),
-              "State of the device is different: source %#x, target %#x",
-              mDeviceState[SOURCE], mDeviceState[TARGET]);
+    // The source has one more buffer only if queueing the target failed
+    LOGASSERT(mQueuedCount[SOURCE] >= mQueuedCount[TARGET],
+              "Number of the queued buffers is different: source %u, target %u",
+              mQueuedCount[SOURCE], mQueuedCount[TARGET]);
+
+    if (mQueuedCount[TARGET] == 0)
+        return true;
 
     v4l2_buffer buffer;
     memset(&buffer, 0, sizeof(buffer));
@@ -634,12 +702,15 @@ bool AcrylicCompositorMSCL9810::dequeueBuffer()
     if (!dequeueBuffer(TARGET, &buffer))
         return false;
 
+    // The buffers are processed in the order of queueing
+    mQueueHead = (mQueueHead + 1) % getBufferCount();
+
     return true;
 }
 
 bool AcrylicCompositorMSCL9810::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buffer)
 {
-    if (testDeviceState(dir, STATE_QBUF)) {
+    if (mQueuedCount[dir] > 0) {
         buffer->type = mCurrentTypeBuf[dir];
         buffer->memory = (mCurrentTypeMem[dir] == AcrylicCanvas::MT_DMABUF) ? V4L2_MEMORY_DMABUF
                                                                            : V4L2_MEMORY_USERPTR;
@@ -661,7 +732,7 @@ bool AcrylicCompositorMSCL9810::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buf
             ALOGI("Error during streaming: type=%d, memory=%d", buffer->type, buffer->memory);
         }
 
-        clearDeviceState(dir, STATE_QBUF);
+        mQueuedCount[dir]--;
 
         // The clients of V4L2 capture/m2m device should identify and verify the payload
         // written by the device and the expected payload but MSCL driver does not specify
@@ -675,9 +746,41 @@ bool AcrylicCompositorMSCL9810::dequeueBuffer(BUFDIRECTION dir, v4l2_buffer *buf
 
 }
 
-bool AcrylicCompositorMSCL9810::waitExecution(int __unused handle)
+bool AcrylicCompositorMSCL9810::waitQueue(unsigned int count)
 {
-    return dequeueBuffer();
+    while (mQueuedCount[TARGET] > count) {
+        if (!dequeueBuffer())
+            return false;
+    }
+
+    return true;
+}
+
+bool AcrylicCompositorMSCL9810::waitExecution(int handle)
+{
+    if (handle <= 0)
+        return waitQueue(0);
+
+    for (unsigned int i = 0; i < mQueuedCount[TARGET]; i++) {
+        if (mFrameHandle[(mQueueHead + i) % getBufferCount()] == handle)
+            return waitQueue(mQueuedCount[TARGET] - i - 1);
+    }
+
+    // The frame of the handle is already completed
+    return true;
+}
+
+bool AcrylicCompositorMSCL9810::setQueueDepth(unsigned int depth)
+{
+    if ((depth == 0) || (depth > MAX_QUEUE_DEPTH)) {
+        ALOGE("Queue depth %u is not in the range of 1 ~ %u", depth, MAX_QUEUE_DEPTH);
+        return false;
+    }
+
+    // applied by reqbufs at the next frame
+    mQueueDepth = depth;
+
+    return true;
 }
 
 bool AcrylicCompositorMSCL9810::requestPerformanceQoS(AcrylicPerformanceRequest *request)
@@ -689,10 +792,8 @@ bool AcrylicCompositorMSCL9810::requestPerformanceQoS(AcrylicPerformanceRequest
     else
         framerate = request->getFrame(0)->mFrameRate;
 
-    if (mFramerate != framerate) {
-        mFramerate = framerate;
-        mFramerateChanged = true;
-    }
+    // configured with the other controls at the next frame
+    setControl(CTRL_FRAMERATE, framerate);
 
     return true;
 }
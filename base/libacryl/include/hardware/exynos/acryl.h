@@ -1182,6 +1182,18 @@ public:
      * as required. They should be defined in acrylic_soc.h.
      */
     virtual bool requestPerformanceQoS(AcrylicPerformanceRequest *request);
+    /*
+     * Configure the number of the frames that can be queued to HW 2D at the
+     * same time. The default depth is 1 which means that execute() waits for
+     * the previous frame to complete before it queues the next frame. With a
+     * deeper queue, execute() waits only if @depth frames are already queued.
+     * Users should not reuse the buffers of a frame until its release fences
+     * are signaled or waitExecution() with its handle returns.
+     * The implementations that do not support multiple frames in flight
+     * accept only 1. The new depth may be applied from the next frame that
+     * reconfigures HW 2D.
+     */
+    virtual bool setQueueDepth(unsigned int depth) { return depth == 1; }
     /*
      * Called when an AcrylicLayer is being destroyed
      */
@@ -0,0 +1,418 @@
+/*
+ *  libacryl_plugins/libacryl_plugin_slsi_hdr10_lut.cpp
+ *
+ *   Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <system/graphics.h>
+
+#include "libacryl_plugin_slsi_hdr10_lut.h"
+
+#define TRANSFER_INDEX(transfer) (HAL_DATASPACE_TRANSFER_##transfer >> HAL_DATASPACE_TRANSFER_SHIFT)
+
+#define EOTF_RANGE 1024
+#define EOTF_MAX   0x3FFF
+#define TM_RANGE   16384
+#define TM_MAX     0x3FF
+#define GM_ONE     16384
+
+// The luminance of ST.2084 content above the knee is compressed if the content is brighter than
+// HDR_REFERENCE_LUMINANCE. It reproduces EOTF_ST2084_4000nit.
+#define EOTF_KNEE_LUMINANCE 300.0
+// TM to Gamma 2.2 makes the reference 1.82 times brighter than SDR white and the highlights
+// above 75% of SDR white are compressed. It reproduces TM_GAMMA22_1000nit.
+#define TM_SDR_GAIN 1.82
+#define TM_SDR_KNEE 0.75
+
+static double pqToLuminance(double e)
+{
+    const double m1 = 2610.0 / 16384, m2 = 2523.0 / 4096 * 128;
+    const double c1 = 3424.0 / 4096, c2 = 2413.0 / 4096 * 32, c3 = 2392.0 / 4096 * 32;
+    double p = pow(e, 1 / m2);
+
+    return HDR_MAX_LUMINANCE * pow(std::max(p - c1, 0.0) / (c2 - c3 * p), 1 / m1);
+}
+
+static double luminanceToPq(double l)
+{
+    const double m1 = 2610.0 / 16384, m2 = 2523.0 / 4096 * 128;
+    const double c1 = 3424.0 / 4096, c2 = 2413.0 / 4096 * 32, c3 = 2392.0 / 4096 * 32;
+    double y = pow(l / HDR_MAX_LUMINANCE, m1);
+
+    return pow((c1 + c2 * y) / (1 + c3 * y), m2);
+}
+
+static double srgbToLinear(double e)
+{
+    return (e <= 0.04045) ? e / 12.92 : pow((e + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgb(double l)
+{
+    return (l <= 0.0031308) ? l * 12.92 : 1.055 * pow(l, 1 / 2.4) - 0.055;
+}
+
+static double smpte170mToLinear(double e)
+{
+    return (e < 0.081) ? e / 4.5 : pow((e + 0.099) / 1.099, 1 / 0.45);
+}
+
+static double linearToSmpte170m(double l)
+{
+    return (l < 0.018) ? l * 4.5 : 1.099 * pow(l, 0.45) - 0.099;
+}
+
+static double hlgToLinear(double e)
+{
+    const double a = 0.17883277, b = 1 - 4 * a, c = 0.5 - a * log(4 * a);
+
+    return (e <= 0.5) ? e * e / 3 : (exp((e - c) / a) + b) / 12;
+}
+
+// Extended Reinhard curve from (0, 0) with the slope of 1 to (@white, 1)
+static double shoulder(double l, double white)
+{
+    return l * (1 + l / (white * white)) / (1 + l);
+}
+
+// @e is ST.2084 of content mastered at @luminance and the result is relative to the reference.
+static double pqToReference(double e, double luminance)
+{
+    const double range = HDR_REFERENCE_LUMINANCE - EOTF_KNEE_LUMINANCE;
+    double l = pqToLuminance(e);
+
+    if ((luminance > HDR_REFERENCE_LUMINANCE) && (l > EOTF_KNEE_LUMINANCE))
+        l = EOTF_KNEE_LUMINANCE + range * shoulder((l - EOTF_KNEE_LUMINANCE) / range,
+                                                   (luminance - EOTF_KNEE_LUMINANCE) / range);
+
+    return std::min(l / HDR_REFERENCE_LUMINANCE, 1.0);
+}
+
+// @l is relative to the reference and @peak is the peak of the content relative to the reference.
+// The result is relative to SDR white. The knee moves up to SDR white as the content gets dimmer
+// because the highlights need less compression.
+static double referenceToSdr(double l, double peak)
+{
+    double sdr = l * TM_SDR_GAIN;
+    double white = peak * TM_SDR_GAIN;
+
+    if (white <= 1.0)
+        return std::min(sdr, 1.0);
+
+    double knee = 1.0 - (1.0 - TM_SDR_KNEE) * std::min((white - 1.0) / (TM_SDR_GAIN - 1.0), 1.0);
+    if (sdr <= knee)
+        return sdr;
+
+    return std::min(knee + (1 - knee) * shoulder((sdr - knee) / (1 - knee),
+                                                 (white - knee) / (1 - knee)), 1.0);
+}
+
+// The largest distance of @curve from the line between the control points at @from and @to
+static double interpolationError(const std::vector<double> &curve, unsigned int from, unsigned int to)
+{
+    double slope = (curve[to] - curve[from]) / (to - from);
+    double error = 0;
+
+    for (unsigned int x = from + 1; x < to; x++)
+        error = std::max(error, fabs(curve[from] + slope * (x - from) - curve[x]));
+
+    return error;
+}
+
+// Places the control points from 0 to @range with the longest segments within @tolerance.
+// Returns the number of the control points before @range.
+static unsigned int placeControlPoints(const std::vector<double> &curve, unsigned int range,
+                                       double tolerance, std::vector<unsigned int> &points)
+{
+    points.clear();
+
+    for (unsigned int x = 0; x < range; ) {
+        unsigned int end = x + 1;
+        unsigned int step = 1;
+
+        points.push_back(x);
+
+        while ((end + step <= range) && (interpolationError(curve, x, end + step) <= tolerance)) {
+            end += step;
+            step *= 2;
+        }
+
+        while (step > 1) {
+            step /= 2;
+            if ((end + step <= range) && (interpolationError(curve, x, end + step) <= tolerance))
+                end += step;
+        }
+
+        x = end;
+    }
+
+    return static_cast<unsigned int>(points.size());
+}
+
+// @curve has the output codes of the inputs from 0 to @range. The control points are placed where
+// the largest error of the linear interpolation between them is the smallest.
+static void writeControlPoints(const std::vector<double> &curve, unsigned int range,
+                               unsigned int count, uint32_t coef[], bool eotf)
+{
+    std::vector<unsigned int> points;
+    double low = 0, high = curve[range] - curve[0];
+
+    // down to a quarter of the code of 14-bit
+    for (int i = 0; i < 16; i++) {
+        double tolerance = (low + high) / 2;
+        if (placeControlPoints(curve, range, tolerance, points) > count)
+            low = tolerance;
+        else
+            high = tolerance;
+    }
+
+    placeControlPoints(curve, range, high, points);
+
+    // the longest segments are split if the curve needs fewer control points
+    points.push_back(range);
+    while (points.size() < count + 1) {
+        unsigned int longest = 0;
+        for (unsigned int i = 1; i < points.size() - 1; i++)
+            if (points[i + 1] - points[i] > points[longest + 1] - points[longest])
+                longest = i;
+        points.insert(points.begin() + longest + 1, (points[longest] + points[longest + 1]) / 2);
+    }
+
+    unsigned int y = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        y = static_cast<unsigned int>(lround(curve[points[i]]));
+        coef[i] = eotf ? EOTF_COEF(points[i], y) : TM_COEF(points[i], y);
+    }
+
+    unsigned int end = static_cast<unsigned int>(lround(curve[range]));
+    coef[count] = eotf ? EOTF_COEF(range - points[count - 1], end - y)
+                       : TM_COEF(range - points[count - 1], end - y);
+}
+
+double HdrLutGenerator::eotf(unsigned int transfer, unsigned int luminance, double e)
+{
+    if ((transfer == TRANSFER_INDEX(UNSPECIFIED)) || (transfer == TRANSFER_INDEX(SMPTE_170M)))
+        return std::min(smpte170mToLinear(e), 1.0);
+    if (transfer == TRANSFER_INDEX(SRGB))
+        return std::min(srgbToLinear(e), 1.0);
+    if (transfer == TRANSFER_INDEX(HLG))
+        return std::min(hlgToLinear(e), 1.0);
+    if (transfer == TRANSFER_INDEX(ST2084))
+        return pqToReference(e, std::min(luminance, static_cast<unsigned int>(HDR_MAX_LUMINANCE)));
+
+    return -1.0;
+}
+
+double HdrLutGenerator::tm(unsigned int transfer, unsigned int luminance, double l)
+{
+    double peak = static_cast<double>(std::min(luminance, static_cast<unsigned int>(HDR_MAX_LUMINANCE)))
+                  / HDR_REFERENCE_LUMINANCE;
+
+    if ((transfer == TRANSFER_INDEX(UNSPECIFIED)) || (transfer == TRANSFER_INDEX(SRGB)))
+        return std::min(linearToSrgb(l), 1.0);
+    // TM_SMPTE170M_1000nit and TM_SMPTE170M_4000nit are tuned curves that are not modeled
+    if ((transfer == TRANSFER_INDEX(SMPTE_170M)) && (luminance == 0))
+        return std::min(linearToSmpte170m(l), 1.0);
+    if (transfer == TRANSFER_INDEX(GAMMA2_2))
+        return pow((luminance > 0) ? referenceToSdr(l, peak) : std::min(l, 1.0), 1 / 2.2);
+    if (transfer == TRANSFER_INDEX(GAMMA2_6))
+        return pow(std::min(l, 1.0), 1 / 2.6);
+    if (transfer == TRANSFER_INDEX(ST2084))
+        return luminanceToPq(std::min(l, 1.0) * HDR_REFERENCE_LUMINANCE);
+
+    return -1.0;
+}
+
+bool HdrLutGenerator::generateEotf(unsigned int transfer, unsigned int luminance, uint32_t coef[])
+{
+    return generateEotf(transfer, luminance, coef, NUM_EOTF_COEFFICIENTS);
+}
+
+bool HdrLutGenerator::generateEotf(unsigned int transfer, unsigned int luminance, uint32_t coef[],
+                                   unsigned int count)
+{
+    std::vector<double> curve(EOTF_RANGE + 1);
+
+    if (eotf(transfer, luminance, 0.0) < 0)
+        return false;
+
+    for (unsigned int x = 0; x <= EOTF_RANGE; x++)
+        curve[x] = eotf(transfer, luminance, static_cast<double>(x) / EOTF_RANGE) * EOTF_MAX;
+
+    writeControlPoints(curve, EOTF_RANGE, count - 1, coef, true);
+
+    return true;
+}
+
+bool HdrLutGenerator::generateTm(unsigned int transfer, unsigned int luminance, uint32_t coef[])
+{
+    return generateTm(transfer, luminance, coef, NUM_TM_COEFFICIENTS);
+}
+
+bool HdrLutGenerator::generateTm(unsigned int transfer, unsigned int luminance, uint32_t coef[],
+                                 unsigned int count)
+{
+    std::vector<double> curve(TM_RANGE + 1);
+
+    // Only TM to Gamma 2.2 depends on the luminance of the content. The shipped tables serve
+    // the other transfers.
+    if (((luminance > 0) && (transfer != TRANSFER_INDEX(GAMMA2_2))) || (tm(transfer, luminance, 0.0) < 0))
+        return false;
+
+    for (unsigned int x = 0; x <= TM_RANGE; x++)
+        curve[x] = tm(transfer, luminance, static_cast<double>(x) / TM_RANGE) * TM_MAX;
+
+    writeControlPoints(curve, TM_RANGE, count - 1, coef, false);
+
+    return true;
+}
+
+// CIE 1931 xy of the red, green, blue primaries and the white point
+static const double csc_std_primaries[G2D_CSC_STD_COUNT][4][2] = {
+    {{0.640, 0.330}, {0.300, 0.600}, {0.150, 0.060}, {0.3127, 0.3290}}, // G2D_CSC_STD_601
+    {{0.640, 0.330}, {0.300, 0.600}, {0.150, 0.060}, {0.3127, 0.3290}}, // G2D_CSC_STD_709
+    {{0.708, 0.292}, {0.170, 0.797}, {0.131, 0.046}, {0.3127, 0.3290}}, // G2D_CSC_STD_2020
+    {{0.680, 0.320}, {0.265, 0.690}, {0.150, 0.060}, {0.3127, 0.3290}}, // G2D_CSC_STD_P3
+};
+
+static void invertMatrix(const double m[3][3], double inv[3][3])
+{
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            inv[j][i] = (m[(i + 1) % 3][(j + 1) % 3] * m[(i + 2) % 3][(j + 2) % 3] -
+                         m[(i + 1) % 3][(j + 2) % 3] * m[(i + 2) % 3][(j + 1) % 3]) / det;
+}
+
+static void rgbToXyzMatrix(const double primaries[4][2], double m[3][3])
+{
+    double xyz[3][3], inv[3][3], white[3], scale[3];
+
+    for (int i = 0; i < 3; i++) {
+        xyz[0][i] = primaries[i][0] / primaries[i][1];
+        xyz[1][i] = 1.0;
+        xyz[2][i] = (1 - primaries[i][0] - primaries[i][1]) / primaries[i][1];
+    }
+
+    white[0] = primaries[3][0] / primaries[3][1];
+    white[1] = 1.0;
+    white[2] = (1 - primaries[3][0] - primaries[3][1]) / primaries[3][1];
+
+    // the sum of the primaries scaled by @scale is the white point
+    invertMatrix(xyz, inv);
+    for (int i = 0; i < 3; i++)
+        scale[i] = inv[i][0] * white[0] + inv[i][1] * white[1] + inv[i][2] * white[2];
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            m[i][j] = xyz[i][j] * scale[j];
+}
+
+bool HdrLutGenerator::gamutMatrix(unsigned int source, unsigned int target, double matrix[3][3])
+{
+    if ((source >= G2D_CSC_STD_COUNT) || (target >= G2D_CSC_STD_COUNT))
+        return false;
+
+    if (!memcmp(csc_std_primaries[source], csc_std_primaries[target], sizeof(csc_std_primaries[0])))
+        return false;
+
+    double src[3][3], dst[3][3], inv[3][3];
+
+    rgbToXyzMatrix(csc_std_primaries[source], src);
+    rgbToXyzMatrix(csc_std_primaries[target], dst);
+    invertMatrix(dst, inv);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            matrix[i][j] = inv[i][0] * src[0][j] + inv[i][1] * src[1][j] + inv[i][2] * src[2][j];
+
+    return true;
+}
+
+bool HdrLutGenerator::generateGm(unsigned int source, unsigned int target, uint32_t coef[])
+{
+    double matrix[3][3];
+
+    if (!gamutMatrix(source, target, matrix))
+        return false;
+
+    // the coefficients are stored column by column
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            coef[i * 3 + j] = GM_COEF(static_cast<int32_t>(lround(matrix[j][i] * GM_ONE)));
+
+    return true;
+}
+
+enum { LUT_TYPE_EOTF, LUT_TYPE_TM, LUT_TYPE_GM };
+
+uint32_t *HdrLutGenerator::getTable(unsigned int type, unsigned int arg0, unsigned int arg1,
+                                    unsigned int count, Generator generate)
+{
+    static std::mutex lock;
+    static std::map<uint32_t, std::vector<uint32_t>> tables;
+
+    uint32_t key = (type << 24) | ((arg0 & 0xFF) << 16) | (arg1 & 0xFFFF);
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = tables.find(key);
+    if (it == tables.end()) {
+        std::vector<uint32_t> table(count);
+        // an empty table remembers the arguments that are not modeled
+        if (!generate(arg0, arg1, table.data()))
+            table.clear();
+        it = tables.emplace(key, std::move(table)).first;
+    }
+
+    return it->second.empty() ? nullptr : it->second.data();
+}
+
+static unsigned int roundLuminance(unsigned int luminance)
+{
+    unsigned int step = HdrLutGenerator::LUMINANCE_STEP;
+
+    // 0 has its own meaning that should not be made by rounding
+    if (luminance == 0)
+        return 0;
+
+    luminance = std::min(luminance, static_cast<unsigned int>(HDR_MAX_LUMINANCE));
+    return std::max((luminance + step / 2) / step * step, step);
+}
+
+uint32_t *HdrLutGenerator::getEotf(unsigned int transfer, unsigned int luminance)
+{
+    return getTable(LUT_TYPE_EOTF, transfer, roundLuminance(luminance),
+                    NUM_EOTF_COEFFICIENTS, static_cast<Generator>(generateEotf));
+}
+
+uint32_t *HdrLutGenerator::getTm(unsigned int transfer, unsigned int luminance)
+{
+    return getTable(LUT_TYPE_TM, transfer, roundLuminance(luminance),
+                    NUM_TM_COEFFICIENTS, static_cast<Generator>(generateTm));
+}
+
+uint32_t *HdrLutGenerator::getGm(unsigned int source, unsigned int target)
+{
+    return getTable(LUT_TYPE_GM, source, target, NUM_GM_COEFFICIENTS, generateGm);
+}
@@ -0,0 +1,89 @@
+/*
+ *  libacryl_plugins/libacryl_plugin_slsi_hdr10_lut.h
+ *
+ *   Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef __LIBACRYL_PLUGIN_SLSI_HDR10_LUT_H__
+#define __LIBACRYL_PLUGIN_SLSI_HDR10_LUT_H__
+
+#include <cstdint>
+
+enum {
+    G2D_CSC_STD_UNDEFINED = -1,
+    G2D_CSC_STD_601       = 0,
+    G2D_CSC_STD_709       = 1,
+    G2D_CSC_STD_2020      = 2,
+    G2D_CSC_STD_P3        = 3,
+
+    G2D_CSC_STD_COUNT     = 4,
+};
+
+#define NUM_EOTF_COEFFICIENTS 65
+#define NUM_GM_COEFFICIENTS   9
+#define NUM_TM_COEFFICIENTS   33
+
+#define EOTF_COEF(x, y) (((x) & 0x3FF) | (((y) & 0x3FFF) << 16))
+#define GM_COEF(v)      (v & 0x1FFFF)
+#define TM_COEF(x, y)   (((x) & 0x3FFF) | (((y) & 0x3FF) << 16))
+
+// The linear output of EOTF and the linear input of TM are normalized to this luminance of HDR
+// content. EOTF compresses the highlights of the brighter content to fit in it.
+#define HDR_REFERENCE_LUMINANCE 1000
+#define HDR_MAX_LUMINANCE       10000
+
+// HdrLutGenerator computes the coefficients of EOTF, GM and TM in the encodings of the shipped
+// tables from the transfer functions and the primaries instead of picking the nearest table.
+// - EOTF of ST.2084 maps the luminance up to HDR_REFERENCE_LUMINANCE linearly. The highlights of
+//   brighter content above a knee are compressed to reach the reference at the mastering luminance.
+// - TM to Gamma 2.2 of HDR content scales the reference to SDR with a gain and compresses the
+//   highlights above a knee to reach the SDR white at the peak luminance of the content.
+// The 64 (EOTF) or 32 (TM) control points are placed where the curve bends the most. The last
+// coefficient is the distance from the last control point to the end of the range.
+// The transfer is the index of HAL_DATASPACE_TRANSFER_*, the luminance is in nits and 0 of
+// luminance means SDR content for TM and the reference for EOTF.
+class HdrLutGenerator {
+public:
+    // Return false if the curve of the arguments is not modeled.
+    static bool generateEotf(unsigned int transfer, unsigned int luminance, uint32_t coef[]);
+    static bool generateTm(unsigned int transfer, unsigned int luminance, uint32_t coef[]);
+    // @count coefficients instead of the number of G2D to evaluate other sizes of the tables
+    static bool generateEotf(unsigned int transfer, unsigned int luminance, uint32_t coef[],
+                             unsigned int count);
+    static bool generateTm(unsigned int transfer, unsigned int luminance, uint32_t coef[],
+                           unsigned int count);
+    // @source and @target are G2D_CSC_STD_*. 601 has the primaries of 709 like the shipped tables.
+    static bool generateGm(unsigned int source, unsigned int target, uint32_t coef[]);
+
+    // The curves and the matrix that the tables are made from. @e is the normalized code value
+    // and @l is the linear light relative to the reference. Return a negative value or false
+    // if not modeled. The matrix converts linear RGB of @source to @target.
+    static double eotf(unsigned int transfer, unsigned int luminance, double e);
+    static double tm(unsigned int transfer, unsigned int luminance, double l);
+    static bool gamutMatrix(unsigned int source, unsigned int target, double matrix[3][3]);
+
+    // Return the generated tables that live until the process exits, or nullptr if not modeled.
+    // The luminance is rounded to LUMINANCE_STEP to bound the number of tables.
+    static uint32_t *getEotf(unsigned int transfer, unsigned int luminance);
+    static uint32_t *getTm(unsigned int transfer, unsigned int luminance);
+    static uint32_t *getGm(unsigned int source, unsigned int target);
+
+    static const unsigned int LUMINANCE_STEP = 50;
+private:
+    typedef bool (*Generator)(unsigned int, unsigned int, uint32_t[]);
+    static uint32_t *getTable(unsigned int type, unsigned int arg0, unsigned int arg1,
+                              unsigned int count, Generator generate);
+};
+
+#endif // __LIBACRYL_PLUGIN_SLSI_HDR10_LUT_H__
@@ -0,0 +1,255 @@
+/*
+ *  libacryl_plugins/test/hdr10_lut_test.cpp
+ *
+ *   Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <system/graphics.h>
+
+#include "../libacryl_plugin_slsi_hdr10_tables.h"
+
+#define TRANSFER_INDEX(transfer) (HAL_DATASPACE_TRANSFER_##transfer >> HAL_DATASPACE_TRANSFER_SHIFT)
+
+struct ControlPoint {
+    int x;
+    int y;
+};
+
+// the last coefficient is turned to the end of the range
+static std::vector<ControlPoint> decodeEotf(const uint32_t coef[])
+{
+    std::vector<ControlPoint> points;
+
+    for (unsigned int i = 0; i < NUM_EOTF_COEFFICIENTS - 1; i++)
+        points.push_back({static_cast<int>(coef[i] & 0x3FF), static_cast<int>((coef[i] >> 16) & 0x3FFF)});
+
+    const uint32_t last = coef[NUM_EOTF_COEFFICIENTS - 1];
+    points.push_back({points.back().x + static_cast<int>(last & 0x3FF),
+                      points.back().y + static_cast<int>((last >> 16) & 0x3FFF)});
+
+    return points;
+}
+
+static std::vector<ControlPoint> decodeTm(const uint32_t coef[])
+{
+    std::vector<ControlPoint> points;
+
+    for (unsigned int i = 0; i < NUM_TM_COEFFICIENTS - 1; i++)
+        points.push_back({static_cast<int>(coef[i] & 0x3FFF), static_cast<int>((coef[i] >> 16) & 0x3FF)});
+
+    const uint32_t last = coef[NUM_TM_COEFFICIENTS - 1];
+    points.push_back({points.back().x + static_cast<int>(last & 0x3FFF),
+                      points.back().y + static_cast<int>((last >> 16) & 0x3FF)});
+
+    return points;
+}
+
+static double interpolate(const std::vector<ControlPoint> &points, int x)
+{
+    for (size_t i = 1; i < points.size(); i++) {
+        if (x <= points[i].x)
+            return points[i - 1].y + static_cast<double>(points[i].y - points[i - 1].y) *
+                   (x - points[i - 1].x) / (points[i].x - points[i - 1].x);
+    }
+
+    return points.back().y;
+}
+
+static void checkControlPoints(const std::vector<ControlPoint> &points, int range, int max)
+{
+    EXPECT_EQ(points.front().x, 0);
+    EXPECT_EQ(points.back().x, range);
+    EXPECT_EQ(points.back().y, max);
+    for (size_t i = 1; i < points.size(); i++) {
+        EXPECT_GT(points[i].x, points[i - 1].x) << "control point " << i;
+        EXPECT_GE(points[i].y, points[i - 1].y) << "control point " << i;
+    }
+}
+
+// The curve of the generated table passes by every control point of the shipped table
+static double maxDistance(const std::vector<ControlPoint> &generated, const std::vector<ControlPoint> &shipped)
+{
+    double distance = 0;
+
+    for (auto &point : shipped)
+        distance = std::max(distance, std::abs(interpolate(generated, point.x) - point.y));
+
+    return distance;
+}
+
+TEST(HdrLutGeneratorTest, EotfMatchesShippedTables)
+{
+    const struct {
+        unsigned int transfer;
+        unsigned int luminance;
+        const uint32_t *table;
+        double tolerance; // in 14-bit linear of full scale 16383
+    } tests[] = {
+        {TRANSFER_INDEX(SMPTE_170M), 0,    EOTF_SMPTE170M,      40},  // 0.25%
+        {TRANSFER_INDEX(SRGB),       0,    EOTF_sRGB,           40},  // 0.25%
+        {TRANSFER_INDEX(HLG),        0,    EOTF_HLG,            4},
+        {TRANSFER_INDEX(ST2084),     1000, EOTF_ST2084_1000nit, 135}, // 0.8%
+        // the knee of EOTF_ST2084_4000nit is tuned by hand
+        {TRANSFER_INDEX(ST2084),     4000, EOTF_ST2084_4000nit, 235}, // 1.4%
+    };
+
+    for (auto &test : tests) {
+        uint32_t coef[NUM_EOTF_COEFFICIENTS];
+
+        ASSERT_TRUE(HdrLutGenerator::generateEotf(test.transfer, test.luminance, coef));
+        auto generated = decodeEotf(coef);
+        auto shipped = decodeEotf(test.table);
+        checkControlPoints(generated, 1024, shipped.back().y);
+        EXPECT_LE(maxDistance(generated, shipped), test.tolerance)
+            << "transfer " << test.transfer << " " << test.luminance << " nit";
+    }
+}
+
+TEST(HdrLutGeneratorTest, TmMatchesShippedTables)
+{
+    const struct {
+        unsigned int transfer;
+        unsigned int luminance;
+        const uint32_t *table;
+        double tolerance; // in 10-bit
+    } tests[] = {
+        {TRANSFER_INDEX(SRGB),       0,    TM_sRGB,            2},
+        {TRANSFER_INDEX(SMPTE_170M), 0,    TM_SMPTE170M,       2},
+        {TRANSFER_INDEX(GAMMA2_2),   0,    TM_GAMMA22,         2},
+        {TRANSFER_INDEX(GAMMA2_2),   1000, TM_GAMMA22_1000nit, 5},
+        {TRANSFER_INDEX(GAMMA2_6),   0,    TM_GAMMA26,         2},
+        {TRANSFER_INDEX(ST2084),     0,    TM_ST2084_1000nit,  2},
+    };
+
+    for (auto &test : tests) {
+        uint32_t coef[NUM_TM_COEFFICIENTS];
+
+        ASSERT_TRUE(HdrLutGenerator::generateTm(test.transfer, test.luminance, coef));
+        auto generated = decodeTm(coef);
+        auto shipped = decodeTm(test.table);
+        checkControlPoints(generated, 16384, shipped.back().y);
+        EXPECT_LE(maxDistance(generated, shipped), test.tolerance)
+            << "transfer " << test.transfer << " " << test.luminance << " nit";
+    }
+}
+
+TEST(HdrLutGeneratorTest, GmMatchesShippedTables)
+{
+    const struct {
+        unsigned int source;
+        unsigned int target;
+        const uint32_t *table;
+    } tests[] = {
+        {G2D_CSC_STD_709,  G2D_CSC_STD_P3,   GM_709_to_P3},
+        {G2D_CSC_STD_709,  G2D_CSC_STD_2020, GM_709_to_2020},
+        {G2D_CSC_STD_P3,   G2D_CSC_STD_709,  GM_P3_to_709},
+        {G2D_CSC_STD_P3,   G2D_CSC_STD_2020, GM_P3_to_2020},
+        {G2D_CSC_STD_2020, G2D_CSC_STD_709,  GM_2020_to_709},
+        {G2D_CSC_STD_2020, G2D_CSC_STD_P3,   GM_2020_to_P3},
+    };
+
+    for (auto &test : tests) {
+        uint32_t coef[NUM_GM_COEFFICIENTS];
+
+        ASSERT_TRUE(HdrLutGenerator::generateGm(test.source, test.target, coef));
+        for (unsigned int i = 0; i < NUM_GM_COEFFICIENTS; i++) {
+            // sign extension of 17-bit
+            int generated = static_cast<int>(coef[i] << 15) >> 15;
+            int shipped = static_cast<int>(test.table[i] << 15) >> 15;
+            EXPECT_LE(std::abs(generated - shipped), 2)
+                << test.source << " to " << test.target << " coefficient " << i;
+        }
+    }
+}
+
+TEST(HdrLutGeneratorTest, ArbitraryLuminance)
+{
+    uint32_t coef[NUM_EOTF_COEFFICIENTS];
+    double previous = 0x3FFF;
+
+    // brighter content is compressed more
+    for (unsigned int luminance = 1000; luminance <= 10000; luminance += 250) {
+        ASSERT_TRUE(HdrLutGenerator::generateEotf(TRANSFER_INDEX(ST2084), luminance, coef));
+        auto points = decodeEotf(coef);
+        checkControlPoints(points, 1024, 0x3FFF);
+
+        double highlight = interpolate(points, 768);
+        EXPECT_LE(highlight, previous) << luminance << " nit";
+        previous = highlight;
+    }
+
+    // dimmer content is compressed less
+    std::vector<ControlPoint> dimmer;
+    for (unsigned int luminance = 50; luminance <= 1000; luminance += 50) {
+        ASSERT_TRUE(HdrLutGenerator::generateTm(TRANSFER_INDEX(GAMMA2_2), luminance, coef));
+        auto points = decodeTm(coef);
+        checkControlPoints(points, 16384, 0x3FF);
+
+        // the peak of the content reaches SDR white if the gain does not keep it darker
+        int peak = luminance * 16384 / 1000;
+        if (luminance >= 550) {
+            EXPECT_NEAR(interpolate(points, peak), 0x3FF, 4) << luminance << " nit";
+        }
+
+        if (!dimmer.empty()) {
+            int dimmerPeak = (luminance - 50) * 16384 / 1000;
+            EXPECT_LE(interpolate(points, dimmerPeak), interpolate(dimmer, dimmerPeak) + 1)
+                << luminance << " nit";
+        }
+        dimmer = points;
+    }
+}
+
+TEST(HdrLutGeneratorTest, UnmodeledCurves)
+{
+    uint32_t coef[NUM_EOTF_COEFFICIENTS];
+
+    EXPECT_FALSE(HdrLutGenerator::generateEotf(TRANSFER_INDEX(LINEAR), 0, coef));
+    EXPECT_FALSE(HdrLutGenerator::generateEotf(TRANSFER_INDEX(GAMMA2_8), 0, coef));
+    EXPECT_FALSE(HdrLutGenerator::generateTm(TRANSFER_INDEX(HLG), 0, coef));
+    EXPECT_FALSE(HdrLutGenerator::generateTm(TRANSFER_INDEX(SMPTE_170M), 1000, coef));
+    EXPECT_FALSE(HdrLutGenerator::generateTm(TRANSFER_INDEX(SRGB), 1000, coef));
+    EXPECT_FALSE(HdrLutGenerator::generateGm(G2D_CSC_STD_601, G2D_CSC_STD_709, coef));
+    EXPECT_FALSE(HdrLutGenerator::generateGm(G2D_CSC_STD_P3, G2D_CSC_STD_P3, coef));
+}
+
+TEST(HdrLutGeneratorTest, CachedTables)
+{
+    const unsigned int pq = TRANSFER_INDEX(ST2084);
+    uint32_t coef[NUM_EOTF_COEFFICIENTS];
+
+    uint32_t *table = HdrLutGenerator::getEotf(pq, 1510);
+    ASSERT_NE(table, nullptr);
+    EXPECT_EQ(HdrLutGenerator::getEotf(pq, 1520), table);
+    EXPECT_NE(HdrLutGenerator::getEotf(pq, 1600), table);
+
+    ASSERT_TRUE(HdrLutGenerator::generateEotf(pq, 1500, coef));
+    EXPECT_EQ(memcmp(table, coef, sizeof(coef)), 0);
+
+    // dim content is not rounded to SDR
+    table = HdrLutGenerator::getTm(TRANSFER_INDEX(GAMMA2_2), 10);
+    ASSERT_NE(table, nullptr);
+    ASSERT_TRUE(HdrLutGenerator::generateTm(TRANSFER_INDEX(GAMMA2_2), HdrLutGenerator::LUMINANCE_STEP, coef));
+    EXPECT_EQ(memcmp(table, coef, sizeof(uint32_t) * NUM_TM_COEFFICIENTS), 0);
+
+    EXPECT_EQ(HdrLutGenerator::getTm(TRANSFER_INDEX(SMPTE_170M), 600), nullptr);
+    EXPECT_EQ(HdrLutGenerator::getTm(TRANSFER_INDEX(SMPTE_170M), 600), nullptr);
+    EXPECT_EQ(HdrLutGenerator::getGm(G2D_CSC_STD_709, G2D_CSC_STD_P3),
+              HdrLutGenerator::getGm(G2D_CSC_STD_709, G2D_CSC_STD_P3));
+}
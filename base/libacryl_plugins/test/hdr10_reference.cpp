@@ -0,0 +1,384 @@
+/*
+ *  libacryl_plugins/test/hdr10_reference.cpp
+ *
+ *   Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+
+#include <system/graphics.h>
+
+#include "hdr10_reference.h"
+
+#define TRANSFER_OF(dataspace) (((dataspace) & HAL_DATASPACE_TRANSFER_MASK) >> HAL_DATASPACE_TRANSFER_SHIFT)
+#define STANDARD_OF(dataspace) ((dataspace) & HAL_DATASPACE_STANDARD_MASK)
+
+// The registers of the coefficients of the slots and the fields of LAYERx_HDR_MODE_REG
+static const uint32_t eotfSlotOffset[G2DHdr10Reference::MAX_SLOTS] = {0x3200, 0x3000};
+static const uint32_t gmSlotOffset[G2DHdr10Reference::MAX_SLOTS]   = {0x3500, 0x3400};
+static const uint32_t tmSlotOffset[G2DHdr10Reference::MAX_SLOTS]   = {0x3700, 0x3600};
+
+#define HDR_MODE_EOTF_SLOT(mode) ((mode) & 1)
+#define HDR_MODE_EOTF_ENABLE     (1 << 1)
+#define HDR_MODE_GM_SLOT(mode)   (((mode) >> 4) & 1)
+#define HDR_MODE_GM_ENABLE       (1 << 5)
+#define HDR_MODE_TM_SLOT(mode)   (((mode) >> 7) & 1)
+#define HDR_MODE_TM_ENABLE       (1 << 8)
+
+#define EOTF_IN_MAX  1023
+#define EOTF_OUT_MAX 16383
+#define TM_IN_MAX    16383
+#define TM_OUT_MAX   1023
+
+void G2DHdr10ErrorStats::add(double error)
+{
+    error = fabs(error);
+    max = std::max(max, error);
+    sumSquare += error * error;
+    count++;
+}
+
+double G2DHdr10ErrorStats::rms() const
+{
+    return count ? sqrt(sumSquare / count) : 0.0;
+}
+
+static bool findSlot(const uint32_t slotOffset[], unsigned int count, uint32_t offset,
+                     unsigned int &slot, unsigned int &index)
+{
+    for (slot = 0; slot < G2DHdr10Reference::MAX_SLOTS; slot++) {
+        if ((offset >= slotOffset[slot]) && (offset < slotOffset[slot] + count * sizeof(uint32_t))) {
+            index = (offset - slotOffset[slot]) / sizeof(uint32_t);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool G2DHdr10Reference::load(const g2d_commandlist &commands)
+{
+    mLayerModes.clear();
+    for (unsigned int i = 0; i < commands.layer_count; i++)
+        mLayerModes.push_back(commands.layer_hdr_mode[i].value);
+
+    for (unsigned int i = 0; i < commands.command_count; i++) {
+        const g2d_reg &reg = commands.commands[i];
+        unsigned int slot, index;
+
+        if (findSlot(eotfSlotOffset, NUM_EOTF_COEFFICIENTS, reg.offset, slot, index))
+            mEotf[slot][index] = reg.value;
+        else if (findSlot(gmSlotOffset, NUM_GM_COEFFICIENTS, reg.offset, slot, index))
+            mGm[slot][index] = reg.value;
+        else if (findSlot(tmSlotOffset, NUM_TM_COEFFICIENTS, reg.offset, slot, index))
+            mTm[slot][index] = reg.value;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+const uint32_t *G2DHdr10Reference::getEotf(unsigned int layer) const
+{
+    uint32_t mode = mLayerModes[layer];
+    return (mode & HDR_MODE_EOTF_ENABLE) ? mEotf[HDR_MODE_EOTF_SLOT(mode)] : nullptr;
+}
+
+const uint32_t *G2DHdr10Reference::getGm(unsigned int layer) const
+{
+    uint32_t mode = mLayerModes[layer];
+    return (mode & HDR_MODE_GM_ENABLE) ? mGm[HDR_MODE_GM_SLOT(mode)] : nullptr;
+}
+
+const uint32_t *G2DHdr10Reference::getTm(unsigned int layer) const
+{
+    uint32_t mode = mLayerModes[layer];
+    return (mode & HDR_MODE_TM_ENABLE) ? mTm[HDR_MODE_TM_SLOT(mode)] : nullptr;
+}
+
+struct ControlPoint {
+    int64_t x;
+    int64_t y;
+};
+
+// The last coefficient is the distance of the end of the range from the last control point
+static ControlPoint decode(const uint32_t coef[], unsigned int index, unsigned int count, bool eotf)
+{
+    const uint32_t xmask = eotf ? 0x3FF : 0x3FFF;
+    const uint32_t ymask = eotf ? 0x3FFF : 0x3FF;
+
+    if (index < count - 1)
+        return {coef[index] & xmask, (coef[index] >> 16) & ymask};
+
+    ControlPoint last = decode(coef, count - 2, count, eotf);
+    return {last.x + (coef[count - 1] & xmask), last.y + ((coef[count - 1] >> 16) & ymask)};
+}
+
+static unsigned int findSegment(const uint32_t coef[], unsigned int count, bool eotf, double x)
+{
+    unsigned int i = 1;
+
+    while ((i < count - 1) && (x >= decode(coef, i, count, eotf).x))
+        i++;
+
+    return i;
+}
+
+double G2DHdr10Reference::interpolate(const uint32_t coef[], unsigned int count, bool eotf, double x)
+{
+    unsigned int i = findSegment(coef, count, eotf, x);
+    ControlPoint p0 = decode(coef, i - 1, count, eotf);
+    ControlPoint p1 = decode(coef, i, count, eotf);
+
+    if (x >= p1.x)
+        return p1.y;
+
+    return p0.y + static_cast<double>(p1.y - p0.y) * (x - p0.x) / (p1.x - p0.x);
+}
+
+uint32_t G2DHdr10Reference::interpolate(const uint32_t coef[], unsigned int count, bool eotf, uint32_t x)
+{
+    unsigned int i = findSegment(coef, count, eotf, x);
+    ControlPoint p0 = decode(coef, i - 1, count, eotf);
+    ControlPoint p1 = decode(coef, i, count, eotf);
+
+    if (x >= p1.x)
+        return static_cast<uint32_t>(p1.y);
+
+    int64_t dx = p1.x - p0.x;
+    int64_t delta = (p1.y - p0.y) * (static_cast<int64_t>(x) - p0.x);
+    // rounds to the nearest
+    int64_t y = p0.y + ((delta >= 0) ? (2 * delta + dx) / (2 * dx) : -((-2 * delta + dx) / (2 * dx)));
+
+    return static_cast<uint32_t>(std::max<int64_t>(y, 0));
+}
+
+static int32_t gmCoefficient(const uint32_t coef[], unsigned int row, unsigned int column)
+{
+    // 17-bit signed, stored column by column
+    return static_cast<int32_t>(coef[column * 3 + row] << 15) >> 15;
+}
+
+void G2DHdr10Reference::convert(unsigned int layer, const uint16_t in[3], uint16_t out[3]) const
+{
+    const uint32_t *eotf = getEotf(layer), *gm = getGm(layer), *tm = getTm(layer);
+    int64_t linear[3], mapped[3];
+
+    for (int i = 0; i < 3; i++)
+        linear[i] = eotf ? interpolate(eotf, NUM_EOTF_COEFFICIENTS, true, static_cast<uint32_t>(in[i]))
+                         : (in[i] * EOTF_OUT_MAX * 2 + EOTF_IN_MAX) / (EOTF_IN_MAX * 2);
+
+    for (int i = 0; i < 3; i++) {
+        if (gm) {
+            int64_t sum = 0;
+            for (int j = 0; j < 3; j++)
+                sum += gmCoefficient(gm, i, j) * linear[j];
+            mapped[i] = (sum + 8192) >> 14;
+        } else {
+            mapped[i] = linear[i];
+        }
+        mapped[i] = std::min<int64_t>(std::max<int64_t>(mapped[i], 0), TM_IN_MAX);
+    }
+
+    for (int i = 0; i < 3; i++)
+        out[i] = static_cast<uint16_t>(tm ? interpolate(tm, NUM_TM_COEFFICIENTS, false, static_cast<uint32_t>(mapped[i]))
+                                          : (mapped[i] * TM_OUT_MAX * 2 + TM_IN_MAX) / (TM_IN_MAX * 2));
+}
+
+void G2DHdr10Reference::convert(unsigned int layer, const double in[3], double out[3]) const
+{
+    const uint32_t *eotf = getEotf(layer), *gm = getGm(layer), *tm = getTm(layer);
+    double linear[3], mapped[3];
+
+    for (int i = 0; i < 3; i++)
+        linear[i] = eotf ? interpolate(eotf, NUM_EOTF_COEFFICIENTS, true, in[i])
+                         : in[i] * EOTF_OUT_MAX / EOTF_IN_MAX;
+
+    for (int i = 0; i < 3; i++) {
+        mapped[i] = linear[i];
+        if (gm) {
+            mapped[i] = 0;
+            for (int j = 0; j < 3; j++)
+                mapped[i] += gmCoefficient(gm, i, j) * linear[j] / 16384.0;
+        }
+        mapped[i] = std::min(std::max(mapped[i], 0.0), static_cast<double>(TM_IN_MAX));
+    }
+
+    for (int i = 0; i < 3; i++)
+        out[i] = tm ? interpolate(tm, NUM_TM_COEFFICIENTS, false, mapped[i])
+                    : mapped[i] * TM_OUT_MAX / TM_IN_MAX;
+}
+
+void G2DHdr10Reference::measureCurve(const uint32_t coef[], unsigned int count, bool eotf,
+                                     const std::function<double(double)> &ideal, G2DHdr10ErrorStats &stats)
+{
+    // the half codes of EOTF catch the errors in the middle of short segments
+    const unsigned int last = eotf ? EOTF_IN_MAX * 2 : TM_IN_MAX;
+    const double range = eotf ? (EOTF_IN_MAX + 1) * 2 : TM_IN_MAX + 1;
+    const double step = eotf ? 0.5 : 1.0;
+    const double scale = eotf ? EOTF_OUT_MAX : TM_OUT_MAX;
+
+    for (unsigned int x = 0; x <= last; x++) {
+        double y = ideal(x / range);
+        if (y >= 0)
+            stats.add(interpolate(coef, count, eotf, x * step) - y * scale);
+    }
+}
+
+void G2DHdr10Reference::measureEotf(const uint32_t coef[], unsigned int count, unsigned int transfer,
+                                    unsigned int luminance, G2DHdr10ErrorStats &stats)
+{
+    measureCurve(coef, count, true,
+                 [=](double e) { return HdrLutGenerator::eotf(transfer, luminance, e); }, stats);
+}
+
+void G2DHdr10Reference::measureTm(const uint32_t coef[], unsigned int count, unsigned int transfer,
+                                  unsigned int luminance, G2DHdr10ErrorStats &stats)
+{
+    measureCurve(coef, count, false,
+                 [=](double l) { return HdrLutGenerator::tm(transfer, luminance, l); }, stats);
+}
+
+double G2DHdr10Reference::st2084Eotf(double e)
+{
+    const double m1 = 0.1593017578125, m2 = 78.84375;
+    const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+    double p = pow(std::max(e, 0.0), 1 / m2);
+
+    return 10000.0 * pow(std::max(p - c1, 0.0) / (c2 - c3 * p), 1 / m1);
+}
+
+double G2DHdr10Reference::hlgInverseOetf(double e)
+{
+    const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
+
+    return (e <= 0.5) ? e * e / 3 : (exp((e - c) / a) + b) / 12;
+}
+
+double G2DHdr10Reference::hlgOotf(double scene, double peak)
+{
+    // the system gamma of BT.2100 for the nominal peak, that is 1.2 at 1000 nit
+    double gamma = 1.2 + 0.42 * log10(peak / 1000);
+
+    // the luminance of a gray pixel is the scene light itself
+    return pow(scene, gamma);
+}
+
+double G2DHdr10Reference::srgbInverseEotf(double l)
+{
+    return (l <= 0.0031308) ? l * 12.92 : 1.055 * pow(l, 1 / 2.4) - 0.055;
+}
+
+static int standardToCscStd(int dataspace)
+{
+    switch (STANDARD_OF(dataspace)) {
+    case HAL_DATASPACE_STANDARD_UNSPECIFIED:
+    case HAL_DATASPACE_STANDARD_BT709:
+        return G2D_CSC_STD_709;
+    case HAL_DATASPACE_STANDARD_BT601_625:
+    case HAL_DATASPACE_STANDARD_BT601_625_UNADJUSTED:
+    case HAL_DATASPACE_STANDARD_BT601_525:
+    case HAL_DATASPACE_STANDARD_BT601_525_UNADJUSTED:
+        return G2D_CSC_STD_601;
+    case HAL_DATASPACE_STANDARD_BT2020:
+    case HAL_DATASPACE_STANDARD_BT2020_CONSTANT_LUMINANCE:
+        return G2D_CSC_STD_2020;
+    case HAL_DATASPACE_STANDARD_DCI_P3:
+        return G2D_CSC_STD_P3;
+    default:
+        return G2D_CSC_STD_UNDEFINED;
+    }
+}
+
+// The gray ramp and pseudo random colors of every layer
+static std::vector<uint16_t> testPixels()
+{
+    std::vector<uint16_t> pixels;
+    uint32_t seed = 1;
+
+    for (uint16_t code = 0; code <= EOTF_IN_MAX; code++)
+        pixels.insert(pixels.end(), {code, code, code});
+
+    for (int i = 0; i < 3 * 4096; i++) {
+        seed = seed * 1103515245 + 12345;
+        pixels.push_back(static_cast<uint16_t>((seed >> 16) % (EOTF_IN_MAX + 1)));
+    }
+
+    return pixels;
+}
+
+bool G2DHdr10Reference::measure(unsigned int layer, int source, unsigned int luminance, int target,
+                                G2DHdr10Errors &errors) const
+{
+    const uint32_t *eotf = getEotf(layer), *gm = getGm(layer), *tm = getTm(layer);
+    unsigned int sourceTransfer = TRANSFER_OF(source);
+    unsigned int targetTransfer = TRANSFER_OF(target);
+    double matrix[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+    // TM of HDR content maps the reference to the target like HDRMatrixWriter.
+    // EOTF has compressed brighter content into the reference.
+    unsigned int tmLuminance = 0;
+    if ((sourceTransfer == TRANSFER_OF(HAL_DATASPACE_TRANSFER_ST2084)) || (luminance > 100))
+        tmLuminance = ((luminance == 0) || (luminance > HDR_REFERENCE_LUMINANCE))
+                      ? HDR_REFERENCE_LUMINANCE : luminance;
+
+    if (eotf && (HdrLutGenerator::eotf(sourceTransfer, luminance, 0.0) < 0))
+        return false;
+    if (tm && (HdrLutGenerator::tm(targetTransfer, tmLuminance, 0.0) < 0))
+        return false;
+    if (gm && !HdrLutGenerator::gamutMatrix(standardToCscStd(source), standardToCscStd(target), matrix))
+        return false;
+
+    if (eotf)
+        measureEotf(eotf, NUM_EOTF_COEFFICIENTS, sourceTransfer, luminance, errors.eotf);
+    if (tm)
+        measureTm(tm, NUM_TM_COEFFICIENTS, targetTransfer, tmLuminance, errors.tm);
+
+    std::vector<uint16_t> pixels = testPixels();
+    for (size_t p = 0; p < pixels.size(); p += 3) {
+        const uint16_t *in = &pixels[p];
+        double inFloat[3] = {static_cast<double>(in[0]), static_cast<double>(in[1]), static_cast<double>(in[2])};
+        double linear[3], mapped[3], ideal[3], outFloat[3];
+        uint16_t out[3];
+
+        convert(layer, in, out);
+        convert(layer, inFloat, outFloat);
+
+        for (int i = 0; i < 3; i++)
+            linear[i] = eotf ? HdrLutGenerator::eotf(sourceTransfer, luminance, in[i] / 1024.0)
+                             : static_cast<double>(in[i]) / EOTF_IN_MAX;
+
+        for (int i = 0; i < 3; i++) {
+            mapped[i] = matrix[i][0] * linear[0] + matrix[i][1] * linear[1] + matrix[i][2] * linear[2];
+            if (gm) {
+                double quantized = 0;
+                for (int j = 0; j < 3; j++)
+                    quantized += gmCoefficient(gm, i, j) / 16384.0 * linear[j];
+                errors.gm.add((quantized - mapped[i]) * EOTF_OUT_MAX);
+            }
+            mapped[i] = std::min(std::max(mapped[i], 0.0), 1.0);
+        }
+
+        for (int i = 0; i < 3; i++) {
+            ideal[i] = tm ? HdrLutGenerator::tm(targetTransfer, tmLuminance, mapped[i]) * TM_OUT_MAX
+                          : mapped[i] * TM_OUT_MAX;
+            errors.quantization.add(out[i] - outFloat[i]);
+            errors.total.add(out[i] - ideal[i]);
+        }
+    }
+
+    return true;
+}
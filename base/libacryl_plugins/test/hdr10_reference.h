@@ -0,0 +1,112 @@
+/*
+ *  libacryl_plugins/test/hdr10_reference.h
+ *
+ *   Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#ifndef __LIBACRYL_PLUGIN_SLSI_HDR10_REFERENCE_H__
+#define __LIBACRYL_PLUGIN_SLSI_HDR10_REFERENCE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <hardware/exynos/g2d9810_hdr_plugin.h>
+
+#include "../libacryl_plugin_slsi_hdr10_lut.h"
+
+struct G2DHdr10ErrorStats {
+    double max = 0;
+    double sumSquare = 0;
+    size_t count = 0;
+
+    void add(double error);
+    double rms() const;
+};
+
+// The errors of a layer against the ideal conversion. The errors of the tables are the distance
+// of the linear interpolation of their control points from the ideal curves, EOTF and GM in
+// 14-bit and TM in 10-bit. The quantization is the distance of the fixed point pipeline from the
+// same pipeline in floating point in 10-bit. The total is the distance of the fixed point
+// pipeline from the ideal conversion in 10-bit.
+struct G2DHdr10Errors {
+    G2DHdr10ErrorStats eotf;
+    G2DHdr10ErrorStats gm;
+    G2DHdr10ErrorStats tm;
+    G2DHdr10ErrorStats quantization;
+    G2DHdr10ErrorStats total;
+};
+
+// G2DHdr10Reference models the HDR path of G2D on the host with the registers in a command list
+// of IG2DHdr10CommandWriter. A pixel of a layer goes through EOTF, gamut mapping and tone mapping
+// that LAYERx_HDR_MODE_REG enables with the coefficients in the slot that it selects.
+// - EOTF maps 10-bit code values to 14-bit linear light with the linear interpolation between
+//   the control points.
+// - GM multiplies the linear light by the 3x3 matrix in 1/16384 and clamps it to 14-bit.
+// - TM maps 14-bit linear light to 10-bit code values like EOTF.
+// The fixed point pipeline rounds every stage to the nearest integer. A disabled stage scales
+// the values to the bits of the next stage.
+class G2DHdr10Reference {
+public:
+    enum { MAX_SLOTS = 2 };
+
+    // Returns false if a register is not one of the HDR coefficients
+    bool load(const g2d_commandlist &commands);
+    unsigned int getLayerCount() const { return static_cast<unsigned int>(mLayerModes.size()); }
+
+    // 10-bit in and out
+    void convert(unsigned int layer, const uint16_t in[3], uint16_t out[3]) const;
+    void convert(unsigned int layer, const double in[3], double out[3]) const;
+
+    // Compares @layer with the ideal conversion from @source of @luminance nit to @target.
+    // Returns false if the curves of the dataspaces are not modeled.
+    bool measure(unsigned int layer, int source, unsigned int luminance, int target,
+                 G2DHdr10Errors &errors) const;
+
+    // The piecewise linear curve of the coefficients of any number of control points
+    static double interpolate(const uint32_t coef[], unsigned int count, bool eotf, double x);
+    static uint32_t interpolate(const uint32_t coef[], unsigned int count, bool eotf, uint32_t x);
+    // The error of the coefficients against the ideal curve over the whole input range
+    static void measureEotf(const uint32_t coef[], unsigned int count, unsigned int transfer,
+                            unsigned int luminance, G2DHdr10ErrorStats &stats);
+    static void measureTm(const uint32_t coef[], unsigned int count, unsigned int transfer,
+                          unsigned int luminance, G2DHdr10ErrorStats &stats);
+    // The error of the coefficients against @ideal from the input in [0, 1] to the output in
+    // [0, 1]. The inputs where @ideal is negative are skipped.
+    static void measureCurve(const uint32_t coef[], unsigned int count, bool eotf,
+                             const std::function<double(double)> &ideal, G2DHdr10ErrorStats &stats);
+
+    // The curves of the standards, written apart from HdrLutGenerator that fits the shipped tables
+    // - ST 2084 EOTF from a code value to the luminance in nit
+    // - BT.2100 HLG inverse OETF from a code value to the scene light
+    // - BT.2100 HLG OOTF from the scene light to the display light of a display of @peak nit
+    // - IEC 61966-2-1 sRGB inverse EOTF from the linear light to a code value
+    static double st2084Eotf(double e);
+    static double hlgInverseOetf(double e);
+    static double hlgOotf(double scene, double peak);
+    static double srgbInverseEotf(double l);
+
+private:
+    const uint32_t *getEotf(unsigned int layer) const;
+    const uint32_t *getGm(unsigned int layer) const;
+    const uint32_t *getTm(unsigned int layer) const;
+
+    uint32_t mEotf[MAX_SLOTS][NUM_EOTF_COEFFICIENTS];
+    uint32_t mGm[MAX_SLOTS][NUM_GM_COEFFICIENTS];
+    uint32_t mTm[MAX_SLOTS][NUM_TM_COEFFICIENTS];
+    std::vector<uint32_t> mLayerModes;
+};
+
+#endif // __LIBACRYL_PLUGIN_SLSI_HDR10_REFERENCE_H__
@@ -0,0 +1,277 @@
+/*
+ *  libacryl_plugins/test/hdr10_reference_test.cpp
+ *
+ *   Copyright 2018 Samsung Electronics Co., Ltd.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <system/graphics.h>
+
+#include "../libacryl_plugin_slsi_hdr10_tables.h"
+#include "hdr10_reference.h"
+
+#define TRANSFER_INDEX(transfer) (HAL_DATASPACE_TRANSFER_##transfer >> HAL_DATASPACE_TRANSFER_SHIFT)
+
+#define DATASPACE_GAMMA2_2 (HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_TRANSFER_GAMMA2_2 | HAL_DATASPACE_RANGE_FULL)
+
+struct ConversionCase {
+    const char *name;
+    int source;
+    unsigned int luminance;
+    int target;
+    // the bounds of the total error in 10-bit
+    double maxError;
+    double rmsError;
+};
+
+static void printStats(const char *name, const char *table, const G2DHdr10ErrorStats &stats)
+{
+    printf("%-24s %-12s max %8.2f rms %8.3f (%zu samples)\n", name, table, stats.max, stats.rms(), stats.count);
+}
+
+static void printErrors(const char *name, const G2DHdr10Errors &errors)
+{
+    printStats(name, "EOTF(14bit)", errors.eotf);
+    printStats(name, "GM(14bit)", errors.gm);
+    printStats(name, "TM(10bit)", errors.tm);
+    printStats(name, "fixed(10bit)", errors.quantization);
+    printStats(name, "total(10bit)", errors.total);
+}
+
+class G2DHdr10ReferenceTest : public ::testing::Test {
+protected:
+    void SetUp() override { mWriter.reset(IG2DHdr10CommandWriter::createInstance()); }
+
+    bool load(const ConversionCase &conversion)
+    {
+        mWriter->setTargetInfo(conversion.target, nullptr);
+        mWriter->setLayerStaticMetadata(0, conversion.source, 0, conversion.luminance);
+        mWriter->setLayerImageInfo(0, 0, false);
+
+        g2d_commandlist *commands = mWriter->getCommands();
+        if (!commands)
+            return false;
+
+        bool loaded = mReference.load(*commands);
+        mWriter->putCommands(commands);
+
+        return loaded;
+    }
+
+    std::unique_ptr<IG2DHdr10CommandWriter> mWriter;
+    G2DHdr10Reference mReference;
+};
+
+// The maximum errors are near black where a code of 14-bit linear light is several codes of
+// Gamma 2.2 and sRGB. The shipped tables of 1000 and 4000 nit are tuned away from the ideal curves
+// and the content brighter than 1000 nit shares the TM of 4000 nit.
+static const ConversionCase conversionCases[] = {
+    {"PQ1000 to sRGB",       HAL_DATASPACE_BT2020_PQ,  1000, HAL_DATASPACE_V0_SRGB,    40,  2},
+    {"PQ1000 to P3",         HAL_DATASPACE_BT2020_PQ,  1000, HAL_DATASPACE_DISPLAY_P3, 40,  2},
+    {"PQ1000 to Gamma2.2",   HAL_DATASPACE_BT2020_PQ,  1000, DATASPACE_GAMMA2_2,       64,  2.5},
+    {"PQ4000 to Gamma2.2",   HAL_DATASPACE_BT2020_PQ,  4000, DATASPACE_GAMMA2_2,       200, 24},
+    {"PQ600 to Gamma2.2",    HAL_DATASPACE_BT2020_PQ,   600, DATASPACE_GAMMA2_2,       64,  2.5},
+    {"PQ1500 to Gamma2.2",   HAL_DATASPACE_BT2020_PQ,  1500, DATASPACE_GAMMA2_2,       72,  18},
+    {"HLG to sRGB",          HAL_DATASPACE_BT2020_HLG,    0, HAL_DATASPACE_V0_SRGB,    4,   1},
+};
+
+TEST_F(G2DHdr10ReferenceTest, WrittenTablesMatchIdealConversion)
+{
+    for (const ConversionCase &conversion : conversionCases) {
+        SCOPED_TRACE(conversion.name);
+
+        ASSERT_TRUE(load(conversion));
+        ASSERT_EQ(mReference.getLayerCount(), 1U);
+
+        G2DHdr10Errors errors;
+        ASSERT_TRUE(mReference.measure(0, conversion.source, conversion.luminance, conversion.target, errors));
+        printErrors(conversion.name, errors);
+
+        EXPECT_GT(errors.total.count, 0U);
+        EXPECT_LE(errors.total.max, conversion.maxError);
+        EXPECT_LE(errors.total.rms(), conversion.rmsError);
+        // rounding of the fixed point pipeline on top of the interpolation
+        EXPECT_LE(errors.quantization.rms(), 1.0);
+    }
+}
+
+TEST_F(G2DHdr10ReferenceTest, DisabledStagesPassThrough)
+{
+    ASSERT_TRUE(load({"sRGB to sRGB", HAL_DATASPACE_V0_SRGB, 0, HAL_DATASPACE_V0_SRGB, 0, 0}));
+    ASSERT_EQ(mReference.getLayerCount(), 1U);
+
+    for (uint16_t code = 0; code <= 1023; code++) {
+        uint16_t in[3] = {code, code, code}, out[3];
+
+        mReference.convert(0, in, out);
+        for (int i = 0; i < 3; i++)
+            EXPECT_NEAR(out[i], code, 1);
+    }
+}
+
+TEST(G2DHdr10ReferenceTables, InterpolationMatchesControlPoints)
+{
+    for (unsigned int i = 0; i < NUM_EOTF_COEFFICIENTS - 1; i++) {
+        uint32_t x = EOTF_ST2084_1000nit[i];
+        EXPECT_EQ(G2DHdr10Reference::interpolate(EOTF_ST2084_1000nit, NUM_EOTF_COEFFICIENTS, true, x & 0x3FF),
+                  (x >> 16) & 0x3FFF);
+    }
+    EXPECT_EQ(G2DHdr10Reference::interpolate(EOTF_ST2084_1000nit, NUM_EOTF_COEFFICIENTS, true, 1024U), 16383U);
+}
+
+// The tables are measured against the curves of the standards rather than the curves of
+// HdrLutGenerator that are fitted to the shipped tables. The shipped tables are tuned away from
+// the standards, mostly near black and around the knee of ST 2084.
+TEST(G2DHdr10ReferenceTables, TablesMatchStandardCurves)
+{
+    const unsigned int pq = TRANSFER_INDEX(ST2084);
+    auto pq1000 = [](double e) { return std::min(G2DHdr10Reference::st2084Eotf(e) / 1000, 1.0); };
+    // content brighter than the reference is compressed above the knee
+    auto pqKnee = [](double e) {
+        double luminance = G2DHdr10Reference::st2084Eotf(e);
+        return (luminance <= 300) ? luminance / 1000 : -1.0;
+    };
+    // G2D leaves the OOTF of HLG to the display, so EOTF gives the scene light
+    auto hlg = [](double e) { return G2DHdr10Reference::hlgInverseOetf(e); };
+
+    struct {
+        const char *name;
+        const uint32_t *shipped;
+        unsigned int transfer;
+        unsigned int luminance;
+        std::function<double(double)> ideal;
+        // the bounds of the maximum error in 14-bit
+        double generatedError;
+        double shippedError;
+    } eotfCases[] = {
+        {"EOTF PQ1000",      EOTF_ST2084_1000nit, pq,                  1000, pq1000, 10, 128},
+        {"EOTF PQ4000 knee", EOTF_ST2084_4000nit, pq,                  4000, pqKnee, 2,  115},
+        {"EOTF HLG",         EOTF_HLG,            TRANSFER_INDEX(HLG), 0,    hlg,    3,  4},
+    };
+
+    for (auto &eotf : eotfCases) {
+        uint32_t generated[NUM_EOTF_COEFFICIENTS];
+        G2DHdr10ErrorStats shippedStats, generatedStats;
+
+        ASSERT_TRUE(HdrLutGenerator::generateEotf(eotf.transfer, eotf.luminance, generated));
+        G2DHdr10Reference::measureCurve(eotf.shipped, NUM_EOTF_COEFFICIENTS, true, eotf.ideal, shippedStats);
+        G2DHdr10Reference::measureCurve(generated, NUM_EOTF_COEFFICIENTS, true, eotf.ideal, generatedStats);
+        printStats(eotf.name, "shipped", shippedStats);
+        printStats(eotf.name, "generated", generatedStats);
+
+        EXPECT_LE(generatedStats.max, eotf.generatedError) << eotf.name;
+        EXPECT_LE(shippedStats.max, eotf.shippedError) << eotf.name;
+    }
+
+    // The compression of 4000 nit content never makes it brighter than ST 2084 beyond the
+    // rounding, and the peak of the content reaches the end of the range
+    uint32_t generated[NUM_EOTF_COEFFICIENTS];
+    ASSERT_TRUE(HdrLutGenerator::generateEotf(pq, 4000, generated));
+
+    struct {
+        const char *name;
+        const uint32_t *coef;
+        double brighterError;
+    } compressionCases[] = {
+        {"generated", generated,           2},
+        {"shipped",   EOTF_ST2084_4000nit, 48},
+    };
+
+    for (auto &compression : compressionCases) {
+        double brighter = 0, peak = 0;
+
+        for (unsigned int x = 0; x <= 1023; x++) {
+            double y = G2DHdr10Reference::interpolate(compression.coef, NUM_EOTF_COEFFICIENTS, true, x / 1.0);
+            brighter = std::max(brighter, y - pq1000(x / 1024.0) * 16383);
+            if (G2DHdr10Reference::st2084Eotf(x / 1024.0) <= 4000)
+                peak = y;
+        }
+        printf("%-24s %-12s brighter %6.2f peak %8.2f\n", "EOTF PQ4000", compression.name, brighter, peak);
+
+        EXPECT_LE(brighter, compression.brighterError) << compression.name;
+        EXPECT_GE(peak, 16383 * 0.999) << compression.name;
+    }
+
+    struct {
+        const char *name;
+        const uint32_t *shipped;
+        unsigned int transfer;
+        std::function<double(double)> ideal;
+        // the bounds of the maximum error in 10-bit
+        double generatedError;
+        double shippedError;
+    } tmCases[] = {
+        {"TM sRGB", TM_sRGB,    TRANSFER_INDEX(SRGB),     G2DHdr10Reference::srgbInverseEotf,        1, 2},
+        {"TM G2.2", TM_GAMMA22, TRANSFER_INDEX(GAMMA2_2), [](double l) { return pow(l, 1 / 2.2); }, 1, 10},
+        {"TM G2.6", TM_GAMMA26, TRANSFER_INDEX(GAMMA2_6), [](double l) { return pow(l, 1 / 2.6); }, 1.5, 25},
+    };
+
+    for (auto &tm : tmCases) {
+        uint32_t generated[NUM_TM_COEFFICIENTS];
+        G2DHdr10ErrorStats shippedStats, generatedStats;
+
+        ASSERT_TRUE(HdrLutGenerator::generateTm(tm.transfer, 0, generated));
+        G2DHdr10Reference::measureCurve(tm.shipped, NUM_TM_COEFFICIENTS, false, tm.ideal, shippedStats);
+        G2DHdr10Reference::measureCurve(generated, NUM_TM_COEFFICIENTS, false, tm.ideal, generatedStats);
+        printStats(tm.name, "shipped", shippedStats);
+        printStats(tm.name, "generated", generatedStats);
+
+        EXPECT_LE(generatedStats.max, tm.generatedError) << tm.name;
+        EXPECT_LE(shippedStats.max, tm.shippedError) << tm.name;
+    }
+}
+
+TEST(G2DHdr10ReferenceTables, HlgOotf)
+{
+    // the system gamma is 1.2 at 1000 nit and the display light of the peak is the peak
+    EXPECT_DOUBLE_EQ(G2DHdr10Reference::hlgOotf(1.0, 1000), 1.0);
+    EXPECT_NEAR(G2DHdr10Reference::hlgOotf(0.5, 1000), pow(0.5, 1.2), 1e-12);
+    EXPECT_NEAR(G2DHdr10Reference::hlgOotf(0.5, 2000), pow(0.5, 1.2 + 0.42 * log10(2.0)), 1e-12);
+    // the reference white of BT.2408 at 75% of HLG is 203 nit on a 1000 nit display
+    EXPECT_NEAR(G2DHdr10Reference::hlgOotf(G2DHdr10Reference::hlgInverseOetf(0.75), 1000) * 1000, 203, 1);
+}
+
+TEST(G2DHdr10ReferenceTables, LargerTablesAreMoreAccurate)
+{
+    static const unsigned int sizes[] = {17, 33, 65, 129};
+    double eotfError = 1e9, tmError = 1e9;
+
+    for (unsigned int count : sizes) {
+        std::vector<uint32_t> eotf(count), tm(count);
+        G2DHdr10ErrorStats eotfStats, tmStats;
+
+        ASSERT_TRUE(HdrLutGenerator::generateEotf(TRANSFER_INDEX(ST2084), 4000, eotf.data(), count));
+        ASSERT_TRUE(HdrLutGenerator::generateTm(TRANSFER_INDEX(GAMMA2_2), 1000, tm.data(), count));
+        G2DHdr10Reference::measureEotf(eotf.data(), count, TRANSFER_INDEX(ST2084), 4000, eotfStats);
+        G2DHdr10Reference::measureTm(tm.data(), count, TRANSFER_INDEX(GAMMA2_2), 1000, tmStats);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u coefficients", count);
+        printStats(name, "EOTF PQ4000", eotfStats);
+        printStats(name, "TM G2.2", tmStats);
+
+        // the error of EOTF stops at the rounding of 14-bit
+        EXPECT_LT(eotfStats.rms(), eotfError);
+        EXPECT_LT(tmStats.rms(), tmError);
+        eotfError = eotfStats.rms();
+        tmError = tmStats.rms();
+    }
+}
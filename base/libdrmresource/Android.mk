@@ -49,3 +49,37 @@ LOCAL_MODULE_TAGS := optional
 include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
 include $(BUILD_SHARED_LIBRARY)
 
+
+# The host build with the fake DRM device of fakedrm.cpp instead of libdrm
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := libcutils liblog libutils libhardware
+
+LOCAL_SRC_FILES := \
+	worker.cpp \
+	resourcemanager.cpp \
+	drmdevice.cpp \
+	drmconnector.cpp \
+	drmcrtc.cpp \
+	drmencoder.cpp \
+	drmmode.cpp \
+	drmplane.cpp \
+	drmproperty.cpp \
+	drmeventlistener.cpp \
+	vsyncworker.cpp \
+	fakedrm.cpp
+
+LOCAL_C_INCLUDES := \
+	external/libdrm \
+	external/libdrm/include/drm
+
+LOCAL_CFLAGS := -DHLOG_CODE=0 -DUSE_FAKE_DRM
+LOCAL_CFLAGS += -Wno-unused-parameter
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH) $(LOCAL_C_INCLUDES)
+
+LOCAL_MODULE := libdrmresource_fake
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
@@ -22,6 +22,9 @@
 #include "drmencoder.h"
 #include "drmeventlistener.h"
 #include "drmplane.h"
+#ifdef USE_FAKE_DRM
+#include "fakedrm.h"
+#endif
 
 #include <errno.h>
 #include <fcntl.h>
@@ -44,11 +47,19 @@ DrmDevice::DrmDevice() : event_listener_(this) {
 
 DrmDevice::~DrmDevice() {
   event_listener_.Exit();
+#ifdef USE_FAKE_DRM
+  FakeDrm::Release(fd());
+#endif
 }
 
 std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
   /* TODO: Use drmOpenControl here instead */
-  fd_.Set(open(path, O_RDWR));
+#ifdef USE_FAKE_DRM
+  if (FakeDrm::IsFakePath(path))
+    fd_.Set(FakeDrm::Open());
+  else
+#endif
+    fd_.Set(open(path, O_RDWR));
   if (fd() < 0) {
     ALOGE("Failed to open dri %s: %s", path, strerror(errno));
     return std::make_tuple(-ENODEV, 0);
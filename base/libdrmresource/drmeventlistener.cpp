@@ -18,11 +18,16 @@
 
 #include "drmeventlistener.h"
 #include "drmdevice.h"
+#include "vsyncworker.h"
 
 #include <assert.h>
 #include <errno.h>
 #include <linux/netlink.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <time.h>
+
+#include <algorithm>
 
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
@@ -55,14 +60,38 @@ int DrmEventListener::Init() {
     return -errno;
   }
 
+  wake_fd_.Set(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  if (wake_fd_.get() < 0) {
+    ALOGE("Failed to create eventfd: %s", strerror(errno));
+    return -errno;
+  }
+
   FD_ZERO(&fds_);
   FD_SET(drm_->fd(), &fds_);
   FD_SET(uevent_fd_.get(), &fds_);
-  max_fd_ = std::max(drm_->fd(), uevent_fd_.get());
+  FD_SET(wake_fd_.get(), &fds_);
+  max_fd_ = std::max({drm_->fd(), uevent_fd_.get(), wake_fd_.get()});
 
   return InitWorker();
 }
 
+void DrmEventListener::Exit() {
+  Lock();
+  exiting_ = true;
+  /* The events still pending are never handled */
+  pending_vblanks_.clear();
+  Unlock();
+
+  Wake();
+  Worker::Exit();
+}
+
+void DrmEventListener::Wake() {
+  uint64_t count = 1;
+  if (write(wake_fd_.get(), &count, sizeof(count)) < 0)
+    ALOGE("Failed to wake up event listener: %s", strerror(errno));
+}
+
 void DrmEventListener::RegisterHotplugHandler(DrmEventHandler *handler) {
   assert(!hotplug_handler_);
   hotplug_handler_.reset(handler);
@@ -83,6 +112,29 @@ void DrmEventListener::UnRegisterPanelResetHandler(DrmEventHandler *handler) {
         panelreset_handler_ = NULL;
 }
 
+void DrmEventListener::RegisterVSyncWorker(VSyncWorker *worker) {
+  Lock();
+  vsync_workers_.insert(worker);
+  Unlock();
+  Wake();
+}
+
+void DrmEventListener::UnRegisterVSyncWorker(VSyncWorker *worker) {
+  std::lock_guard<std::mutex> dispatch_lock(dispatch_mutex_);
+  Lock();
+  vsync_workers_.erase(worker);
+  for (auto it = pending_vblanks_.begin(); it != pending_vblanks_.end();) {
+    if (it->second == worker)
+      it = pending_vblanks_.erase(it);
+    else
+      it++;
+  }
+  vsyncs_.erase(std::remove_if(vsyncs_.begin(), vsyncs_.end(),
+                               [worker](auto &vsync) { return vsync.first == worker; }),
+                vsyncs_.end());
+  Unlock();
+}
+
 void DrmEventListener::FlipHandler(int /* fd */, unsigned int /* sequence */,
                                    unsigned int tv_sec, unsigned int tv_usec,
                                    void *user_data) {
@@ -95,6 +147,83 @@ void DrmEventListener::FlipHandler(int /* fd */, unsigned int /* sequence */,
 }
 
 static const uint64_t kOneSecondNs = 1ULL * 1000 * 1000 * 1000;
+
+static int64_t GetMonotonicTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * (int64_t)kOneSecondNs + ts.tv_nsec;
+}
+
+/* The listener whose event loop is handling the drm events on this thread */
+static thread_local DrmEventListener *handling_listener = NULL;
+
+void DrmEventListener::VBlankHandler(int /* fd */, unsigned int /* sequence */,
+                                     unsigned int tv_sec, unsigned int tv_usec,
+                                     void *user_data) {
+  if (!handling_listener)
+    return;
+
+  handling_listener->HandleVBlank((unsigned long)user_data,
+                                  (int64_t)tv_sec * kOneSecondNs + (int64_t)tv_usec * 1000);
+}
+
+void DrmEventListener::HandleVBlank(unsigned long id, int64_t timestamp) {
+  std::vector<int64_t> timestamps;
+
+  Lock();
+  /* The worker could be unregistered after requesting the event */
+  auto it = pending_vblanks_.find(id);
+  if (it != pending_vblanks_.end()) {
+    VSyncWorker *worker = it->second;
+    pending_vblanks_.erase(it);
+    worker->HandleVBlank(timestamp, timestamps);
+    for (auto vsync : timestamps)
+      vsyncs_.emplace_back(worker, vsync);
+  }
+  Unlock();
+}
+
+/* Must be called with the lock held */
+void DrmEventListener::RequestVBlanks(int64_t now, int64_t *timeout_ns) {
+  for (auto worker : vsync_workers_) {
+    if (worker->NeedsVBlankEvent()) {
+      uint32_t high_crtc = (worker->pipe_ << DRM_VBLANK_HIGH_CRTC_SHIFT);
+      drmVBlank vblank;
+      memset(&vblank, 0, sizeof(vblank));
+      vblank.request.type = (drmVBlankSeqType)(
+          DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT | (high_crtc & DRM_VBLANK_HIGH_CRTC_MASK));
+      vblank.request.sequence = 1;
+
+      unsigned long id = next_vblank_id_++;
+      vblank.request.signal = id;
+      if (drmWaitVBlank(drm_->fd(), &vblank)) {
+        worker->HandleVBlankEventFailure(now);
+      } else {
+        pending_vblanks_[id] = worker;
+        worker->SetVBlankEventPending(true);
+      }
+    }
+
+    int64_t next = worker->NextSoftwareVSync();
+    if (next >= 0) {
+      int64_t timeout = std::max(next - now, (int64_t)0);
+      if ((*timeout_ns < 0) || (timeout < *timeout_ns))
+        *timeout_ns = timeout;
+    }
+  }
+}
+
+void DrmEventListener::DispatchVSyncs() {
+  std::lock_guard<std::mutex> dispatch_lock(dispatch_mutex_);
+  std::vector<std::pair<VSyncWorker *, int64_t>> vsyncs;
+
+  Lock();
+  vsyncs.swap(vsyncs_);
+  Unlock();
+
+  for (auto &vsync : vsyncs)
+    vsync.first->Deliver(vsync.second);
+}
 void DrmEventListener::UEventHandler() {
   char buffer[1024] = {0};
   int ret;
@@ -145,20 +274,65 @@ void DrmEventListener::UEventHandler() {
 }
 
 void DrmEventListener::Routine() {
+  int64_t timeout_ns = -1;
+
+  Lock();
+  if (exiting_) {
+    WaitForSignalOrExitLocked();
+    Unlock();
+    return;
+  }
+  RequestVBlanks(GetMonotonicTime(), &timeout_ns);
+  Unlock();
+
+  /* Sleep until an event or the earliest software vsync */
+  struct timeval timeout;
+  struct timeval *timeout_ptr = NULL;
+  if (timeout_ns >= 0) {
+    timeout_ns = (timeout_ns + 999) / 1000;
+    timeout.tv_sec = timeout_ns / 1000000;
+    timeout.tv_usec = timeout_ns % 1000000;
+    timeout_ptr = &timeout;
+  }
+
+  fd_set fds;
   int ret;
   do {
-    ret = select(max_fd_ + 1, &fds_, NULL, NULL, NULL);
+    fds = fds_;
+    ret = select(max_fd_ + 1, &fds, NULL, NULL, timeout_ptr);
   } while (ret == -1 && errno == EINTR);
 
-  if (FD_ISSET(drm_->fd(), &fds_)) {
-    drmEventContext event_context =
-        {.version = 2,
-         .vblank_handler = NULL,
-         .page_flip_handler = DrmEventListener::FlipHandler};
-    drmHandleEvent(drm_->fd(), &event_context);
+  if (ret > 0) {
+    if (FD_ISSET(drm_->fd(), &fds)) {
+      drmEventContext event_context =
+          {.version = 2,
+           .vblank_handler = DrmEventListener::VBlankHandler,
+           .page_flip_handler = DrmEventListener::FlipHandler};
+      handling_listener = this;
+      drmHandleEvent(drm_->fd(), &event_context);
+      handling_listener = NULL;
+    }
+
+    if (FD_ISSET(uevent_fd_.get(), &fds))
+      UEventHandler();
+
+    if (FD_ISSET(wake_fd_.get(), &fds)) {
+      uint64_t count;
+      if (read(wake_fd_.get(), &count, sizeof(count)) < 0)
+        ALOGE("Failed to read eventfd: %s", strerror(errno));
+    }
+  }
+
+  Lock();
+  int64_t now = GetMonotonicTime();
+  for (auto worker : vsync_workers_) {
+    std::vector<int64_t> timestamps;
+    worker->HandleSoftwareVSync(now, timestamps);
+    for (auto vsync : timestamps)
+      vsyncs_.emplace_back(worker, vsync);
   }
+  Unlock();
 
-  if (FD_ISSET(uevent_fd_.get(), &fds_))
-    UEventHandler();
+  DispatchVSyncs();
 }
 }  // namespace android
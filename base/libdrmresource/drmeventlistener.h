@@ -20,9 +20,16 @@
 #include "autofd.h"
 #include "worker.h"
 
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
 namespace android {
 
 class DrmDevice;
+class VSyncWorker;
 
 class DrmEventHandler {
  public:
@@ -42,24 +49,52 @@ class DrmEventListener : public Worker {
   }
 
   int Init();
+  /* Hides Worker::Exit() to wake up the event loop */
+  void Exit();
 
   void RegisterHotplugHandler(DrmEventHandler *handler);
   void UnRegisterHotplugHandler(DrmEventHandler *handler);
   void RegisterPanelResetHandler(DrmEventHandler *handler);
   void UnRegisterPanelResetHandler(DrmEventHandler *handler);
+  void RegisterVSyncWorker(VSyncWorker *worker);
+  void UnRegisterVSyncWorker(VSyncWorker *worker);
+  /* Makes the event loop re-evaluate vblank requests of vsync workers */
+  void Wake();
 
   static void FlipHandler(int fd, unsigned int sequence, unsigned int tv_sec,
                           unsigned int tv_usec, void *user_data);
+  static void VBlankHandler(int fd, unsigned int sequence, unsigned int tv_sec,
+                            unsigned int tv_usec, void *user_data);
 
  protected:
   virtual void Routine();
 
  private:
   void UEventHandler();
+  void RequestVBlanks(int64_t now, int64_t *timeout_ns);
+  void HandleVBlank(unsigned long id, int64_t timestamp);
+  void DispatchVSyncs();
 
   fd_set fds_;
   UniqueFd uevent_fd_;
+  UniqueFd wake_fd_;
   int max_fd_ = -1;
+  bool exiting_ = false;
+
+  /*
+   * A vsync worker is removed from the list with dispatch_mutex_ held, so
+   * it is not destroyed while its vsyncs are delivered.
+   */
+  std::set<VSyncWorker *> vsync_workers_;
+  std::vector<std::pair<VSyncWorker *, int64_t>> vsyncs_;
+  /*
+   * Requested vblank events by the id in their user data. A worker can be
+   * destroyed and another one created at its address while its event is
+   * pending, so the events carry ids instead of worker pointers.
+   */
+  std::map<unsigned long, VSyncWorker *> pending_vblanks_;
+  unsigned long next_vblank_id_ = 1;
+  std::mutex dispatch_mutex_;
 
   DrmDevice *drm_;
   std::unique_ptr<DrmEventHandler> hotplug_handler_;
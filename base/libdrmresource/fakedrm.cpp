@@ -0,0 +1,1285 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "hwc-fake-drm"
+
+#include "fakedrm.h"
+#include "drm_fourcc.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <hardware/hardware.h>
+#include <log/log.h>
+
+/* libdrm keeps the request opaque, the fake has its own one */
+struct FakeDrmAtomicItem {
+  uint32_t object_id;
+  uint32_t property_id;
+  uint64_t value;
+};
+
+struct _drmModeAtomicReq {
+  std::vector<FakeDrmAtomicItem> items;
+};
+
+namespace android {
+
+static std::mutex registry_mutex;
+static std::map<int, FakeDrm *> registry;
+static FakeDrmConfig default_config;
+
+static int64_t Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+template <typename T>
+static T *AllocArray(const std::vector<T> &values) {
+  if (values.empty())
+    return NULL;
+  T *array = (T *)calloc(values.size(), sizeof(T));
+  if (array)
+    memcpy(array, values.data(), values.size() * sizeof(T));
+  return array;
+}
+
+bool FakeDrm::IsFakePath(const char *path) {
+  return path && !strncmp(path, "fake", strlen("fake"));
+}
+
+void FakeDrm::SetConfig(const FakeDrmConfig &config) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  default_config = config;
+}
+
+int FakeDrm::Open() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0) {
+    ALOGE("Failed to create the fake drm fd: %s", strerror(errno));
+    return fd;
+  }
+
+  FakeDrm *drm = new FakeDrm(default_config, fd);
+  int ret = drm->InitWorker();
+  if (ret) {
+    ALOGE("Failed to initialize the fake drm worker %d", ret);
+    delete drm;
+    close(fd);
+    return -1;
+  }
+  registry[fd] = drm;
+  return fd;
+}
+
+void FakeDrm::Release(int fd) {
+  FakeDrm *drm = NULL;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = registry.find(fd);
+    if (it == registry.end())
+      return;
+    drm = it->second;
+    registry.erase(it);
+  }
+  delete drm;
+}
+
+FakeDrm *FakeDrm::Get(int fd) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto it = registry.find(fd);
+  return it == registry.end() ? NULL : it->second;
+}
+
+FakeDrm::FakeDrm(const FakeDrmConfig &config, int event_fd)
+    : Worker("fake-drm", HAL_PRIORITY_URGENT_DISPLAY),
+      config_(config),
+      event_fd_(event_fd),
+      vblank_base_(Now()) {
+  if (config_.refresh_rate == 0)
+    config_.refresh_rate = 60;
+  CreateObjects();
+}
+
+FakeDrm::~FakeDrm() {
+  Exit();
+  /* The pending flips never complete, their fences are left unsignaled */
+  for (auto &it : flips_) {
+    for (int fence : it.second.in_fences)
+      close(fence);
+    if (it.second.out_fence >= 0)
+      close(it.second.out_fence);
+  }
+}
+
+void FakeDrm::SetFailures(const FakeDrmConfig &config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_.commit_latency_ns = config.commit_latency_ns;
+  config_.fail_commit_interval = config.fail_commit_interval;
+  config_.fail_test_commit_interval = config.fail_test_commit_interval;
+  config_.fail_import_interval = config.fail_import_interval;
+}
+
+FakeDrmStats FakeDrm::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string FakeDrm::Dump() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream out;
+  out << "FakeDrm: " << crtcs_.size() << " crtcs, " << planes_.size()
+      << " planes, " << config_.width << "x" << config_.height << "@"
+      << config_.refresh_rate << ", latency " << config_.commit_latency_ns
+      << " ns\n";
+  out << "\tcommits " << stats_.commits << ", test commits "
+      << stats_.test_commits << ", failed " << stats_.failed_commits
+      << ", busy " << stats_.busy_commits << "\n";
+  out << "\tflips " << stats_.flips << ", late flips " << stats_.late_flips
+      << ", vblank events " << stats_.vblank_events << "\n";
+  out << "\timports " << stats_.imports << ", failed imports "
+      << stats_.failed_imports << ", framebuffers " << fbs_.size() << "\n";
+  return out.str();
+}
+
+uint32_t FakeDrm::AddProperty(
+    const char *name, uint32_t flags, std::vector<uint64_t> values,
+    std::vector<std::pair<uint64_t, std::string>> enums) {
+  uint32_t id = next_id_++;
+  // Like the kernel, enum properties report their enum values as values.
+  for (auto &it : enums)
+    values.push_back(it.first);
+  properties_[id] = Property{id, name, flags, std::move(values),
+                             std::move(enums)};
+  return id;
+}
+
+uint32_t FakeDrm::AddObject(uint32_t type) {
+  uint32_t id = next_id_++;
+  objects_[id] = Object{type, {}};
+  return id;
+}
+
+uint32_t FakeDrm::AddBlob(const void *data, size_t length) {
+  uint32_t id = next_id_++;
+  const uint8_t *bytes = (const uint8_t *)data;
+  blobs_[id] = std::vector<uint8_t>(bytes, bytes + length);
+  return id;
+}
+
+void FakeDrm::AttachProperty(uint32_t object_id, uint32_t property_id,
+                             uint64_t value) {
+  objects_[object_id].properties.emplace_back(property_id, value);
+}
+
+uint32_t FakeDrm::FindProperty(uint32_t object_id, const char *name) const {
+  auto object = objects_.find(object_id);
+  if (object == objects_.end())
+    return 0;
+  for (auto &it : object->second.properties) {
+    if (properties_.at(it.first).name == name)
+      return it.first;
+  }
+  return 0;
+}
+
+uint64_t *FakeDrm::PropertyValue(uint32_t object_id, uint32_t property_id) {
+  auto object = objects_.find(object_id);
+  if (object == objects_.end())
+    return NULL;
+  for (auto &it : object->second.properties) {
+    if (it.first == property_id)
+      return &it.second;
+  }
+  return NULL;
+}
+
+void FakeDrm::CreateObjects() {
+  formats_ = {DRM_FORMAT_ARGB8888, DRM_FORMAT_ABGR8888, DRM_FORMAT_XRGB8888,
+              DRM_FORMAT_XBGR8888, DRM_FORMAT_RGB565,   DRM_FORMAT_ABGR2101010,
+              DRM_FORMAT_NV12,     DRM_FORMAT_NV21};
+
+  memset(&mode_, 0, sizeof(mode_));
+  mode_.hdisplay = config_.width;
+  mode_.hsync_start = config_.width + 16;
+  mode_.hsync_end = config_.width + 32;
+  mode_.htotal = config_.width + 64;
+  mode_.vdisplay = config_.height;
+  mode_.vsync_start = config_.height + 8;
+  mode_.vsync_end = config_.height + 16;
+  mode_.vtotal = config_.height + 32;
+  mode_.vrefresh = config_.refresh_rate;
+  mode_.clock = (uint32_t)((uint64_t)mode_.htotal * mode_.vtotal *
+                           config_.refresh_rate / 1000);
+  mode_.type = DRM_MODE_TYPE_PREFERRED | DRM_MODE_TYPE_DRIVER;
+  snprintf(mode_.name, DRM_DISPLAY_MODE_LEN, "%ux%u", config_.width,
+           config_.height);
+
+  /* The properties are shared by the objects of a type like in the kernel */
+  uint32_t active = AddProperty("ACTIVE", DRM_MODE_PROP_RANGE, {0, 1});
+  uint32_t mode_id = AddProperty("MODE_ID", DRM_MODE_PROP_BLOB, {});
+  uint32_t out_fence_ptr = AddProperty("OUT_FENCE_PTR", DRM_MODE_PROP_RANGE,
+                                       {0, UINT64_MAX});
+
+  uint32_t dpms = AddProperty("DPMS", DRM_MODE_PROP_ENUM, {},
+                              {{DRM_MODE_DPMS_ON, "On"},
+                               {DRM_MODE_DPMS_STANDBY, "Standby"},
+                               {DRM_MODE_DPMS_SUSPEND, "Suspend"},
+                               {DRM_MODE_DPMS_OFF, "Off"}});
+  uint32_t conn_crtc_id = AddProperty("CRTC_ID", DRM_MODE_PROP_OBJECT,
+                                      {DRM_MODE_OBJECT_CRTC});
+  uint32_t edid = AddProperty("EDID",
+                              DRM_MODE_PROP_BLOB | DRM_MODE_PROP_IMMUTABLE, {});
+
+  uint32_t type = AddProperty("type",
+                              DRM_MODE_PROP_ENUM | DRM_MODE_PROP_IMMUTABLE, {},
+                              {{DRM_PLANE_TYPE_OVERLAY, "Overlay"},
+                               {DRM_PLANE_TYPE_PRIMARY, "Primary"},
+                               {DRM_PLANE_TYPE_CURSOR, "Cursor"}});
+  uint32_t plane_crtc_id = AddProperty("CRTC_ID", DRM_MODE_PROP_OBJECT,
+                                       {DRM_MODE_OBJECT_CRTC});
+  uint32_t fb_id = AddProperty("FB_ID", DRM_MODE_PROP_OBJECT,
+                               {DRM_MODE_OBJECT_FB});
+  std::vector<uint64_t> signed_range = {(uint64_t)(int64_t)INT_MIN, INT_MAX};
+  uint32_t crtc_x = AddProperty("CRTC_X", DRM_MODE_PROP_SIGNED_RANGE,
+                                signed_range);
+  uint32_t crtc_y = AddProperty("CRTC_Y", DRM_MODE_PROP_SIGNED_RANGE,
+                                signed_range);
+  uint32_t crtc_w = AddProperty("CRTC_W", DRM_MODE_PROP_RANGE, {0, INT_MAX});
+  uint32_t crtc_h = AddProperty("CRTC_H", DRM_MODE_PROP_RANGE, {0, INT_MAX});
+  uint32_t src_x = AddProperty("SRC_X", DRM_MODE_PROP_RANGE, {0, UINT32_MAX});
+  uint32_t src_y = AddProperty("SRC_Y", DRM_MODE_PROP_RANGE, {0, UINT32_MAX});
+  uint32_t src_w = AddProperty("SRC_W", DRM_MODE_PROP_RANGE, {0, UINT32_MAX});
+  uint32_t src_h = AddProperty("SRC_H", DRM_MODE_PROP_RANGE, {0, UINT32_MAX});
+  uint32_t in_formats = AddProperty(
+      "IN_FORMATS", DRM_MODE_PROP_BLOB | DRM_MODE_PROP_IMMUTABLE, {});
+  uint32_t zpos = AddProperty("zpos", DRM_MODE_PROP_RANGE,
+                              {0, config_.planes_per_crtc - 1});
+  uint32_t rotation = AddProperty("rotation", DRM_MODE_PROP_BITMASK, {},
+                                  {{0, "rotate-0"},
+                                   {1, "rotate-90"},
+                                   {2, "rotate-180"},
+                                   {3, "rotate-270"},
+                                   {4, "reflect-x"},
+                                   {5, "reflect-y"}});
+  uint32_t alpha = AddProperty("alpha", DRM_MODE_PROP_RANGE, {0, 0xffff});
+  uint32_t blend = AddProperty("pixel blend mode", DRM_MODE_PROP_ENUM, {},
+                               {{0, "None"}, {1, "Pre-multiplied"}, {2, "Coverage"}});
+  uint32_t in_fence_fd = AddProperty("IN_FENCE_FD", DRM_MODE_PROP_SIGNED_RANGE,
+                                     {(uint64_t)-1, INT32_MAX});
+
+  /* IN_FORMATS: every format with the linear modifier */
+  struct drm_format_modifier_blob header;
+  memset(&header, 0, sizeof(header));
+  size_t formats_size = formats_.size() * sizeof(uint32_t);
+  header.version = FORMAT_BLOB_CURRENT;
+  header.count_formats = formats_.size();
+  header.formats_offset = sizeof(header);
+  header.count_modifiers = 1;
+  header.modifiers_offset = (sizeof(header) + formats_size + 7) & ~7;
+  struct drm_format_modifier modifier;
+  memset(&modifier, 0, sizeof(modifier));
+  modifier.formats = (1ULL << formats_.size()) - 1;
+  modifier.modifier = DRM_FORMAT_MOD_LINEAR;
+  std::vector<uint8_t> formats_blob(header.modifiers_offset + sizeof(modifier));
+  memcpy(formats_blob.data(), &header, sizeof(header));
+  memcpy(formats_blob.data() + header.formats_offset, formats_.data(),
+         formats_size);
+  memcpy(formats_blob.data() + header.modifiers_offset, &modifier,
+         sizeof(modifier));
+  uint32_t formats_blob_id = AddBlob(formats_blob.data(), formats_blob.size());
+
+  for (uint32_t i = 0; i < config_.num_displays; i++) {
+    Crtc crtc;
+    crtc.id = AddObject(DRM_MODE_OBJECT_CRTC);
+    AttachProperty(crtc.id, active, 0);
+    AttachProperty(crtc.id, mode_id, 0);
+    AttachProperty(crtc.id, out_fence_ptr, 0);
+
+    crtc.encoder_id = AddObject(DRM_MODE_OBJECT_ENCODER);
+    crtc.connector_id = AddObject(DRM_MODE_OBJECT_CONNECTOR);
+    crtc.connector_type = i == 0 ? DRM_MODE_CONNECTOR_DSI
+                                 : DRM_MODE_CONNECTOR_DisplayPort;
+    AttachProperty(crtc.connector_id, dpms, DRM_MODE_DPMS_OFF);
+    AttachProperty(crtc.connector_id, conn_crtc_id, 0);
+    AttachProperty(crtc.connector_id, edid, 0);
+    crtcs_.push_back(crtc);
+
+    for (uint32_t j = 0; j < config_.planes_per_crtc; j++) {
+      uint32_t plane_id = AddObject(DRM_MODE_OBJECT_PLANE);
+      AttachProperty(plane_id, type,
+                     j == 0 ? DRM_PLANE_TYPE_PRIMARY : DRM_PLANE_TYPE_OVERLAY);
+      AttachProperty(plane_id, plane_crtc_id, 0);
+      AttachProperty(plane_id, fb_id, 0);
+      AttachProperty(plane_id, crtc_x, 0);
+      AttachProperty(plane_id, crtc_y, 0);
+      AttachProperty(plane_id, crtc_w, 0);
+      AttachProperty(plane_id, crtc_h, 0);
+      AttachProperty(plane_id, src_x, 0);
+      AttachProperty(plane_id, src_y, 0);
+      AttachProperty(plane_id, src_w, 0);
+      AttachProperty(plane_id, src_h, 0);
+      AttachProperty(plane_id, in_formats, formats_blob_id);
+      AttachProperty(plane_id, zpos, j);
+      AttachProperty(plane_id, rotation, 1 << 0);
+      AttachProperty(plane_id, alpha, 0xffff);
+      AttachProperty(plane_id, blend, 1);
+      AttachProperty(plane_id, in_fence_fd, (uint64_t)-1);
+      planes_.push_back(plane_id);
+      plane_possible_crtcs_[plane_id] = 1 << i;
+    }
+  }
+}
+
+int FakeDrm::SetClientCap(uint64_t capability, uint64_t value) {
+  return 0;
+}
+
+drmModeResPtr FakeDrm::GetResources() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  drmModeResPtr res = (drmModeResPtr)calloc(1, sizeof(*res));
+  if (!res)
+    return NULL;
+
+  std::vector<uint32_t> crtcs, encoders, connectors;
+  for (auto &crtc : crtcs_) {
+    crtcs.push_back(crtc.id);
+    encoders.push_back(crtc.encoder_id);
+    connectors.push_back(crtc.connector_id);
+  }
+  res->count_crtcs = crtcs.size();
+  res->crtcs = AllocArray(crtcs);
+  res->count_encoders = encoders.size();
+  res->encoders = AllocArray(encoders);
+  res->count_connectors = connectors.size();
+  res->connectors = AllocArray(connectors);
+  res->min_width = 0;
+  res->min_height = 0;
+  res->max_width = 8192;
+  res->max_height = 8192;
+  return res;
+}
+
+drmModeCrtcPtr FakeDrm::GetCrtc(uint32_t crtc_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &crtc : crtcs_) {
+    if (crtc.id != crtc_id)
+      continue;
+
+    drmModeCrtcPtr c = (drmModeCrtcPtr)calloc(1, sizeof(*c));
+    if (!c)
+      return NULL;
+    c->crtc_id = crtc.id;
+    c->width = config_.width;
+    c->height = config_.height;
+    c->mode_valid = *PropertyValue(crtc.id, FindProperty(crtc.id, "MODE_ID")) != 0;
+    if (c->mode_valid)
+      c->mode = mode_;
+    return c;
+  }
+  errno = ENOENT;
+  return NULL;
+}
+
+drmModeEncoderPtr FakeDrm::GetEncoder(uint32_t encoder_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t i = 0; i < crtcs_.size(); i++) {
+    if (crtcs_[i].encoder_id != encoder_id)
+      continue;
+
+    drmModeEncoderPtr e = (drmModeEncoderPtr)calloc(1, sizeof(*e));
+    if (!e)
+      return NULL;
+    e->encoder_id = encoder_id;
+    e->encoder_type = crtcs_[i].connector_type == DRM_MODE_CONNECTOR_DSI
+                          ? DRM_MODE_ENCODER_DSI
+                          : DRM_MODE_ENCODER_TMDS;
+    e->crtc_id = crtcs_[i].id;
+    e->possible_crtcs = 1 << i;
+    e->possible_clones = 0;
+    return e;
+  }
+  errno = ENOENT;
+  return NULL;
+}
+
+drmModeConnectorPtr FakeDrm::GetConnector(uint32_t connector_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t i = 0; i < crtcs_.size(); i++) {
+    if (crtcs_[i].connector_id != connector_id)
+      continue;
+
+    drmModeConnectorPtr c = (drmModeConnectorPtr)calloc(1, sizeof(*c));
+    if (!c)
+      return NULL;
+    c->connector_id = connector_id;
+    c->encoder_id = crtcs_[i].encoder_id;
+    c->connector_type = crtcs_[i].connector_type;
+    c->connector_type_id = i + 1;
+    c->connection = DRM_MODE_CONNECTED;
+    c->mmWidth = 70;
+    c->mmHeight = 155;
+    c->subpixel = DRM_MODE_SUBPIXEL_UNKNOWN;
+    c->count_modes = 1;
+    c->modes = AllocArray(std::vector<drmModeModeInfo>{mode_});
+
+    std::vector<uint32_t> props;
+    std::vector<uint64_t> values;
+    for (auto &it : objects_[connector_id].properties) {
+      props.push_back(it.first);
+      values.push_back(it.second);
+    }
+    c->count_props = props.size();
+    c->props = AllocArray(props);
+    c->prop_values = AllocArray(values);
+    c->count_encoders = 1;
+    c->encoders = AllocArray(std::vector<uint32_t>{crtcs_[i].encoder_id});
+    return c;
+  }
+  errno = ENOENT;
+  return NULL;
+}
+
+drmModePlaneResPtr FakeDrm::GetPlaneResources() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  drmModePlaneResPtr res = (drmModePlaneResPtr)calloc(1, sizeof(*res));
+  if (!res)
+    return NULL;
+  res->count_planes = planes_.size();
+  res->planes = AllocArray(planes_);
+  return res;
+}
+
+drmModePlanePtr FakeDrm::GetPlane(uint32_t plane_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto possible_crtcs = plane_possible_crtcs_.find(plane_id);
+  if (possible_crtcs == plane_possible_crtcs_.end()) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  drmModePlanePtr p = (drmModePlanePtr)calloc(1, sizeof(*p));
+  if (!p)
+    return NULL;
+  p->plane_id = plane_id;
+  p->crtc_id = *PropertyValue(plane_id, FindProperty(plane_id, "CRTC_ID"));
+  p->fb_id = *PropertyValue(plane_id, FindProperty(plane_id, "FB_ID"));
+  p->possible_crtcs = possible_crtcs->second;
+  p->count_formats = formats_.size();
+  p->formats = AllocArray(formats_);
+  return p;
+}
+
+drmModeObjectPropertiesPtr FakeDrm::GetObjectProperties(uint32_t object_id,
+                                                        uint32_t object_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto object = objects_.find(object_id);
+  if ((object == objects_.end()) ||
+      ((object_type != DRM_MODE_OBJECT_ANY) &&
+       (object->second.type != object_type))) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  drmModeObjectPropertiesPtr props =
+      (drmModeObjectPropertiesPtr)calloc(1, sizeof(*props));
+  if (!props)
+    return NULL;
+  std::vector<uint32_t> ids;
+  std::vector<uint64_t> values;
+  for (auto &it : object->second.properties) {
+    ids.push_back(it.first);
+    values.push_back(it.second);
+  }
+  props->count_props = ids.size();
+  props->props = AllocArray(ids);
+  props->prop_values = AllocArray(values);
+  return props;
+}
+
+drmModePropertyPtr FakeDrm::GetProperty(uint32_t property_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = properties_.find(property_id);
+  if (it == properties_.end()) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  const Property &property = it->second;
+  drmModePropertyPtr p = (drmModePropertyPtr)calloc(1, sizeof(*p));
+  if (!p)
+    return NULL;
+  p->prop_id = property.id;
+  p->flags = property.flags;
+  strncpy(p->name, property.name.c_str(), DRM_PROP_NAME_LEN - 1);
+  p->count_values = property.values.size();
+  p->values = AllocArray(property.values);
+  if (!property.enums.empty()) {
+    std::vector<struct drm_mode_property_enum> enums(property.enums.size());
+    for (size_t i = 0; i < property.enums.size(); i++) {
+      enums[i].value = property.enums[i].first;
+      strncpy(enums[i].name, property.enums[i].second.c_str(),
+              DRM_PROP_NAME_LEN - 1);
+    }
+    p->count_enums = enums.size();
+    p->enums = AllocArray(enums);
+  }
+  return p;
+}
+
+drmModePropertyBlobPtr FakeDrm::GetPropertyBlob(uint32_t blob_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end()) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  drmModePropertyBlobPtr blob = (drmModePropertyBlobPtr)calloc(1, sizeof(*blob));
+  if (!blob)
+    return NULL;
+  blob->id = blob_id;
+  blob->length = it->second.size();
+  blob->data = AllocArray(it->second);
+  return blob;
+}
+
+int FakeDrm::CreatePropertyBlob(const void *data, size_t length,
+                                uint32_t *blob_id) {
+  if (!data || !length)
+    return -EINVAL;
+  std::lock_guard<std::mutex> lock(mutex_);
+  *blob_id = AddBlob(data, length);
+  return 0;
+}
+
+int FakeDrm::DestroyPropertyBlob(uint32_t blob_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  /* A blob in use stays alive in the kernel, the fake keeps it too */
+  return blobs_.count(blob_id) ? 0 : -ENOENT;
+}
+
+int FakeDrm::SetConnectorProperty(uint32_t connector_id, uint32_t property_id,
+                                  uint64_t value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto property = properties_.find(property_id);
+  uint64_t *current = PropertyValue(connector_id, property_id);
+  if ((property == properties_.end()) || !current)
+    return -ENOENT;
+  int ret = CheckValue(property->second, value);
+  if (ret)
+    return ret;
+  *current = value;
+  return 0;
+}
+
+bool FakeDrm::ShouldFail(uint32_t interval, uint64_t *count) {
+  return interval && ((++(*count) % interval) == 0);
+}
+
+int FakeDrm::PrimeFDToHandle(int prime_fd, uint32_t *handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.imports++;
+  struct stat st;
+  if (ShouldFail(config_.fail_import_interval, &import_count_) ||
+      fstat(prime_fd, &st)) {
+    stats_.failed_imports++;
+    return -EINVAL;
+  }
+
+  /* The same buffer has the same handle */
+  auto key = std::make_pair((uint64_t)st.st_dev, (uint64_t)st.st_ino);
+  auto it = handles_.find(key);
+  if (it == handles_.end())
+    it = handles_.emplace(key, next_handle_++).first;
+  *handle = it->second;
+  return 0;
+}
+
+int FakeDrm::CloseHandle(uint32_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = handles_.begin(); it != handles_.end(); ++it) {
+    if (it->second == handle) {
+      handles_.erase(it);
+      return 0;
+    }
+  }
+  return -EINVAL;
+}
+
+int FakeDrm::AddFB(uint32_t width, uint32_t height, uint32_t pixel_format,
+                   const uint32_t handles[4], uint32_t *buf_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!width || !height || (width > 8192) || (height > 8192))
+    return -EINVAL;
+
+  std::vector<uint32_t> fb_handles;
+  for (int i = 0; i < 4; i++) {
+    if (!handles[i])
+      continue;
+    bool found = false;
+    for (auto &it : handles_)
+      found = found || (it.second == handles[i]);
+    if (!found)
+      return -ENOENT;
+    fb_handles.push_back(handles[i]);
+  }
+  if (fb_handles.empty())
+    return -EINVAL;
+
+  *buf_id = next_id_++;
+  fbs_[*buf_id] = fb_handles;
+  return 0;
+}
+
+int FakeDrm::RemoveFB(uint32_t fb_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!fbs_.erase(fb_id))
+    return -ENOENT;
+
+  /* Removing a framebuffer in use disables its planes */
+  for (auto plane_id : planes_) {
+    uint64_t *fb = PropertyValue(plane_id, FindProperty(plane_id, "FB_ID"));
+    if (*fb == fb_id) {
+      *fb = 0;
+      *PropertyValue(plane_id, FindProperty(plane_id, "CRTC_ID")) = 0;
+    }
+  }
+  return 0;
+}
+
+int FakeDrm::CheckValue(const Property &property, uint64_t value) const {
+  uint32_t extended = property.flags & DRM_MODE_PROP_EXTENDED_TYPE;
+  if (property.flags & DRM_MODE_PROP_RANGE) {
+    if ((value < property.values[0]) || (value > property.values[1]))
+      return -EINVAL;
+  } else if (extended == DRM_MODE_PROP_SIGNED_RANGE) {
+    if (((int64_t)value < (int64_t)property.values[0]) ||
+        ((int64_t)value > (int64_t)property.values[1]))
+      return -EINVAL;
+  } else if (property.flags & DRM_MODE_PROP_ENUM) {
+    for (auto &it : property.enums) {
+      if (it.first == value)
+        return 0;
+    }
+    return -EINVAL;
+  } else if (property.flags & DRM_MODE_PROP_BITMASK) {
+    uint64_t mask = 0;
+    for (auto &it : property.enums)
+      mask |= 1ULL << it.first;
+    if (value & ~mask)
+      return -EINVAL;
+  } else if (extended == DRM_MODE_PROP_OBJECT) {
+    if (!value)
+      return 0;
+    if (property.values[0] == DRM_MODE_OBJECT_FB)
+      return fbs_.count(value) ? 0 : -ENOENT;
+    auto object = objects_.find(value);
+    if ((object == objects_.end()) ||
+        (object->second.type != property.values[0]))
+      return -ENOENT;
+  } else if (property.flags & DRM_MODE_PROP_BLOB) {
+    if (value && !blobs_.count(value))
+      return -ENOENT;
+  }
+  return 0;
+}
+
+int FakeDrm::CheckCommit(drmModeAtomicReqPtr req, uint32_t flags,
+                         std::vector<uint32_t> *pipes) {
+  bool modeset = flags & DRM_MODE_ATOMIC_ALLOW_MODESET;
+  std::map<uint32_t, uint64_t> new_crtcs;
+
+  for (auto &item : req->items) {
+    auto object = objects_.find(item.object_id);
+    auto property = properties_.find(item.property_id);
+    uint64_t *current = PropertyValue(item.object_id, item.property_id);
+    if ((object == objects_.end()) || (property == properties_.end()) ||
+        !current) {
+      ALOGE("%s: object %u has no property %u", __func__, item.object_id,
+            item.property_id);
+      return -ENOENT;
+    }
+    if (property->second.flags & DRM_MODE_PROP_IMMUTABLE)
+      return -EINVAL;
+
+    int ret = CheckValue(property->second, item.value);
+    if (ret) {
+      ALOGE("%s: invalid %s(%" PRIu64 ") of object %u", __func__,
+            property->second.name.c_str(), item.value, item.object_id);
+      return ret;
+    }
+
+    const std::string &name = property->second.name;
+    if (!modeset && ((name == "ACTIVE") || (name == "MODE_ID")) &&
+        (item.value != *current)) {
+      ALOGE("%s: %s needs a modeset", __func__, name.c_str());
+      return -EINVAL;
+    }
+    if (name == "CRTC_ID")
+      new_crtcs[item.object_id] = item.value;
+  }
+
+  /* The crtcs of the updated objects are the ones after the commit */
+  for (auto &item : req->items) {
+    uint32_t crtc_id = item.object_id;
+    if (objects_[item.object_id].type != DRM_MODE_OBJECT_CRTC) {
+      auto it = new_crtcs.find(item.object_id);
+      crtc_id = it != new_crtcs.end()
+                    ? it->second
+                    : *PropertyValue(item.object_id,
+                                     FindProperty(item.object_id, "CRTC_ID"));
+    }
+    for (uint32_t pipe = 0; pipe < crtcs_.size(); pipe++) {
+      if (crtcs_[pipe].id != crtc_id)
+        continue;
+      auto possible = plane_possible_crtcs_.find(item.object_id);
+      if ((possible != plane_possible_crtcs_.end()) &&
+          !(possible->second & (1 << pipe)))
+        return -EINVAL;
+      if (std::find(pipes->begin(), pipes->end(), pipe) == pipes->end())
+        pipes->push_back(pipe);
+    }
+  }
+  return 0;
+}
+
+int FakeDrm::AtomicCommit(drmModeAtomicReqPtr req, uint32_t flags,
+                          void *user_data) {
+  if (!req)
+    return -EINVAL;
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  bool test_only = flags & DRM_MODE_ATOMIC_TEST_ONLY;
+  bool fail;
+  if (test_only) {
+    stats_.test_commits++;
+    fail = ShouldFail(config_.fail_test_commit_interval, &test_commit_count_);
+  } else {
+    stats_.commits++;
+    fail = ShouldFail(config_.fail_commit_interval, &commit_count_);
+  }
+
+  std::vector<uint32_t> pipes;
+  int ret = fail ? -EINVAL : CheckCommit(req, flags, &pipes);
+  if (ret) {
+    stats_.failed_commits++;
+    return ret;
+  }
+  if (test_only)
+    return 0;
+
+  auto flips_done = [&]() {
+    for (auto pipe : pipes) {
+      if (crtcs_[pipe].flip_pending && !should_exit())
+        return false;
+    }
+    return true;
+  };
+  if (!flips_done()) {
+    if (flags & DRM_MODE_ATOMIC_NONBLOCK) {
+      stats_.busy_commits++;
+      return -EBUSY;
+    }
+    flip_cond_.wait(lk, flips_done);
+  }
+
+  std::map<uint32_t, uint64_t> out_fence_ptrs;
+  std::map<uint32_t, std::vector<int>> in_fences;
+  for (auto &item : req->items) {
+    const std::string &name = properties_[item.property_id].name;
+    if ((name == "OUT_FENCE_PTR") || (name == "IN_FENCE_FD"))
+      continue;
+    *PropertyValue(item.object_id, item.property_id) = item.value;
+  }
+  for (auto &item : req->items) {
+    const std::string &name = properties_[item.property_id].name;
+    for (uint32_t pipe = 0; pipe < crtcs_.size(); pipe++) {
+      if ((name == "OUT_FENCE_PTR") && (crtcs_[pipe].id == item.object_id) &&
+          item.value) {
+        out_fence_ptrs[pipe] = item.value;
+      } else if ((name == "IN_FENCE_FD") && ((int64_t)item.value >= 0) &&
+                 (*PropertyValue(item.object_id,
+                                 FindProperty(item.object_id, "CRTC_ID")) ==
+                  crtcs_[pipe].id)) {
+        /* The commit holds a reference of the fence like the kernel */
+        int fence = dup((int)item.value);
+        if (fence >= 0)
+          in_fences[pipe].push_back(fence);
+      }
+    }
+  }
+
+  int64_t latch = VBlankTime(VBlankSequence(Now() + config_.commit_latency_ns) + 1);
+  for (auto pipe : pipes) {
+    Flip flip;
+    flip.pipe = pipe;
+    flip.in_fences = in_fences[pipe];
+    flip.send_event = flags & DRM_MODE_PAGE_FLIP_EVENT;
+    flip.user_data = (uint64_t)(uintptr_t)user_data;
+
+    auto out_fence_ptr = out_fence_ptrs.find(pipe);
+    if (out_fence_ptr != out_fence_ptrs.end()) {
+      int fence = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (fence >= 0)
+        flip.out_fence = dup(fence);
+      /* The kernel writes a s32 */
+      *(int32_t *)(uintptr_t)out_fence_ptr->second = fence;
+    }
+
+    crtcs_[pipe].flip_pending = true;
+    flips_.emplace(latch, flip);
+  }
+  Signal();
+
+  if (!(flags & DRM_MODE_ATOMIC_NONBLOCK))
+    flip_cond_.wait(lk, flips_done);
+  return 0;
+}
+
+int64_t FakeDrm::VBlankPeriod() const {
+  return 1000000000LL / config_.refresh_rate;
+}
+
+uint32_t FakeDrm::VBlankSequence(int64_t timestamp) const {
+  if (timestamp < vblank_base_)
+    return 0;
+  return (uint32_t)((timestamp - vblank_base_) / VBlankPeriod());
+}
+
+int64_t FakeDrm::VBlankTime(uint32_t sequence) const {
+  return vblank_base_ + sequence * VBlankPeriod();
+}
+
+void FakeDrm::QueueEvent(const Event &event) {
+  uint64_t count = 1;
+  events_.push_back(event);
+  if (event.type == EventType::kVBlank)
+    stats_.vblank_events++;
+  if (write(event_fd_, &count, sizeof(count)) != sizeof(count))
+    ALOGE("Failed to signal the fake drm fd: %s", strerror(errno));
+}
+
+void FakeDrm::LatchFlip(Flip &flip, int64_t timestamp) {
+  for (int fence : flip.in_fences)
+    close(fence);
+  if (flip.out_fence >= 0) {
+    uint64_t count = 1;
+    if (write(flip.out_fence, &count, sizeof(count)) != sizeof(count))
+      ALOGE("Failed to signal the out fence: %s", strerror(errno));
+    close(flip.out_fence);
+  }
+
+  Crtc &crtc = crtcs_[flip.pipe];
+  crtc.flip_pending = false;
+  stats_.flips++;
+  if (flip.send_event)
+    QueueEvent(Event{EventType::kFlip, crtc.id, VBlankSequence(timestamp),
+                     timestamp, flip.user_data});
+  flip_cond_.notify_all();
+}
+
+int FakeDrm::WaitVBlank(drmVBlankPtr vbl) {
+  uint32_t type = vbl->request.type;
+  uint32_t pipe = (type & DRM_VBLANK_SECONDARY)
+                      ? 1
+                      : (type & DRM_VBLANK_HIGH_CRTC_MASK) >>
+                            DRM_VBLANK_HIGH_CRTC_SHIFT;
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  /* The vblank is off while the crtc is inactive */
+  if ((pipe >= crtcs_.size()) ||
+      !*PropertyValue(crtcs_[pipe].id, FindProperty(crtcs_[pipe].id, "ACTIVE")))
+    return -EINVAL;
+
+  uint32_t current = VBlankSequence(Now());
+  uint32_t target = vbl->request.sequence;
+  if (type & DRM_VBLANK_RELATIVE)
+    target += current;
+  if ((int32_t)(target - current) < 0) {
+    if (type & DRM_VBLANK_NEXTONMISS)
+      target = current + 1;
+    else
+      target = current;
+  }
+
+  if (type & DRM_VBLANK_EVENT) {
+    Event event{EventType::kVBlank, crtcs_[pipe].id, target, VBlankTime(target),
+                vbl->request.signal};
+    if (target == current)
+      QueueEvent(event);
+    else
+      vblanks_.emplace(event.timestamp, event);
+    Signal();
+    vbl->reply.sequence = target;
+    return 0;
+  }
+
+  lk.unlock();
+  int64_t timestamp = VBlankTime(target);
+  int64_t delay = timestamp - Now();
+  if (delay > 0) {
+    struct timespec ts = {(time_t)(delay / 1000000000LL),
+                          (long)(delay % 1000000000LL)};
+    nanosleep(&ts, NULL);
+  }
+  vbl->reply.sequence = target;
+  vbl->reply.tval_sec = timestamp / 1000000000LL;
+  vbl->reply.tval_usec = (timestamp % 1000000000LL) / 1000;
+  return 0;
+}
+
+int FakeDrm::HandleEvent(drmEventContextPtr evctx) {
+  uint64_t count;
+  if ((read(event_fd_, &count, sizeof(count)) < 0) && (errno != EAGAIN))
+    return -1;
+
+  std::deque<Event> events;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events.swap(events_);
+  }
+
+  for (auto &event : events) {
+    unsigned int tv_sec = event.timestamp / 1000000000LL;
+    unsigned int tv_usec = (event.timestamp % 1000000000LL) / 1000;
+    void *user_data = (void *)(uintptr_t)event.user_data;
+    if (event.type == EventType::kVBlank) {
+      if (evctx->vblank_handler)
+        evctx->vblank_handler(event_fd_, event.sequence, tv_sec, tv_usec,
+                              user_data);
+    } else if ((evctx->version >= 3) && evctx->page_flip_handler2) {
+      evctx->page_flip_handler2(event_fd_, event.sequence, tv_sec, tv_usec,
+                                event.crtc_id, user_data);
+    } else if (evctx->page_flip_handler) {
+      evctx->page_flip_handler(event_fd_, event.sequence, tv_sec, tv_usec,
+                               user_data);
+    }
+  }
+  return 0;
+}
+
+void FakeDrm::Routine() {
+  Lock();
+  int64_t timeout = -1;
+  int64_t now = Now();
+  if (!flips_.empty())
+    timeout = std::max<int64_t>(flips_.begin()->first - now, 0);
+  if (!vblanks_.empty()) {
+    int64_t vblank_timeout = std::max<int64_t>(vblanks_.begin()->first - now, 0);
+    timeout = timeout < 0 ? vblank_timeout : std::min(timeout, vblank_timeout);
+  }
+
+  if (timeout != 0) {
+    int ret = WaitForSignalOrExitLocked(timeout);
+    if (ret == -EINTR) {
+      /* Wakes up the blocking commits */
+      flip_cond_.notify_all();
+      Unlock();
+      return;
+    }
+  }
+
+  now = Now();
+  while (!vblanks_.empty() && (vblanks_.begin()->first <= now)) {
+    QueueEvent(vblanks_.begin()->second);
+    vblanks_.erase(vblanks_.begin());
+  }
+
+  while (!flips_.empty() && (flips_.begin()->first <= now)) {
+    int64_t timestamp = flips_.begin()->first;
+    Flip flip = flips_.begin()->second;
+    flips_.erase(flips_.begin());
+
+    bool signaled = true;
+    for (int fence : flip.in_fences) {
+      struct pollfd pfd = {fence, POLLIN, 0};
+      signaled = signaled && (poll(&pfd, 1, 0) > 0);
+    }
+    if (!signaled) {
+      /* The hardware latches the frame on the next vblank */
+      stats_.late_flips++;
+      flips_.emplace(timestamp + VBlankPeriod(), flip);
+      continue;
+    }
+    LatchFlip(flip, timestamp);
+  }
+  Unlock();
+}
+}  // namespace android
+
+using android::FakeDrm;
+
+extern "C" {
+
+int drmIoctl(int fd, unsigned long request, void *arg) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  int ret = -EBADF;
+  if (drm) {
+    switch (request) {
+      case DRM_IOCTL_MODE_CREATEPROPBLOB: {
+        struct drm_mode_create_blob *blob = (struct drm_mode_create_blob *)arg;
+        ret = drm->CreatePropertyBlob((const void *)(uintptr_t)blob->data,
+                                      blob->length, &blob->blob_id);
+        break;
+      }
+      case DRM_IOCTL_MODE_DESTROYPROPBLOB:
+        ret = drm->DestroyPropertyBlob(
+            ((struct drm_mode_destroy_blob *)arg)->blob_id);
+        break;
+      case DRM_IOCTL_GEM_CLOSE:
+        ret = drm->CloseHandle(((struct drm_gem_close *)arg)->handle);
+        break;
+      default:
+        ret = -ENOTTY;
+        break;
+    }
+  }
+  if (ret < 0) {
+    errno = -ret;
+    return -1;
+  }
+  return 0;
+}
+
+int drmSetClientCap(int fd, uint64_t capability, uint64_t value) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->SetClientCap(capability, value) : -EBADF;
+}
+
+int drmGetNodeTypeFromFd(int fd) {
+  return FakeDrm::Get(fd) ? DRM_NODE_PRIMARY : -1;
+}
+
+drmModeResPtr drmModeGetResources(int fd) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetResources() : NULL;
+}
+
+void drmModeFreeResources(drmModeResPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->fbs);
+  free(ptr->crtcs);
+  free(ptr->connectors);
+  free(ptr->encoders);
+  free(ptr);
+}
+
+drmModeCrtcPtr drmModeGetCrtc(int fd, uint32_t crtcId) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetCrtc(crtcId) : NULL;
+}
+
+void drmModeFreeCrtc(drmModeCrtcPtr ptr) {
+  free(ptr);
+}
+
+drmModeEncoderPtr drmModeGetEncoder(int fd, uint32_t encoder_id) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetEncoder(encoder_id) : NULL;
+}
+
+void drmModeFreeEncoder(drmModeEncoderPtr ptr) {
+  free(ptr);
+}
+
+drmModeConnectorPtr drmModeGetConnector(int fd, uint32_t connectorId) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetConnector(connectorId) : NULL;
+}
+
+void drmModeFreeConnector(drmModeConnectorPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->encoders);
+  free(ptr->prop_values);
+  free(ptr->props);
+  free(ptr->modes);
+  free(ptr);
+}
+
+drmModePlaneResPtr drmModeGetPlaneResources(int fd) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetPlaneResources() : NULL;
+}
+
+void drmModeFreePlaneResources(drmModePlaneResPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->planes);
+  free(ptr);
+}
+
+drmModePlanePtr drmModeGetPlane(int fd, uint32_t plane_id) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetPlane(plane_id) : NULL;
+}
+
+void drmModeFreePlane(drmModePlanePtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->formats);
+  free(ptr);
+}
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd,
+                                                      uint32_t object_id,
+                                                      uint32_t object_type) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetObjectProperties(object_id, object_type) : NULL;
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->props);
+  free(ptr->prop_values);
+  free(ptr);
+}
+
+drmModePropertyPtr drmModeGetProperty(int fd, uint32_t propertyId) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetProperty(propertyId) : NULL;
+}
+
+void drmModeFreeProperty(drmModePropertyPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->values);
+  free(ptr->enums);
+  free(ptr->blob_ids);
+  free(ptr);
+}
+
+drmModePropertyBlobPtr drmModeGetPropertyBlob(int fd, uint32_t blob_id) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->GetPropertyBlob(blob_id) : NULL;
+}
+
+void drmModeFreePropertyBlob(drmModePropertyBlobPtr ptr) {
+  if (!ptr)
+    return;
+  free(ptr->data);
+  free(ptr);
+}
+
+int drmModeConnectorSetProperty(int fd, uint32_t connector_id,
+                                uint32_t property_id, uint64_t value) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->SetConnectorProperty(connector_id, property_id, value)
+             : -EBADF;
+}
+
+int drmPrimeFDToHandle(int fd, int prime_fd, uint32_t *handle) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  int ret = drm ? drm->PrimeFDToHandle(prime_fd, handle) : -EBADF;
+  if (ret < 0) {
+    errno = -ret;
+    return -1;
+  }
+  return 0;
+}
+
+int drmModeAddFB2WithModifiers(int fd, uint32_t width, uint32_t height,
+                               uint32_t pixel_format,
+                               const uint32_t bo_handles[4],
+                               const uint32_t pitches[4],
+                               const uint32_t offsets[4],
+                               const uint64_t modifier[4], uint32_t *buf_id,
+                               uint32_t flags) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->AddFB(width, height, pixel_format, bo_handles, buf_id)
+             : -EBADF;
+}
+
+int drmModeRmFB(int fd, uint32_t bufferId) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->RemoveFB(bufferId) : -EBADF;
+}
+
+drmModeAtomicReqPtr drmModeAtomicAlloc(void) {
+  return new _drmModeAtomicReq();
+}
+
+drmModeAtomicReqPtr drmModeAtomicDuplicate(drmModeAtomicReqPtr req) {
+  return req ? new _drmModeAtomicReq(*req) : NULL;
+}
+
+int drmModeAtomicMerge(drmModeAtomicReqPtr base, drmModeAtomicReqPtr augment) {
+  if (!base)
+    return -EINVAL;
+  if (augment)
+    base->items.insert(base->items.end(), augment->items.begin(),
+                       augment->items.end());
+  return 0;
+}
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req) {
+  delete req;
+}
+
+int drmModeAtomicGetCursor(drmModeAtomicReqPtr req) {
+  return req ? (int)req->items.size() : -EINVAL;
+}
+
+void drmModeAtomicSetCursor(drmModeAtomicReqPtr req, int cursor) {
+  if (req && (cursor >= 0) && ((size_t)cursor < req->items.size()))
+    req->items.resize(cursor);
+}
+
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id,
+                             uint32_t property_id, uint64_t value) {
+  if (!req)
+    return -EINVAL;
+  req->items.push_back(FakeDrmAtomicItem{object_id, property_id, value});
+  return req->items.size();
+}
+
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags,
+                        void *user_data) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->AtomicCommit(req, flags, user_data) : -EBADF;
+}
+
+int drmWaitVBlank(int fd, drmVBlankPtr vbl) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  int ret = drm ? drm->WaitVBlank(vbl) : -EBADF;
+  if (ret < 0) {
+    errno = -ret;
+    return -1;
+  }
+  return 0;
+}
+
+int drmHandleEvent(int fd, drmEventContextPtr evctx) {
+  FakeDrm *drm = FakeDrm::Get(fd);
+  return drm ? drm->HandleEvent(evctx) : -1;
+}
+}
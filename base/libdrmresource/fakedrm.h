@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FAKE_DRM_H_
+#define ANDROID_FAKE_DRM_H_
+
+#include "worker.h"
+
+#include <stdint.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+struct FakeDrmConfig {
+  /* The first display has a DSI connector, the others DisplayPort ones */
+  uint32_t num_displays = 1;
+  uint32_t planes_per_crtc = 4;
+  uint32_t width = 1080;
+  uint32_t height = 2400;
+  uint32_t refresh_rate = 60;
+  /* A commit is latched on the first vblank after this latency */
+  int64_t commit_latency_ns = 1000000;
+  /* Every Nth request fails, 0 never fails */
+  uint32_t fail_commit_interval = 0;
+  uint32_t fail_test_commit_interval = 0;
+  uint32_t fail_import_interval = 0;
+};
+
+struct FakeDrmStats {
+  uint64_t commits = 0;
+  uint64_t test_commits = 0;
+  uint64_t failed_commits = 0;
+  uint64_t busy_commits = 0;
+  uint64_t flips = 0;
+  /* Flips moved to a later vblank because an in-fence was not signaled */
+  uint64_t late_flips = 0;
+  uint64_t vblank_events = 0;
+  uint64_t imports = 0;
+  uint64_t failed_imports = 0;
+};
+
+/*
+ * FakeDrm models a DRM/KMS device in the process for the host runs.
+ * It implements the libdrm functions that libdrmresource and libhwc2.1 call,
+ * so a host build links libdrmresource_fake instead of libdrm and
+ * DrmDevice opens the "fake" device path.
+ *
+ * A commit is validated like an atomic check: the objects, properties,
+ * ranges, framebuffers and blobs have to exist and only modeset commits
+ * can change ACTIVE and MODE_ID. It is latched on the first vblank after
+ * the commit latency and waits for the in-fences of its planes. Then the
+ * out-fence is signaled and the page flip event is delivered. The fences
+ * are eventfds, which are readable when signaled.
+ * The device fd is an eventfd that is readable while events are pending.
+ */
+class FakeDrm : public Worker {
+ public:
+  static bool IsFakePath(const char *path);
+  /* The config of the devices opened later */
+  static void SetConfig(const FakeDrmConfig &config);
+  /* Returns the device fd */
+  static int Open();
+  /* Called before the device fd is closed */
+  static void Release(int fd);
+  static FakeDrm *Get(int fd);
+
+  FakeDrm(const FakeDrmConfig &config, int event_fd);
+  ~FakeDrm() override;
+
+  /* Changes the latency and the failure injection of the config */
+  void SetFailures(const FakeDrmConfig &config);
+  FakeDrmStats stats();
+  std::string Dump();
+
+  /* libdrm */
+  int SetClientCap(uint64_t capability, uint64_t value);
+  drmModeResPtr GetResources();
+  drmModeCrtcPtr GetCrtc(uint32_t crtc_id);
+  drmModeEncoderPtr GetEncoder(uint32_t encoder_id);
+  drmModeConnectorPtr GetConnector(uint32_t connector_id);
+  drmModePlaneResPtr GetPlaneResources();
+  drmModePlanePtr GetPlane(uint32_t plane_id);
+  drmModeObjectPropertiesPtr GetObjectProperties(uint32_t object_id,
+                                                 uint32_t object_type);
+  drmModePropertyPtr GetProperty(uint32_t property_id);
+  drmModePropertyBlobPtr GetPropertyBlob(uint32_t blob_id);
+  int CreatePropertyBlob(const void *data, size_t length, uint32_t *blob_id);
+  int DestroyPropertyBlob(uint32_t blob_id);
+  int SetConnectorProperty(uint32_t connector_id, uint32_t property_id,
+                           uint64_t value);
+  int PrimeFDToHandle(int prime_fd, uint32_t *handle);
+  int CloseHandle(uint32_t handle);
+  int AddFB(uint32_t width, uint32_t height, uint32_t pixel_format,
+            const uint32_t handles[4], uint32_t *buf_id);
+  int RemoveFB(uint32_t fb_id);
+  int AtomicCommit(drmModeAtomicReqPtr req, uint32_t flags, void *user_data);
+  int WaitVBlank(drmVBlankPtr vbl);
+  int HandleEvent(drmEventContextPtr evctx);
+
+ protected:
+  void Routine() override;
+
+ private:
+  struct Property {
+    uint32_t id;
+    std::string name;
+    uint32_t flags;
+    std::vector<uint64_t> values;
+    std::vector<std::pair<uint64_t, std::string>> enums;
+  };
+
+  struct Object {
+    uint32_t type;
+    /* property id and value */
+    std::vector<std::pair<uint32_t, uint64_t>> properties;
+  };
+
+  struct Crtc {
+    uint32_t id;
+    uint32_t encoder_id;
+    uint32_t connector_id;
+    uint32_t connector_type;
+    /* A flip is pending until the commit is latched */
+    bool flip_pending = false;
+  };
+
+  enum class EventType { kVBlank, kFlip };
+
+  struct Event {
+    EventType type;
+    uint32_t crtc_id;
+    uint32_t sequence;
+    int64_t timestamp;
+    uint64_t user_data;
+  };
+
+  struct Flip {
+    uint32_t pipe;
+    int out_fence = -1;
+    std::vector<int> in_fences;
+    bool send_event = false;
+    uint64_t user_data = 0;
+  };
+
+  void CreateObjects();
+  uint32_t AddProperty(const char *name, uint32_t flags,
+                       std::vector<uint64_t> values,
+                       std::vector<std::pair<uint64_t, std::string>> enums = {});
+  uint32_t AddObject(uint32_t type);
+  uint32_t AddBlob(const void *data, size_t length);
+  void AttachProperty(uint32_t object_id, uint32_t property_id, uint64_t value);
+  uint32_t FindProperty(uint32_t object_id, const char *name) const;
+  uint64_t *PropertyValue(uint32_t object_id, uint32_t property_id);
+  int CheckValue(const Property &property, uint64_t value) const;
+  /* Returns the pipes of the crtcs that the commit updates */
+  int CheckCommit(drmModeAtomicReqPtr req, uint32_t flags,
+                  std::vector<uint32_t> *pipes);
+  bool ShouldFail(uint32_t interval, uint64_t *count);
+
+  int64_t VBlankPeriod() const;
+  uint32_t VBlankSequence(int64_t timestamp) const;
+  int64_t VBlankTime(uint32_t sequence) const;
+  void QueueEvent(const Event &event);
+  void LatchFlip(Flip &flip, int64_t timestamp);
+
+  FakeDrmConfig config_;
+  /* The device fd, closed by its DrmDevice */
+  int event_fd_ = -1;
+  int64_t vblank_base_;
+
+  uint32_t next_id_ = 1;
+  std::map<uint32_t, Property> properties_;
+  std::map<uint32_t, Object> objects_;
+  std::map<uint32_t, std::vector<uint8_t>> blobs_;
+  std::vector<Crtc> crtcs_;
+  std::vector<uint32_t> planes_;
+  std::map<uint32_t, uint32_t> plane_possible_crtcs_;
+  std::vector<uint32_t> formats_;
+  drmModeModeInfo mode_;
+
+  /* The gem handle of a dmabuf is found with its inode */
+  uint32_t next_handle_ = 1;
+  std::map<std::pair<uint64_t, uint64_t>, uint32_t> handles_;
+  std::map<uint32_t, std::vector<uint32_t>> fbs_;
+
+  std::multimap<int64_t, Flip> flips_;
+  std::multimap<int64_t, Event> vblanks_;
+  std::deque<Event> events_;
+  std::condition_variable flip_cond_;
+
+  FakeDrmStats stats_;
+  uint64_t commit_count_ = 0;
+  uint64_t test_commit_count_ = 0;
+  uint64_t import_count_ = 0;
+};
+}  // namespace android
+
+#endif  // ANDROID_FAKE_DRM_H_
@@ -32,7 +32,11 @@ int ResourceManager::Init() {
   char path_pattern[PROPERTY_VALUE_MAX];
   // Could be a valid path or it can have at the end of it the wildcard %
   // which means that it will try open all devices until an error is met.
+#ifdef USE_FAKE_DRM
+  int path_len = property_get("vendor.hwc.drm.device", path_pattern, "fake");
+#else
   int path_len = property_get("vendor.hwc.drm.device", path_pattern, "/dev/dri/card%");
+#endif
   int ret = 0;
   if (path_pattern[path_len - 1] != '%') {
     ret = AddDrmDevice(std::string(path_pattern));
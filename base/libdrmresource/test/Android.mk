@@ -0,0 +1,27 @@
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+#### Host test for libdrmresource on the fake DRM device ####
+
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS := -DHLOG_CODE=0 -DUSE_FAKE_DRM
+LOCAL_CFLAGS += -Wno-unused-parameter
+LOCAL_STATIC_LIBRARIES := libdrmresource_fake
+LOCAL_SHARED_LIBRARIES := libcutils liblog libutils
+LOCAL_SRC_FILES := fakedrm_test.cpp
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := libdrmresource_fake_test
+include $(BUILD_HOST_NATIVE_TEST)
@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "drm_fourcc.h"
+#include "drmconnector.h"
+#include "drmcrtc.h"
+#include "drmdevice.h"
+#include "drmplane.h"
+#include "fakedrm.h"
+#include "vsyncworker.h"
+
+// Drives DrmDevice, DrmEventListener and VSyncWorker through the fake DRM
+// device like ExynosDisplayDrmInterface does on the target. The fences of the
+// fake are eventfds, which are readable when signaled.
+
+namespace android {
+
+static const int kFrameMs = 1000 / 60;
+
+static bool IsSignaled(int fence, int timeout_ms) {
+  struct pollfd pfd = {fence, POLLIN, 0};
+  return poll(&pfd, 1, timeout_ms) > 0;
+}
+
+static void Signal(int fence) {
+  uint64_t count = 1;
+  ASSERT_EQ(write(fence, &count, sizeof(count)), (ssize_t)sizeof(count));
+}
+
+// Records the page flip event, DrmEventListener deletes it after the event
+class FlipEventHandler : public DrmEventHandler {
+ public:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cond;
+    int flips = 0;
+    uint64_t timestamp_us = 0;
+  };
+
+  FlipEventHandler(std::shared_ptr<State> state) : state_(state) {
+  }
+
+  void HandleEvent(uint64_t timestamp_us) override {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->flips++;
+    state_->timestamp_us = timestamp_us;
+    state_->cond.notify_all();
+  }
+  void HandlePanelEvent(uint64_t timestamp_us) override {
+  }
+
+ private:
+  std::shared_ptr<State> state_;
+};
+
+class VsyncRecorder : public VsyncCallback {
+ public:
+  void Callback(int display, int64_t timestamp) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timestamps_.push_back(timestamp);
+    cond_.notify_all();
+  }
+
+  std::vector<int64_t> WaitFor(size_t count, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                   [&] { return timestamps_.size() >= count; });
+    return timestamps_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<int64_t> timestamps_;
+};
+
+class FakeDrmTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    FakeDrmConfig config;
+    config.num_displays = 2;
+    FakeDrm::SetConfig(config);
+
+    drm_ = std::make_unique<DrmDevice>();
+    int ret, displays;
+    std::tie(ret, displays) = drm_->Init("fake", 0);
+    ASSERT_EQ(ret, 0);
+    ASSERT_EQ(displays, 2);
+    fake_ = FakeDrm::Get(drm_->fd());
+    ASSERT_NE(fake_, nullptr);
+
+    crtc_ = drm_->GetCrtcForDisplay(0);
+    connector_ = drm_->GetConnectorForDisplay(0);
+    ASSERT_NE(crtc_, nullptr);
+    ASSERT_NE(connector_, nullptr);
+    for (auto &plane : drm_->planes()) {
+      if (plane->GetCrtcSupported(*crtc_))
+        planes_.push_back(plane.get());
+      else
+        other_plane_ = plane.get();
+    }
+    ASSERT_FALSE(planes_.empty());
+    ASSERT_NE(other_plane_, nullptr);
+
+    req_ = drmModeAtomicAlloc();
+  }
+
+  void TearDown() override {
+    drmModeAtomicFree(req_);
+    if (buffer_ >= 0)
+      close(buffer_);
+    drm_.reset();
+  }
+
+  void Add(uint32_t object_id, const DrmProperty &property, uint64_t value) {
+    ASSERT_GT(drmModeAtomicAddProperty(req_, object_id, property.id(), value), 0);
+  }
+
+  int Commit(uint32_t flags, void *user_data = nullptr) {
+    int ret = drmModeAtomicCommit(drm_->fd(), req_, flags, user_data);
+    drmModeAtomicSetCursor(req_, 0);
+    return ret;
+  }
+
+  // Turns on display 0
+  void Modeset() {
+    ASSERT_EQ(connector_->UpdateModes(), 0);
+    ASSERT_FALSE(connector_->modes().empty());
+    const DrmMode &mode = connector_->modes()[0];
+    connector_->set_active_mode(mode);
+
+    struct drm_mode_modeinfo info;
+    mode.ToDrmModeModeInfo(&info);
+    uint32_t blob_id = 0;
+    ASSERT_EQ(drm_->CreatePropertyBlob(&info, sizeof(info), &blob_id), 0);
+
+    Add(crtc_->id(), crtc_->active_property(), 1);
+    Add(crtc_->id(), crtc_->mode_property(), blob_id);
+    Add(connector_->id(), connector_->crtc_id_property(), crtc_->id());
+    ASSERT_EQ(Commit(DRM_MODE_ATOMIC_ALLOW_MODESET), 0);
+  }
+
+  // Adds a framebuffer of a dmabuf, a memfd stands for it on the host
+  uint32_t AddFramebuffer() {
+    buffer_ = memfd_create("fakedrm-test", MFD_CLOEXEC);
+    EXPECT_GE(buffer_, 0);
+    uint32_t handle = 0;
+    EXPECT_EQ(drmPrimeFDToHandle(drm_->fd(), buffer_, &handle), 0);
+
+    uint32_t handles[4] = {handle, 0, 0, 0};
+    uint32_t pitches[4] = {1080 * 4, 0, 0, 0};
+    uint32_t offsets[4] = {0, 0, 0, 0};
+    uint64_t modifiers[4] = {0, 0, 0, 0};
+    uint32_t fb_id = 0;
+    EXPECT_EQ(drmModeAddFB2WithModifiers(drm_->fd(), 1080, 2400, DRM_FORMAT_ARGB8888,
+                                         handles, pitches, offsets, modifiers,
+                                         &fb_id, 0),
+              0);
+    return fb_id;
+  }
+
+  void AddPlane(const DrmPlane &plane, uint32_t fb_id, int in_fence) {
+    Add(plane.id(), plane.crtc_property(), crtc_->id());
+    Add(plane.id(), plane.fb_property(), fb_id);
+    Add(plane.id(), plane.crtc_w_property(), 1080);
+    Add(plane.id(), plane.crtc_h_property(), 2400);
+    Add(plane.id(), plane.src_w_property(), 1080 << 16);
+    Add(plane.id(), plane.src_h_property(), 2400 << 16);
+    Add(plane.id(), plane.in_fence_fd_property(), (uint64_t)(int64_t)in_fence);
+  }
+
+  std::unique_ptr<DrmDevice> drm_;
+  FakeDrm *fake_ = nullptr;
+  DrmCrtc *crtc_ = nullptr;
+  DrmConnector *connector_ = nullptr;
+  std::vector<DrmPlane *> planes_;
+  // A plane of the other crtc
+  DrmPlane *other_plane_ = nullptr;
+  drmModeAtomicReqPtr req_ = nullptr;
+  int buffer_ = -1;
+};
+
+TEST_F(FakeDrmTest, DeviceInit) {
+  EXPECT_EQ(drm_->crtcs().size(), 2u);
+  EXPECT_EQ(drm_->planes().size(), 8u);
+  EXPECT_TRUE(connector_->internal());
+  ASSERT_NE(drm_->GetConnectorForDisplay(1), nullptr);
+  EXPECT_TRUE(drm_->GetConnectorForDisplay(1)->external());
+  EXPECT_EQ(planes_.size(), 4u);
+  EXPECT_NE(planes_[0]->in_fence_fd_property().id(), 0u);
+  EXPECT_NE(crtc_->out_fence_ptr_property().id(), 0u);
+}
+
+TEST_F(FakeDrmTest, AtomicCommitValidation) {
+  uint32_t fb_id = AddFramebuffer();
+  const DrmPlane &plane = *planes_[0];
+
+  /* ACTIVE and MODE_ID change only in a modeset */
+  Add(crtc_->id(), crtc_->active_property(), 1);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_NONBLOCK), -EINVAL);
+
+  /* An unknown framebuffer */
+  Add(plane.id(), plane.crtc_property(), crtc_->id());
+  Add(plane.id(), plane.fb_property(), fb_id + 100);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_TEST_ONLY), -ENOENT);
+
+  /* A value out of the range */
+  Add(plane.id(), plane.alpha_property(), 0x10000);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_TEST_ONLY), -EINVAL);
+
+  /* A property of another object */
+  Add(crtc_->id(), plane.alpha_property(), 0xff);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_TEST_ONLY), -ENOENT);
+
+  /* A plane that can't be attached to the crtc */
+  Add(other_plane_->id(), other_plane_->crtc_property(), crtc_->id());
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_TEST_ONLY), -EINVAL);
+
+  /* A valid test commit doesn't flip */
+  Add(crtc_->id(), crtc_->active_property(), 1);
+  AddPlane(plane, fb_id, -1);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_TEST_ONLY | DRM_MODE_ATOMIC_ALLOW_MODESET), 0);
+
+  FakeDrmStats stats = fake_->stats();
+  EXPECT_EQ(stats.test_commits, 5u);
+  EXPECT_EQ(stats.failed_commits, 5u);
+  EXPECT_EQ(stats.flips, 0u);
+
+  /* A removed framebuffer can't be committed */
+  EXPECT_EQ(drmModeRmFB(drm_->fd(), fb_id), 0);
+  AddPlane(plane, fb_id, -1);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_TEST_ONLY), -ENOENT);
+}
+
+TEST_F(FakeDrmTest, OutFenceAndPageFlipEvent) {
+  Modeset();
+  uint32_t fb_id = AddFramebuffer();
+
+  auto state = std::make_shared<FlipEventHandler::State>();
+  int32_t out_fence = -1;
+  AddPlane(*planes_[0], fb_id, -1);
+  Add(crtc_->id(), crtc_->out_fence_ptr_property(), (uint64_t)(uintptr_t)&out_fence);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT,
+                   new FlipEventHandler(state)),
+            0);
+  ASSERT_GE(out_fence, 0);
+
+  /* The flip is pending until the next vblank */
+  AddPlane(*planes_[0], fb_id, -1);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_NONBLOCK), -EBUSY);
+
+  EXPECT_TRUE(IsSignaled(out_fence, kFrameMs * 3));
+  close(out_fence);
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  EXPECT_TRUE(state->cond.wait_for(lock, std::chrono::milliseconds(kFrameMs * 3),
+                                   [&] { return state->flips == 1; }));
+  EXPECT_GT(state->timestamp_us, 0u);
+  EXPECT_EQ(fake_->stats().busy_commits, 1u);
+}
+
+TEST_F(FakeDrmTest, InFenceGatesFlip) {
+  Modeset();
+  uint32_t fb_id = AddFramebuffer();
+
+  int in_fence = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ASSERT_GE(in_fence, 0);
+  int32_t out_fence = -1;
+  AddPlane(*planes_[0], fb_id, in_fence);
+  Add(crtc_->id(), crtc_->out_fence_ptr_property(), (uint64_t)(uintptr_t)&out_fence);
+  EXPECT_EQ(Commit(DRM_MODE_ATOMIC_NONBLOCK), 0);
+  ASSERT_GE(out_fence, 0);
+
+  /* The commit holds its own reference of the in-fence */
+  int fence = dup(in_fence);
+  close(in_fence);
+
+  EXPECT_FALSE(IsSignaled(out_fence, kFrameMs * 4));
+  EXPECT_GE(fake_->stats().late_flips, 1u);
+  EXPECT_EQ(fake_->stats().flips, 1u);
+
+  Signal(fence);
+  EXPECT_TRUE(IsSignaled(out_fence, kFrameMs * 3));
+  EXPECT_EQ(fake_->stats().flips, 2u);
+  close(fence);
+  close(out_fence);
+}
+
+TEST_F(FakeDrmTest, VSyncWorkerDeliversVBlanks) {
+  Modeset();
+
+  VsyncRecorder recorder;
+  VSyncWorker worker;
+  ASSERT_EQ(worker.Init(drm_.get(), 0), 0);
+  worker.RegisterCallback(&recorder);
+  worker.VSyncControl(true);
+
+  std::vector<int64_t> timestamps = recorder.WaitFor(4, kFrameMs * 10);
+  worker.VSyncControl(false);
+  ASSERT_GE(timestamps.size(), 4u);
+  const int64_t period = 1000000000LL / 60;
+  for (size_t i = 1; i < timestamps.size(); i++) {
+    int64_t interval = timestamps[i] - timestamps[i - 1];
+    /* A vblank can be missed while the next one is requested */
+    int64_t frames = (interval + period / 2) / period;
+    EXPECT_GE(frames, 1) << "vsync " << i;
+    /* The event has the timestamp in microseconds */
+    EXPECT_NEAR(interval, frames * period, 1000) << "vsync " << i;
+  }
+  EXPECT_GE(fake_->stats().vblank_events, 4u);
+}
+
+TEST_F(FakeDrmTest, VSyncWorkerDestroyedWithPendingVBlank) {
+  Modeset();
+
+  VsyncRecorder stale;
+  std::unique_ptr<VSyncWorker> worker = std::make_unique<VSyncWorker>();
+  ASSERT_EQ(worker->Init(drm_.get(), 0), 0);
+  worker->RegisterCallback(&stale);
+  worker->VSyncControl(true);
+  ASSERT_FALSE(stale.WaitFor(1, kFrameMs * 4).empty());
+  /* The next vblank is requested right after the vsync is delivered */
+  worker.reset();
+
+  /* The new worker can be allocated at the address of the destroyed one */
+  VsyncRecorder recorder;
+  worker = std::make_unique<VSyncWorker>();
+  ASSERT_EQ(worker->Init(drm_.get(), 0), 0);
+  worker->RegisterCallback(&recorder);
+  worker->VSyncControl(true);
+  EXPECT_GE(recorder.WaitFor(2, kFrameMs * 10).size(), 2u);
+  worker->VSyncControl(false);
+}
+
+TEST_F(FakeDrmTest, VSyncWorkerWithoutInit) {
+  /* Virtual displays don't initialize their worker */
+  VsyncRecorder recorder;
+  VSyncWorker worker;
+  worker.RegisterCallback(&recorder);
+  worker.VSyncControl(true);
+  EXPECT_TRUE(recorder.WaitFor(1, kFrameMs * 2).empty());
+  worker.VSyncControl(false);
+}
+
+TEST_F(FakeDrmTest, InjectedCommitFailures) {
+  Modeset();
+  uint32_t fb_id = AddFramebuffer();
+
+  FakeDrmConfig config;
+  config.fail_commit_interval = 2;
+  fake_->SetFailures(config);
+
+  AddPlane(*planes_[0], fb_id, -1);
+  EXPECT_EQ(Commit(0), 0);
+  AddPlane(*planes_[0], fb_id, -1);
+  EXPECT_EQ(Commit(0), -EINVAL);
+  AddPlane(*planes_[0], fb_id, -1);
+  EXPECT_EQ(Commit(0), 0);
+}
+}  // namespace android
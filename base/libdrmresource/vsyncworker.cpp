@@ -18,50 +18,103 @@
 
 #include "vsyncworker.h"
 #include "drmdevice.h"
-#include "worker.h"
+#include "drmeventlistener.h"
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <time.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <map>
 
+#include <cutils/properties.h>
 #include <hardware/hardware.h>
 #include <log/log.h>
 
 namespace android {
 
+static const int64_t kOneSecondNs = 1LL * 1000 * 1000 * 1000;
+
 VSyncWorker::VSyncWorker()
-    : Worker("vsync", HAL_PRIORITY_URGENT_DISPLAY),
-      drm_(NULL),
+    : drm_(NULL),
       display_(-1),
+      pipe_(-1),
       enabled_(false),
       last_timestamp_(-1) {
 }
 
 VSyncWorker::~VSyncWorker() {
+  if (drm_)
+    drm_->event_listener()->UnRegisterVSyncWorker(this);
 }
 
 int VSyncWorker::Init(DrmDevice *drm, int display) {
+  DrmCrtc *crtc = drm->GetCrtcForDisplay(display);
+  if (!crtc) {
+    ALOGE("Failed to get crtc for display %d", display);
+    return -ENODEV;
+  }
+
   drm_ = drm;
   display_ = display;
+  pipe_ = crtc->pipe();
+  sw_vsync_allowed_ = property_get_bool("vendor.hwc.drm.sw_vsync", false);
 
-  return InitWorker();
+  drm_->event_listener()->RegisterVSyncWorker(this);
+  return 0;
 }
 
 void VSyncWorker::RegisterCallback(VsyncCallback* callback) {
-  Lock();
+  /* Init() is not called for virtual displays, no vsync is delivered */
+  if (!drm_) {
+    callback_ = callback;
+    return;
+  }
+
+  DrmEventListener *listener = drm_->event_listener();
+  listener->Lock();
   callback_ = callback;
-  Unlock();
+  listener->Unlock();
 }
 
 void VSyncWorker::VSyncControl(bool enabled) {
-  Lock();
+  if (!drm_) {
+    enabled_ = enabled;
+    return;
+  }
+
+  DrmEventListener *listener = drm_->event_listener();
+  listener->Lock();
   enabled_ = enabled;
   last_timestamp_ = -1;
-  Unlock();
+  synthetic_timestamp_ = -1;
+  ResetModel();
+  listener->Unlock();
+
+  listener->Wake();
+}
 
-  Signal();
+void VSyncWorker::ResetModel() {
+  if (software_)
+    ALOGI("display %d: leave software vsync", display_);
+  software_ = false;
+  resync_ = false;
+  period_ = 0;
+  anchor_ = -1;
+  frames_ = 0;
+  steady_frames_ = 0;
+}
+
+int64_t VSyncWorker::GetPeriod() const {
+  float refresh = 60.0f;  // Default to 60Hz refresh rate
+  DrmConnector *conn = drm_->GetConnectorForDisplay(display_);
+  if (conn && conn->active_mode().v_refresh() != 0.0f)
+    refresh = conn->active_mode().v_refresh();
+  else
+    ALOGW("Vsync worker active with conn=%p refresh=%f\n", conn,
+          conn ? conn->active_mode().v_refresh() : 0.0f);
+
+  return kOneSecondNs / refresh;
 }
 
 /*
@@ -77,7 +130,7 @@ void VSyncWorker::VSyncControl(bool enabled) {
  *  Thus, we must sleep until timestamp 687 to maintain phase with the last
  *  timestamp.
  */
-int64_t VSyncWorker::GetPhasedVSync(int64_t frame_ns, int64_t current) {
+int64_t VSyncWorker::GetPhasedVSync(int64_t frame_ns, int64_t current) const {
   if (last_timestamp_ < 0)
     return current + frame_ns;
 
@@ -85,108 +138,108 @@ int64_t VSyncWorker::GetPhasedVSync(int64_t frame_ns, int64_t current) {
          last_timestamp_;
 }
 
-static const int64_t kOneSecondNs = 1LL * 1000 * 1000 * 1000;
+bool VSyncWorker::NeedsVBlankEvent() const {
+  if (!enabled_ || event_pending_ || (synthetic_timestamp_ >= 0))
+    return false;
 
-int VSyncWorker::SyntheticWaitVBlank(int64_t *timestamp) {
-  struct timespec vsync;
-  int ret = clock_gettime(CLOCK_MONOTONIC, &vsync);
+  return !software_ || resync_;
+}
 
-  float refresh = 60.0f;  // Default to 60Hz refresh rate
-  DrmConnector *conn = drm_->GetConnectorForDisplay(display_);
-  if (conn && conn->active_mode().v_refresh() != 0.0f)
-    refresh = conn->active_mode().v_refresh();
-  else
-    ALOGW("Vsync worker active with conn=%p refresh=%f\n", conn,
-          conn ? conn->active_mode().v_refresh() : 0.0f);
+void VSyncWorker::SetVBlankEventPending(bool pending) {
+  event_pending_ = pending;
+}
 
-  int64_t phased_timestamp = GetPhasedVSync(kOneSecondNs / refresh,
-                                            vsync.tv_sec * kOneSecondNs +
-                                                vsync.tv_nsec);
-  vsync.tv_sec = phased_timestamp / kOneSecondNs;
-  vsync.tv_nsec = phased_timestamp - (vsync.tv_sec * kOneSecondNs);
-  do {
-    ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &vsync, NULL);
-  } while (ret == -1 && errno == EINTR);
-  if (ret)
-    return ret;
-
-  *timestamp = (int64_t)vsync.tv_sec * kOneSecondNs + (int64_t)vsync.tv_nsec;
-  return 0;
+void VSyncWorker::HandleVBlankEventFailure(int64_t now) {
+  /* The crtc is off or doesn't support vblank events, make up the vsync */
+  if (software_)
+    ResetModel();
+  synthetic_timestamp_ = GetPhasedVSync(GetPeriod(), now);
 }
 
-void VSyncWorker::Routine() {
-  int ret;
+void VSyncWorker::HandleVBlank(int64_t timestamp, std::vector<int64_t> &vsyncs) {
+  event_pending_ = false;
+  if (!enabled_)
+    return;
 
-  Lock();
-  if (!enabled_) {
-    ret = WaitForSignalOrExitLocked();
-    if (ret == -EINTR) {
-      Unlock();
-      return;
+  int64_t period = GetPeriod();
+  if (period != period_) {
+    ResetModel();
+    period_ = period;
+  }
+
+  if (anchor_ >= 0) {
+    int64_t frames = (timestamp - anchor_ + period / 2) / period;
+    int64_t error = timestamp - (anchor_ + frames * period);
+    if (error < 0)
+      error = -error;
+
+    if (error > kToleranceNs) {
+      if (software_)
+        ALOGI("display %d: vsync is off by %" PRId64 "ns from the model", display_, error);
+      ResetModel();
+      period_ = period;
+    } else if (!software_ && (++steady_frames_ >= kSteadyFrames) && sw_vsync_allowed_) {
+      ALOGI("display %d: enter software vsync, period %" PRId64 "ns", display_, period);
+      software_ = true;
     }
   }
 
-  int display = display_;
-  VsyncCallback* callback(callback_);
-  Unlock();
+  anchor_ = timestamp;
+  frames_ = 0;
+  resync_ = false;
 
-  DrmCrtc *crtc = drm_->GetCrtcForDisplay(display);
-  if (!crtc) {
-    ALOGE("Failed to get crtc for display");
-    return;
+  if (timestamp > last_timestamp_) {
+    vsyncs.push_back(timestamp);
+    last_timestamp_ = timestamp;
   }
-  uint32_t high_crtc = (crtc->pipe() << DRM_VBLANK_HIGH_CRTC_SHIFT);
+}
+
+int64_t VSyncWorker::NextSoftwareVSync() const {
+  if (!enabled_)
+    return -1;
+
+  if (synthetic_timestamp_ >= 0)
+    return synthetic_timestamp_;
 
-  drmVBlank vblank;
-  memset(&vblank, 0, sizeof(vblank));
-  vblank.request.type = (drmVBlankSeqType)(
-      DRM_VBLANK_RELATIVE | (high_crtc & DRM_VBLANK_HIGH_CRTC_MASK));
-  vblank.request.sequence = 1;
+  /* The vblank event of resync delivers the vsync */
+  if (!software_ || event_pending_)
+    return -1;
 
-  int64_t timestamp;
-  ret = drmWaitVBlank(drm_->fd(), &vblank);
-  if (ret == -EINTR) {
+  return anchor_ + (frames_ + 1) * period_;
+}
+
+void VSyncWorker::HandleSoftwareVSync(int64_t now, std::vector<int64_t> &vsyncs) {
+  int64_t timestamp = NextSoftwareVSync();
+  if ((timestamp < 0) || (now < timestamp))
     return;
-  } else if (ret) {
-    ret = SyntheticWaitVBlank(&timestamp);
-    if (ret)
-      return;
+
+  if (synthetic_timestamp_ >= 0) {
+    synthetic_timestamp_ = -1;
   } else {
-    timestamp = (int64_t)vblank.reply.tval_sec * kOneSecondNs +
-                (int64_t)vblank.reply.tval_usec * 1000;
+    /* Skip the vsyncs that have been missed */
+    frames_ = (now - anchor_) / period_;
+    timestamp = anchor_ + frames_ * period_;
+    if (frames_ >= kResyncFrames)
+      resync_ = true;
   }
 
+  if (timestamp > last_timestamp_) {
+    vsyncs.push_back(timestamp);
+    last_timestamp_ = timestamp;
+  }
+}
+
+void VSyncWorker::Deliver(int64_t timestamp) {
   /*
-   * VSync could be disabled during routine execution so it could potentially
-   * lead to crash since callback's inner hook could be invalid anymore. We have
-   * no control over lifetime of this hook, therefore we can't rely that it'll
-   * be valid after vsync disabling.
-   *
-   * Blocking VSyncControl to wait until routine
-   * will finish execution is logically correct way to fix this issue, but it
-   * creates visible lags and stutters, so we have to resort to other ways of
-   * mitigating this issue.
-   *
+   * VSync could be disabled after the vsync has been generated.
+   * The callback's inner hook may not be valid anymore after vsync disabling.
    * Doing check before attempt to invoke callback drastically shortens the
-   * window when such situation could happen and that allows us to practically
-   * avoid this issue.
-   *
-   * Please note that issue described below is different one and it is related
-   * to RegisterCallback, not to disabling vsync via VSyncControl.
+   * window when such situation could happen.
    */
   if (!enabled_)
     return;
-  /*
-   * There's a race here where a change in callback_ will not take effect until
-   * the next subsequent requested vsync. This is unavoidable since we can't
-   * call the vsync hook while holding the thread lock.
-   *
-   * We could shorten the race window by caching callback_ right before calling
-   * the hook. However, in practice, callback_ is only updated once, so it's not
-   * worth the overhead.
-   */
-  if (callback)
-    callback->Callback(display, timestamp);
-  last_timestamp_ = timestamp;
+
+  if (callback_)
+    callback_->Callback(display_, timestamp);
 }
 }  // namespace android
@@ -18,10 +18,11 @@
 #define ANDROID_EVENT_WORKER_H_
 
 #include "drmdevice.h"
-#include "worker.h"
 
 #include <stdint.h>
+#include <atomic>
 #include <map>
+#include <vector>
 
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
@@ -35,30 +36,70 @@ class VsyncCallback {
   virtual void Callback(int display, int64_t timestamp) = 0;
 };
 
-class VSyncWorker : public Worker {
+/*
+ * VSyncWorker tracks the vsync of a display. It doesn't own a thread, the
+ * DrmEventListener of the device requests vblank events for it and delivers
+ * the callbacks from its event loop.
+ *
+ * If the software vsync model is enabled (vendor.hwc.drm.sw_vsync), the
+ * worker stops requesting vblank events once kSteadyFrames vblanks in a row
+ * have been within kToleranceNs of the prediction, and generates the vsyncs
+ * from the last vblank and the refresh period of the active mode. It requests
+ * a vblank every kResyncFrames to check the prediction and goes back to
+ * vblank events if the error exceeds kToleranceNs or the mode changes.
+ */
+class VSyncWorker {
  public:
   VSyncWorker();
-  ~VSyncWorker() override;
+  ~VSyncWorker();
 
   int Init(DrmDevice *drm, int display);
   void RegisterCallback(VsyncCallback* callback);
 
   void VSyncControl(bool enabled);
 
- protected:
-  void Routine() override;
-
  private:
-  int64_t GetPhasedVSync(int64_t frame_ns, int64_t current);
-  int SyntheticWaitVBlank(int64_t *timestamp);
+  friend class DrmEventListener;
+
+  static const uint32_t kSteadyFrames = 120;
+  static const uint32_t kResyncFrames = 300;
+  static const int64_t kToleranceNs = 200 * 1000;
+
+  /* These are called by DrmEventListener with the listener lock held */
+  bool NeedsVBlankEvent() const;
+  void SetVBlankEventPending(bool pending);
+  void HandleVBlankEventFailure(int64_t now);
+  void HandleVBlank(int64_t timestamp, std::vector<int64_t> &vsyncs);
+  /* Returns the time of the next software vsync or -1 if there is none */
+  int64_t NextSoftwareVSync() const;
+  void HandleSoftwareVSync(int64_t now, std::vector<int64_t> &vsyncs);
+  /* Called by DrmEventListener without the listener lock */
+  void Deliver(int64_t timestamp);
+
+  int64_t GetPeriod() const;
+  int64_t GetPhasedVSync(int64_t frame_ns, int64_t current) const;
+  void ResetModel();
 
   DrmDevice *drm_;
 
   VsyncCallback* callback_ = NULL;
 
   int display_;
+  int pipe_;
   std::atomic_bool enabled_;
   int64_t last_timestamp_;
+
+  bool sw_vsync_allowed_ = false;
+  bool event_pending_ = false;
+  /* the time of a synthetic vsync after a vblank request failed */
+  int64_t synthetic_timestamp_ = -1;
+  /* software vsync model */
+  bool software_ = false;
+  bool resync_ = false;
+  int64_t period_ = 0;
+  int64_t anchor_ = -1;
+  uint32_t frames_ = 0;
+  uint32_t steady_frames_ = 0;
 };
 }  // namespace android
 
@@ -73,12 +73,15 @@ LOCAL_SRC_FILES := \
 	device/ExynosDeviceFbInterface.cpp \
 	device/ExynosDeviceInterface.cpp \
 	device/ExynosResourceManager.cpp \
+	display/ExynosDamageRegion.cpp \
 	display/ExynosDisplay.cpp \
 	display/ExynosDisplayDrmInterface.cpp \
 	display/ExynosDrmFramebufferManager.cpp \
 	display/ExynosDisplayFbInterface.cpp \
 	display/ExynosDisplayInterface.cpp \
 	display/ExynosLayer.cpp \
+	display/ExynosLayerDump.cpp \
+	display/ExynosVsyncModel.cpp \
 	primarydisplay/ExynosPrimaryDisplay.cpp \
 	primarydisplay/ExynosPrimaryDisplayFbInterface.cpp \
 	externaldisplay/ExynosExternalDisplay.cpp \
@@ -86,6 +89,7 @@ LOCAL_SRC_FILES := \
 	virtualdisplay/ExynosVirtualDisplay.cpp \
 	virtualdisplay/ExynosVirtualDisplayFbInterface.cpp \
 	resources/ExynosMPP.cpp \
+	resources/ExynosMPPBufferPool.cpp \
 	utils/ExynosFenceTracer.cpp \
 	utils/ExynosHWCDebug.cpp \
 	utils/ExynosHWCFormat.cpp \
@@ -28,6 +28,7 @@
 #include "ExynosVirtualDisplayModule.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosMPPBufferPool.h"
 #include "ExynosDeviceFbInterface.h"
 #include "ExynosDeviceDrmInterface.h"
 #include <sync/sync.h>
@@ -242,10 +243,10 @@ ExynosDevice::ExynosDevice()
 #endif
 
     if (mInterfaceType == INTERFACE_TYPE_DRM) {
-        for (uint32_t i = 0; i < mResourceManager->getM2mMPPSize(); i++) {
-            mResourceManager->getM2mMPP(i)->registerBufDestoryedCallback(
-                [=](const uint64_t &bufferId) { ExynosDisplayInterface::removeBuffer(bufferId); });
-        }
+        ExynosMPPBufferPool::getInstance().registerBufDestroyedCallback(
+            [=](buffer_handle_t handle) {
+                ExynosDisplayInterface::removeBuffer(ExynosGraphicBufferMeta::get_buffer_id(handle));
+            });
     }
 
     mResourceManager->initDisplaysTDMInfo();
@@ -680,6 +681,11 @@ void ExynosDevice::dump(uint32_t *outSize, char *outBuffer) {
             display->dump(result);
     }
 
+    ExynosMPPBufferPool::getInstance().dump(result);
+
+    if (mDeviceInterface != nullptr)
+        mDeviceInterface->dump(result);
+
     if (outBuffer == NULL) {
         *outSize = (uint32_t)result.length();
     } else {
@@ -1999,6 +2005,8 @@ int32_t ExynosDevice::setLayerBuffer(ExynosDisplay *display,
 
     int32_t ret = exynosLayer->setLayerBuffer(buffer, acquireFence,
                                               mGeometryChanged);
+    if (ret == HWC2_ERROR_NONE)
+        display->prepareLayerBuffer(*exynosLayer);
     return ret;
 }
 
@@ -2046,6 +2054,76 @@ int32_t ExynosDevice::setLayerZOrder(ExynosLayer *layer, uint32_t z) {
     return ret;
 }
 
+void ExynosDevice::setLayerProperties(ExynosDisplay *display,
+                                      const std::vector<ExynosLayerProperties> &layers,
+                                      std::vector<int32_t> &outErrors) {
+    Mutex::Autolock lock(mMutex);
+    uint64_t geometryFlag = 0;
+    bool hiberExitRequested = false;
+    bool renderingStateCleared = false;
+
+    outErrors.assign(layers.size(), HWC2_ERROR_NONE);
+    for (size_t i = 0; i < layers.size(); i++) {
+        const ExynosLayerProperties &props = layers[i];
+        ExynosLayer *exynosLayer = display->checkLayer(props.layer);
+        if (exynosLayer == nullptr) {
+            outErrors[i] = HWC2_ERROR_BAD_LAYER;
+            continue;
+        }
+
+        int32_t &err = outErrors[i];
+        auto apply = [&err](int32_t ret) {
+            if (err == HWC2_ERROR_NONE)
+                err = ret;
+        };
+
+        bool bufferSet = false;
+        if (props.hasBuffer) {
+            if (!hiberExitRequested) {
+                display->requestHiberExit();
+                hiberExitRequested = true;
+            }
+            int32_t ret = exynosLayer->setLayerBuffer(display->mPlugState ? props.buffer : NULL,
+                                                      props.acquireFence, geometryFlag);
+            bufferSet = (ret == HWC2_ERROR_NONE);
+            apply(ret);
+        }
+        if (props.surfaceDamage)
+            apply(exynosLayer->setLayerSurfaceDamage(*props.surfaceDamage));
+        if (props.blendMode)
+            apply(exynosLayer->setLayerBlendMode(*props.blendMode, geometryFlag));
+        if (props.color)
+            apply(exynosLayer->setLayerColor(*props.color));
+        if (props.compositionType)
+            apply(exynosLayer->setLayerCompositionType(*props.compositionType, geometryFlag));
+        if (props.dataspace)
+            apply(exynosLayer->setLayerDataspace(*props.dataspace, geometryFlag));
+        if (props.displayFrame) {
+            if (!renderingStateCleared) {
+                clearRenderingStateFlags();
+                renderingStateCleared = true;
+            }
+            apply(exynosLayer->setLayerDisplayFrame(*props.displayFrame, geometryFlag));
+        }
+        if (props.planeAlpha)
+            apply(exynosLayer->setLayerPlaneAlpha(*props.planeAlpha));
+        if (props.sourceCrop)
+            apply(exynosLayer->setLayerSourceCrop(*props.sourceCrop, geometryFlag));
+        if (props.transform)
+            apply(exynosLayer->setLayerTransform(*props.transform, geometryFlag));
+        if (props.visibleRegion)
+            apply(exynosLayer->setLayerVisibleRegion(*props.visibleRegion));
+        if (props.zOrder)
+            apply(exynosLayer->setLayerZOrder(*props.zOrder, geometryFlag));
+
+        /* Same as setLayerBuffer, once the rest of the layer is applied */
+        if (bufferSet)
+            display->prepareLayerBuffer(*exynosLayer);
+    }
+
+    mGeometryChanged |= geometryFlag;
+}
+
 int32_t ExynosDevice::setColorMode(ExynosDisplay *display, int32_t mode) {
     Mutex::Autolock lock(mMutex);
     return display->setColorMode(mode, mCanProcessWCG, mGeometryChanged);
@@ -342,6 +342,13 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     int32_t setLayerTransform(ExynosLayer *layer,
                               int32_t /*hwc_transform_t*/ transform);
     int32_t setLayerZOrder(ExynosLayer *layer, uint32_t z);
+    /*
+     * Sets the properties of the layers of @display with one lock.
+     * @outErrors gets the first error of each layer.
+     */
+    void setLayerProperties(ExynosDisplay *display,
+                            const std::vector<ExynosLayerProperties> &layers,
+                            std::vector<int32_t> &outErrors);
     int32_t printMppsAttr();
     void resetForDestroyClient();
 
@@ -47,6 +47,7 @@ class ExynosDeviceInterface {
     /* This function must be implemented in abstracted class */
     virtual int32_t getRestrictions(struct dpp_restrictions_info_v2 *&restrictions, uint32_t otfMPPSize) = 0;
     virtual void setPrimaryDisplayFd(int32_t displayFd){};
+    virtual void dump(String8 __unused &result){};
 
   protected:
     /* Print restriction */
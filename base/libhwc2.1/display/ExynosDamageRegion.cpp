@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <algorithm>
+#include "ExynosDamageRegion.h"
+
+static inline bool isEmptyRect(const hwc_rect_t &r) {
+    return (r.left >= r.right) || (r.top >= r.bottom);
+}
+
+static inline uint64_t rectArea(const hwc_rect_t &r) {
+    if (isEmptyRect(r))
+        return 0;
+    return (uint64_t)(r.right - r.left) * (uint64_t)(r.bottom - r.top);
+}
+
+static inline hwc_rect_t unionRect(const hwc_rect_t &r1, const hwc_rect_t &r2) {
+    return {std::min(r1.left, r2.left), std::min(r1.top, r2.top),
+            std::max(r1.right, r2.right), std::max(r1.bottom, r2.bottom)};
+}
+
+static inline hwc_rect_t intersectRect(const hwc_rect_t &r1, const hwc_rect_t &r2) {
+    return {std::max(r1.left, r2.left), std::max(r1.top, r2.top),
+            std::min(r1.right, r2.right), std::min(r1.bottom, r2.bottom)};
+}
+
+static inline bool containsRect(const hwc_rect_t &outer, const hwc_rect_t &inner) {
+    return (outer.left <= inner.left) && (outer.top <= inner.top) &&
+           (outer.right >= inner.right) && (outer.bottom >= inner.bottom);
+}
+
+void ExynosDamageRegion::clear(uint32_t xres, uint32_t yres) {
+    mXres = xres;
+    mYres = yres;
+    mNumRects = 0;
+}
+
+void ExynosDamageRegion::removeRect(size_t index) {
+    mRects[index] = mRects[mNumRects - 1];
+    mNumRects--;
+}
+
+void ExynosDamageRegion::add(const hwc_rect_t &rect) {
+    hwc_rect_t pending = intersectRect(rect, {0, 0, (int)mXres, (int)mYres});
+    if (isEmptyRect(pending))
+        return;
+
+    while (true) {
+        bool merged = false;
+        for (size_t i = 0; i < mNumRects; i++) {
+            if (containsRect(mRects[i], pending))
+                return;
+            if (!isEmptyRect(intersectRect(mRects[i], pending))) {
+                /* The bounds of the two can overlap other rects, so start over */
+                pending = unionRect(mRects[i], pending);
+                removeRect(i);
+                merged = true;
+                break;
+            }
+        }
+        if (merged)
+            continue;
+
+        if (mNumRects < MAX_RECTS) {
+            mRects[mNumRects++] = pending;
+            return;
+        }
+
+        /* Merge the pending rect with the rect that grows the least */
+        size_t best = 0;
+        uint64_t bestGrowth = UINT64_MAX;
+        for (size_t i = 0; i < mNumRects; i++) {
+            uint64_t growth = rectArea(unionRect(mRects[i], pending)) -
+                    rectArea(mRects[i]) - rectArea(pending);
+            if (growth < bestGrowth) {
+                bestGrowth = growth;
+                best = i;
+            }
+        }
+        pending = unionRect(mRects[best], pending);
+        removeRect(best);
+    }
+}
+
+hwc_rect_t ExynosDamageRegion::getBounds() const {
+    hwc_rect_t bounds = {(int)mXres, (int)mYres, 0, 0};
+    for (size_t i = 0; i < mNumRects; i++)
+        bounds = unionRect(bounds, mRects[i]);
+    return bounds;
+}
+
+uint64_t ExynosDamageRegion::getArea() const {
+    uint64_t area = 0;
+    /* The rects are disjoint */
+    for (size_t i = 0; i < mNumRects; i++)
+        area += rectArea(mRects[i]);
+    return area;
+}
+
+hwc_rect_t ExynosDamageRegion::alignRect(const hwc_rect_t &rect, const UpdateCost &cost) const {
+    int32_t alignW = std::max(cost.alignWidth, 1U);
+    int32_t alignH = std::max(cost.alignHeight, 1U);
+    hwc_rect_t aligned = rect;
+
+    aligned.left = std::max(aligned.left - aligned.left % alignW, 0);
+    aligned.top = std::max(aligned.top - aligned.top % alignH, 0);
+    if (aligned.right % alignW)
+        aligned.right += alignW - aligned.right % alignW;
+    if (aligned.bottom % alignH)
+        aligned.bottom += alignH - aligned.bottom % alignH;
+    aligned.right = std::min(aligned.right, (int)mXres);
+    aligned.bottom = std::min(aligned.bottom, (int)mYres);
+
+    /* Grow a small rect to the right and bottom, or the left and top at the edges */
+    if (aligned.right - aligned.left < (int)cost.minWidth) {
+        aligned.right = std::min(aligned.left + (int)cost.minWidth, (int)mXres);
+        aligned.left = std::max(aligned.right - (int)cost.minWidth, 0);
+    }
+    if (aligned.bottom - aligned.top < (int)cost.minHeight) {
+        aligned.bottom = std::min(aligned.top + (int)cost.minHeight, (int)mYres);
+        aligned.top = std::max(aligned.bottom - (int)cost.minHeight, 0);
+    }
+
+    return aligned;
+}
+
+uint64_t ExynosDamageRegion::getFrameBytes(const hwc_rect_t &update, const UpdateCost &cost,
+                                           const std::vector<Plane> &planes) const {
+    uint64_t bits = rectArea(update) * cost.outputBpp;
+    for (auto &plane : planes)
+        bits += rectArea(intersectRect(plane.frame, update)) * plane.bpp;
+    return bits / 8;
+}
+
+bool ExynosDamageRegion::getUpdateRect(const UpdateCost &cost, const std::vector<Plane> &planes,
+                                       hwc_rect_t &outRect) {
+    hwc_rect_t full = {0, 0, (int)mXres, (int)mYres};
+    uint64_t fullBytes = getFrameBytes(full, cost, planes);
+    mFullBytes += fullBytes;
+    outRect = full;
+
+    if (isEmpty()) {
+        mFullFrames++;
+        mUpdatedPixels += rectArea(full);
+        return false;
+    }
+
+    hwc_rect_t aligned = alignRect(getBounds(), cost);
+    uint64_t partialBytes = getFrameBytes(aligned, cost, planes) + cost.overhead;
+    mDamagedPixels += getArea();
+    if (partialBytes >= fullBytes) {
+        mFullFrames++;
+        mUpdatedPixels += rectArea(full);
+        return false;
+    }
+
+    mPartialFrames++;
+    mUpdatedPixels += rectArea(aligned);
+    mSavedBytes += fullBytes - partialBytes;
+    outRect = aligned;
+    return true;
+}
+
+void ExynosDamageRegion::dump(String8 &result) const {
+    result.appendFormat("Damage region: partial frames(%" PRIu64 "), full frames(%" PRIu64 ")",
+                        mPartialFrames, mFullFrames);
+    if (mUpdatedPixels)
+        result.appendFormat(", damaged/updated pixels(%.1f%%)",
+                            mDamagedPixels * 100.0 / mUpdatedPixels);
+    if (mFullBytes)
+        result.appendFormat(", saved bytes(%" PRIu64 " KB, %.1f%%)", mSavedBytes / 1024,
+                            mSavedBytes * 100.0 / mFullBytes);
+    result.appendFormat("\n");
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSDAMAGEREGION_H
+#define _EXYNOSDAMAGEREGION_H
+
+#include <hardware/hwcomposer_defs.h>
+#include <utils/String8.h>
+#include <array>
+#include <vector>
+
+using namespace android;
+
+/*
+ * ExynosDamageRegion collects the damage of a frame as up to MAX_RECTS
+ * disjoint rects instead of folding it into one rect. A new rect that
+ * overlaps a collected rect is merged with it, and when the set is full
+ * the pair that grows the least is merged.
+ *
+ * The DPU takes a single partial region, so getUpdateRect() reduces the
+ * region to its bounds aligned to the DPU restrictions and compares the
+ * bytes of that partial frame with the bytes of a full frame. A frame
+ * costs the fetch of every plane in the update rect plus the output to
+ * the panel, and a partial frame costs UpdateCost::overhead on top of it.
+ * The damaged pixels of the rects are counted against the updated pixels
+ * in the statistics, which are kept across clear().
+ */
+class ExynosDamageRegion {
+  public:
+    static constexpr size_t MAX_RECTS = 8;
+
+    struct UpdateCost {
+        /* The partial region is aligned to these, e.g. the DSC slice size */
+        uint32_t alignWidth = 1;
+        uint32_t alignHeight = 1;
+        uint32_t minWidth = 0;
+        uint32_t minHeight = 0;
+        /* Bits per pixel of the output to the panel */
+        uint32_t outputBpp = 24;
+        /* Fixed bytes of a partial frame: region setup and panel address commands */
+        uint64_t overhead = 0;
+    };
+
+    /* A plane fetched by the DPU. @bpp is in bits per pixel, 0 for a color fill */
+    struct Plane {
+        hwc_rect_t frame;
+        uint32_t bpp;
+    };
+
+    void clear(uint32_t xres, uint32_t yres);
+    /* The rect is clipped to the display */
+    void add(const hwc_rect_t &rect);
+    void addFull() { add({0, 0, (int)mXres, (int)mYres}); };
+
+    bool isEmpty() const { return mNumRects == 0; };
+    size_t getNumRects() const { return mNumRects; };
+    const hwc_rect_t &getRect(size_t index) const { return mRects[index]; };
+    /* Returns {xres, yres, 0, 0} if the region is empty */
+    hwc_rect_t getBounds() const;
+    /* The number of damaged pixels */
+    uint64_t getArea() const;
+
+    hwc_rect_t alignRect(const hwc_rect_t &rect, const UpdateCost &cost) const;
+    uint64_t getFrameBytes(const hwc_rect_t &update, const UpdateCost &cost,
+                           const std::vector<Plane> &planes) const;
+    /*
+     * Sets @outRect to the aligned bounds of the region and returns true if
+     * the partial frame costs less than a full frame. Returns false if the
+     * region is empty or a full update is cheaper.
+     */
+    bool getUpdateRect(const UpdateCost &cost, const std::vector<Plane> &planes,
+                       hwc_rect_t &outRect);
+
+    void dump(String8 &result) const;
+
+  private:
+    void removeRect(size_t index);
+
+    uint32_t mXres = 0;
+    uint32_t mYres = 0;
+    std::array<hwc_rect_t, MAX_RECTS> mRects;
+    size_t mNumRects = 0;
+
+    /* statistics */
+    uint64_t mPartialFrames = 0;
+    uint64_t mFullFrames = 0;
+    uint64_t mDamagedPixels = 0;
+    uint64_t mUpdatedPixels = 0;
+    uint64_t mFullBytes = 0;
+    uint64_t mSavedBytes = 0;
+};
+
+#endif  // _EXYNOSDAMAGEREGION_H
@@ -23,10 +23,12 @@
 #include <android/sync.h>
 #include <cmath>
 
+#include <algorithm>
 #include <map>
 #include "ExynosDisplay.h"
 #include "ExynosExternalDisplay.h"
 #include "ExynosLayer.h"
+#include "ExynosMPPBufferPool.h"
 #include "exynos_format.h"
 #include "ExynosFenceTracer.h"
 #include "TraceUtils.h"
@@ -440,7 +442,7 @@ void ExynosDisplay::initCompositionInfo(ExynosCompositionInfo &compositionInfo)
 int32_t ExynosDisplay::destroyLayer(hwc2_layer_t outLayer,
                                     uint64_t &geometryFlag) {
     Mutex::Autolock lock(mDRMutex);
-    if ((ExynosLayer *)outLayer == NULL)
+    if (mLayerHandles.erase((ExynosLayer *)outLayer) == 0)
         return HWC2_ERROR_BAD_LAYER;
 
     mLayers.remove((ExynosLayer *)outLayer);
@@ -469,14 +471,13 @@ void ExynosDisplay::destroyLayers() {
             delete layer;
         }
     }
+    mLayerHandles.clear();
 }
 
 ExynosLayer *ExynosDisplay::checkLayer(hwc2_layer_t addr, bool printError) {
     ExynosLayer *temp = (ExynosLayer *)addr;
-    for (auto layer : mLayers) {
-        if (layer == temp)
-            return layer;
-    }
+    if (mLayerHandles.count(temp))
+        return temp;
 
     if (printError)
         DISPLAY_LOGE("HWC2 : %s wrong layer request, layer num(%zu)!", __func__, mLayers.size());
@@ -990,6 +991,55 @@ bool ExynosDisplay::is2StepBlendingRequired(exynos_image &src, buffer_handle_t o
     return false;
 }
 
+void ExynosDisplay::prepareLayerBuffer(ExynosLayer &layer) {
+    buffer_handle_t handle = layer.mLayerBuffer;
+    if ((handle == NULL) || layer.isDimLayer() || (mPlugState == false))
+        return;
+
+    ExynosGraphicBufferMeta gmeta(handle);
+    exynos_win_config_data cfg;
+    cfg.state = cfg.WIN_STATE_BUFFER;
+    cfg.owner = (void *)&layer;
+    cfg.compressionInfo = layer.mCompressionInfo;
+    if (layer.mCompressionInfo.type != COMP_TYPE_NONE)
+        cfg.comp_src = DPP_COMP_SRC_GPU;
+    cfg.format = layer.mLayerFormat;
+    cfg.fd_idma[0] = gmeta.fd;
+    cfg.fd_idma[1] = gmeta.fd1;
+    cfg.fd_idma[2] = gmeta.fd2;
+    cfg.buffer_id = ExynosGraphicBufferMeta::get_buffer_id(handle);
+    cfg.protection = (getDrmMode(gmeta.producer_usage) == SECURE_DRM) ? 1 : 0;
+    cfg.src.f_w = gmeta.stride;
+    cfg.src.f_h = gmeta.vstride;
+
+    mDisplayInterface->prepareBuffer(cfg);
+}
+
+void ExynosDisplay::prepareClientTarget() {
+    buffer_handle_t handle = mClientCompositionInfo.mTargetBuffer;
+    if ((handle == NULL) || (mClientCompositionInfo.mHasCompositionLayer == false) ||
+        (mPlugState == false))
+        return;
+
+    ExynosGraphicBufferMeta gmeta(handle);
+    exynos_win_config_data config;
+    config.state = config.WIN_STATE_BUFFER;
+    config.owner = (void *)&mClientCompositionInfo;
+    config.fd_idma[0] = gmeta.fd;
+    config.fd_idma[1] = gmeta.fd1;
+    config.fd_idma[2] = gmeta.fd2;
+    config.buffer_id = ExynosGraphicBufferMeta::get_buffer_id(handle);
+    config.protection = (getDrmMode(gmeta.producer_usage) == SECURE_DRM) ? 1 : 0;
+    config.src.f_w = gmeta.stride;
+    config.src.f_h = gmeta.vstride;
+    config.compressionInfo = mClientCompositionInfo.mCompressionInfo;
+    if (mClientCompositionInfo.mCompressionInfo.type)
+        config.comp_src = DPP_COMP_SRC_GPU;
+    config.format = mClientCompositionInfo.mFormat;
+
+    mDisplayInterface->prepareBuffer(config);
+}
+
 int32_t ExynosDisplay::configureHandle(ExynosLayer &layer, int fence_fd,
                                        exynos_win_config_data &cfg, bool hdrException) {
     /* TODO : this is hardcoded */
@@ -2134,6 +2184,7 @@ int32_t ExynosDisplay::createLayer(hwc2_layer_t *outLayer,
     getDisplayInfo(mDisplayInfo);
     ExynosLayer *layer = new ExynosLayer(mDisplayInfo);
     mLayers.add((ExynosLayer *)layer);
+    mLayerHandles.insert(layer);
     *outLayer = (hwc2_layer_t)layer;
     setGeometryChanged(GEOMETRY_DISPLAY_LAYER_ADDED, geometryFlag);
     mDisplayInterface->onLayerCreated(*outLayer);
@@ -2596,6 +2647,7 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
                                       int32_t *outPresentFence) {
     ATRACE_CALL();
     gettimeofday(&updateTimeInfo.lastPresentTime, NULL);
+    nsecs_t presentStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
     int32_t ret = HWC2_ERROR_NONE;
     String8 errString;
@@ -2664,15 +2716,9 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         return ret;
     }
 
-    if (mLayerDumpManager->isRunning()) {
-        int32_t dumpFrameCurIndex = mLayerDumpManager->getDumpFrameIndex();
-        int32_t dumpFrameMaxIndex = mLayerDumpManager->getDumpMaxIndex();
-        if (dumpFrameCurIndex == dumpFrameMaxIndex) {
-            dumpLayers();
-        } else {
-            mLayerDumpManager->triggerDumpFrame();
-        }
-    }
+    int32_t dumpFrameNo = -1;
+    if (mLayerDumpManager->isCapturing())
+        dumpFrameNo = mLayerDumpManager->captureFrame(mLayers);
 
     if (mUseDynamicRecomp && mDynamicRecompTimer &&
         (mDynamicRecompMode != DEVICE_TO_CLIENT))
@@ -2725,6 +2771,7 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         mDpuData.present_fence = -1;
         return ret;
     }
+    mVsyncModel.addCommit(presentStartTime, systemTime(SYSTEM_TIME_MONOTONIC));
 
     if (needReadWorkingPeriod)
         mWorkingVsyncInfo.setVsyncPeriod(static_cast<uint32_t>(mDisplayInterface->getWorkingVsyncPeriod()));
@@ -2767,6 +2814,9 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
     mFenceTracer.changeFenceInfoState(mLastPresentFence, mDisplayInfo.displayIdentifier,
                                       FENCE_TYPE_PRESENT, FENCE_IP_DPP, FENCE_DUP, true);
 
+    /* The pooled MPP buffers returned before this frame are off screen when it is shown */
+    ExynosMPPBufferPool::getInstance().onPresent(mDisplayId, mLastPresentFence);
+
     increaseMPPDstBufIndex();
 
     /* Check all of acquireFence are closed */
@@ -2803,6 +2853,8 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         mFenceTracer.setFenceInfo(mLayers[i]->mReleaseFence, mDisplayInfo.displayIdentifier,
                                   FENCE_TYPE_SRC_RELEASE, FENCE_IP_LAYER, FENCE_TO);
     }
+    if (dumpFrameNo >= 0)
+        mLayerDumpManager->setReleaseFences(dumpFrameNo, mLayers);
 
     doPostProcessing();
     clearWinConfigData();
@@ -2929,6 +2981,7 @@ int32_t ExynosDisplay::setClientTarget(buffer_handle_t target,
     if (handle) {
         mClientCompositionInfo.mCompressionInfo = getCompressionInfo(handle);
         mClientCompositionInfo.mFormat = ExynosFormat(gmeta.format, mClientCompositionInfo.mCompressionInfo.type);
+        prepareClientTarget();
     }
 
     return HWC2_ERROR_NONE;
@@ -3597,6 +3650,8 @@ int ExynosDisplay::clearDisplay() {
     const int ret = mDisplayInterface->clearDisplay();
     if (ret)
         DISPLAY_LOGE("fail to clear display");
+    else
+        ExynosMPPBufferPool::getInstance().releaseDisplay(mDisplayId);
 
     mClientCompositionInfo.mSkipStaticInitFlag = false;
     mClientCompositionInfo.mSkipFlag = false;
@@ -3633,6 +3688,7 @@ int32_t ExynosDisplay::setPowerMode(int32_t /*hwc2_power_mode_t*/ mode,
     if (mode == HWC_POWER_MODE_OFF) {
         /* It should be called from validate() when the screen is on */
         mNeedSkipPresent = true;
+        mVsyncModel.reset();
         setGeometryChanged(GEOMETRY_DISPLAY_POWER_OFF, geometryFlag);
         if ((mRenderingState >= RENDERING_STATE_VALIDATED) &&
             (mRenderingState < RENDERING_STATE_PRESENTED))
@@ -3888,6 +3944,9 @@ void ExynosDisplay::dump(String8 &result) {
         ExynosLayer *layer = mLayers[i];
         layer->dump(result);
     }
+    mVsyncModel.dump(result);
+    mDamageRegion.dump(result);
+    mLayerDumpManager->dump(result);
     result.appendFormat("\n");
 }
 
@@ -4492,13 +4551,31 @@ int ExynosDisplay::handleWindowUpdate() {
     if (windowUpdateExceptions())
         return 0;
 
-    hwc_rect mergedRect = {(int)mXres, (int)mYres, 0, 0};
-    hwc_rect damageRect = {(int)mXres, (int)mYres, 0, 0};
-    if (mergeDamageRect(mergedRect, damageRect) != NO_ERROR) {
+    mDamageRegion.clear(mXres, mYres);
+    if (mergeDamageRect(mDamageRegion) != NO_ERROR) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled");
         return 0;
     }
 
+    ExynosDamageRegion::UpdateCost cost;
+    getWindowUpdateCost(cost);
+
+    std::vector<ExynosDamageRegion::Plane> planes;
+    for (size_t i = 0; i < mDpuData.configs.size(); i++) {
+        exynos_win_config_data &config = mDpuData.configs[i];
+        if (config.state == config.WIN_STATE_BUFFER)
+            planes.push_back({{config.dst.x, config.dst.y,
+                               config.dst.x + (int)config.dst.w, config.dst.y + (int)config.dst.h},
+                              config.format.bpp()});
+    }
+
+    hwc_rect mergedRect;
+    if (!mDamageRegion.getUpdateRect(cost, planes, mergedRect)) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "Full update is cheaper, %zu damage rects",
+                     mDamageRegion.getNumRects());
+        return 0;
+    }
+
     if (setWindowUpdate(mergedRect) != NO_ERROR) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled");
         return 0;
@@ -4507,7 +4584,15 @@ int ExynosDisplay::handleWindowUpdate() {
     return 0;
 }
 
-int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect) {
+void ExynosDisplay::getWindowUpdateCost(ExynosDamageRegion::UpdateCost &cost) {
+    mDisplayInterface->getPartialRegionAlignment(cost.alignWidth, cost.alignHeight);
+    cost.minWidth = WINDOW_UPDATE_MIN_WIDTH;
+    cost.minHeight = WINDOW_UPDATE_MIN_HEIGHT;
+    cost.overhead = (uint64_t)WINDOW_UPDATE_OVERHEAD_LINES * mXres * cost.outputBpp / 8;
+}
+
+int ExynosDisplay::mergeDamageRect(ExynosDamageRegion &damageRegion) {
+    hwc_rect damage_rect;
     for (size_t i = 0; i < mLayers.size(); i++) {
         int32_t windowIndex = mLayers[i]->mWindowIndex;
         if ((windowIndex < 0) ||
@@ -4528,22 +4613,21 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
             damage_rect.bottom = mLayers[i]->mDisplayFrame.bottom;
             DISPLAY_LOGD(eDebugWindowUpdate, "Skip layer (origin) : %d, %d, %d, %d",
                          damage_rect.left, damage_rect.top, damage_rect.right, damage_rect.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            damageRegion.add(damage_rect);
             hwc_rect prevDst = {mLastDpuData.configs[windowIndex].dst.x, mLastDpuData.configs[windowIndex].dst.y,
                                 mLastDpuData.configs[windowIndex].dst.x + (int)mLastDpuData.configs[windowIndex].dst.w,
                                 mLastDpuData.configs[windowIndex].dst.y + (int)mLastDpuData.configs[windowIndex].dst.h};
             DISPLAY_LOGD(eDebugWindowUpdate, "prev rect(%d, %d, %d, %d)",
                          prevDst.left, prevDst.top, prevDst.right, prevDst.bottom);
 
-            merge_rect = expand(merge_rect, prevDst);
+            damageRegion.add(prevDst);
             continue;
         }
 
-        unsigned int excp = getLayerRegion(mLayers[i], damage_rect, eDamageRegionByDamage);
+        unsigned int excp = getLayerRegion(mLayers[i], damage_rect, eDamageRegionByDamage, &damageRegion);
         if (excp == eDamageRegionPartial) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) partial : %d, %d, %d, %d", i,
                          damage_rect.left, damage_rect.top, damage_rect.right, damage_rect.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
         } else if (excp == eDamageRegionSkip) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) skip", i);
             continue;
@@ -4557,7 +4641,7 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
                          mLayers[i]->mDisplayFrame.top,
                          mLayers[i]->mDisplayFrame.right,
                          mLayers[i]->mDisplayFrame.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            damageRegion.add(damage_rect);
         } else {
             DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled, Skip reason (layer %zu) : %d", i, excp);
             return -1;
@@ -4567,7 +4651,8 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
     return NO_ERROR;
 }
 
-unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_area, uint32_t regionType) {
+unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_area, uint32_t regionType,
+                                           ExynosDamageRegion *damageRegion) {
     android::Vector<hwc_rect_t> hwcRects;
     size_t numRects = 0;
 
@@ -4586,7 +4671,8 @@ unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_ar
         return eDamageRegionSkip;
 
     switch (regionType) {
-    case eDamageRegionByDamage:
+    case eDamageRegionByDamage: {
+        std::vector<hwc_rect_t> rects;
         for (size_t j = 0; j < hwcRects.size(); j++) {
             hwc_rect_t rect;
 
@@ -4612,9 +4698,16 @@ unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_ar
             adjustRect(rect, INT_MAX, INT_MAX);
             /* Get sums of rects */
             rect_area = expand(rect_area, rect);
+            rects.push_back(rect);
+        }
+        /* Nothing is added if a rect of the layer is invalid */
+        if (damageRegion) {
+            for (auto &rect : rects)
+                damageRegion->add(rect);
         }
         return eDamageRegionPartial;
         break;
+    }
     case eDamageRegionByLayer:
         if (layer->mLastLayerBuffer != layer->mLayerBuffer)
             return eDamageRegionFull;
@@ -4998,210 +5091,6 @@ void ExynosDisplay::setDumpCount(uint32_t dumpCount) {
     mLayerDumpManager->run(dumpCount);
 }
 
-void ExynosDisplay::getDumpLayer() {
-    int32_t frameIndex = mLayerDumpManager->getDumpFrameIndex();
-    layerDumpFrameInfo *frameInfo = mLayerDumpManager->getLayerDumpFrameInfo(frameIndex);
-
-    if ((frameInfo->layerDumpState == LAYER_DUMP_IDLE) ||
-        (frameInfo->layerDumpState == LAYER_DUMP_DONE)) {
-        return;
-    }
-
-    ATRACE_CALL();
-    DISPLAY_LOGD(eDebugHWC, "debug_dump_source %s dumpCount=%d mDisplayId=%d", __func__, frameIndex, mDisplayId);
-
-    frameInfo->layerDumpCnt = mLayers.size();
-
-    for (size_t i = 0; i < mLayers.size(); i++) {
-        buffer_handle_t hnd = mLayers[i]->mLayerBuffer;
-        int32_t acqFence = mLayers[i]->mAcquireFence;
-
-        ExynosGraphicBufferMeta gmeta(hnd);
-
-        if (!hnd) {
-            DISPLAY_LOGE("%s: [%d] handle is NULL", __func__, 0);
-            continue;
-        }
-
-        unsigned long long start, end;
-        start = systemTime(SYSTEM_TIME_MONOTONIC);
-        DISPLAY_LOGD(eDebugHWC, "%s, memcpy.. Frame : %d, Layer : %zu,  %p, %d", __func__, frameIndex, i, mLayers[i]->mLayerBuffer, acqFence);
-
-        if (mFenceTracer.fence_valid(acqFence)) {
-            if (sync_wait(acqFence, 1000) < 0) {
-                DISPLAY_LOGE("debug_dump_source %s:: [%d] sync wait failed", __func__, 0);
-                return;
-            }
-        }
-
-        layerDumpLayerInfo layerInfo;
-
-        if (getBufLength(hnd, 4, layerInfo.bufferLength, gmeta.format, gmeta.stride, gmeta.vstride) != NO_ERROR) {
-            DISPLAY_LOGE("debug_dump_source %s:: invalid bufferLength(%zu, %zu, %zu, %zu), format(0x%8x)", __func__,
-                         layerInfo.bufferLength[0], layerInfo.bufferLength[1], layerInfo.bufferLength[2], layerInfo.bufferLength[3], gmeta.format);
-            return;
-        }
-
-        layerInfo.bufferNum = getBufferNumOfFormat(gmeta.format);
-        layerInfo.layerType = getTypeOfFormat(gmeta.format);
-        layerInfo.compressionType = (mLayers[i]->mCompressionInfo.type == COMP_TYPE_NONE) ? true : false;
-        layerInfo.format = gmeta.format;
-        layerInfo.stride = gmeta.stride;
-        layerInfo.vStride = gmeta.vstride;
-        layerInfo.width = gmeta.width;
-        layerInfo.height = gmeta.height;
-        layerInfo.compositionType = mLayers[i]->mCompositionType;
-
-        int bufFds[4];
-        bufFds[0] = gmeta.fd;
-        bufFds[1] = gmeta.fd1;
-        bufFds[2] = gmeta.fd2;
-
-        for (int pNo = 0; pNo < layerInfo.bufferNum; pNo++) {
-            if ((bufFds[pNo] != -1) && layerInfo.bufferLength[pNo] > 0) {
-                void *_buf = mmap(0, layerInfo.bufferLength[0], PROT_READ | PROT_WRITE, MAP_SHARED, bufFds[0], 0);
-                if (_buf != MAP_FAILED && _buf != NULL) {
-                    layerInfo.planeRawData[0] = malloc(layerInfo.bufferLength[0]);
-                    if (layerInfo.planeRawData[0] != NULL)
-                        memcpy(layerInfo.planeRawData[0], _buf, layerInfo.bufferLength[0]);
-                    munmap(_buf, layerInfo.bufferLength[0]);
-                }
-            }
-        }
-
-        frameInfo->layerInfo[i] = layerInfo;
-
-        end = systemTime(SYSTEM_TIME_MONOTONIC);
-        DISPLAY_LOGD(eDebugHWC, "%s, memcpy.. Done Frame : %d, Layer : %zu, %p, %d, time %lld",
-                     __func__, frameIndex, i, mLayers[i]->mLayerBuffer,
-                     acqFence, (unsigned long long)end - start);
-    }
-
-    frameInfo->layerDumpState = LAYER_DUMP_DONE;
-}
-
-void ExynosDisplay::dumpLayers() {
-    int32_t frameIndex = mLayerDumpManager->getDumpFrameIndex();
-    int32_t maxIndex = mLayerDumpManager->getDumpMaxIndex();
-    DISPLAY_LOGD(eDebugHWC, "debug_dump_source finished dump file index=%d", frameIndex);
-    for (int j = 0; j <= maxIndex; j++) {
-        layerDumpFrameInfo *temp = mLayerDumpManager->getLayerDumpFrameInfo(j);
-        for (int i = 0; i < temp->layerDumpCnt; i++) {
-            DISPLAY_LOGD(eDebugHWC, "%s, writing.. frame : %d, layer : %d", __func__, j, i);
-            writeDumpData(j, i, temp, &temp->layerInfo[i]);
-        }
-    }
-
-    for (int j = 0; j <= maxIndex; j++) {
-        layerDumpFrameInfo *temp = mLayerDumpManager->getLayerDumpFrameInfo(j);
-        for (int i = 0; i < temp->layerDumpCnt; i++) {
-            for (int k = 0; k < 3; k++) {
-                layerDumpLayerInfo *layerInfo = &temp->layerInfo[i];
-                if (layerInfo->planeRawData[k] != nullptr) {
-                    free(layerInfo->planeRawData[k]);
-                    layerInfo->planeRawData[k] = nullptr;
-                }
-            }
-        }
-    }
-    mLayerDumpManager->stop();
-}
-
-void ExynosDisplay::writeDumpData(int32_t frameNo, int32_t layerNo,
-                                  layerDumpFrameInfo *frameInfo, layerDumpLayerInfo *layerInfo) {
-    FILE *fp = NULL;
-    size_t result = 0;
-    char filePath[MAX_DEV_NAME];
-    uint32_t bufferNum = layerInfo->bufferNum;
-    int32_t format = layerInfo->format;
-    uint32_t compressionType = layerInfo->compressionType;
-    int32_t compositionType = layerInfo->compositionType;
-
-    if (isFormatRgb(format)) {
-        DISPLAY_LOGD(eDebugHWC, "debug_dump_source rgb data enter");
-        if (compressionType == COMP_TYPE_AFBC)
-            sprintf(filePath, "%s/afbc_displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw", ERROR_LOG_PATH0, mDisplayId, frameNo,
-                    layerNo, format, 1, compositionType, layerInfo->stride, layerInfo->vStride);
-        else
-            sprintf(filePath, "%s/displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw", ERROR_LOG_PATH0, mDisplayId, frameNo,
-                    layerNo, format, 0, compositionType, layerInfo->stride, layerInfo->vStride);
-
-        fp = fopen(filePath, "w+");
-        if (fp) {
-            result = fwrite(layerInfo->planeRawData[0], layerInfo->bufferLength[0], 1, fp);
-            fclose(fp);
-        }
-
-        /* make afbc decoding script file */
-        if (compressionType == COMP_TYPE_AFBC) {
-            FILE *scfp = NULL;
-            String8 scriptText;
-            char scriptFilePath[MAX_DEV_NAME];
-
-            sprintf(scriptFilePath, "%s/afbcdec.sh", ERROR_LOG_PATH0);
-            scfp = fopen(scriptFilePath, "a+");
-            if (scfp != NULL) {
-                scriptText.appendFormat("./afbcdec -i afbc_displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw ",
-                                        mDisplayId, frameNo, layerNo, format, 1, compositionType, layerInfo->stride, layerInfo->vStride);
-
-                scriptText.appendFormat("-o displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw ",
-                                        mDisplayId, frameNo, layerNo, format, 0, compositionType, layerInfo->stride, layerInfo->vStride);
-
-                if (format == HAL_PIXEL_FORMAT_RGB_565)
-                    scriptText.appendFormat("-h %dx%d_r5g6b5_0_0_0_0\n", layerInfo->stride, layerInfo->vStride);
-                else if (format == HAL_PIXEL_FORMAT_RGBA_1010102)
-                    scriptText.appendFormat("-h %dx%d_r10g10b10a2_0_0_0_0\n", layerInfo->stride, layerInfo->vStride);
-                else
-                    scriptText.appendFormat("-h %dx%d_r8g8b8a8_0_0_0_0\n", layerInfo->stride, layerInfo->vStride);
-
-                fwrite(scriptText.string(), 1, scriptText.size(), scfp);
-                fclose(scfp);
-            }
-        }
-
-        DISPLAY_LOGD(eDebugHWC, "debug_dump_source Frame Dump %s: is %s result=%s mLayers.size=%zu", filePath, result ? "Successful" : "Failed", result ? "1" : strerror(errno), mLayers.size());
-    }
-
-    if (isFormatYUV(format)) {
-        sprintf(filePath, "%s/displayid_%u_frame_%03d_layer_%02d_format_%d_compressed_%d_comtype_%d_%dx%d.raw", ERROR_LOG_PATH0, mDisplayId, frameNo,
-                layerNo, format, 0, compositionType, layerInfo->stride, layerInfo->vStride);
-
-        //forbit apend buffer when file has exited.so before each dumping,clear file
-        fp = fopen(filePath, "w+");
-        if (fp) {
-            fclose(fp);
-        }
-        for (uint32_t start = 0; start < bufferNum; start++) {
-            DISPLAY_LOGD(eDebugHWC, "debug_dump_source yuv data enter start_times=%d", start);
-            fp = fopen(filePath, "a+");
-
-            if (fp) {
-                int align_width = layerInfo->stride;
-                int width = layerInfo->width;
-                int height = start == 0 ? layerInfo->height : layerInfo->height / 2;
-                if (bufferNum == 3 && start != 0) {
-                    height = layerInfo->height / 4;
-                }
-                result = yuvWriteByLines(layerInfo->planeRawData[0], align_width, width, height, fp);
-                fclose(fp);
-            }
-            DISPLAY_LOGD(eDebugHWC, "debug_dump_source Frame Dump %s: is %s result=%s mLayers.size=%zu", filePath, result ? "Successful" : "Failed", result ? "1" : strerror(errno), mLayers.size());
-        }
-    }
-}
-
-size_t ExynosDisplay::yuvWriteByLines(void *temp, int align_Width, int original_Width, int original_Height, FILE *fp) {
-    size_t result = 0;
-
-    DISPLAY_LOGD(eDebugHWC, "debug_dump_source yuvWriteByLines enter align_Width=%d original_Width=%d, original_Height=%d",
-                 align_Width, original_Width, original_Height);
-
-    for (int h = 0; h < original_Height; h++) {
-        result = fwrite((char *)temp + h * align_Width, original_Width, 1, fp);
-    }
-    return result;
-}
-
 void ExynosDisplay::setPresentState() {
     mRenderingState = RENDERING_STATE_PRESENTED;
     mRenderingStateFlags.presentFlag = true;
@@ -5441,11 +5330,12 @@ void ExynosDisplay::handleVsync(uint64_t timestamp) {
         }
     }
 
-    if (mDisplayId == getDisplayId(HWC_DISPLAY_PRIMARY, 0)) {
-        hwc2_vsync_period_t curPeriod;
-        getDisplayVsyncPeriodInternal(&curPeriod);
+    hwc2_vsync_period_t curPeriod;
+    getDisplayVsyncPeriodInternal(&curPeriod);
+    mVsyncModel.addVsync(static_cast<nsecs_t>(timestamp), curPeriod);
+
+    if (mDisplayId == getDisplayId(HWC_DISPLAY_PRIMARY, 0))
         ATRACE_INT("fps", std::chrono::nanoseconds(1s).count() / curPeriod);
-    }
 
     if (!mVsyncCallback.getVSyncEnabled()) {
         return;
@@ -5588,92 +5478,396 @@ void ExynosDisplay::resetForDestroyClient() {
 }
 
 LayerDumpManager::LayerDumpManager(ExynosDisplay *display)
-    : mDumpFrameIndex(0),
-      mDumpMaxIndex(-1),
-      mDisplay(display) {}
+    : mDisplay(display) {}
 
 LayerDumpManager::~LayerDumpManager() {
     stop();
 }
 
-int32_t LayerDumpManager::getDumpFrameIndex() {
+void LayerDumpManager::run(uint32_t cnt) {
     std::lock_guard<std::mutex> lock(mMutex);
-    return mDumpFrameIndex;
+    if (mRunning) {
+        ALOGI("LayerDumpManager::the dump is not finished");
+        return;
+    }
+
+    mCompress = property_get_bool("vendor.hwc.exynos.layer_dump.compress", true);
+    mMinInterval = ms2ns(property_get_int32("vendor.hwc.exynos.layer_dump.interval_ms", 0));
+    mRemainingFrames = cnt;
+    mFrameNo = 0;
+    mLastCaptureTime = 0;
+    mWrittenFrames = mDroppedFrames = mSkippedFrames = mFailedLayers = 0;
+    mRawBytes = mWrittenBytes = 0;
+    mRunning = (cnt > 0);
+
+    if (!mCopyThread.joinable()) {
+        mExit = false;
+        mCopyThread = std::thread(&LayerDumpManager::copyLoop, this);
+        mWriteThread = std::thread(&LayerDumpManager::writeLoop, this);
+    }
 }
 
-int32_t LayerDumpManager::getDumpMaxIndex() {
+void LayerDumpManager::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+        mRemainingFrames = 0;
+        mRunning = false;
+    }
+    mCondition.notify_all();
+    if (mCopyThread.joinable()) {
+        mCopyThread.join();
+        mWriteThread.join();
+        ALOGI("LayerDumpManager::stop the threads are joined");
+    }
+
     std::lock_guard<std::mutex> lock(mMutex);
-    return mDumpMaxIndex;
+    for (auto &frame : mQueue)
+        releaseFrame(frame);
+    mQueue.clear();
+    mQueuedBytes = 0;
 }
 
-layerDumpFrameInfo *LayerDumpManager::getLayerDumpFrameInfo(uint32_t idx) {
+bool LayerDumpManager::isRunning() {
     std::lock_guard<std::mutex> lock(mMutex);
-    return &mLayerDumpInfo[idx];
+    return mRunning;
 }
 
-void LayerDumpManager::setCount(uint32_t cnt) {
+bool LayerDumpManager::isCapturing() {
     std::lock_guard<std::mutex> lock(mMutex);
-    mDumpMaxIndex = cnt;
-    mDumpFrameIndex = 0;
+    return mRemainingFrames > 0;
 }
 
-void LayerDumpManager::run(uint32_t cnt) {
-    setCount(cnt);
-    {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mState = ThreadState::RUN;
-    }
-    if (!mThread.joinable())
-        mThread = std::thread(&LayerDumpManager::loop, this);
-    else
-        ALOGI("LayerDumpManager::the thread is already started");
+void LayerDumpManager::finishLocked() {
+    if (!mRunning || (mRemainingFrames > 0) || !mQueue.empty())
+        return;
+
+    mRunning = false;
+    ALOGI("LayerDumpManager::dump finished, written(%" PRIu64 "), dropped(%" PRIu64
+          "), skipped(%" PRIu64 "), failed layers(%" PRIu64 "), %" PRIu64 " KB -> %" PRIu64 " KB",
+          mWrittenFrames, mDroppedFrames, mSkippedFrames, mFailedLayers,
+          mRawBytes / 1024, mWrittenBytes / 1024);
 }
 
-void LayerDumpManager::stop() {
-    setCount(-1);
-    {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mState = ThreadState::STOPPED;
+int32_t LayerDumpManager::captureFrame(const ExynosSortedLayer &layers) {
+    ATRACE_CALL();
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mRemainingFrames == 0)
+        return -1;
+    if (mLastCaptureTime && (now - mLastCaptureTime < mMinInterval)) {
+        mSkippedFrames++;
+        return -1;
     }
-    if (mThread.joinable()) {
-        mThread.join();
-        ALOGI("LayerDumpManager::stop the thread is joined");
-    } else {
-        ALOGE("LayerDumpManager::stop the thread join is impossible");
+    mLastCaptureTime = now;
+    mRemainingFrames--;
+
+    DumpFrame frame;
+    frame.frameNo = mFrameNo++;
+    frame.compress = mCompress;
+    for (size_t i = 0; (i < layers.size()) && (i < LAYER_DUMP_LAYER_CNT_MAX); i++) {
+        ExynosLayer *layer = layers[i];
+        buffer_handle_t hnd = layer->mLayerBuffer;
+        if (!hnd)
+            continue;
+
+        ExynosGraphicBufferMeta gmeta(hnd);
+        layerDumpLayerInfo layerInfo;
+        if (getBufLength(hnd, 4, layerInfo.bufferLength, gmeta.format, gmeta.stride, gmeta.vstride) != NO_ERROR) {
+            ALOGE("LayerDumpManager::invalid bufferLength(%zu, %zu, %zu, %zu), format(0x%8x)",
+                  layerInfo.bufferLength[0], layerInfo.bufferLength[1],
+                  layerInfo.bufferLength[2], layerInfo.bufferLength[3], gmeta.format);
+            mFailedLayers++;
+            continue;
+        }
+
+        layerInfo.layerIndex = i;
+        layerInfo.bufferNum = std::min(getBufferNumOfFormat(gmeta.format), 3U);
+        layerInfo.layerType = getTypeOfFormat(gmeta.format);
+        layerInfo.compressionType = layer->mCompressionInfo.type;
+        layerInfo.format = gmeta.format;
+        layerInfo.stride = gmeta.stride;
+        layerInfo.vStride = gmeta.vstride;
+        layerInfo.width = gmeta.width;
+        layerInfo.height = gmeta.height;
+        layerInfo.compositionType = layer->mCompositionType;
+        for (uint32_t pNo = 0; pNo < layerInfo.bufferNum; pNo++)
+            frame.bytes += layerInfo.bufferLength[pNo];
+        frame.layers.push_back(layerInfo);
+    }
+
+    if ((mQueue.size() >= LAYER_DUMP_FRAME_CNT_MAX) ||
+        (mQueuedBytes + frame.bytes > LAYER_DUMP_MAX_QUEUED_BYTES)) {
+        HDEBUGLOGD(eDebugHWC, "LayerDumpManager::drop frame %d, queued %zu frames, %zu bytes",
+                   frame.frameNo, mQueue.size(), mQueuedBytes);
+        mDroppedFrames++;
+        finishLocked();
+        return -1;
     }
+
+    /* The buffers and the fences are kept until the thread copies them */
+    for (auto &layerInfo : frame.layers) {
+        ExynosLayer *layer = layers[layerInfo.layerIndex];
+        ExynosGraphicBufferMeta gmeta(layer->mLayerBuffer);
+        int bufFds[3] = {gmeta.fd, gmeta.fd1, gmeta.fd2};
+        for (uint32_t pNo = 0; pNo < layerInfo.bufferNum; pNo++) {
+            if ((bufFds[pNo] >= 0) && (layerInfo.bufferLength[pNo] > 0))
+                layerInfo.bufFds[pNo] = dup(bufFds[pNo]);
+        }
+        if (layer->mAcquireFence >= 0)
+            layerInfo.acqFence = dup(layer->mAcquireFence);
+    }
+
+    int32_t frameNo = frame.frameNo;
+    mQueuedBytes += frame.bytes;
+    mQueue.push_back(std::move(frame));
+    mCondition.notify_all();
+    return frameNo;
 }
 
-bool LayerDumpManager::isRunning() {
+void LayerDumpManager::setReleaseFences(int32_t frameNo, const ExynosSortedLayer &layers) {
     std::lock_guard<std::mutex> lock(mMutex);
-    if (mState == ThreadState::RUN)
-        return true;
-    else
-        return false;
+    auto it = std::find_if(mQueue.begin(), mQueue.end(),
+                           [=](const DumpFrame &frame) { return frame.frameNo == frameNo; });
+    /* Only a copy that has not finished needs them */
+    if ((it == mQueue.end()) || it->copied)
+        return;
+
+    for (auto &layerInfo : it->layers) {
+        if ((layerInfo.layerIndex < layers.size()) &&
+            (layers[layerInfo.layerIndex]->mReleaseFence >= 0) && (layerInfo.relFence < 0))
+            layerInfo.relFence = dup(layers[layerInfo.layerIndex]->mReleaseFence);
+    }
 }
 
-void LayerDumpManager::triggerDumpFrame() {
-    std::lock_guard<std::mutex> lock(mMutex);
+void LayerDumpManager::copyLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        auto notCopied = [](const DumpFrame &frame) { return !frame.copied; };
+        while (!mExit && (std::find_if(mQueue.begin(), mQueue.end(), notCopied) == mQueue.end()))
+            mCondition.wait(lock);
+        if (mExit)
+            break;
 
-    if (mDumpFrameIndex > 0) {
-        // wait previous buffer copy
-        while (mLayerDumpInfo[mDumpFrameIndex].layerDumpState != LAYER_DUMP_DONE) {
-            HDEBUGLOGD(eDebugHWC, "wait : %d, %d", mDumpFrameIndex, mState);
+        /* The writer only pops copied frames, so the frame stays in the queue */
+        DumpFrame &frame = *std::find_if(mQueue.begin(), mQueue.end(), notCopied);
+        lock.unlock();
+        bool copied = copyFrame(frame);
+        lock.lock();
+        frame.copied = true;
+        if (!copied) {
+            HDEBUGLOGD(eDebugHWC, "LayerDumpManager::drop frame %d not copied", frame.frameNo);
+            frame.dropped = true;
+            mDroppedFrames++;
         }
+        mCondition.notify_all();
     }
-    mDumpFrameIndex++;
-    mLayerDumpInfo[mDumpFrameIndex].layerDumpState = LAYER_DUMP_READY;
-    HDEBUGLOGD(eDebugHWC, "%s trigger %d", __func__, mDumpFrameIndex);
 }
 
-void LayerDumpManager::loop() {
+void LayerDumpManager::writeLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
     while (true) {
-        if (isRunning()) {
-            mDisplay->getDumpLayer();
-        } else {
+        while (!mExit && (mQueue.empty() || !mQueue.front().copied))
+            mCondition.wait(lock);
+        if (mExit)
             break;
+
+        DumpFrame &frame = mQueue.front();
+        lock.unlock();
+        if (!frame.dropped)
+            writeFrame(frame);
+        releaseFrame(frame);
+        lock.lock();
+        mQueuedBytes -= frame.bytes;
+        if (!frame.dropped)
+            mWrittenFrames++;
+        mQueue.pop_front();
+        finishLocked();
+    }
+}
+
+bool LayerDumpManager::copyFrame(DumpFrame &frame) {
+    ATRACE_CALL();
+    /* The producer may be drawing the next content already */
+    auto isReleased = [&](layerDumpLayerInfo &layerInfo) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if ((layerInfo.relFence < 0) || (sync_wait(layerInfo.relFence, 0) != 0))
+            return false;
+        releaseFrame(frame);
+        return true;
+    };
+
+    for (auto &layerInfo : frame.layers) {
+        if (layerInfo.acqFence >= 0) {
+            int ret = sync_wait(layerInfo.acqFence, 1000);
+            hwcFdClose(layerInfo.acqFence);
+            layerInfo.acqFence = -1;
+            if (ret < 0) {
+                ALOGE("LayerDumpManager::frame %d sync wait failed", frame.frameNo);
+                std::lock_guard<std::mutex> lock(mMutex);
+                releaseFrame(frame);
+                return false;
+            }
         }
+
+        if (isReleased(layerInfo))
+            return false;
+
+        for (uint32_t pNo = 0; pNo < layerInfo.bufferNum; pNo++) {
+            if (layerInfo.bufFds[pNo] < 0)
+                continue;
+            void *_buf = mmap(0, layerInfo.bufferLength[pNo], PROT_READ, MAP_SHARED, layerInfo.bufFds[pNo], 0);
+            if (_buf != MAP_FAILED && _buf != NULL) {
+                layerInfo.planeRawData[pNo] = malloc(layerInfo.bufferLength[pNo]);
+                if (layerInfo.planeRawData[pNo] != NULL)
+                    memcpy(layerInfo.planeRawData[pNo], _buf, layerInfo.bufferLength[pNo]);
+                munmap(_buf, layerInfo.bufferLength[pNo]);
+            }
+            hwcFdClose(layerInfo.bufFds[pNo]);
+            layerInfo.bufFds[pNo] = -1;
+        }
+
+        /* The copy can overlap the next content if the buffer is released during it */
+        if (isReleased(layerInfo))
+            return false;
     }
-    return;
+    return true;
+}
+
+void LayerDumpManager::writeFrame(DumpFrame &frame) {
+    ATRACE_CALL();
+    for (size_t i = 0; i < frame.layers.size(); i++) {
+        HDEBUGLOGD(eDebugHWC, "%s, writing.. frame : %d, layer : %zu", __func__, frame.frameNo, i);
+        writeLayer(frame, i);
+    }
+}
+
+void LayerDumpManager::releaseFrame(DumpFrame &frame) {
+    for (auto &layerInfo : frame.layers) {
+        for (int k = 0; k < 4; k++) {
+            if (layerInfo.planeRawData[k] != nullptr) {
+                free(layerInfo.planeRawData[k]);
+                layerInfo.planeRawData[k] = nullptr;
+            }
+            if (layerInfo.bufFds[k] >= 0) {
+                hwcFdClose(layerInfo.bufFds[k]);
+                layerInfo.bufFds[k] = -1;
+            }
+        }
+        if (layerInfo.acqFence >= 0) {
+            hwcFdClose(layerInfo.acqFence);
+            layerInfo.acqFence = -1;
+        }
+        if (layerInfo.relFence >= 0) {
+            hwcFdClose(layerInfo.relFence);
+            layerInfo.relFence = -1;
+        }
+    }
+}
+
+void LayerDumpManager::writeLayer(DumpFrame &frame, size_t layerNo) {
+    layerDumpLayerInfo &layerInfo = frame.layers[layerNo];
+    int32_t frameNo = frame.frameNo;
+    uint32_t displayId = mDisplay->mDisplayId;
+    char filePath[MAX_DEV_NAME];
+    uint32_t bufferNum = layerInfo.bufferNum;
+    int32_t format = layerInfo.format;
+    int32_t compositionType = layerInfo.compositionType;
+    bool isAfbc = (layerInfo.compressionType == COMP_TYPE_AFBC);
+    /* AFBC is compressed already and afbcdec reads the raw file */
+    bool compress = frame.compress && !isAfbc;
+    ExynosLayerDumpFile file;
+    bool result = false;
+
+    if (layerInfo.planeRawData[0] == nullptr) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFailedLayers++;
+        return;
+    }
+
+    if (isFormatRgb(format)) {
+        HDEBUGLOGD(eDebugHWC, "debug_dump_source rgb data enter");
+        snprintf(filePath, sizeof(filePath), "%s/%sdisplayid_%u_frame_%03d_layer_%02zu_format_%d_compressed_%d_comtype_%d_%dx%d.raw%s",
+                 ERROR_LOG_PATH0, isAfbc ? "afbc_" : "", displayId, frameNo, layerNo, format, isAfbc ? 1 : 0,
+                 compositionType, layerInfo.stride, layerInfo.vStride, compress ? ".dlz" : "");
+
+        if (file.open(filePath, compress, getBytePerPixelOfPrimaryPlane(format))) {
+            file.write(layerInfo.planeRawData[0], layerInfo.bufferLength[0]);
+            result = file.close();
+        }
+
+        /* make afbc decoding script file */
+        if (isAfbc) {
+            FILE *scfp = NULL;
+            String8 scriptText;
+            char scriptFilePath[MAX_DEV_NAME];
+
+            snprintf(scriptFilePath, sizeof(scriptFilePath), "%s/afbcdec.sh", ERROR_LOG_PATH0);
+            scfp = fopen(scriptFilePath, "a+");
+            if (scfp != NULL) {
+                scriptText.appendFormat("./afbcdec -i afbc_displayid_%u_frame_%03d_layer_%02zu_format_%d_compressed_%d_comtype_%d_%dx%d.raw ",
+                                        displayId, frameNo, layerNo, format, 1, compositionType, layerInfo.stride, layerInfo.vStride);
+
+                scriptText.appendFormat("-o displayid_%u_frame_%03d_layer_%02zu_format_%d_compressed_%d_comtype_%d_%dx%d.raw ",
+                                        displayId, frameNo, layerNo, format, 0, compositionType, layerInfo.stride, layerInfo.vStride);
+
+                if (format == HAL_PIXEL_FORMAT_RGB_565)
+                    scriptText.appendFormat("-h %dx%d_r5g6b5_0_0_0_0\n", layerInfo.stride, layerInfo.vStride);
+                else if (format == HAL_PIXEL_FORMAT_RGBA_1010102)
+                    scriptText.appendFormat("-h %dx%d_r10g10b10a2_0_0_0_0\n", layerInfo.stride, layerInfo.vStride);
+                else
+                    scriptText.appendFormat("-h %dx%d_r8g8b8a8_0_0_0_0\n", layerInfo.stride, layerInfo.vStride);
+
+                fwrite(scriptText.string(), 1, scriptText.size(), scfp);
+                fclose(scfp);
+            }
+        }
+    }
+
+    if (isFormatYUV(format)) {
+        snprintf(filePath, sizeof(filePath), "%s/displayid_%u_frame_%03d_layer_%02zu_format_%d_compressed_%d_comtype_%d_%dx%d.raw%s",
+                 ERROR_LOG_PATH0, displayId, frameNo, layerNo, format, 0, compositionType,
+                 layerInfo.stride, layerInfo.vStride, compress ? ".dlz" : "");
+
+        if (file.open(filePath, compress, getBytePerPixelOfPrimaryPlane(format))) {
+            for (uint32_t start = 0; start < bufferNum; start++) {
+                const char *plane = static_cast<const char *>(layerInfo.planeRawData[start]);
+                if (plane == nullptr)
+                    break;
+
+                uint32_t height = start == 0 ? layerInfo.height : layerInfo.height / 2;
+                if (bufferNum == 3 && start != 0)
+                    height = layerInfo.height / 4;
+                /* Only the visible width of every line */
+                for (uint32_t h = 0; h < height; h++)
+                    file.write(plane + h * layerInfo.stride, layerInfo.width);
+            }
+            result = file.close();
+        }
+    }
+
+    HDEBUGLOGD(eDebugHWC, "debug_dump_source Frame Dump %s: is %s result=%s", filePath,
+               result ? "Successful" : "Failed", result ? "1" : strerror(errno));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!result)
+        mFailedLayers++;
+    mRawBytes += file.getRawBytes();
+    mWrittenBytes += file.getWrittenBytes();
+}
+
+void LayerDumpManager::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mRunning && (mWrittenFrames == 0) && (mDroppedFrames == 0))
+        return;
+
+    result.appendFormat("Layer dump: %s, remaining(%u), queued(%zu, %zu KB), written(%" PRIu64
+                        "), dropped(%" PRIu64 "), skipped(%" PRIu64 "), failed layers(%" PRIu64
+                        "), %" PRIu64 " KB -> %" PRIu64 " KB\n",
+                        mRunning ? "running" : "done", mRemainingFrames, mQueue.size(),
+                        mQueuedBytes / 1024, mWrittenFrames, mDroppedFrames, mSkippedFrames,
+                        mFailedLayers, mRawBytes / 1024, mWrittenBytes / 1024);
 }
 
 hdrInterface *ExynosDisplay::createHdrInterfaceInstance() {
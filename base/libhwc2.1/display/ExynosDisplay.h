@@ -17,7 +17,10 @@
 #ifndef _EXYNOSDISPLAY_H
 #define _EXYNOSDISPLAY_H
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <unordered_set>
 
 #include <utils/Vector.h>
 #include <utils/KeyedVector.h>
@@ -30,6 +33,9 @@
 #include "ExynosMPP.h"
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWCDebug.h"
+#include "ExynosVsyncModel.h"
+#include "ExynosDamageRegion.h"
+#include "ExynosLayerDump.h"
 #include "OneShotTimer.h"
 
 //#include <hardware/exynos/hdrInterface.h>
@@ -49,8 +55,25 @@
 #define DYNAMIC_RECOMP_TIMER_MS 500
 #endif
 
+/* The fixed cost of a partial update in lines of a full update */
+#ifndef WINDOW_UPDATE_OVERHEAD_LINES
+#define WINDOW_UPDATE_OVERHEAD_LINES 16
+#endif
+
+#ifndef WINDOW_UPDATE_MIN_WIDTH
+#define WINDOW_UPDATE_MIN_WIDTH 0
+#endif
+
+#ifndef WINDOW_UPDATE_MIN_HEIGHT
+#define WINDOW_UPDATE_MIN_HEIGHT 0
+#endif
+
 #define LAYER_DUMP_FRAME_CNT_MAX 30
 #define LAYER_DUMP_LAYER_CNT_MAX 30
+/* The layer copies queued to the dump writer */
+#ifndef LAYER_DUMP_MAX_QUEUED_BYTES
+#define LAYER_DUMP_MAX_QUEUED_BYTES (256 * 1024 * 1024)
+#endif
 #define ATRACE_FD(fd, w, h)                                                \
     do {                                                                   \
         if (ATRACE_ENABLED()) {                                            \
@@ -96,12 +119,6 @@ enum class hwc_request_state_t {
     SET_CONFIG_STATE_REQUESTED,
 };
 
-enum {
-    LAYER_DUMP_IDLE,
-    LAYER_DUMP_READY,
-    LAYER_DUMP_DONE
-};
-
 #define NUM_SKIP_STATIC_LAYER 5
 struct ExynosFrameInfo {
     uint32_t srcNum;
@@ -142,12 +159,13 @@ struct layerDumpLayerInfo {
     uint32_t vStride = 0;
     uint32_t width = 0;
     uint32_t height = 0;
-};
-
-struct layerDumpFrameInfo {
-    int32_t layerDumpState = LAYER_DUMP_IDLE;
-    int32_t layerDumpCnt = 0;
-    layerDumpLayerInfo layerInfo[LAYER_DUMP_LAYER_CNT_MAX];
+    /* Duplicated to keep the buffer until it is copied */
+    int bufFds[4] = {-1, -1, -1, -1};
+    int acqFence = -1;
+    /* The producer may reuse the buffer once it signals */
+    int relFence = -1;
+    /* Index in the layers of the frame */
+    size_t layerIndex = 0;
 };
 
 class ExynosSortedLayer : public Vector<ExynosLayer *> {
@@ -373,6 +391,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
          * Layer list those sorted by z-order
          */
     ExynosSortedLayer mLayers;
+    /* The layers of mLayers for the lookup of layer handles */
+    std::unordered_set<ExynosLayer *> mLayerHandles;
 
     /**
          * Layer index, target buffer information for GLES.
@@ -555,7 +575,6 @@ class ExynosDisplay : public ExynosVsyncHandler {
 
     int getId();
 
-    size_t yuvWriteByLines(void *temp, int align_Width, int original_Width, int original_Height, FILE *fp);
     int32_t setCompositionTargetExynosImage(uint32_t targetType, exynos_image *src_img, exynos_image *dst_img);
     int32_t initializeValidateInfos();
     int32_t addClientCompositionLayer(uint32_t layerIndex,
@@ -600,6 +619,15 @@ class ExynosDisplay : public ExynosVsyncHandler {
     int32_t configureHandle(ExynosLayer &layer, int fence_fd,
                             exynos_win_config_data &cfg, bool hdrException = false);
 
+    /*
+     * Starts adding the framebuffer of a new buffer before the present.
+     * The config is what configureHandle() and configureOverlay() set
+     * for a buffer that the OTF MPP takes without scaling or cropping,
+     * a different config at present only misses the prepared framebuffer.
+     */
+    void prepareLayerBuffer(ExynosLayer &layer);
+    void prepareClientTarget();
+
     void clearWinConfigData() { mDpuData.reset(); };
     virtual int setWinConfigData(DevicePresentInfo &deviceInfo);
 
@@ -1124,6 +1152,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
     int32_t updateVsyncAppliedTimeLine(int64_t actualChangeTime);
     virtual int32_t getDisplayVsyncPeriodInternal(hwc2_vsync_period_t *outVsyncPeriod);
     int32_t getDisplayVsyncTimestamp(uint64_t *outVsyncTimestamp);
+    /* Returns the first vsync predicted after @time, 0 if it is unknown */
+    nsecs_t getPredictedVsync(nsecs_t time) { return mVsyncModel.getPredictedVsync(time); };
     virtual int32_t doDisplayConfigPostProcess();
     int32_t getConfigAppliedTime(const uint64_t desiredTime,
                                  const uint64_t actualChangeTime,
@@ -1147,11 +1177,13 @@ class ExynosDisplay : public ExynosVsyncHandler {
     void printConfig(exynos_win_config_data &c);
 
     unsigned int getLayerRegion(ExynosLayer *layer,
-                                hwc_rect &rect_area, uint32_t regionType);
+                                hwc_rect &rect_area, uint32_t regionType,
+                                ExynosDamageRegion *damageRegion = nullptr);
     int canApplyWindowUpdate(const exynos_dpu_data &lastConfigsData,
                              const exynos_dpu_data &newConfigsData,
                              uint32_t index);
-    int mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect);
+    int mergeDamageRect(ExynosDamageRegion &damageRegion);
+    void getWindowUpdateCost(ExynosDamageRegion::UpdateCost &cost);
     int setWindowUpdate(const hwc_rect &merge_rect);
     bool windowUpdateExceptions();
     int handleWindowUpdate();
@@ -1177,11 +1209,7 @@ class ExynosDisplay : public ExynosVsyncHandler {
     void increaseMPPDstBufIndex();
     virtual void initDisplayInterface(uint32_t interfaceType,
                                       void *deviceData, size_t &deviceDataSize);
-    void getDumpLayer();
-    void dumpLayers();
     void setDumpCount(uint32_t dumpCount);
-    void writeDumpData(int32_t frameNo, int32_t layerNo,
-                       layerDumpFrameInfo *frameInfo, layerDumpLayerInfo *layerInfo);
     /* Override for each display's meaning of 'enabled state'
          * Primary : Power on, this function overrided in primary display module
          * Exteranal : Plug-in, default */
@@ -1225,6 +1253,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
   protected:
     Mutex mDisplayMutex;
     ExynosVsyncCallback mVsyncCallback;
+    ExynosVsyncModel mVsyncModel;
+    ExynosDamageRegion mDamageRegion;
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
     PendingConfigInfo mPendConfigInfo;
     virtual bool getHDRException(ExynosLayer *layer,
@@ -1254,34 +1284,82 @@ class ExynosDisplay : public ExynosVsyncHandler {
     std::map<uint32_t, displayTDMInfo> mDisplayTDMInfo;
 };
 
+/*
+ * LayerDumpManager dumps the layers of the next frames to files without
+ * stalling the present. The present only takes the buffer information and
+ * duplicates the fds and the acquire fence of every layer, and gives the
+ * release fences after the present. The copy thread waits for the acquire
+ * fences and copies the buffers as soon as they are ready. The write thread
+ * writes the copies through ExynosLayerDumpFile, compressed unless the
+ * buffer is AFBC, so writing never delays a copy. A frame whose release
+ * fence signals before or during its copy is dropped because the producer
+ * may be drawing the next content into the buffer.
+ *
+ * A frame is dropped if the queue has LAYER_DUMP_FRAME_CNT_MAX frames or
+ * LAYER_DUMP_MAX_QUEUED_BYTES of buffers, and frames closer than the
+ * minimum interval are skipped. The file names keep the frame numbers of
+ * the dropped frames, and the counts are logged when a dump finishes.
+ */
 class LayerDumpManager {
   public:
-    LayerDumpManager();
     LayerDumpManager(ExynosDisplay *display);
     ~LayerDumpManager();
-    int32_t getDumpFrameIndex();
-    int32_t getDumpMaxIndex();
-    layerDumpFrameInfo *getLayerDumpFrameInfo(uint32_t idx);
-    void setCount(uint32_t cnt);
+    /* Dumps @cnt frames */
     void run(uint32_t cnt);
     void stop();
-    void wait();
+    /* True until every requested frame is written */
     bool isRunning();
-    void triggerDumpFrame();
-    void loop();
-    enum class ThreadState {
-        STOPPED = 0,
-        RUN = 1,
-    };
+    bool isCapturing();
+    /* Queues the layers of a frame to be presented, returns the frame number or -1 */
+    int32_t captureFrame(const ExynosSortedLayer &layers);
+    /* Gives the release fences of the layers of @frameNo after the present */
+    void setReleaseFences(int32_t frameNo, const ExynosSortedLayer &layers);
+    void dump(String8 &result);
 
   private:
-    int32_t mDumpFrameIndex GUARDED_BY(mMutex);
-    int32_t mDumpMaxIndex GUARDED_BY(mMutex);
+    struct DumpFrame {
+        int32_t frameNo = 0;
+        std::vector<layerDumpLayerInfo> layers;
+        size_t bytes = 0;
+        bool compress = true;
+        bool copied = false;
+        bool dropped = false;
+    };
+
+    /*
+     * The copy thread copies the buffers as soon as they are ready so
+     * that writing and compressing the files never delays a copy
+     */
+    void copyLoop();
+    void writeLoop();
+    bool copyFrame(DumpFrame &frame);
+    void writeFrame(DumpFrame &frame);
+    void writeLayer(DumpFrame &frame, size_t layerNo);
+    void releaseFrame(DumpFrame &frame);
+    void finishLocked() REQUIRES(mMutex);
+
     ExynosDisplay *mDisplay;
     std::mutex mMutex;
-    ThreadState mState GUARDED_BY(mMutex) = ThreadState::STOPPED;
-    layerDumpFrameInfo mLayerDumpInfo[LAYER_DUMP_FRAME_CNT_MAX];
-    std::thread mThread;
+    std::condition_variable mCondition;
+    std::deque<DumpFrame> mQueue GUARDED_BY(mMutex);
+    size_t mQueuedBytes GUARDED_BY(mMutex) = 0;
+    uint32_t mRemainingFrames GUARDED_BY(mMutex) = 0;
+    bool mRunning GUARDED_BY(mMutex) = false;
+    bool mExit GUARDED_BY(mMutex) = false;
+    int32_t mFrameNo GUARDED_BY(mMutex) = 0;
+    nsecs_t mLastCaptureTime GUARDED_BY(mMutex) = 0;
+    nsecs_t mMinInterval GUARDED_BY(mMutex) = 0;
+    bool mCompress GUARDED_BY(mMutex) = true;
+    std::thread mCopyThread;
+    std::thread mWriteThread;
+
+    /* statistics of the current dump */
+    uint64_t mWrittenFrames GUARDED_BY(mMutex) = 0;
+    uint64_t mDroppedFrames GUARDED_BY(mMutex) = 0;
+    uint64_t mSkippedFrames GUARDED_BY(mMutex) = 0;
+    uint64_t mFailedLayers GUARDED_BY(mMutex) = 0;
+    uint64_t mRawBytes GUARDED_BY(mMutex) = 0;
+    uint64_t mWrittenBytes GUARDED_BY(mMutex) = 0;
 };
 
 #endif  //_EXYNOSDISPLAY_H
@@ -34,6 +34,7 @@ constexpr float DISPLAY_LUMINANCE_UNIT = 10000;
 constexpr float CONSTANT_FOR_DP_MIN_LUMINANCE = 255.0f * 255.0f / 100.0f;
 constexpr auto nsecsPerSec = std::chrono::nanoseconds(1s).count();
 constexpr bool kUseBufferCaching = true;
+constexpr bool kUseDeltaCommit = true;
 
 typedef struct _drmModeAtomicReqItem drmModeAtomicReqItem, *drmModeAtomicReqItemPtr;
 
@@ -52,6 +53,30 @@ struct _drmModeAtomicReq {
 extern struct exynos_hwc_control exynosHWCControl;
 static const int32_t kUmPerInch = 25400;
 
+ANDROID_SINGLETON_STATIC_INSTANCE(DrmCommittedState);
+
+bool DrmCommittedState::isCommitted(int drmFd, uint32_t objectId, uint32_t propertyId,
+                                    uint64_t value) {
+    Mutex::Autolock lock(mMutex);
+    auto device = mValues.find(drmFd);
+    if (device == mValues.end())
+        return false;
+    auto it = device->second.find(key(objectId, propertyId));
+    return (it != device->second.end()) && (it->second == value);
+}
+
+void DrmCommittedState::update(int drmFd, const std::vector<PropertyValue> &values) {
+    Mutex::Autolock lock(mMutex);
+    auto &committed = mValues[drmFd];
+    for (auto &property : values)
+        committed[key(property.objectId, property.propertyId)] = property.value;
+}
+
+void DrmCommittedState::invalidate(int drmFd) {
+    Mutex::Autolock lock(mMutex);
+    mValues.erase(drmFd);
+}
+
 void ExynosDisplayInterface::removeBuffer(const uint64_t &bufferId) {
     static FramebufferManager &fbManager = FramebufferManager::getInstance();
     fbManager.removeBuffer(bufferId);
@@ -63,6 +88,7 @@ ExynosDisplayDrmInterface::ExynosDisplayDrmInterface()
       mDrmConnector(nullptr) {
     mType = INTERFACE_TYPE_DRM;
     mDrmReq.init(this);
+    mDrmReq.setDeltaCommit(kUseDeltaCommit);
 }
 
 ExynosDisplayDrmInterface::~ExynosDisplayDrmInterface() {
@@ -298,9 +324,33 @@ void ExynosDisplayDrmInterface::initDrmDevice(DrmDevice *drmDevice, int drmDispl
               mDisplayIdentifier.name.string(), (unsigned long)EnumId);
     }
 
+    initTrackedProperties();
+
     return;
 }
 
+void ExynosDisplayDrmInterface::initTrackedProperties() {
+    mTrackedObjectIds.clear();
+    mUntrackedPropertyIds.clear();
+
+    mTrackedObjectIds.insert(mDrmCrtc->id());
+    /* These are consumed by each commit */
+    mUntrackedPropertyIds.insert(mDrmCrtc->out_fence_ptr_property().id());
+    mUntrackedPropertyIds.insert(mDrmCrtc->dqe_fd_property().id());
+
+    for (auto &plane : mDrmDevice->planes()) {
+        mTrackedObjectIds.insert(plane->id());
+        mUntrackedPropertyIds.insert(plane->in_fence_fd_property().id());
+        mUntrackedPropertyIds.insert(plane->hdr_fd_property().id());
+        /*
+         * RmFB of a framebuffer on screen disables its plane in the kernel
+         * and fb ids are reused, so the committed values can be stale
+         */
+        mUntrackedPropertyIds.insert(plane->fb_property().id());
+        mUntrackedPropertyIds.insert(plane->crtc_property().id());
+    }
+}
+
 void ExynosDisplayDrmInterface::Callback(
     int display, int64_t timestamp) {
     mVsyncHandler->handleVsync(timestamp);
@@ -391,6 +441,8 @@ int32_t ExynosDisplayDrmInterface::setPowerMode(int32_t mode) {
                                            dpms_value)) != NO_ERROR) {
         HWC_LOGE(mDisplayIdentifier, "setPower mode ret (%d)", ret);
     }
+    /* The driver may reset plane states while the display is powered off */
+    mCommittedState.invalidate(mDrmDevice->fd());
 
     if (mode == HWC_POWER_MODE_OFF) {
         if (mDisplayIdentifier.type == HWC_DISPLAY_VIRTUAL) {
@@ -1585,6 +1637,8 @@ void ExynosDisplayDrmInterface::DrmModeAtomicReq::reset() {
         HWC_LOGE(mDrmDisplayInterface->mDisplayIdentifier, "destroy blob error");
 
     drmModeAtomicSetCursor(mPset, 0);
+    mTrackedValues.clear();
+    mSkippedProperties = 0;
 }
 
 int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
@@ -1598,6 +1652,14 @@ int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
     }
 
     if (property.id()) {
+        bool tracked = mDeltaCommit &&
+                       mDrmDisplayInterface->isTrackedProperty(id, property.id());
+        if (tracked &&
+            mDrmDisplayInterface->mCommittedState.isCommitted(drmFd(), id, property.id(), value)) {
+            mSkippedProperties++;
+            return NO_ERROR;
+        }
+
         int ret = drmModeAtomicAddProperty(mPset, id,
                                            property.id(), value);
         if (ret < 0) {
@@ -1605,6 +1667,9 @@ int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
                      __func__, property.id(), property.name().c_str(), id, ret);
             return ret;
         }
+
+        if (tracked)
+            mTrackedValues.push_back({id, property.id(), value});
     }
 
     return NO_ERROR;
@@ -1689,13 +1754,26 @@ int ExynosDisplayDrmInterface::DrmModeAtomicReq::commit(uint32_t flags, bool log
     android::String8 result;
     int ret = drmModeAtomicCommit(mDrmDisplayInterface->mDrmDevice->fd(),
                                   mPset, flags, mDrmDisplayInterface->mDrmDevice);
-    if (loggingForDebug)
+    if (loggingForDebug) {
         dumpAtomicCommitInfo(result, true);
+        if (mDeltaCommit)
+            HDEBUGLOGD(eDebugDisplayInterfaceConfig, "%s:: %d properties, %u skipped",
+                       __func__, drmModeAtomicGetCursor(mPset), mSkippedProperties);
+    }
     if (ret < 0) {
         HWC_LOGE(mDrmDisplayInterface->mDisplayIdentifier, "commit error");
         setError(ret);
     }
 
+    if (!(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+        DrmCommittedState &committedState = mDrmDisplayInterface->mCommittedState;
+        /* Failed commits and modesets can leave any state in the driver */
+        if ((ret < 0) || !mDeltaCommit || (flags & DRM_MODE_ATOMIC_ALLOW_MODESET))
+            committedState.invalidate(drmFd());
+        else
+            committedState.update(drmFd(), mTrackedValues);
+    }
+
     return ret;
 }
 
@@ -2044,6 +2122,8 @@ bool ExynosDisplayDrmInterface::updateHdrSinkInfo() {
 
 void ExynosDisplayDrmInterface::onDisplayRemoved() {
     mFBManager.onDisplayRemoved(mDisplayIdentifier.type);
+    if (mDrmDevice != nullptr)
+        mCommittedState.invalidate(mDrmDevice->fd());
 }
 
 int32_t ExynosDisplayDrmInterface::setWorkingVsyncPeriodProp(DrmModeAtomicReq &drmReq) {
@@ -21,6 +21,9 @@
 #include <xf86drmMode.h>
 
 #include <unordered_map>
+#include <unordered_set>
+
+#include <utils/Singleton.h>
 
 #include "ExynosDisplay.h"
 #include "ExynosDisplayInterface.h"
@@ -47,6 +50,34 @@ enum drm_virtual8k_split {
     EXYNOS_SPLIT_BOTTOM
 };
 
+/*
+ * Property values of the last successful atomic commits on each drm device.
+ * Displays share planes, so the state is shared by all display interfaces.
+ * A delta commit adds only the properties whose values differ from this state.
+ * Any commit that isn't a delta commit, a modeset or a failed commit
+ * invalidates the state so that the next frame is committed with full state.
+ */
+class DrmCommittedState : public Singleton<DrmCommittedState> {
+  public:
+    struct PropertyValue {
+        uint32_t objectId;
+        uint32_t propertyId;
+        uint64_t value;
+    };
+
+    bool isCommitted(int drmFd, uint32_t objectId, uint32_t propertyId, uint64_t value);
+    void update(int drmFd, const std::vector<PropertyValue> &values);
+    void invalidate(int drmFd);
+
+  private:
+    static uint64_t key(uint32_t objectId, uint32_t propertyId) {
+        return (static_cast<uint64_t>(objectId) << 32) | propertyId;
+    }
+    /* key is drm fd */
+    std::unordered_map<int, std::unordered_map<uint64_t, uint64_t>> mValues;
+    Mutex mMutex;
+};
+
 class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
                                   public VsyncCallback {
   public:
@@ -64,6 +95,11 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         void reset();
         void setError(int err) { mError = err; };
         int getError() { return mError; };
+        /*
+         * Properties that are already committed with the same value
+         * are not added to the delta commit request
+         */
+        void setDeltaCommit(bool deltaCommit) { mDeltaCommit = deltaCommit; };
         int32_t atomicAddProperty(const uint32_t id,
                                   const DrmProperty &property,
                                   uint64_t value, bool optional = false);
@@ -89,6 +125,10 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         drmModeAtomicReqPtr mPset = nullptr;
         int mError = 0;
         ExynosDisplayDrmInterface *mDrmDisplayInterface = NULL;
+        bool mDeltaCommit = false;
+        /* Values that will be committed state if commit succeeds */
+        std::vector<DrmCommittedState::PropertyValue> mTrackedValues;
+        uint32_t mSkippedProperties = 0;
         /* Destroy old blobs after commit */
         std::vector<uint32_t> mOldBlobs;
         int drmFd() const { return mDrmDisplayInterface->mDrmDevice->fd(); }
@@ -155,6 +195,9 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     virtual void onClientTargetDestroyed(void *owner) override {
         mFBManager.removeBuffersForOwner(owner);
     };
+    virtual void prepareBuffer(const exynos_win_config_data &config) override {
+        mFBManager.prepareBuffer(mDisplayIdentifier.type, config);
+    };
 
     struct virtual8KOTFHalfInfo {
         int32_t channelId = -1;
@@ -286,6 +329,12 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
                                            DrmModeAtomicReq &drmReq);
     void flipFBs(bool isActiveCommit);
     int32_t setWorkingVsyncPeriodProp(DrmModeAtomicReq &drmReq);
+    /* Properties of planes and crtc except per-frame properties like fences */
+    bool isTrackedProperty(uint32_t objectId, uint32_t propertyId) const {
+        return (mTrackedObjectIds.count(objectId) != 0) &&
+               (mUntrackedPropertyIds.count(propertyId) == 0);
+    };
+    void initTrackedProperties();
     hwc2_config_t getPreferredModeId() { return mPreferredModeId; };
 
   private:
@@ -346,6 +395,9 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
 
     DrmModeAtomicReq mDrmReq;
     ColorRequest mColorRequest;
+    DrmCommittedState &mCommittedState = DrmCommittedState::getInstance();
+    std::unordered_set<uint32_t> mTrackedObjectIds;
+    std::unordered_set<uint32_t> mUntrackedPropertyIds;
 
   private:
     std::unordered_map</*mode id*/ uint32_t, DrmMode> mDozeDrmModes;
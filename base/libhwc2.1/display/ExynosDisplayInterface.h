@@ -103,6 +103,10 @@ class ExynosDisplayInterface {
     virtual void onLayerDestroyed(hwc2_layer_t __unused layer){};
     virtual void onLayerCreated(hwc2_layer_t __unused layer){};
     virtual void onClientTargetDestroyed(void *__unused owner){};
+    /* A buffer of the config is expected to be presented soon */
+    virtual void prepareBuffer(const exynos_win_config_data __unused &config){};
+    /* The alignment of the partial region, left as it is if there is no restriction */
+    virtual void getPartialRegionAlignment(uint32_t __unused &width, uint32_t __unused &height){};
 
     virtual void canDisableAllPlanes(__unused bool canDisable){};
     virtual uint64_t getWorkingVsyncPeriod() { return 0; };
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#include <unistd.h>
 #include <xf86drm.h>
 #include "exynos_drm_modifier.h"
 #include "ExynosDrmFramebufferManager.h"
@@ -87,6 +88,15 @@ FramebufferManager::~FramebufferManager() {
         mRmFBThread.join();
     }
 
+    {
+        Mutex::Autolock lock(mImportMutex);
+        mImportThreadRunning = false;
+    }
+    mImportCondition.broadcast();
+    if (mImportThread.joinable()) {
+        mImportThread.join();
+    }
+
     releaseAll();
 }
 
@@ -95,6 +105,9 @@ void FramebufferManager::init(int drmFd) {
     mRmFBThreadRunning = true;
     mRmFBThread = std::thread(&FramebufferManager::removeFBsThreadRoutine, this);
     pthread_setname_np(mRmFBThread.native_handle(), "RemoveFBsThread");
+    mImportThreadRunning = true;
+    mImportThread = std::thread(&FramebufferManager::importThreadRoutine, this);
+    pthread_setname_np(mImportThread.native_handle(), "ImportFBsThread");
 }
 
 uint32_t FramebufferManager::getBufHandleFromFd(int fd) {
@@ -119,33 +132,48 @@ int FramebufferManager::addFB2WithModifiers(uint32_t width, uint32_t height, uin
     return ret;
 }
 
-bool FramebufferManager::canRemoveBuffer(const std::unique_ptr<Framebuffer> &frameBuf) {
-    for (uint32_t i = 0; i < HWC_NUM_DISPLAY_TYPES; i++) {
-        /* Can't remove framebuffer in active commit */
-        if (mLastActiveCommitTime[i] &&
-            mLastActiveCommitTime[i] == frameBuf->lastActiveTime[i]) {
-            return false;
-        }
+bool FramebufferManager::canRemoveBuffer(const Shard &shard,
+                                         const std::unique_ptr<Framebuffer> &frameBuf) {
+    /* Can't remove framebuffer in active commit */
+    if (shard.mLastActiveCommitTime &&
+        shard.mLastActiveCommitTime == frameBuf->lastActiveTime) {
+        return false;
     }
     return true;
 }
 
-void FramebufferManager::fillCleanupBuffer() {
-    auto it = mCachedBuffers.end();
+void FramebufferManager::retireCachedBuffer(Shard &shard, FBList::iterator it) {
+    auto range = shard.mCachedIndex.equal_range((*it)->key());
+    for (auto indexIt = range.first; indexIt != range.second; indexIt++) {
+        if (indexIt->second == it) {
+            shard.mCachedIndex.erase(indexIt);
+            break;
+        }
+    }
+    shard.mCleanupBuffers.splice(shard.mCleanupBuffers.end(), shard.mCachedBuffers, it);
+}
+
+void FramebufferManager::fillCleanupBuffer(Shard &shard) {
+    if (shard.mCachedBuffers.size() <= MAX_CACHED_BUFFERS)
+        return;
+
+    auto it = shard.mCachedBuffers.end();
     it--;
-    while (mCachedBuffers.size() > MAX_CACHED_BUFFERS) {
+    while (shard.mCachedBuffers.size() > MAX_CACHED_BUFFERS) {
         bool stop = false;
         /*
          * MAX_CACHED_BUFFERS is more than 2,
          * it-- whouldn't be out of range
          */
         auto const cit = it;
-        if (it == mCachedBuffers.begin())
+        if (it == shard.mCachedBuffers.begin())
             stop = true;
         else
             it--;
-        if (canRemoveBuffer(*cit))
-            mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
+        if (canRemoveBuffer(shard, *cit)) {
+            retireCachedBuffer(shard, cit);
+            shard.mStats.evictions++;
+        }
 
         if (stop)
             break;
@@ -161,9 +189,11 @@ void FramebufferManager::removeFBsThreadRoutine() {
                 break;
             }
             mCondition.wait(mMutex);
-            fillCleanupBuffer();
-            cleanupBuffers.splice(cleanupBuffers.end(), mCleanupBuffers,
-                                  mCleanupBuffers.begin(), mCleanupBuffers.end());
+        }
+        for (auto &shard : mShards) {
+            Mutex::Autolock lock(shard.mMutex);
+            fillCleanupBuffer(shard);
+            cleanupBuffers.splice(cleanupBuffers.end(), shard.mCleanupBuffers);
         }
         ATRACE_BEGIN("cleanup framebuffers");
         cleanupBuffers.clear();
@@ -171,27 +201,14 @@ void FramebufferManager::removeFBsThreadRoutine() {
     }
 }
 
-int32_t FramebufferManager::getBuffer(const uint32_t displayType,
-                                      const exynos_win_config_data &config,
-                                      uint32_t &fbId, const bool caching) {
-    int ret = NO_ERROR;
+int32_t FramebufferManager::getFramebufferInfo(const exynos_win_config_data &config,
+                                               FramebufferInfo &info) {
     int drmFormat = DRM_FORMAT_UNDEFINED;
     uint32_t bpp = 0;
-    uint32_t pitches[HWC_DRM_BO_MAX_PLANES] = {0};
-    uint32_t offsets[HWC_DRM_BO_MAX_PLANES] = {0};
-    uint64_t modifiers[HWC_DRM_BO_MAX_PLANES] = {0};
-    uint32_t bufferNum, planeNum = 0;
-    BufHandles handles = {0};
-    uint32_t bufWidth, bufHeight = 0;
-
-    funcReturnCallback retCallback([&]() {
-        if (config.state != config.WIN_STATE_COLOR) {
-            for (uint32_t i = 0; i < bufferNum; i++) {
-                if (handles[i])
-                    freeBufHandle(mDrmFd, handles[i]);
-            }
-        }
-    });
+    uint32_t bufWidth = 0, bufHeight = 0;
+    uint32_t *pitches = info.pitches;
+    uint32_t *offsets = info.offsets;
+    uint64_t *modifiers = info.modifiers;
 
     if (config.protection)
         modifiers[0] |= DRM_FORMAT_MOD_PROTECTION;
@@ -215,15 +232,15 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
         }
 
         bpp = getBytePerPixelOfPrimaryPlane(formatDesc.halFormat);
-        if ((bufferNum = formatDesc.bufferNum) == 0) {
+        if ((info.bufferNum = formatDesc.bufferNum) == 0) {
             HWC_LOGE_NODISP("%s:: getBufferNumOfFormat(%s) error",
                             __func__, formatDesc.name.string());
             return -EINVAL;
         }
-        if (((planeNum = formatDesc.planeNum) == 0) ||
-            (planeNum > MAX_PLANE_NUM)) {
+        if (((info.planeNum = formatDesc.planeNum) == 0) ||
+            (info.planeNum > MAX_PLANE_NUM)) {
             HWC_LOGE_NODISP("%s:: getPlaneNumOfFormat(%s) error, planeNum(%d)",
-                            __func__, formatDesc.name.string(), planeNum);
+                            __func__, formatDesc.name.string(), info.planeNum);
             return -EINVAL;
         }
 
@@ -244,7 +261,7 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
             uint32_t compressed_block_size = config.compressionInfo.SAJCMaxBlockSize;
             modifiers[0] |= DRM_FORMAT_MOD_SAMSUNG_SAJC(compressed_block_size);
             //SAJC buffer has 2 planes//
-            planeNum++;
+            info.planeNum++;
         } else {
             modifiers[0] |= getSBWCModifierBits(formatDesc);
         }
@@ -260,16 +277,16 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
         }
 #endif
 
-        for (uint32_t bufferIndex = 0; bufferIndex < bufferNum; bufferIndex++) {
+        for (uint32_t bufferIndex = 0; bufferIndex < info.bufferNum; bufferIndex++) {
             pitches[bufferIndex] = config.src.f_w * bpp;
             modifiers[bufferIndex] = modifiers[0];
         }
 
-        if ((bufferNum == 1) && (planeNum > bufferNum)) {
+        if ((info.bufferNum == 1) && (info.planeNum > info.bufferNum)) {
             /* offset for cbcr */
             if (config.compressionInfo.type == COMP_TYPE_SAJC)
                 offsets[SAJC_KEY_INDEX] = config.compressionInfo.SAJCHeaderOffset;
-            for (uint32_t planeIndex = 1; planeIndex < planeNum; planeIndex++) {
+            for (uint32_t planeIndex = 1; planeIndex < info.planeNum; planeIndex++) {
                 pitches[planeIndex] = pitches[0];
                 modifiers[planeIndex] = modifiers[0];
             }
@@ -279,7 +296,7 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
         bufHeight = config.dst.h;
         modifiers[0] |= DRM_FORMAT_MOD_SAMSUNG_COLORMAP;
         drmFormat = DRM_FORMAT_BGRA8888;
-        handles[0] = 0xff000000;
+        info.colorMap = true;
         bpp = getBytePerPixelOfPrimaryPlane(HAL_PIXEL_FORMAT_BGRA_8888);
         pitches[0] = config.dst.w * bpp;
     } else {
@@ -288,83 +305,293 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
         return -EINVAL;
     }
 
-    if (caching) {
-        Mutex::Autolock lock(mMutex);
-        auto it =
-            std::find_if(mCachedBuffers.begin(), mCachedBuffers.end(),
-                         [&config, &drmFormat, &bufWidth, &bufHeight, &modifiers](auto &buffer) { return (buffer->bufferId == config.buffer_id) &&
-                                                                                                         (buffer->format == drmFormat) &&
-                                                                                                         (buffer->width == bufWidth) &&
-                                                                                                         (buffer->height == bufHeight) &&
-                                                                                                         (buffer->modifier == modifiers[0]); });
-        if (it != mCachedBuffers.end()) {
-            fbId = (*it)->fbId;
-            mStagingBuffers.splice(mStagingBuffers.end(), mCachedBuffers, it);
-            return NO_ERROR;
+    info.key = {config.buffer_id, static_cast<uint32_t>(drmFormat), bufWidth, bufHeight,
+                modifiers[0]};
+    return NO_ERROR;
+}
+
+int32_t FramebufferManager::addFramebuffer(Shard &shard, const FramebufferInfo &info,
+                                           const int fds[], uint32_t &fbId) {
+    BufHandles handles = {0};
+    const uint32_t *pitches = info.pitches;
+    const uint32_t *offsets = info.offsets;
+    const uint64_t *modifiers = info.modifiers;
+    int drmFormat = info.key.format;
+
+    /*
+     * The gem handles of the drm fd are not reference counted. The import
+     * thread and the present can import the same buffer and get the same
+     * handle, so one must not close it before the other has added its
+     * framebuffer.
+     */
+    Mutex::Autolock handleLock(mHandleMutex);
+    funcReturnCallback retCallback([&]() {
+        if (!info.colorMap) {
+            for (uint32_t i = 0; i < info.bufferNum; i++) {
+                if (handles[i])
+                    freeBufHandle(mDrmFd, handles[i]);
+            }
         }
-    }
+    });
 
-    /* Get handles only if buffer is not in cache */
-    if (config.state != config.WIN_STATE_COLOR) {
-        for (uint32_t bufferIndex = 0; bufferIndex < bufferNum; bufferIndex++) {
-            handles[bufferIndex] = getBufHandleFromFd(config.fd_idma[bufferIndex]);
+    if (info.colorMap) {
+        handles[0] = 0xff000000;
+    } else {
+        for (uint32_t bufferIndex = 0; bufferIndex < info.bufferNum; bufferIndex++) {
+            handles[bufferIndex] = getBufHandleFromFd(fds[bufferIndex]);
             if (handles[bufferIndex] == 0) {
                 return -EINVAL;
             }
         }
-        if ((bufferNum == 1) && (planeNum > bufferNum)) {
-            for (uint32_t planeIndex = 1; planeIndex < planeNum; planeIndex++) {
+        if ((info.bufferNum == 1) && (info.planeNum > info.bufferNum)) {
+            for (uint32_t planeIndex = 1; planeIndex < info.planeNum; planeIndex++) {
                 handles[planeIndex] = handles[0];
             }
         }
     }
 
-    ret = addFB2WithModifiers(bufWidth, bufHeight, drmFormat, handles, pitches, offsets, modifiers,
-                              &fbId, modifiers[0] ? DRM_MODE_FB_MODIFIERS : 0);
+    int ret = addFB2WithModifiers(info.key.width, info.key.height, drmFormat, handles, pitches,
+                                  offsets, modifiers, &fbId,
+                                  modifiers[0] ? DRM_MODE_FB_MODIFIERS : 0);
+
+    {
+        Mutex::Autolock lock(shard.mMutex);
+        shard.mStats.addFB2Calls++;
+        if (ret)
+            shard.mStats.addFB2Failures++;
+    }
 
     if (ret) {
         HWC_LOGE_NODISP(
-            "%s:: Failed to add FB, fb_id(%d), ret(%d), f_w: %d, f_h: %d, dst.w: %d, dst.h: %d, "
+            "%s:: Failed to add FB, fb_id(%d), ret(%d), width: %d, height: %d, "
             "format: %d %4.4s, buf_handles[%d, %d, %d, %d], "
             "pitches[%d, %d, %d, %d], offsets[%d, %d, %d, %d], modifiers[%#" PRIx64 ", %#" PRIx64
             ", %#" PRIx64 ", %#" PRIx64 "]",
-            __func__, fbId, ret, config.src.f_w, config.src.f_h, config.dst.w, config.dst.h,
+            __func__, fbId, ret, info.key.width, info.key.height,
             drmFormat, (char *)&drmFormat, handles[0], handles[1], handles[2], handles[3],
             pitches[0], pitches[1], pitches[2], pitches[3], offsets[0], offsets[1], offsets[2],
             offsets[3], modifiers[0], modifiers[1], modifiers[2], modifiers[3]);
+    }
+    return ret;
+}
+
+bool FramebufferManager::stageCachedBuffer(Shard &shard, const FramebufferKey &key,
+                                           uint32_t &fbId) {
+    auto indexIt = shard.mCachedIndex.find(key);
+    if (indexIt == shard.mCachedIndex.end())
+        return false;
+
+    auto it = indexIt->second;
+    fbId = (*it)->fbId;
+    if ((*it)->prepared) {
+        (*it)->prepared = false;
+        shard.mStats.preparedHits++;
+    }
+    shard.mCachedIndex.erase(indexIt);
+    shard.mStagingBuffers.splice(shard.mStagingBuffers.end(), shard.mCachedBuffers, it);
+    shard.mStats.hits++;
+    return true;
+}
+
+int32_t FramebufferManager::getBuffer(const uint32_t displayType,
+                                      const exynos_win_config_data &config,
+                                      uint32_t &fbId, const bool caching) {
+    FramebufferInfo info;
+    int ret = getFramebufferInfo(config, info);
+    if (ret)
         return ret;
+
+    Shard &shard = mShards[displayType];
+    if (caching) {
+        {
+            Mutex::Autolock lock(shard.mMutex);
+            if (stageCachedBuffer(shard, info.key, fbId))
+                return NO_ERROR;
+        }
+
+        /* The import thread may be adding this framebuffer */
+        if (waitForImport(displayType, info.key)) {
+            Mutex::Autolock lock(shard.mMutex);
+            shard.mStats.importWaits++;
+            if (stageCachedBuffer(shard, info.key, fbId))
+                return NO_ERROR;
+        }
+
+        Mutex::Autolock lock(shard.mMutex);
+        shard.mStats.misses++;
     }
 
+    /* Get handles only if buffer is not in cache */
+    ret = addFramebuffer(shard, info, config.fd_idma, fbId);
+    if (ret)
+        return ret;
+
     if (caching) {
-        Mutex::Autolock lock(mMutex);
-        mStagingBuffers.emplace_back(new Framebuffer(mDrmFd, config.buffer_id,
-                                                     displayType, config.owner,
-                                                     drmFormat, bufWidth, bufHeight,
-                                                     modifiers[0], fbId));
+        Mutex::Autolock lock(shard.mMutex);
+        shard.mStagingBuffers.emplace_back(new Framebuffer(mDrmFd, config.buffer_id,
+                                                           displayType, config.owner,
+                                                           info.key.format, info.key.width,
+                                                           info.key.height, info.key.modifier,
+                                                           fbId));
     }
 
     return NO_ERROR;
 }
 
+void FramebufferManager::prepareBuffer(const uint32_t displayType,
+                                       const exynos_win_config_data &config) {
+    if ((displayType >= HWC_NUM_DISPLAY_TYPES) || (config.state != config.WIN_STATE_BUFFER))
+        return;
+
+    ImportRequest request;
+    request.displayType = displayType;
+    request.owner = config.owner;
+    if (getFramebufferInfo(config, request.info))
+        return;
+
+    Shard &shard = mShards[displayType];
+    {
+        Mutex::Autolock lock(shard.mMutex);
+        if (shard.mCachedIndex.count(request.info.key))
+            return;
+    }
+
+    Mutex::Autolock lock(mImportMutex);
+    if (!mImportThreadRunning)
+        return;
+    if (mImporting && (mImportingDisplayType == displayType) &&
+        (mImportingKey == request.info.key))
+        return;
+    for (auto &queued : mImportQueue) {
+        if ((queued.displayType == displayType) && (queued.info.key == request.info.key))
+            return;
+    }
+
+    /* The layer may release the buffer before the import */
+    for (uint32_t i = 0; i < kIdmaFdNum; i++)
+        request.fds[i] = -1;
+    for (uint32_t i = 0; i < request.info.bufferNum; i++) {
+        request.fds[i] = dup(config.fd_idma[i]);
+        if (request.fds[i] < 0) {
+            closeImportRequest(request);
+            return;
+        }
+    }
+    mImportQueue.push_back(request);
+    mImportCondition.broadcast();
+}
+
+void FramebufferManager::closeImportRequest(ImportRequest &request) {
+    for (auto &fd : request.fds) {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+}
+
+bool FramebufferManager::waitForImport(const uint32_t displayType, const FramebufferKey &key) {
+    Mutex::Autolock lock(mImportMutex);
+    for (auto it = mImportQueue.begin(); it != mImportQueue.end(); it++) {
+        if ((it->displayType == displayType) && (it->info.key == key)) {
+            /* Not started yet, the caller adds it now */
+            closeImportRequest(*it);
+            mImportQueue.erase(it);
+            return false;
+        }
+    }
+
+    if (!mImporting || (mImportingDisplayType != displayType) || !(mImportingKey == key))
+        return false;
+
+    ATRACE_NAME("wait for framebuffer import");
+    while (mImporting && (mImportingDisplayType == displayType) && (mImportingKey == key))
+        mImportCondition.wait(mImportMutex);
+    return true;
+}
+
+void FramebufferManager::importThreadRoutine() {
+    while (true) {
+        ImportRequest request;
+        {
+            Mutex::Autolock lock(mImportMutex);
+            while (mImportThreadRunning && mImportQueue.empty())
+                mImportCondition.wait(mImportMutex);
+            if (!mImportThreadRunning)
+                break;
+            request = mImportQueue.front();
+            mImportQueue.pop_front();
+            mImporting = true;
+            mImportingDisplayType = request.displayType;
+            mImportingOwner = request.owner;
+            mImportingKey = request.info.key;
+            mImportCancelled = false;
+        }
+
+        ATRACE_NAME("prepare framebuffer");
+        Shard &shard = mShards[request.displayType];
+        uint32_t fbId = 0;
+        if (addFramebuffer(shard, request.info, request.fds.data(), fbId) == NO_ERROR) {
+            Mutex::Autolock lock(shard.mMutex);
+            /*
+             * removeBufferInternal() marks the cancel before it scans the cache
+             * under the shard lock, so the buffer is either seen there or dropped here
+             */
+            if (mImportCancelled) {
+                drmModeRmFB(mDrmFd, fbId);
+            } else {
+                const FramebufferKey &key = request.info.key;
+                shard.mCachedBuffers.emplace_front(new Framebuffer(mDrmFd, key.bufferId,
+                                                                   request.displayType,
+                                                                   request.owner, key.format,
+                                                                   key.width, key.height,
+                                                                   key.modifier, fbId));
+                shard.mCachedBuffers.front()->prepared = true;
+                shard.mCachedIndex.emplace(key, shard.mCachedBuffers.begin());
+                shard.mStats.prepared++;
+            }
+        }
+        closeImportRequest(request);
+
+        {
+            Mutex::Autolock lock(mImportMutex);
+            mImporting = false;
+            mImportCondition.broadcast();
+        }
+        cleanupSignal(false);
+    }
+}
+
 void FramebufferManager::flip(uint32_t displayType, bool isActiveCommit) {
     {
-        Mutex::Autolock lock(mMutex);
+        Shard &shard = mShards[displayType];
+        Mutex::Autolock lock(shard.mMutex);
         nsecs_t time = systemTime(SYSTEM_TIME_MONOTONIC);
         if (isActiveCommit)
             updateLastActiveCommitTime(displayType, time);
-        for (auto &it : mStagingBuffers) {
+        for (auto it = shard.mStagingBuffers.begin(); it != shard.mStagingBuffers.end(); it++) {
             if (isActiveCommit)
-                it->updateLastActiveTime(displayType, time);
+                (*it)->updateLastActiveTime(time);
+            shard.mCachedIndex.emplace((*it)->key(), it);
         }
-        mCachedBuffers.splice(mCachedBuffers.begin(), mStagingBuffers);
+        shard.mCachedBuffers.splice(shard.mCachedBuffers.begin(), shard.mStagingBuffers);
     }
     cleanupSignal(false);
 }
 
 void FramebufferManager::releaseAll() {
-    Mutex::Autolock lock(mMutex);
-    mStagingBuffers.clear();
-    mCachedBuffers.clear();
+    {
+        Mutex::Autolock lock(mImportMutex);
+        for (auto &request : mImportQueue)
+            closeImportRequest(request);
+        mImportQueue.clear();
+    }
+    for (auto &shard : mShards) {
+        Mutex::Autolock lock(shard.mMutex);
+        shard.mStagingBuffers.clear();
+        shard.mCachedIndex.clear();
+        shard.mCachedBuffers.clear();
+        shard.mCleanupBuffers.clear();
+    }
 }
 
 void FramebufferManager::onDisplayRemoved(const uint32_t displayType) {
@@ -375,49 +602,93 @@ void FramebufferManager::onDisplayRemoved(const uint32_t displayType) {
          * after this function call so active commit time wouldn't be
          * added after this function call.
          */
-        Mutex::Autolock lock(mMutex);
-        mLastActiveCommitTime[displayType] = 0;
+        Mutex::Autolock lock(mShards[displayType].mMutex);
+        mShards[displayType].mLastActiveCommitTime = 0;
     }
     removeBuffersForDisplay(displayType);
 }
 
-void FramebufferManager::removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc) {
+void FramebufferManager::removeBufferInternal(
+    std::function<bool(uint64_t bufferId, uint32_t displayType, const void *owner)> compareFunc) {
     {
-        Mutex::Autolock lock(mMutex);
-        FBList::iterator it = mCachedBuffers.begin();
-        while (it != mCachedBuffers.end()) {
+        Mutex::Autolock lock(mImportMutex);
+        for (auto it = mImportQueue.begin(); it != mImportQueue.end();) {
+            if (compareFunc(it->info.key.bufferId, it->displayType, it->owner)) {
+                closeImportRequest(*it);
+                it = mImportQueue.erase(it);
+            } else {
+                it++;
+            }
+        }
+        /* Don't let the import thread cache a buffer removed under it */
+        if (mImporting && compareFunc(mImportingKey.bufferId, mImportingDisplayType,
+                                      mImportingOwner))
+            mImportCancelled = true;
+    }
+
+    bool needSignal = false;
+    for (auto &shard : mShards) {
+        Mutex::Autolock lock(shard.mMutex);
+        FBList::iterator it = shard.mCachedBuffers.begin();
+        while (it != shard.mCachedBuffers.end()) {
             auto const cit = it;
             it++;
-            if ((*cit)->removePending || compareFunc(*cit)) {
-                if (canRemoveBuffer(*cit)) {
-                    mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
+            if ((*cit)->removePending ||
+                compareFunc((*cit)->bufferId, (*cit)->displayType, (*cit)->owner)) {
+                if (canRemoveBuffer(shard, *cit)) {
+                    retireCachedBuffer(shard, cit);
+                    shard.mStats.removals++;
                 } else {
                     (*cit)->pendRemove();
                 }
             }
         }
+        if (shard.mCleanupBuffers.size() > 0)
+            needSignal = true;
     }
-    if (mCleanupBuffers.size() > 0)
+    if (needSignal)
         mCondition.signal();
 }
-
 void FramebufferManager::removeBuffer(const uint64_t &bufferId) {
-    auto compareFunc = [=](const std::unique_ptr<Framebuffer> &buf) {
-        return (buf->bufferId == bufferId);
+    auto compareFunc = [=](uint64_t bufId, uint32_t, const void *) {
+        return (bufId == bufferId);
     };
     removeBufferInternal(compareFunc);
 }
 
 void FramebufferManager::removeBuffersForDisplay(const uint32_t displayType) {
-    auto compareFunc = [=](const std::unique_ptr<Framebuffer> &buf) {
-        return (buf->displayType == displayType);
+    auto compareFunc = [=](uint64_t, uint32_t type, const void *) {
+        return (type == displayType);
     };
     removeBufferInternal(compareFunc);
 }
 
 void FramebufferManager::removeBuffersForOwner(const void *owner) {
-    auto compareFunc = [=](const std::unique_ptr<Framebuffer> &buf) {
-        return (buf->owner == owner);
+    auto compareFunc = [=](uint64_t, uint32_t, const void *bufOwner) {
+        return (bufOwner == owner);
     };
     removeBufferInternal(compareFunc);
 }
+
+void FramebufferManager::dump(String8 &result) {
+    result.appendFormat("Framebuffer cache (max %u per display)\n", MAX_CACHED_BUFFERS);
+    for (uint32_t i = 0; i < HWC_NUM_DISPLAY_TYPES; i++) {
+        Shard &shard = mShards[i];
+        Mutex::Autolock lock(shard.mMutex);
+        const Stats &stats = shard.mStats;
+        uint64_t lookups = stats.hits + stats.misses;
+        if ((lookups == 0) && (stats.addFB2Calls == 0))
+            continue;
+        result.appendFormat("\tdisplay type(%u): cached(%zu), staging(%zu), "
+                            "hits(%" PRIu64 "), misses(%" PRIu64 "), hit rate(%.1f%%), "
+                            "addFB2(%" PRIu64 ", failed: %" PRIu64 "), "
+                            "evictions(%" PRIu64 "), removals(%" PRIu64 "), "
+                            "prepared(%" PRIu64 ", hits: %" PRIu64 ", waits: %" PRIu64 ")\n",
+                            i, shard.mCachedBuffers.size(), shard.mStagingBuffers.size(),
+                            stats.hits, stats.misses,
+                            lookups ? (stats.hits * 100.0 / lookups) : 0.0,
+                            stats.addFB2Calls, stats.addFB2Failures,
+                            stats.evictions, stats.removals,
+                            stats.prepared, stats.preparedHits, stats.importWaits);
+    }
+}
@@ -19,9 +19,14 @@
 #include <sys/types.h>
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
 #include <list>
 #include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <thread>
+#include <unordered_map>
 #include <xf86drmMode.h>
 #include <utils/Singleton.h>
 #include "ExynosHWCTypes.h"
@@ -50,6 +55,11 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     // when frame is committed
     int32_t getBuffer(const uint32_t displayType, const exynos_win_config_data &config, uint32_t &fbId, const bool caching);
 
+    // add the framebuffer of a config that is expected to be presented soon on the import
+    // thread and put it in the cached buffers, so getBuffer() of the present finds it.
+    // this is called when a buffer arrives, the fds of the config are duplicated
+    void prepareBuffer(const uint32_t displayType, const exynos_win_config_data &config);
+
     // this should be called after frame update
     // this will move all staged buffers to front of the cached buffers queue
     // This will also schedule a cleanup of cached buffers if cached buffer list goes
@@ -60,7 +70,7 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     void releaseAll();
 
     void updateLastActiveCommitTime(uint32_t displayType, nsecs_t time) {
-        mLastActiveCommitTime[displayType] = time;
+        mShards[displayType].mLastActiveCommitTime = time;
     };
 
     void onDisplayRemoved(const uint32_t displayId);
@@ -68,9 +78,9 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     void cleanupSignal(bool hasLayerNumChange = true) {
         bool needSignal = false;
         uint32_t maxCacheBuffer = hasLayerNumChange ? MAX_CACHED_BUFFERS : MAX_CACHED_BUFFERS_NO_LAYER_NUM_CHANGE;
-        {
-            Mutex::Autolock lock(mMutex);
-            if (mCachedBuffers.size() > maxCacheBuffer)
+        for (auto &shard : mShards) {
+            Mutex::Autolock lock(shard.mMutex);
+            if (shard.mCachedBuffers.size() > maxCacheBuffer)
                 needSignal = true;
         }
         if (needSignal)
@@ -81,8 +91,34 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     void removeBuffersForDisplay(const uint32_t displayType);
     void removeBuffersForOwner(const void *owner);
 
+    void dump(String8 &result);
+
   private:
     uint32_t getBufHandleFromFd(int fd);
+    // identifies a framebuffer in the cache
+    struct FramebufferKey {
+        uint64_t bufferId;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint64_t modifier;
+
+        bool operator==(const FramebufferKey &rhs) const {
+            return (bufferId == rhs.bufferId) && (format == rhs.format) &&
+                    (width == rhs.width) && (height == rhs.height) &&
+                    (modifier == rhs.modifier);
+        };
+    };
+    struct FramebufferKeyHash {
+        size_t operator()(const FramebufferKey &key) const {
+            size_t hash = std::hash<uint64_t>()(key.bufferId);
+            for (uint64_t value : {static_cast<uint64_t>(key.format),
+                                   (static_cast<uint64_t>(key.width) << 32) | key.height,
+                                   key.modifier})
+                hash ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        };
+    };
     // this struct should contain elements that can be used to identify framebuffer more easily
     struct Framebuffer {
         Framebuffer(int _drmFd, uint64_t _bufferId, uint32_t _displayType,
@@ -94,10 +130,13 @@ class FramebufferManager : public Singleton<FramebufferManager> {
         ~Framebuffer() {
             drmModeRmFB(drmFd, fbId);
         };
-        void updateLastActiveTime(uint32_t displayType, nsecs_t time) {
-            lastActiveTime[displayType] = time;
+        void updateLastActiveTime(nsecs_t time) {
+            lastActiveTime = time;
         };
         void pendRemove() { removePending = true; };
+        FramebufferKey key() const {
+            return {bufferId, format, width, height, modifier};
+        };
 
         uint32_t displayType;
         void *owner;
@@ -113,10 +152,68 @@ class FramebufferManager : public Singleton<FramebufferManager> {
 
         uint32_t fbId;
         int drmFd;
-        nsecs_t lastActiveTime[HWC_NUM_DISPLAY_TYPES] = {0};
+        nsecs_t lastActiveTime = 0;
         bool removePending;
+        // added by the import thread and not presented yet
+        bool prepared = false;
     };
     using FBList = std::list<std::unique_ptr<Framebuffer>>;
+    // Several framebuffers can share a key if the same buffer is staged twice in a frame
+    using FBIndex = std::unordered_multimap<FramebufferKey, FBList::iterator, FramebufferKeyHash>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t addFB2Calls = 0;
+        uint64_t addFB2Failures = 0;
+        uint64_t evictions = 0;
+        uint64_t removals = 0;
+        uint64_t prepared = 0;
+        // lookups that found a prepared framebuffer
+        uint64_t preparedHits = 0;
+        // lookups that waited for the import thread
+        uint64_t importWaits = 0;
+    };
+
+    // the framebuffer parameters of a config
+    struct FramebufferInfo {
+        FramebufferKey key;
+        uint32_t bufferNum = 0;
+        uint32_t planeNum = 0;
+        uint32_t pitches[HWC_DRM_BO_MAX_PLANES] = {0};
+        uint32_t offsets[HWC_DRM_BO_MAX_PLANES] = {0};
+        uint64_t modifiers[HWC_DRM_BO_MAX_PLANES] = {0};
+        bool colorMap = false;
+    };
+
+    struct ImportRequest {
+        uint32_t displayType;
+        void *owner;
+        FramebufferInfo info;
+        // duplicated fds of the buffer
+        std::array<int, kIdmaFdNum> fds;
+    };
+
+    /*
+     * Buffers are cached per display type. A framebuffer is staged and flipped
+     * by the display that requested it, so a display never waits for
+     * the lock held by another display and flip() of a display doesn't
+     * commit buffers staged by another display.
+     */
+    struct Shard {
+        // buffers that are going to be committed in the next atomic frame update
+        FBList mStagingBuffers;
+        // unused buffers that have been used recently, front of the queue has the most recently
+        // used ones
+        FBList mCachedBuffers;
+        // index of mCachedBuffers, the iterators stay valid while the nodes are spliced
+        FBIndex mCachedIndex;
+        // buffers that are going to be removed
+        FBList mCleanupBuffers;
+        nsecs_t mLastActiveCommitTime = 0;
+        Stats mStats;
+        Mutex mMutex;
+    };
 
     int addFB2WithModifiers(uint32_t width, uint32_t height, uint32_t pixel_format,
                             const BufHandles handles, const uint32_t pitches[4],
@@ -124,29 +221,52 @@ class FramebufferManager : public Singleton<FramebufferManager> {
                             uint32_t flags);
 
     void removeFBsThreadRoutine();
+    void importThreadRoutine();
+
+    int32_t getFramebufferInfo(const exynos_win_config_data &config, FramebufferInfo &info);
+    int32_t addFramebuffer(Shard &shard, const FramebufferInfo &info, const int fds[],
+                           uint32_t &fbId);
+    // finds a cached framebuffer and moves it to the staging buffers
+    bool stageCachedBuffer(Shard &shard, const FramebufferKey &key, uint32_t &fbId)
+        REQUIRES(shard.mMutex);
+    // drops the queued import of the key, or waits for it if it is in progress.
+    // returns true if the import thread added the framebuffer
+    bool waitForImport(const uint32_t displayType, const FramebufferKey &key);
+    void closeImportRequest(ImportRequest &request);
 
-    bool canRemoveBuffer(const std::unique_ptr<Framebuffer> &frameBuf)
-        REQUIRES(mMutex);
-    void removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc);
+    bool canRemoveBuffer(const Shard &shard, const std::unique_ptr<Framebuffer> &frameBuf)
+        REQUIRES(shard.mMutex);
+    void removeBufferInternal(std::function<bool(uint64_t bufferId, uint32_t displayType,
+                                                 const void *owner)> compareFunc);
+    // Move a cached framebuffer to the cleanup list of the shard
+    void retireCachedBuffer(Shard &shard, FBList::iterator it) REQUIRES(shard.mMutex);
     // Put the framebuffers at the back of the cached buffer queue that go beyond
     // MAX_CACHED_BUFFERS to the FBList. Framebuffers in the FBList would be
     // released by removeFBsThreadRoutine()
-    void fillCleanupBuffer();
+    void fillCleanupBuffer(Shard &shard) REQUIRES(shard.mMutex);
 
-    // buffers that are going to be committed in the next atomic frame update
-    FBList mStagingBuffers;
-    // unused buffers that have been used recently, front of the queue has the most recently used
-    // ones
-    FBList mCachedBuffers;
-    // buffers that are going to be removed
-    FBList mCleanupBuffers;
+    std::array<Shard, HWC_NUM_DISPLAY_TYPES> mShards;
 
     int mDrmFd = -1;
-    nsecs_t mLastActiveCommitTime[HWC_NUM_DISPLAY_TYPES] = {0};
 
     std::thread mRmFBThread;
     bool mRmFBThreadRunning = false;
     Condition mCondition;
     Mutex mMutex;
+
+    std::thread mImportThread;
+    bool mImportThreadRunning = false;
+    std::deque<ImportRequest> mImportQueue;
+    // the request that the import thread is adding
+    bool mImporting = false;
+    uint32_t mImportingDisplayType = 0;
+    const void *mImportingOwner = nullptr;
+    FramebufferKey mImportingKey;
+    // the buffer was removed while the import thread was adding it
+    std::atomic<bool> mImportCancelled{false};
+    Condition mImportCondition;
+    Mutex mImportMutex;
+    // held from getting the gem handles to closing them in addFramebuffer()
+    Mutex mHandleMutex;
 };
 #endif
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+#include <algorithm>
+#include "ExynosLayerDump.h"
+
+static constexpr uint32_t HASH_BITS = 16;
+static constexpr uint32_t NO_POSITION = UINT32_MAX;
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t readLe32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void writeLe32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static inline uint32_t hash32(uint32_t v) {
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/* Writes the extra bytes of a length of 15 or more in the token */
+static inline bool writeLength(uint8_t *dst, size_t dstSize, size_t &op, size_t length) {
+    for (length -= 15; length >= 255; length -= 255) {
+        if (op >= dstSize)
+            return false;
+        dst[op++] = 255;
+    }
+    if (op >= dstSize)
+        return false;
+    dst[op++] = length;
+    return true;
+}
+
+static inline bool readLength(const uint8_t *src, size_t srcSize, size_t &ip, size_t &length) {
+    uint8_t byte;
+    do {
+        if (ip >= srcSize)
+            return false;
+        byte = src[ip++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/* A sequence of literals, followed by a match if @matchLength is not 0 */
+static bool writeSequence(const uint8_t *literals, size_t literalLength,
+                          size_t offset, size_t matchLength,
+                          uint8_t *dst, size_t dstSize, size_t &op) {
+    if (op >= dstSize)
+        return false;
+    size_t token = op++;
+    size_t matchCode = matchLength ? matchLength - ExynosLayerDumpFile::MIN_MATCH : 0;
+    dst[token] = (std::min(literalLength, (size_t)15) << 4) | std::min(matchCode, (size_t)15);
+
+    if ((literalLength >= 15) && !writeLength(dst, dstSize, op, literalLength))
+        return false;
+    if (op + literalLength > dstSize)
+        return false;
+    memcpy(dst + op, literals, literalLength);
+    op += literalLength;
+
+    if (matchLength == 0)
+        return true;
+    if (op + 2 > dstSize)
+        return false;
+    dst[op++] = offset & 0xff;
+    dst[op++] = (offset >> 8) & 0xff;
+    if ((matchCode >= 15) && !writeLength(dst, dstSize, op, matchCode))
+        return false;
+    return true;
+}
+
+size_t ExynosLayerDumpFile::compressBlock(const uint8_t *src, size_t srcSize,
+                                          uint8_t *dst, size_t dstSize) {
+    std::vector<uint32_t> table(1 << HASH_BITS, NO_POSITION);
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+
+    while (ip + MIN_MATCH <= srcSize) {
+        uint32_t value = read32(src + ip);
+        uint32_t h = hash32(value);
+        uint32_t ref = table[h];
+        table[h] = ip;
+
+        if ((ref == NO_POSITION) || (ip - ref > MAX_OFFSET) || (read32(src + ref) != value)) {
+            ip++;
+            continue;
+        }
+
+        size_t matchLength = MIN_MATCH;
+        while ((ip + matchLength < srcSize) && (src[ref + matchLength] == src[ip + matchLength]))
+            matchLength++;
+
+        if (!writeSequence(src + anchor, ip - anchor, ip - ref, matchLength, dst, dstSize, op))
+            return 0;
+        ip += matchLength;
+        anchor = ip;
+    }
+
+    /* The last sequence has only literals */
+    if (!writeSequence(src + anchor, srcSize - anchor, 0, 0, dst, dstSize, op))
+        return 0;
+    return op;
+}
+
+bool ExynosLayerDumpFile::decompressBlock(const uint8_t *src, size_t srcSize,
+                                          uint8_t *dst, size_t dstSize) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < srcSize) {
+        uint8_t token = src[ip++];
+
+        size_t literalLength = token >> 4;
+        if ((literalLength == 15) && !readLength(src, srcSize, ip, literalLength))
+            return false;
+        if ((ip + literalLength > srcSize) || (op + literalLength > dstSize))
+            return false;
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == srcSize)
+            break;
+
+        if (ip + 2 > srcSize)
+            return false;
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if ((offset == 0) || (offset > op))
+            return false;
+
+        size_t matchLength = token & 0xf;
+        if ((matchLength == 15) && !readLength(src, srcSize, ip, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (op + matchLength > dstSize)
+            return false;
+        /* The match can overlap the output */
+        for (size_t i = 0; i < matchLength; i++, op++)
+            dst[op] = dst[op - offset];
+    }
+
+    return op == dstSize;
+}
+
+bool ExynosLayerDumpFile::decompress(const uint8_t *src, size_t srcSize, std::vector<uint8_t> &out) {
+    out.clear();
+    if ((srcSize < 16) || (readLe32(src) != MAGIC) || (readLe32(src + 4) != VERSION))
+        return false;
+
+    uint32_t pixelBytes = readLe32(src + 8);
+    uint32_t chunkSize = readLe32(src + 12);
+    size_t ip = 16;
+    while (ip < srcSize) {
+        if (ip + 8 > srcSize)
+            return false;
+        uint32_t rawSize = readLe32(src + ip);
+        uint32_t storedSize = readLe32(src + ip + 4);
+        ip += 8;
+        if (rawSize > chunkSize)
+            return false;
+
+        size_t start = out.size();
+        out.resize(start + rawSize);
+        if (storedSize == 0) {
+            if (ip + rawSize > srcSize)
+                return false;
+            memcpy(out.data() + start, src + ip, rawSize);
+            ip += rawSize;
+            continue;
+        }
+
+        if ((ip + storedSize > srcSize) ||
+            !decompressBlock(src + ip, storedSize, out.data() + start, rawSize))
+            return false;
+        ip += storedSize;
+        if (pixelBytes) {
+            uint8_t *chunk = out.data() + start;
+            for (size_t i = pixelBytes; i < rawSize; i++)
+                chunk[i] += chunk[i - pixelBytes];
+        }
+    }
+
+    return true;
+}
+
+bool ExynosLayerDumpFile::open(const char *path, bool compress, uint32_t pixelBytes) {
+    close();
+
+    mFp = fopen(path, "w+");
+    if (mFp == nullptr)
+        return false;
+
+    mCompress = compress;
+    mError = false;
+    mPixelBytes = pixelBytes;
+    mRawBytes = 0;
+    mWrittenBytes = 0;
+    if (!mCompress)
+        return true;
+
+    mChunk.reserve(CHUNK_SIZE);
+    mChunk.clear();
+    mDelta.resize(CHUNK_SIZE);
+    mStored.resize(compressBound(CHUNK_SIZE));
+
+    uint8_t header[16];
+    writeLe32(header, MAGIC);
+    writeLe32(header + 4, VERSION);
+    writeLe32(header + 8, mPixelBytes);
+    writeLe32(header + 12, CHUNK_SIZE);
+    return writeBytes(header, sizeof(header));
+}
+
+bool ExynosLayerDumpFile::writeBytes(const void *data, size_t size) {
+    if (mError || (fwrite(data, 1, size, mFp) != size)) {
+        mError = true;
+        return false;
+    }
+    mWrittenBytes += size;
+    return true;
+}
+
+bool ExynosLayerDumpFile::flushChunk() {
+    size_t rawSize = mChunk.size();
+    if (rawSize == 0)
+        return true;
+
+    const uint8_t *chunk = mChunk.data();
+    uint8_t *delta = mDelta.data();
+    if (mPixelBytes) {
+        size_t head = std::min((size_t)mPixelBytes, rawSize);
+        memcpy(delta, chunk, head);
+        for (size_t i = head; i < rawSize; i++)
+            delta[i] = chunk[i] - chunk[i - mPixelBytes];
+    } else {
+        memcpy(delta, chunk, rawSize);
+    }
+
+    /* Keep the raw bytes if the compressed ones are not smaller */
+    size_t storedSize = compressBlock(delta, rawSize, mStored.data(), rawSize - 1);
+    uint8_t header[8];
+    writeLe32(header, rawSize);
+    writeLe32(header + 4, storedSize);
+    bool ret = writeBytes(header, sizeof(header)) &&
+            (storedSize ? writeBytes(mStored.data(), storedSize) : writeBytes(chunk, rawSize));
+    mChunk.clear();
+    return ret;
+}
+
+bool ExynosLayerDumpFile::write(const void *data, size_t size) {
+    if (mFp == nullptr)
+        return false;
+
+    mRawBytes += size;
+    if (!mCompress)
+        return writeBytes(data, size);
+
+    const uint8_t *src = static_cast<const uint8_t *>(data);
+    while (size) {
+        size_t length = std::min(size, CHUNK_SIZE - mChunk.size());
+        mChunk.insert(mChunk.end(), src, src + length);
+        src += length;
+        size -= length;
+        if ((mChunk.size() == CHUNK_SIZE) && !flushChunk())
+            return false;
+    }
+    return !mError;
+}
+
+bool ExynosLayerDumpFile::close() {
+    if (mFp == nullptr)
+        return false;
+
+    if (mCompress)
+        flushChunk();
+    if (fclose(mFp) != 0)
+        mError = true;
+    mFp = nullptr;
+    mChunk.clear();
+    return !mError;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSLAYERDUMP_H
+#define _EXYNOSLAYERDUMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/*
+ * ExynosLayerDumpFile writes a layer dump either as it is or compressed
+ * without loss. The compressed file is
+ *
+ *   header: "EXLD", version, pixel bytes, chunk size (uint32_t each)
+ *   chunks: raw size, stored size (uint32_t each), then the stored bytes
+ *
+ * in little endian. Every chunk holds up to CHUNK_SIZE bytes of the dump.
+ * A byte of a chunk is replaced by its difference from the byte of the
+ * previous pixel, then the differences are compressed by LZ77 with the
+ * sequences of LZ4: a token of the literal and match lengths, the
+ * literals, and a 16 bit offset of the match. A stored size of 0 means
+ * that the chunk did not compress and its raw bytes follow.
+ *
+ * decompress() restores the dump from a compressed file.
+ */
+class ExynosLayerDumpFile {
+  public:
+    static constexpr uint32_t MAGIC = 0x444c5845; /* "EXLD" */
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t MAX_OFFSET = 65535;
+
+    ~ExynosLayerDumpFile() { close(); };
+
+    /* @pixelBytes is the distance of the delta, 0 to disable it */
+    bool open(const char *path, bool compress, uint32_t pixelBytes);
+    bool write(const void *data, size_t size);
+    bool close();
+
+    uint64_t getRawBytes() const { return mRawBytes; };
+    uint64_t getWrittenBytes() const { return mWrittenBytes; };
+
+    static size_t compressBound(size_t size) { return size + size / 255 + 16; };
+    /* Returns the compressed size, or 0 if it does not fit in @dstSize */
+    static size_t compressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+    /* Returns false unless @src decodes into exactly @dstSize bytes */
+    static bool decompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+    static bool decompress(const uint8_t *src, size_t srcSize, std::vector<uint8_t> &out);
+
+  private:
+    bool writeBytes(const void *data, size_t size);
+    bool flushChunk();
+
+    FILE *mFp = nullptr;
+    bool mCompress = false;
+    bool mError = false;
+    uint32_t mPixelBytes = 0;
+    std::vector<uint8_t> mChunk;
+    std::vector<uint8_t> mDelta;
+    std::vector<uint8_t> mStored;
+    uint64_t mRawBytes = 0;
+    uint64_t mWrittenBytes = 0;
+};
+
+#endif  // _EXYNOSLAYERDUMP_H
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <inttypes.h>
+#include <math.h>
+#include <algorithm>
+#include "ExynosVsyncModel.h"
+
+void ExynosVsyncModel::reset() {
+    Mutex::Autolock lock(mMutex);
+    /* Statistics are kept across resets */
+    mConfigPeriod = 0;
+    mLastTimestamp = 0;
+    clearSamplesLocked();
+}
+
+void ExynosVsyncModel::clearSamplesLocked() {
+    mBaseTimestamp = 0;
+    mSampleCount = 0;
+    mNextSample = 0;
+    mConsecutiveOutliers = 0;
+    mValid = false;
+}
+
+void ExynosVsyncModel::fitLocked() {
+    mValid = false;
+    if (mSampleCount < MIN_SAMPLES)
+        return;
+
+    double meanIndex = 0;
+    double meanTime = 0;
+    for (size_t i = 0; i < mSampleCount; i++) {
+        meanIndex += mSamples[i].index;
+        meanTime += mSamples[i].timestamp - mBaseTimestamp;
+    }
+    meanIndex /= mSampleCount;
+    meanTime /= mSampleCount;
+
+    double sumIndex = 0;
+    double sumProduct = 0;
+    for (size_t i = 0; i < mSampleCount; i++) {
+        double index = mSamples[i].index - meanIndex;
+        sumIndex += index * index;
+        sumProduct += index * (mSamples[i].timestamp - mBaseTimestamp - meanTime);
+    }
+    if (sumIndex == 0)
+        return;
+
+    double period = sumProduct / sumIndex;
+    /* The indexes are wrong if the period is far from the config */
+    if (fabs(period - mConfigPeriod) > mConfigPeriod / 10.0)
+        return;
+
+    mPeriod = period;
+    mPhase = meanTime - period * meanIndex;
+    mValid = true;
+}
+
+void ExynosVsyncModel::addJitterLocked(nsecs_t jitter) {
+    size_t bucket = 0;
+    while ((bucket < JITTER_BUCKETS.size()) && (jitter > JITTER_BUCKETS[bucket]))
+        bucket++;
+    mJitterHistogram[bucket]++;
+    mJitterSamples++;
+    mJitterSum += jitter;
+    mMaxJitter = std::max(mMaxJitter, jitter);
+}
+
+void ExynosVsyncModel::addVsync(nsecs_t timestamp, nsecs_t configPeriod) {
+    Mutex::Autolock lock(mMutex);
+
+    if (configPeriod <= 0)
+        return;
+
+    if (configPeriod != mConfigPeriod) {
+        mConfigPeriod = configPeriod;
+        clearSamplesLocked();
+    }
+
+    if ((mLastTimestamp != 0) && (timestamp <= mLastTimestamp))
+        return;
+    if ((mLastTimestamp != 0) && (timestamp - mLastTimestamp > MAX_GAP))
+        clearSamplesLocked();
+    mLastTimestamp = timestamp;
+
+    if (mValid) {
+        double position = (timestamp - mBaseTimestamp - mPhase) / mPeriod;
+        nsecs_t jitter = llabs(static_cast<nsecs_t>((position - round(position)) * mPeriod));
+        addJitterLocked(jitter);
+
+        nsecs_t threshold = std::max(MIN_OUTLIER_THRESHOLD, mConfigPeriod / 8);
+        if (jitter > threshold) {
+            mOutliers++;
+            if (++mConsecutiveOutliers < MAX_CONSECUTIVE_OUTLIERS)
+                return;
+            /* The timeline has moved, fit again from this vsync */
+            mRestarts++;
+            clearSamplesLocked();
+        } else {
+            mConsecutiveOutliers = 0;
+        }
+    }
+
+    int64_t index = 0;
+    if (mSampleCount == 0) {
+        mBaseTimestamp = timestamp;
+    } else if (mValid) {
+        /* The config period would drift from the panel over a long run */
+        index = llround((timestamp - mBaseTimestamp - mPhase) / mPeriod);
+    } else {
+        /* Count from the last sample, the gap is short enough for the config period */
+        const Sample &last = mSamples[(mNextSample + HISTORY_SIZE - 1) % HISTORY_SIZE];
+        index = last.index + llround(static_cast<double>(timestamp - last.timestamp) / mConfigPeriod);
+    }
+
+    Sample &sample = mSamples[mNextSample];
+    sample.index = index;
+    sample.timestamp = timestamp;
+    mNextSample = (mNextSample + 1) % HISTORY_SIZE;
+    mSampleCount = std::min(mSampleCount + 1, HISTORY_SIZE);
+
+    fitLocked();
+}
+
+nsecs_t ExynosVsyncModel::getPredictedVsyncLocked(nsecs_t time) {
+    if (mLastTimestamp == 0)
+        return 0;
+
+    if (!mValid) {
+        /* Keep the phase of the last vsync */
+        if (time < mLastTimestamp)
+            return mLastTimestamp;
+        return mLastTimestamp + ((time - mLastTimestamp) / mConfigPeriod + 1) * mConfigPeriod;
+    }
+
+    double index = floor((time - mBaseTimestamp - mPhase) / mPeriod) + 1;
+    nsecs_t predicted = mBaseTimestamp + static_cast<nsecs_t>(mPhase + index * mPeriod);
+    /* Rounding can put the prediction on @time */
+    if (predicted <= time)
+        predicted = mBaseTimestamp + static_cast<nsecs_t>(mPhase + (index + 1) * mPeriod);
+    return predicted;
+}
+
+nsecs_t ExynosVsyncModel::getPredictedVsync(nsecs_t time) {
+    Mutex::Autolock lock(mMutex);
+    return getPredictedVsyncLocked(time);
+}
+
+nsecs_t ExynosVsyncModel::getPeriod() {
+    Mutex::Autolock lock(mMutex);
+    return mValid ? static_cast<nsecs_t>(mPeriod) : mConfigPeriod;
+}
+
+bool ExynosVsyncModel::isValid() {
+    Mutex::Autolock lock(mMutex);
+    return mValid;
+}
+
+void ExynosVsyncModel::addCommit(nsecs_t start, nsecs_t end) {
+    Mutex::Autolock lock(mMutex);
+
+    /* The prediction of an old timeline would make up late commits */
+    if (!mValid || (start - mLastTimestamp > MAX_GAP))
+        return;
+
+    nsecs_t vsync = getPredictedVsyncLocked(start);
+    mCommits++;
+    if (end > vsync) {
+        mLateCommits++;
+        mMaxLateness = std::max(mMaxLateness, end - vsync);
+    }
+}
+
+void ExynosVsyncModel::dump(String8 &result) {
+    Mutex::Autolock lock(mMutex);
+
+    result.appendFormat("Vsync model: config period(%" PRId64 " ns), samples(%zu)", mConfigPeriod,
+                        mSampleCount);
+    if (mValid) {
+        double drift = (mPeriod - mConfigPeriod) * 1000000.0 / mConfigPeriod;
+        result.appendFormat(", measured period(%.1f ns, %+.1f ppm), next vsync(%" PRId64 ")\n",
+                            mPeriod, drift, getPredictedVsyncLocked(systemTime(SYSTEM_TIME_MONOTONIC)));
+    } else {
+        result.appendFormat(", not fitted\n");
+    }
+
+    result.appendFormat("\tjitter: samples(%" PRIu64 "), mean(%" PRId64 " ns), max(%" PRId64
+                        " ns), outliers(%" PRIu64 "), restarts(%" PRIu64 ")\n\t",
+                        mJitterSamples, mJitterSamples ? mJitterSum / (nsecs_t)mJitterSamples : 0,
+                        mMaxJitter, mOutliers, mRestarts);
+    for (size_t i = 0; i < mJitterHistogram.size(); i++) {
+        if (i < JITTER_BUCKETS.size())
+            result.appendFormat("<=%" PRId64 "us(%" PRIu64 ") ", ns2us(JITTER_BUCKETS[i]),
+                                mJitterHistogram[i]);
+        else
+            result.appendFormat(">%" PRId64 "us(%" PRIu64 ")\n", ns2us(JITTER_BUCKETS[i - 1]),
+                                mJitterHistogram[i]);
+    }
+
+    result.appendFormat("\tcommits(%" PRIu64 "), late commits(%" PRIu64 "), max lateness(%" PRId64
+                        " ns)\n",
+                        mCommits, mLateCommits, mMaxLateness);
+}
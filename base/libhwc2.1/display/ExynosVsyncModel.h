@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSVSYNCMODEL_H
+#define _EXYNOSVSYNCMODEL_H
+
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <array>
+
+using namespace android;
+
+/*
+ * ExynosVsyncModel estimates the vsync timeline of a display from the
+ * timestamps of the recent vsyncs. The vsync index of a timestamp is counted
+ * on the fitted timeline, or from the last vsync in the period of the active
+ * config until the fit is ready, and a least squares fit of
+ * timestamp = phase + index * period gives the measured period and phase.
+ *
+ * The distance of every vsync from the fitted timeline is the jitter. A vsync
+ * that is farther than the outlier threshold is not added to the fit and
+ * MAX_CONSECUTIVE_OUTLIERS outliers in a row restart the fit because the
+ * timeline has moved. The model also checks every frame commit against the
+ * predicted vsync, so the dump tells the late commits from the panel drift.
+ */
+class ExynosVsyncModel {
+  public:
+    static constexpr size_t HISTORY_SIZE = 32;
+    static constexpr size_t MIN_SAMPLES = 6;
+    static constexpr uint32_t MAX_CONSECUTIVE_OUTLIERS = 3;
+    /* The fit is restarted after a longer gap between vsyncs */
+    static constexpr nsecs_t MAX_GAP = s2ns(1);
+    static constexpr nsecs_t MIN_OUTLIER_THRESHOLD = us2ns(500);
+    /* Upper bounds of the jitter histogram buckets, the last one is open */
+    static constexpr std::array<nsecs_t, 7> JITTER_BUCKETS = {
+        us2ns(25), us2ns(50), us2ns(100), us2ns(250), us2ns(500), us2ns(1000), ms2ns(2)};
+
+    void reset();
+
+    /* @configPeriod is the vsync period of the active config */
+    void addVsync(nsecs_t timestamp, nsecs_t configPeriod);
+    /* Checks if a commit of a frame started at @start finished before its vsync */
+    void addCommit(nsecs_t start, nsecs_t end);
+
+    /*
+     * Returns the first predicted vsync after @time,
+     * or 0 if there has been no vsync since the last reset.
+     */
+    nsecs_t getPredictedVsync(nsecs_t time);
+    /* Returns the measured period or the config period if the fit is not ready */
+    nsecs_t getPeriod();
+    bool isValid();
+
+    void dump(String8 &result);
+
+  private:
+    struct Sample {
+        int64_t index;
+        nsecs_t timestamp;
+    };
+
+    void clearSamplesLocked() REQUIRES(mMutex);
+    void fitLocked() REQUIRES(mMutex);
+    nsecs_t getPredictedVsyncLocked(nsecs_t time) REQUIRES(mMutex);
+    void addJitterLocked(nsecs_t jitter) REQUIRES(mMutex);
+
+    Mutex mMutex;
+
+    nsecs_t mConfigPeriod = 0;
+    nsecs_t mLastTimestamp = 0;
+    /* The vsync indexes are counted from mBaseTimestamp */
+    nsecs_t mBaseTimestamp = 0;
+    std::array<Sample, HISTORY_SIZE> mSamples;
+    size_t mSampleCount = 0;
+    size_t mNextSample = 0;
+    uint32_t mConsecutiveOutliers = 0;
+
+    /* timestamp = mBaseTimestamp + mPhase + index * mPeriod if mValid */
+    bool mValid = false;
+    double mPhase = 0;
+    double mPeriod = 0;
+
+    /* statistics */
+    std::array<uint64_t, JITTER_BUCKETS.size() + 1> mJitterHistogram = {};
+    uint64_t mJitterSamples = 0;
+    nsecs_t mJitterSum = 0;
+    nsecs_t mMaxJitter = 0;
+    uint64_t mOutliers = 0;
+    uint64_t mRestarts = 0;
+    uint64_t mCommits = 0;
+    uint64_t mLateCommits = 0;
+    nsecs_t mMaxLateness = 0;
+};
+
+#endif  // _EXYNOSVSYNCMODEL_H
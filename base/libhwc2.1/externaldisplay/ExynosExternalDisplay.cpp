@@ -24,6 +24,7 @@
 #include "ExynosExternalDisplayFbInterfaceModule.h"
 #include "ExynosDisplayDrmInterface.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosMPPBufferPool.h"
 #include <linux/fb.h>
 
 #define SKIP_FRAME_COUNT 3
@@ -80,6 +81,7 @@ int ExynosExternalDisplay::openExternalDisplay() {
 
     if (mLayers.size() != 0) {
         mLayers.clear();
+        mLayerHandles.clear();
     }
 
     DISPLAY_LOGD(eDebugExternalDisplay, "open fd for External Display(%d)", ret);
@@ -374,6 +376,7 @@ int ExynosExternalDisplay::disable() {
 
     mEnabled = false;
     mPowerModeState = (hwc2_power_mode_t)HWC_POWER_MODE_OFF;
+    ExynosMPPBufferPool::getInstance().releaseDisplay(mDisplayId);
 
     ALOGI("[ExternalDisplay] %s -", __func__);
 
@@ -256,6 +256,15 @@ void ExynosPrimaryDisplayFbInterface::updateDSCBlockSize() {
     }
 }
 
+void ExynosPrimaryDisplayFbInterface::getPartialRegionAlignment(uint32_t &width, uint32_t &height) {
+    if (mDSCHSliceNum == 0 || mDSCYSliceSize == 0)
+        return;
+
+    /* alignDSCBlockSize() aligns the region to the slices */
+    width = mXres / mDSCHSliceNum;
+    height = mDSCYSliceSize;
+}
+
 void ExynosPrimaryDisplayFbInterface::alignDSCBlockSize(hwc_rect &merge_rect) {
     unsigned int blockWidth, blockHeight;
 
@@ -36,6 +36,7 @@ class ExynosPrimaryDisplayFbInterface : public ExynosDisplayFbInterface {
 
     /* For HWC 2.4 APIs */
     virtual int32_t getVsyncAppliedTime(hwc2_config_t __unused configId, displayConfigs &config, int64_t *__unused actualChangeTime);
+    void getPartialRegionAlignment(uint32_t &width, uint32_t &height) override;
 
   protected:
     void alignDSCBlockSize(hwc_rect &merge_rect) override;
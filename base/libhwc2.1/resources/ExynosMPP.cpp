@@ -180,6 +180,9 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
         } else {
             MPP_LOGI("mAcrylicHandle is created: %p", mAcrylicHandle);
         }
+        /* Next frame can be queued while MSC is processing the previous frames */
+        if (!mAcrylicHandle->setQueueDepth(MSC_QUEUE_DEPTH(mLogicalType)))
+            MPP_LOGI("MSC queue depth %d is not supported", MSC_QUEUE_DEPTH(mLogicalType));
     }
 
     if (mMaxSrcLayerNum > 1) {
@@ -804,8 +807,8 @@ void ExynosMPP::ResourceManageThread::threadLoop() {
     ALOGI("%s threadLoop is ended", mExynosMPP->mName.string());
 }
 
+/* The buffers are given back to the buffer pool, their fences are closed here */
 void ExynosMPP::ResourceManageThread::freeBuffers() {
-    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
     android::List<exynos_mpp_img_info>::iterator it;
     android::List<exynos_mpp_img_info>::iterator end;
     it = mFreedBuffers.begin();
@@ -832,7 +835,6 @@ void ExynosMPP::ResourceManageThread::freeBuffers() {
                                                      FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
                                                      "mpp::freeBuffers: acrylicReleaseFence");
         }
-        gAllocator.free(freeBuffer.bufferHandle);
         it = mFreedBuffers.erase(it);
     }
 }
@@ -888,7 +890,6 @@ void ExynosMPP::ResourceManageThread::addStateFence(int fence) {
  */
 int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t usage, uint32_t index) {
     ATRACE_CALL();
-    uint32_t dstStride = 0;
 
     MPP_LOGD(eDebugMPP | eDebugBuf, "index: %d++++++++", index);
 
@@ -901,83 +902,42 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
     dumpExynosMPPImgInfo(eDebugMPP, mDstImgs[index]);
 
     uint64_t allocUsage = getBufferUsage(usage);
-    buffer_handle_t dstBuffer;
 
     MPP_LOGD(eDebugMPP | eDebugBuf, "\tw: %d, h: %d, format: 0x%8x, previousBuffer: %p, allocUsage: 0x%" PRIx64 ", usage: 0x%" PRIx64 "",
              w, h, format, freeDstBuf.bufferHandle, allocUsage, usage);
 
-    status_t error = NO_ERROR;
-    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
-
-    {
-        ATRACE_CALL();
-        error = gAllocator.allocate(w, h, format, 1, allocUsage, &dstBuffer, &dstStride, "HWC");
+    /*
+     * Give back the previous buffer first, then the pool can hand it out
+     * again or free it if the allocation fails
+     */
+    MPP_LOGD(eDebugMPP | eDebugBuf, "free outbuf[%d] %p", index, freeDstBuf.bufferHandle);
+    if (freeDstBuf.bufferHandle != NULL)
+        freeOutBuf(freeDstBuf);
+    else {
+        if (mAssignedDisplayInfo.displayIdentifier.id != UINT32_MAX) {
+            freeDstBuf.acrylicAcquireFenceFd = mFenceTracer.fence_close(
+                    freeDstBuf.acrylicAcquireFenceFd, mAssignedDisplayInfo.displayIdentifier,
+                    FENCE_TYPE_DST_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
+                    "mpp::allocOutBuf: acrylicAcquireFence");
+            freeDstBuf.acrylicReleaseFenceFd = mFenceTracer.fence_close(
+                    freeDstBuf.acrylicReleaseFenceFd, mAssignedDisplayInfo.displayIdentifier,
+                    FENCE_TYPE_DST_RELEASE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
+                    "mpp::allocOutBuf: acrylicReleaseFence");
+        }
     }
+    mDstImgs[index].reset();
 
-    bool freeBuffer = false;
-    if ((error != NO_ERROR) || (dstBuffer == NULL)) {
-        MPP_LOGW("failed to allocate destination buffer(%dx%d): %d", w, h, error);
-
-        if (freeDstBuf.bufferHandle != NULL) {
-            MPP_LOGW("retry to allocate destination buffer after free buffer");
-
-            auto freeOutBuf = [&]() -> void {
-                dumpExynosMPPImgInfo(eDebugMPP | eDebugBuf, freeDstBuf);
-                if (mFenceTracer.fence_valid(freeDstBuf.acrylicAcquireFenceFd)) {
-                    freeDstBuf.acrylicAcquireFenceFd =
-                        mFenceTracer.fence_close(freeDstBuf.acrylicAcquireFenceFd,
-                                                 mAssignedDisplayInfo.displayIdentifier,
-                                                 FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_ALL,
-                                                 "mpp::freeBuffers: acrylicAcquireFence");
-                }
-                if (mFenceTracer.fence_valid(freeDstBuf.acrylicReleaseFenceFd)) {
-                    freeDstBuf.acrylicReleaseFenceFd =
-                        mFenceTracer.fence_close(freeDstBuf.acrylicReleaseFenceFd,
-                                                 mAssignedDisplayInfo.displayIdentifier,
-                                                 FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
-                                                 "mpp::freeBuffers: acrylicReleaseFence");
-                }
-                gAllocator.free(freeDstBuf.bufferHandle);
-                freeDstBuf.reset();
-                freeBuffer = true;
-                ALOGW("free buffer: %p", freeDstBuf.bufferHandle);
-            };
-
-            {
-                ATRACE_CALL();
-                freeOutBuf();
-                error = gAllocator.allocate(w, h, format, 1, allocUsage, &dstBuffer, &dstStride, "HWC");
-            }
-            if ((error != NO_ERROR) || (dstBuffer == NULL)) {
-                MPP_LOGE("retry is failed to allocate destination buffer(%dx%d): %d", w, h, error);
-                return -EINVAL;
-            }
-        }
+    buffer_handle_t dstBuffer = NULL;
+    int32_t error = mBufferPool.acquire({w, h, format, allocUsage}, dstBuffer);
+    if (error != NO_ERROR) {
+        MPP_LOGE("failed to allocate destination buffer(%dx%d): %d", w, h, error);
+        return -EINVAL;
     }
 
-    mDstImgs[index].reset();
     mDstImgs[index].bufferHandle = dstBuffer;
     mDstImgs[index].bufferType = getBufferType(usage);
     mDstImgs[index].format = format;
 
-    if (!freeBuffer) {
-        MPP_LOGD(eDebugMPP | eDebugBuf, "free outbuf[%d] %p", index, freeDstBuf.bufferHandle);
-        if (freeDstBuf.bufferHandle != NULL)
-            freeOutBuf(freeDstBuf);
-        else {
-            if (mAssignedDisplayInfo.displayIdentifier.id != UINT32_MAX) {
-                freeDstBuf.acrylicAcquireFenceFd = mFenceTracer.fence_close(
-                        freeDstBuf.acrylicAcquireFenceFd, mAssignedDisplayInfo.displayIdentifier,
-                        FENCE_TYPE_DST_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
-                        "mpp::allocOutBuf: acrylicAcquireFence");
-                freeDstBuf.acrylicReleaseFenceFd = mFenceTracer.fence_close(
-                        freeDstBuf.acrylicReleaseFenceFd, mAssignedDisplayInfo.displayIdentifier,
-                        FENCE_TYPE_DST_RELEASE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
-                        "mpp::allocOutBuf: acrylicReleaseFence");
-            }
-        }
-    }
-
     MPP_LOGD(eDebugMPP | eDebugBuf, "dstBuffer(%p)-----------", dstBuffer);
 
     return NO_ERROR;
@@ -1004,10 +964,13 @@ int32_t ExynosMPP::setOutBuf(buffer_handle_t outbuf, int32_t fence,
  * @return int32_t
  */
 int32_t ExynosMPP::freeOutBuf(struct exynos_mpp_img_info dst) {
-    if (mBufDestoryedCallback)
-        mBufDestoryedCallback(ExynosGraphicBufferMeta::get_buffer_id(dst.bufferHandle));
-    mResourceManageThread.addFreedBuffer(dst);
+    /* The pool duplicates the fences, they are closed by mResourceManageThread */
+    mBufferPool.release(dst.bufferHandle, dst.acrylicAcquireFenceFd, dst.acrylicReleaseFenceFd,
+                        dst.displayId, NUM_MPP_DST_BUFS(mLogicalType));
     dst.bufferHandle = NULL;
+    if (mFenceTracer.fence_valid(dst.acrylicAcquireFenceFd) ||
+        mFenceTracer.fence_valid(dst.acrylicReleaseFenceFd))
+        mResourceManageThread.addFreedBuffer(dst);
     return NO_ERROR;
 }
 
@@ -1875,6 +1838,7 @@ int32_t ExynosMPP::setDstReleaseFence(int releaseFence, DisplayInfo &display) {
     mDstImgs[dstBufIndex].acrylicReleaseFenceFd =
         mFenceTracer.checkFenceDebug(mAssignedDisplayInfo.displayIdentifier,
                                      FENCE_TYPE_DST_RELEASE, mFenceTracer.getM2MIPFenceType(mPhysicalType), releaseFence);
+    mDstImgs[dstBufIndex].displayId = display.displayIdentifier.id;
 
     mPrivDstBuf = mCurrentDstBuf;
 
@@ -1935,12 +1899,18 @@ int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
                 if (mFreeOutBufFlag == true) {
                     MPP_LOGD(eDebugMPP | eDebugBuf, "free outbuf[%d] %p",
                              i, freeDstBuf.bufferHandle);
+                    /* The fences stay in mDstImgs[i], the pool duplicates them */
                     if (freeDstBuf.bufferHandle != NULL && mAllocOutBufFlag) {
-                        freeOutBuf(freeDstBuf);
+                        mBufferPool.release(freeDstBuf.bufferHandle,
+                                            mDstImgs[i].acrylicAcquireFenceFd,
+                                            mDstImgs[i].acrylicReleaseFenceFd,
+                                            freeDstBuf.displayId,
+                                            NUM_MPP_DST_BUFS(mLogicalType));
                     }
                 } else {
                     mDstImgs[i].bufferHandle = freeDstBuf.bufferHandle;
                     mDstImgs[i].bufferType = freeDstBuf.bufferType;
+                    mDstImgs[i].displayId = freeDstBuf.displayId;
                 }
             }
         }
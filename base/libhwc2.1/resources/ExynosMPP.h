@@ -35,6 +35,7 @@
 #include "ExynosHWCHelper.h"
 #include "ExynosMPPType.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosMPPBufferPool.h"
 
 #include <hardware/exynos/hdrInterface.h>
 
@@ -57,6 +58,14 @@ class ExynosMPP;
 #define MSC_MAX_SRC_NUM 2
 #endif
 
+#ifndef MSC_QUEUE_DEPTH
+/*
+ * Number of frames queued to MSC before the earliest one completes.
+ * It should be smaller than the number of the destination buffers.
+ */
+#define MSC_QUEUE_DEPTH(type) (NUM_MPP_DST_BUFS(type) - 1)
+#endif
+
 #define M2M_JUSTIFIED_DST_ALIGN 16
 
 /* RGB565 needs 32pixel align for Gralloc */
@@ -248,6 +257,8 @@ typedef struct exynos_mpp_img_info {
     AcrylicLayer *mppLayer = NULL;
     int acrylicAcquireFenceFd = -1;
     int acrylicReleaseFenceFd = -1;
+    /* The display that showed the destination buffer */
+    uint32_t displayId = UINT32_MAX;
     void reset() {
         *this = {};
     };
@@ -490,7 +501,7 @@ class ExynosMPP {
         void addStateFence(int fence);
     };
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
-    std::function<void(uint64_t)> mBufDestoryedCallback = nullptr;
+    ExynosMPPBufferPool &mBufferPool = ExynosMPPBufferPool::getInstance();
 
   public:
     /**
@@ -746,9 +757,6 @@ class ExynosMPP {
     virtual uint32_t getAXIPortId() { return mAXIPortId; }
     void printMppsAttr();
 
-    void registerBufDestoryedCallback(std::function<void(uint64_t)> const &cb) {
-        mBufDestoryedCallback = cb;
-    };
     void updatePPCTable(ppc_table &map);
 
   protected:
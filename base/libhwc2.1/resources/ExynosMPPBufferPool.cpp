@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#include <android/sync.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <utils/Errors.h>
+#include <utils/Trace.h>
+#include "ExynosGraphicBuffer.h"
+#include "ExynosHWCFormat.h"
+#include "ExynosMPPBufferPool.h"
+
+using namespace vendor::graphics;
+
+ANDROID_SINGLETON_STATIC_INSTANCE(ExynosMPPBufferPool);
+
+static uint64_t getBufferSize(const ExynosMPPBufferPool::Key &key) {
+    return (uint64_t)key.width * key.height * formatToBpp(key.format) / 8;
+}
+
+ExynosMPPBufferPool::ExynosMPPBufferPool()
+    : mMaxIdleBytes((uint64_t)property_get_int32("vendor.hwc.exynos.mpp_buf_pool.max_idle_kb",
+                                                 MPP_BUF_POOL_MAX_IDLE_BYTES / 1024) * 1024),
+      mIdleTimeout(ms2ns(property_get_int32("vendor.hwc.exynos.mpp_buf_pool.idle_timeout_ms",
+                                            MPP_BUF_POOL_IDLE_TIMEOUT_MS))) {
+    mOps.allocate = [](const Key &key, buffer_handle_t &handle) -> int32_t {
+        ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+        uint32_t stride = 0;
+        handle = NULL;
+        status_t error = gAllocator.allocate(key.width, key.height, key.format, 1, key.usage,
+                                             &handle, &stride, "HWC");
+        if ((error == NO_ERROR) && (handle == NULL))
+            error = -ENOMEM;
+        return error;
+    };
+    mOps.free = [](buffer_handle_t handle) {
+        ExynosGraphicBufferAllocator::get().free(handle);
+    };
+    mOps.isFenceSignaled = [](int fence) { return sync_wait(fence, 0) == 0; };
+    start();
+}
+
+ExynosMPPBufferPool::ExynosMPPBufferPool(const BufferOps &ops, uint64_t maxIdleBytes,
+                                         nsecs_t idleTimeout)
+    : mOps(ops),
+      mMaxIdleBytes(maxIdleBytes),
+      mIdleTimeout(idleTimeout) {
+    start();
+}
+
+ExynosMPPBufferPool::~ExynosMPPBufferPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    if (mTrimThread.joinable())
+        mTrimThread.join();
+
+    /* The borrowed buffers belong to the MPPs */
+    trimBuffers(0, true);
+}
+
+void ExynosMPPBufferPool::start() {
+    mRunning = true;
+    mTrimThread = std::thread(&ExynosMPPBufferPool::trimThreadLoop, this);
+    pthread_setname_np(mTrimThread.native_handle(), "MPPBufPoolTrim");
+}
+
+void ExynosMPPBufferPool::trimThreadLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (mRunning && mEvictedBuffers.empty()) {
+                if (mIdleBuffers.empty())
+                    mCondition.wait(lock);
+                else
+                    mCondition.wait_for(lock, std::chrono::nanoseconds(mIdleTimeout));
+            }
+            if (!mRunning)
+                break;
+        }
+        trim(mIdleTimeout);
+    }
+}
+
+bool ExynosMPPBufferPool::updateFences(Buffer &buffer) {
+    if ((buffer.acquireFence >= 0) && mOps.isFenceSignaled(buffer.acquireFence)) {
+        close(buffer.acquireFence);
+        buffer.acquireFence = -1;
+    }
+    if ((buffer.releaseFence >= 0) && mOps.isFenceSignaled(buffer.releaseFence)) {
+        close(buffer.releaseFence);
+        buffer.releaseFence = -1;
+    }
+    if (buffer.displayId != UINT32_MAX) {
+        if ((buffer.presentFence >= 0) && mOps.isFenceSignaled(buffer.presentFence))
+            buffer.displayId = UINT32_MAX;
+        else if (mPresentCounts[buffer.displayId] >= buffer.offScreenPresentCount)
+            buffer.displayId = UINT32_MAX;
+        if ((buffer.displayId == UINT32_MAX) && (buffer.presentFence >= 0)) {
+            close(buffer.presentFence);
+            buffer.presentFence = -1;
+        }
+    }
+    return (buffer.acquireFence < 0) && (buffer.releaseFence < 0) &&
+           (buffer.displayId == UINT32_MAX);
+}
+
+int ExynosMPPBufferPool::dupFence(int fence) {
+    if ((fence < 0) || mOps.isFenceSignaled(fence))
+        return -1;
+    return dup(fence);
+}
+
+void ExynosMPPBufferPool::closeFences(Buffer &buffer) {
+    if (buffer.acquireFence >= 0)
+        close(buffer.acquireFence);
+    if (buffer.releaseFence >= 0)
+        close(buffer.releaseFence);
+    if (buffer.presentFence >= 0)
+        close(buffer.presentFence);
+    buffer.acquireFence = -1;
+    buffer.releaseFence = -1;
+    buffer.presentFence = -1;
+}
+
+int32_t ExynosMPPBufferPool::acquire(const Key &key, buffer_handle_t &handle) {
+    ATRACE_CALL();
+    handle = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        /* The pool holds a few buffers of a few keys, so the buffers are scanned */
+        for (auto it = mIdleBuffers.begin(); it != mIdleBuffers.end(); it++) {
+            if (!(it->key == key))
+                continue;
+            /* The previous user is still writing it or the display is reading it */
+            if (!updateFences(*it)) {
+                mStats.busySkips++;
+                continue;
+            }
+
+            handle = it->handle;
+            mStats.hits++;
+            mIdleBytes -= it->size;
+            mBorrowedBuffers[handle] = *it;
+            mIdleBuffers.erase(it);
+            return NO_ERROR;
+        }
+    }
+
+    int32_t ret = mOps.allocate(key, handle);
+    if (ret != NO_ERROR) {
+        ALOGW("%s:: fail to allocate buffer(%ux%u, format: 0x%x): %d, retry after freeing idle buffers",
+              __func__, key.width, key.height, key.format, ret);
+        trim(0);
+        ret = mOps.allocate(key, handle);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (ret != NO_ERROR) {
+        ALOGE("%s:: fail to allocate buffer(%ux%u, format: 0x%x): %d",
+              __func__, key.width, key.height, key.format, ret);
+        mStats.allocFailures++;
+        handle = NULL;
+        return ret;
+    }
+
+    Buffer buffer;
+    buffer.key = key;
+    buffer.handle = handle;
+    buffer.size = getBufferSize(key);
+    mBorrowedBuffers[handle] = buffer;
+    mStats.allocations++;
+    return NO_ERROR;
+}
+
+void ExynosMPPBufferPool::release(buffer_handle_t handle, int acquireFence, int releaseFence,
+                                  uint32_t displayId, uint32_t holdPresents) {
+    if (handle == NULL)
+        return;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mBorrowedBuffers.find(handle);
+    if (it == mBorrowedBuffers.end()) {
+        ALOGW("%s:: buffer(%p) is not borrowed from the pool", __func__, handle);
+        return;
+    }
+
+    Buffer buffer = it->second;
+    mBorrowedBuffers.erase(it);
+    buffer.acquireFence = dupFence(acquireFence);
+    buffer.releaseFence = dupFence(releaseFence);
+    buffer.releaseTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    buffer.displayId = displayId;
+    if (displayId != UINT32_MAX)
+        buffer.offScreenPresentCount = mPresentCounts[displayId] + holdPresents;
+    mIdleBuffers.push_front(buffer);
+    mIdleBytes += buffer.size;
+
+    evictBuffers();
+    mCondition.notify_one();
+}
+
+void ExynosMPPBufferPool::onPresent(uint32_t displayId, int presentFence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPresentCounts[displayId]++;
+    /* Only the first frame after the release is waited for, the later ones signal after it */
+    for (auto &buffer : mIdleBuffers) {
+        if ((buffer.displayId == displayId) && (buffer.presentFence < 0)) {
+            buffer.presentFence = dupFence(presentFence);
+            /* The frame is already on screen */
+            if ((buffer.presentFence < 0) && (presentFence >= 0))
+                buffer.displayId = UINT32_MAX;
+        }
+    }
+
+    /* The buffers in use beyond the high-water mark are evicted when they are not used */
+    if (mIdleBytes > mMaxIdleBytes) {
+        evictBuffers();
+        mCondition.notify_one();
+    }
+}
+
+void ExynosMPPBufferPool::releaseDisplay(uint32_t displayId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    /* The display presents no more frames to take its buffers off screen */
+    for (auto &buffer : mIdleBuffers) {
+        if (buffer.displayId != displayId)
+            continue;
+        buffer.displayId = UINT32_MAX;
+        if (buffer.presentFence >= 0) {
+            close(buffer.presentFence);
+            buffer.presentFence = -1;
+        }
+    }
+
+    if (mIdleBytes > mMaxIdleBytes)
+        evictBuffers();
+    mCondition.notify_one();
+}
+
+void ExynosMPPBufferPool::evictBuffers() {
+    for (auto it = mIdleBuffers.end();
+         (mIdleBytes > mMaxIdleBytes) && (it != mIdleBuffers.begin());) {
+        auto evicted = std::prev(it);
+        if (!updateFences(*evicted)) {
+            it = evicted;
+            continue;
+        }
+        mIdleBytes -= evicted->size;
+        mEvictedBuffers.splice(mEvictedBuffers.end(), mIdleBuffers, evicted);
+        mStats.evictions++;
+    }
+}
+
+void ExynosMPPBufferPool::collectIdleBuffers(nsecs_t time, bool force,
+                                             std::list<Buffer> &buffers) {
+    evictBuffers();
+    buffers.splice(buffers.end(), mEvictedBuffers);
+    for (auto it = mIdleBuffers.end(); it != mIdleBuffers.begin();) {
+        auto idle = std::prev(it);
+        if (idle->releaseTime > time)
+            break;
+        if (!force && !updateFences(*idle)) {
+            it = idle;
+            continue;
+        }
+        mIdleBytes -= idle->size;
+        buffers.splice(buffers.end(), mIdleBuffers, idle);
+        mStats.trims++;
+    }
+}
+
+void ExynosMPPBufferPool::freeBuffers(std::list<Buffer> &buffers) {
+    ATRACE_CALL();
+    std::function<void(buffer_handle_t)> callback;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        callback = mBufDestroyedCallback;
+    }
+
+    for (auto &buffer : buffers) {
+        if (callback)
+            callback(buffer.handle);
+        closeFences(buffer);
+        mOps.free(buffer.handle);
+    }
+    buffers.clear();
+}
+
+void ExynosMPPBufferPool::trim(nsecs_t idleTime) {
+    trimBuffers(idleTime, false);
+}
+
+void ExynosMPPBufferPool::trimBuffers(nsecs_t idleTime, bool force) {
+    std::lock_guard<std::mutex> freeLock(mFreeMutex);
+    std::list<Buffer> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        collectIdleBuffers(systemTime(SYSTEM_TIME_MONOTONIC) - idleTime, force, buffers);
+    }
+    freeBuffers(buffers);
+}
+
+void ExynosMPPBufferPool::setMaxIdleBytes(uint64_t maxIdleBytes) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMaxIdleBytes = maxIdleBytes;
+    evictBuffers();
+    mCondition.notify_one();
+}
+
+size_t ExynosMPPBufferPool::getIdleCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mIdleBuffers.size();
+}
+
+uint64_t ExynosMPPBufferPool::getIdleBytes() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mIdleBytes;
+}
+
+size_t ExynosMPPBufferPool::getBorrowedCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBorrowedBuffers.size();
+}
+
+void ExynosMPPBufferPool::dump(String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint64_t borrowedBytes = 0;
+    for (auto &it : mBorrowedBuffers)
+        borrowedBytes += it.second.size;
+
+    result.appendFormat("MPP buffer pool: borrowed(%zu, %" PRIu64 " KB), idle(%zu, %" PRIu64
+                        " KB), max idle(%" PRIu64 " KB), idle timeout(%" PRId64 " ms)\n",
+                        mBorrowedBuffers.size(), borrowedBytes / 1024, mIdleBuffers.size(),
+                        mIdleBytes / 1024, mMaxIdleBytes / 1024, ns2ms(mIdleTimeout));
+    result.appendFormat("\thits(%" PRIu64 "), busy skips(%" PRIu64 "), allocations(%" PRIu64
+                        "), allocation failures(%" PRIu64 "), evictions(%" PRIu64
+                        "), trims(%" PRIu64 ")\n",
+                        mStats.hits, mStats.busySkips, mStats.allocations, mStats.allocFailures,
+                        mStats.evictions, mStats.trims);
+    for (auto &buffer : mIdleBuffers)
+        result.appendFormat("\tidle buffer(%p): %ux%u, format(%s), usage(0x%" PRIx64
+                            "), fences(%d, %d), on screen(%d)\n",
+                            buffer.handle, buffer.key.width, buffer.key.height,
+                            getFormatStr(buffer.key.format).string(), buffer.key.usage,
+                            buffer.acquireFence, buffer.releaseFence,
+                            buffer.displayId != UINT32_MAX);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSMPPBUFFERPOOL_H
+#define _EXYNOSMPPBUFFERPOOL_H
+
+#include <cutils/native_handle.h>
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using namespace android;
+
+#ifndef MPP_BUF_POOL_MAX_IDLE_BYTES
+#define MPP_BUF_POOL_MAX_IDLE_BYTES (64 * 1024 * 1024)
+#endif
+#ifndef MPP_BUF_POOL_IDLE_TIMEOUT_MS
+#define MPP_BUF_POOL_IDLE_TIMEOUT_MS 3000
+#endif
+
+/*
+ * ExynosMPPBufferPool keeps the destination buffers of the M2M MPPs of the
+ * device. An MPP borrows a buffer with acquire() and gives it back with
+ * release() instead of allocating and freeing its own buffers, so the buffers
+ * given back by an MPP that goes idle or changes the format of its output are
+ * used by the next MPP that needs them.
+ *
+ * A buffer is shared by the key of its allocation: the size, which is the
+ * aligned display size, the format and the usage, which has the secure bits.
+ * A returned buffer keeps duplicates of its fences that are not signaled, and
+ * acquire() only hands out a buffer whose fences are signaled, it allocates if
+ * none is found. The release fence of a frame can signal when the frame starts
+ * to be scanned out, so a buffer returned by an MPP of a display is also held
+ * back while it can be on screen, until the display presents the hold count of
+ * frames, the present fence of a later frame of the display signals, or the
+ * display is cleared.
+ *
+ * The idle buffers are bounded by the high-water mark of idle bytes, the least
+ * recently returned ones are freed beyond it. The idle buffers that are not
+ * used for the idle timeout are freed by the trim thread. The buffers on screen
+ * are not freed until they are off screen.
+ */
+class ExynosMPPBufferPool : public Singleton<ExynosMPPBufferPool> {
+  public:
+    struct Key {
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        /* The usage of the allocation, it has the secure bits */
+        uint64_t usage;
+
+        bool operator==(const Key &rhs) const {
+            return (width == rhs.width) && (height == rhs.height) &&
+                   (format == rhs.format) && (usage == rhs.usage);
+        };
+    };
+
+    /* The gralloc and fence operations, the unit tests replace them */
+    struct BufferOps {
+        std::function<int32_t(const Key &key, buffer_handle_t &handle)> allocate;
+        std::function<void(buffer_handle_t handle)> free;
+        std::function<bool(int fence)> isFenceSignaled;
+    };
+
+    ExynosMPPBufferPool();
+    ExynosMPPBufferPool(const BufferOps &ops, uint64_t maxIdleBytes, nsecs_t idleTimeout);
+    ~ExynosMPPBufferPool();
+
+    /* Borrows a buffer of @key */
+    int32_t acquire(const Key &key, buffer_handle_t &handle);
+    /*
+     * Gives back a borrowed buffer. The fences are duplicated, the caller still
+     * owns them. @displayId is the display that showed the buffer last or
+     * UINT32_MAX, the buffer is held back until the display presents
+     * @holdPresents frames.
+     */
+    void release(buffer_handle_t handle, int acquireFence, int releaseFence,
+                 uint32_t displayId, uint32_t holdPresents);
+    /* Called after each frame presented by @displayId, @presentFence is duplicated */
+    void onPresent(uint32_t displayId, int presentFence);
+    /* Called when @displayId is cleared, powered off or removed, it shows no buffer any more */
+    void releaseDisplay(uint32_t displayId);
+    /* Frees the buffers that are idle for @idleTime or longer */
+    void trim(nsecs_t idleTime);
+
+    void setMaxIdleBytes(uint64_t maxIdleBytes);
+    size_t getIdleCount();
+    uint64_t getIdleBytes();
+    size_t getBorrowedCount();
+
+    /* Called before a buffer is freed */
+    void registerBufDestroyedCallback(std::function<void(buffer_handle_t)> const &cb) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBufDestroyedCallback = cb;
+    };
+
+    void dump(String8 &result);
+
+  private:
+    struct Buffer {
+        Key key;
+        buffer_handle_t handle = NULL;
+        uint64_t size = 0;
+        int acquireFence = -1;
+        int releaseFence = -1;
+        nsecs_t releaseTime = 0;
+        /* The display that showed the buffer, UINT32_MAX when it is off screen */
+        uint32_t displayId = UINT32_MAX;
+        /* The present count of the display that takes the buffer off screen */
+        uint64_t offScreenPresentCount = 0;
+        /* The present fence of the first frame of the display after the release */
+        int presentFence = -1;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        /* buffers of the key skipped because they were written, read or on screen */
+        uint64_t busySkips = 0;
+        uint64_t allocations = 0;
+        uint64_t allocFailures = 0;
+        uint64_t evictions = 0;
+        uint64_t trims = 0;
+    };
+
+    void start();
+    void trimThreadLoop();
+    /* Closes the fences of @buffer that are signaled, returns true if it is not used */
+    bool updateFences(Buffer &buffer);
+    int dupFence(int fence);
+    void closeFences(Buffer &buffer);
+    void evictBuffers();
+    /*
+     * Moves the idle buffers that are returned before @time to @buffers,
+     * the buffers on screen are kept unless @force
+     */
+    void collectIdleBuffers(nsecs_t time, bool force, std::list<Buffer> &buffers);
+    void freeBuffers(std::list<Buffer> &buffers);
+    void trimBuffers(nsecs_t idleTime, bool force);
+
+    BufferOps mOps;
+    uint64_t mMaxIdleBytes;
+    nsecs_t mIdleTimeout;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    /* The most recently returned buffer is the first */
+    std::list<Buffer> mIdleBuffers;
+    uint64_t mIdleBytes = 0;
+    /* Evicted by the high-water mark and freed by the trim thread, they are off screen */
+    std::list<Buffer> mEvictedBuffers;
+    std::unordered_map<buffer_handle_t, Buffer> mBorrowedBuffers;
+    /* The frames presented by each display */
+    std::unordered_map<uint32_t, uint64_t> mPresentCounts;
+    std::function<void(buffer_handle_t)> mBufDestroyedCallback = nullptr;
+    Stats mStats;
+
+    /* Serializes the frees, trim() returns after the frees in progress */
+    std::mutex mFreeMutex;
+    std::thread mTrimThread;
+    bool mRunning = false;
+};
+
+#endif  // _EXYNOSMPPBUFFERPOOL_H
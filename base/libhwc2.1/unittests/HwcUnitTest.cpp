@@ -29,13 +29,19 @@
 #include "ExynosDeviceDrmInterface.h"
 #include "ExynosHWCDebug.h"
 #include <hardware/hwcomposer_defs.h>
+#include <hardware/gralloc.h>
 #include "DeconDrmHeader.h"
 #include "DrmDataType.h"
 
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWCService.h"
 
+#include <fcntl.h>
 #include <sys/types.h>
+#include <poll.h>
+#include <set>
+#include <thread>
+#include <vector>
 #include <drm_fourcc.h>
 #include <xf86drm.h>
 #include <drm.h>
@@ -46,6 +52,10 @@
 #include "ExynosGraphicBuffer.h"
 
 #include "OneShotTimer.h"
+#include "ExynosVsyncModel.h"
+#include "ExynosDamageRegion.h"
+#include "ExynosLayerDump.h"
+#include "ExynosMPPBufferPool.h"
 
 #include "TraceUtils.h"
 
@@ -124,6 +134,84 @@ TEST_F(HwcUnitTest, Destructor_FramebufferManager) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, FramebufferManagerPrepareBuffer) {
+    FramebufferManager* tmp = new FramebufferManager();
+    /* There is no drm device, the imports fail without adding framebuffers */
+    tmp->init(-1);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    exynos_win_config_data config;
+    config.state = config.WIN_STATE_BUFFER;
+    config.format = ExynosFormat(HAL_PIXEL_FORMAT_RGBA_8888);
+    config.fd_idma[0] = fds[0];
+    config.buffer_id = 1;
+    config.src.f_w = 64;
+    config.src.f_h = 64;
+
+    tmp->prepareBuffer(HWC_DISPLAY_PRIMARY, config);
+    tmp->prepareBuffer(HWC_DISPLAY_PRIMARY, config);
+    /* The present doesn't wait for a failed import forever */
+    uint32_t fbId = 0;
+    EXPECT_NE(tmp->getBuffer(HWC_DISPLAY_PRIMARY, config, fbId, true), NO_ERROR);
+
+    /* A queued import is dropped with the buffer */
+    config.buffer_id = 2;
+    tmp->prepareBuffer(HWC_DISPLAY_PRIMARY, config);
+    tmp->removeBuffer(2);
+
+    close(fds[0]);
+    close(fds[1]);
+    delete tmp;
+}
+
+TEST_F(HwcUnitTest, FramebufferManagerImportBuffer) {
+    int drmFd = open("/dev/dri/card0", O_RDWR | O_CLOEXEC);
+    if (drmFd < 0)
+        GTEST_SKIP() << "no drm device";
+
+    struct drm_mode_create_dumb createDumb = {.height = 64, .width = 64, .bpp = 32};
+    if (drmIoctl(drmFd, DRM_IOCTL_MODE_CREATE_DUMB, &createDumb)) {
+        close(drmFd);
+        GTEST_SKIP() << "no dumb buffer";
+    }
+    int bufFd = -1;
+    ASSERT_EQ(drmPrimeHandleToFD(drmFd, createDumb.handle, DRM_CLOEXEC, &bufFd), 0);
+    struct drm_mode_destroy_dumb destroyDumb = {.handle = createDumb.handle};
+    drmIoctl(drmFd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroyDumb);
+
+    FramebufferManager* tmp = new FramebufferManager();
+    tmp->init(drmFd);
+
+    exynos_win_config_data config;
+    config.state = config.WIN_STATE_BUFFER;
+    config.format = ExynosFormat(HAL_PIXEL_FORMAT_RGBA_8888);
+    config.fd_idma[0] = bufFd;
+    config.src.f_w = 64;
+    config.src.f_h = 64;
+
+    /*
+     * The import thread and the present of another display import the same
+     * buffer at once and get the same gem handle
+     */
+    for (uint64_t bufferId = 1; bufferId <= 16; bufferId++) {
+        config.buffer_id = bufferId;
+        tmp->prepareBuffer(HWC_DISPLAY_PRIMARY, config);
+        uint32_t fbId = 0;
+        EXPECT_EQ(tmp->getBuffer(HWC_DISPLAY_EXTERNAL, config, fbId, true), NO_ERROR);
+        EXPECT_NE(fbId, 0u);
+        fbId = 0;
+        EXPECT_EQ(tmp->getBuffer(HWC_DISPLAY_PRIMARY, config, fbId, true), NO_ERROR);
+        EXPECT_NE(fbId, 0u);
+        tmp->flip(HWC_DISPLAY_EXTERNAL, false);
+        tmp->flip(HWC_DISPLAY_PRIMARY, false);
+    }
+
+    delete tmp;
+    close(bufFd);
+    close(drmFd);
+}
+
 TEST_F(HwcUnitTest, Destructor_ExynosPrimaryDisplay) {
     uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
     DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
@@ -418,6 +506,65 @@ TEST_F(HwcUnitTest, ExynosFenceTracer) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, ExynosFenceTracerLeakCount) {
+    ExynosFenceTracer* tmp = new ExynosFenceTracer();
+    DisplayIdentifier primary;
+    DisplayIdentifier external;
+    primary.id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    external.id = getDisplayId(HWC_DISPLAY_EXTERNAL, 0);
+
+    /* The fds are not used as files by the tracer */
+    tmp->setFenceInfo(100, primary, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, FENCE_FROM);
+    tmp->setFenceInfo(101, external, FENCE_TYPE_PRESENT, FENCE_IP_DPP, FENCE_FROM, true);
+    EXPECT_EQ(tmp->getUnbalancedFenceCount(primary), 1);
+    EXPECT_EQ(tmp->getUnbalancedFenceCount(external), 0);
+    EXPECT_EQ(tmp->getFenceState(100).usage, 1);
+
+    tmp->setFenceInfo(100, primary, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, FENCE_TO);
+    EXPECT_EQ(tmp->getUnbalancedFenceCount(primary), 0);
+    EXPECT_TRUE(tmp->validateFencePerFrame(primary));
+
+    /* A leak is reported once */
+    tmp->setFenceInfo(102, primary, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, FENCE_FROM);
+    EXPECT_FALSE(tmp->validateFencePerFrame(primary));
+    EXPECT_TRUE(tmp->validateFencePerFrame(primary));
+
+    tmp->setFenceInfo(102, primary, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, FENCE_CLOSE);
+    tmp->setFenceInfo(101, external, FENCE_TYPE_PRESENT, FENCE_IP_DPP, FENCE_CLOSE);
+    EXPECT_EQ(tmp->getFenceState(102).usage, 0);
+    EXPECT_FALSE(tmp->fenceWarn(0));
+
+    delete tmp;
+}
+
+TEST_F(HwcUnitTest, ExynosFenceTracerDisplaySlotRace) {
+    constexpr int32_t kThreads = 4;
+    DisplayIdentifier display;
+    display.id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+
+    for (int32_t round = 0; round < 200; round++) {
+        ExynosFenceTracer* tmp = new ExynosFenceTracer();
+        std::atomic<int32_t> ready = 0;
+        std::vector<std::thread> threads;
+
+        /* The first fences of a display claim its slot at the same time */
+        for (int32_t i = 0; i < kThreads; i++) {
+            threads.emplace_back([&, i] {
+                ready++;
+                while (ready.load() < kThreads)
+                    std::this_thread::yield();
+                tmp->setFenceInfo(100 + i, display, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP,
+                                  FENCE_FROM);
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        ASSERT_EQ(tmp->getUnbalancedFenceCount(display), kThreads) << "round " << round;
+        delete tmp;
+    }
+}
+
 TEST_F(HwcUnitTest, ExynosHWCHelper) {
     min(1,1);
 
@@ -554,3 +701,422 @@ TEST_F(HwcUnitTest, ExynosDisplay_cpp) {
 
     delete tmp;
 }
+
+TEST_F(HwcUnitTest, ExynosVsyncModel) {
+    ExynosVsyncModel model;
+    nsecs_t configPeriod = 16666666;
+    nsecs_t period = 16670000;
+    nsecs_t timestamp = s2ns(1);
+
+    EXPECT_EQ(model.getPredictedVsync(timestamp), 0);
+
+    for (int i = 0; i < 20; i++) {
+        timestamp += period;
+        /* vsyncs disabled for a while */
+        if (i % 5 == 2)
+            continue;
+        model.addVsync(timestamp + ((i % 2) ? 20000 : -20000), configPeriod);
+    }
+    EXPECT_TRUE(model.isValid());
+    EXPECT_NEAR(model.getPeriod(), period, 10000);
+    EXPECT_NEAR(model.getPredictedVsync(timestamp + 1000), timestamp + period, 50000);
+
+    /* Commits that finish before and after the predicted vsync */
+    model.addCommit(timestamp + 1000, timestamp + period - ms2ns(2));
+    model.addCommit(timestamp + 1000, timestamp + period + ms2ns(2));
+
+    /* Outliers don't move the timeline until they are consecutive */
+    model.addVsync(timestamp + period + ms2ns(4), configPeriod);
+    EXPECT_TRUE(model.isValid());
+    timestamp += period * 2;
+    for (uint32_t i = 0; i < ExynosVsyncModel::MAX_CONSECUTIVE_OUTLIERS; i++)
+        model.addVsync(timestamp + period * i + ms2ns(4), configPeriod);
+    EXPECT_FALSE(model.isValid());
+
+    String8 result;
+    model.dump(result);
+    EXPECT_NE(result.find("late commits(1)"), -1);
+
+    model.reset();
+    EXPECT_EQ(model.getPredictedVsync(timestamp), 0);
+}
+
+TEST_F(HwcUnitTest, ExynosVsyncModelDrift) {
+    ExynosVsyncModel model;
+    nsecs_t configPeriod = 16666666;
+    /* 59.94Hz panel on a 60Hz config, 1000ppm of drift */
+    nsecs_t period = 16683350;
+    nsecs_t timestamp = s2ns(1);
+
+    for (int i = 0; i < 3000; i++) {
+        timestamp += period;
+        model.addVsync(timestamp + ((i % 2) ? 20000 : -20000), configPeriod);
+        if (i >= (int)ExynosVsyncModel::MIN_SAMPLES)
+            ASSERT_TRUE(model.isValid()) << "vsync " << i;
+    }
+    EXPECT_NEAR(model.getPeriod(), period, 1000);
+    EXPECT_NEAR(model.getPredictedVsync(timestamp + ms2ns(1)), timestamp + period, 50000);
+
+    String8 result;
+    model.dump(result);
+    EXPECT_NE(result.find("restarts(0)"), -1);
+}
+
+TEST_F(HwcUnitTest, ExynosDamageRegion) {
+    ExynosDamageRegion region;
+    region.clear(1080, 2400);
+    EXPECT_TRUE(region.isEmpty());
+
+    /* Disjoint rects are kept, overlapping and clipped ones are merged */
+    region.add({40, 20, 200, 70});
+    region.add({960, 2300, 1040, 2380});
+    EXPECT_EQ(region.getNumRects(), 2u);
+    EXPECT_EQ(region.getArea(), 160u * 50 + 80u * 80);
+    region.add({150, 60, 1100, 100});
+    EXPECT_EQ(region.getNumRects(), 2u);
+    hwc_rect_t bounds = region.getBounds();
+    EXPECT_EQ(bounds.left, 40);
+    EXPECT_EQ(bounds.right, 1080);
+    EXPECT_EQ(bounds.bottom, 2380);
+
+    /* The set is bounded */
+    region.clear(1080, 2400);
+    for (int i = 0; i < (int)ExynosDamageRegion::MAX_RECTS * 2; i++)
+        region.add({0, i * 100, 10, i * 100 + 10});
+    EXPECT_EQ(region.getNumRects(), ExynosDamageRegion::MAX_RECTS);
+    EXPECT_GE(region.getArea(), 10u * 10 * ExynosDamageRegion::MAX_RECTS * 2);
+
+    /* Alignment to two DSC slices of 540x40 */
+    ExynosDamageRegion::UpdateCost cost;
+    cost.alignWidth = 540;
+    cost.alignHeight = 40;
+    cost.overhead = 16 * 1080 * 3;
+    hwc_rect_t aligned = region.alignRect({100, 1210, 104, 1260}, cost);
+    EXPECT_EQ(aligned.left, 0);
+    EXPECT_EQ(aligned.top, 1200);
+    EXPECT_EQ(aligned.right, 540);
+    EXPECT_EQ(aligned.bottom, 1280);
+}
+
+/*
+ * Replays a damage trace of a phone UI and compares the bytes of always
+ * updating the full frame, of updating the aligned bounds of the damage,
+ * and of the choice of ExynosDamageRegion.
+ */
+TEST_F(HwcUnitTest, ExynosDamageRegionTrace) {
+    const std::vector<ExynosDamageRegion::Plane> planes = {
+        {{0, 0, 1080, 2400}, 32},   /* wallpaper */
+        {{0, 80, 1080, 2280}, 32},  /* app */
+        {{0, 0, 1080, 80}, 32},     /* status bar */
+        {{0, 2280, 1080, 2400}, 32} /* navigation bar */
+    };
+    const std::vector<std::vector<hwc_rect_t>> trace = {
+        {{40, 20, 200, 70}},                               /* clock */
+        {{40, 20, 200, 70}, {960, 2300, 1040, 2380}},      /* clock and an icon */
+        {{100, 1210, 104, 1260}},                          /* cursor */
+        {{60, 1500, 1020, 1520}},                          /* progress bar */
+        {{500, 1000, 580, 1080}, {620, 1000, 700, 1080}},  /* animation */
+        {{0, 80, 1080, 2280}},                             /* scroll */
+        {{0, 0, 1080, 2400}},                              /* full */
+        {},                                                /* nothing damaged */
+    };
+
+    ExynosDamageRegion::UpdateCost cost;
+    cost.alignWidth = 540;
+    cost.alignHeight = 40;
+    cost.overhead = 16 * 1080 * cost.outputBpp / 8;
+
+    ExynosDamageRegion region;
+    uint64_t fullBytes = 0, boundsBytes = 0, chosenBytes = 0;
+    for (int repeat = 0; repeat < 10; repeat++) {
+        for (auto &frame : trace) {
+            region.clear(1080, 2400);
+            for (auto &rect : frame)
+                region.add(rect);
+
+            hwc_rect_t full = {0, 0, 1080, 2400};
+            uint64_t frameFullBytes = region.getFrameBytes(full, cost, planes);
+            fullBytes += frameFullBytes;
+            if (region.isEmpty())
+                boundsBytes += frameFullBytes;
+            else
+                boundsBytes += region.getFrameBytes(region.alignRect(region.getBounds(), cost),
+                                                    cost, planes) + cost.overhead;
+
+            hwc_rect_t update;
+            if (region.getUpdateRect(cost, planes, update))
+                chosenBytes += region.getFrameBytes(update, cost, planes) + cost.overhead;
+            else
+                chosenBytes += frameFullBytes;
+        }
+    }
+
+    String8 result;
+    region.dump(result);
+    printf("full(%" PRIu64 " KB), bounds(%" PRIu64 " KB), chosen(%" PRIu64 " KB)\n%s",
+           fullBytes / 1024, boundsBytes / 1024, chosenBytes / 1024, result.string());
+
+    EXPECT_LE(chosenBytes, boundsBytes);
+    EXPECT_LT(chosenBytes, fullBytes);
+    /* The clock and the icon in opposite corners are updated in full */
+    EXPECT_LT(chosenBytes, boundsBytes);
+}
+
+TEST_F(HwcUnitTest, ExynosLayerDumpFile) {
+    /* A gradient of RGBA pixels and a noise that does not compress */
+    std::vector<uint8_t> raw(ExynosLayerDumpFile::CHUNK_SIZE * 2 + 1000);
+    for (size_t i = 0; i < raw.size(); i++)
+        raw[i] = (i % 4 == 3) ? 0xff : (i / 4) % 1080 * 255 / 1080;
+    for (size_t i = ExynosLayerDumpFile::CHUNK_SIZE; i < ExynosLayerDumpFile::CHUNK_SIZE + 4096; i++)
+        raw[i] = rand();
+
+    char path[] = "/data/local/tmp/layer_dump_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    ExynosLayerDumpFile file;
+    ASSERT_TRUE(file.open(path, true, 4));
+    EXPECT_TRUE(file.write(raw.data(), 100));
+    EXPECT_TRUE(file.write(raw.data() + 100, raw.size() - 100));
+    EXPECT_TRUE(file.close());
+    EXPECT_EQ(file.getRawBytes(), raw.size());
+    EXPECT_LT(file.getWrittenBytes(), raw.size() / 10);
+
+    std::vector<uint8_t> stored(file.getWrittenBytes());
+    FILE *fp = fopen(path, "r");
+    ASSERT_NE(fp, nullptr);
+    EXPECT_EQ(fread(stored.data(), 1, stored.size(), fp), stored.size());
+    fclose(fp);
+    unlink(path);
+
+    std::vector<uint8_t> decoded;
+    EXPECT_TRUE(ExynosLayerDumpFile::decompress(stored.data(), stored.size(), decoded));
+    EXPECT_EQ(decoded, raw);
+
+    /* A truncated file is rejected */
+    EXPECT_FALSE(ExynosLayerDumpFile::decompress(stored.data(), stored.size() - 1, decoded));
+}
+
+TEST_F(HwcUnitTest, ExynosHWCFormatIndex) {
+    /* The first entry of the format, as the table was scanned */
+    auto scan = [](int format, uint32_t compressType) -> const format_description_t * {
+        for (auto &desc : exynos_format_desc) {
+            if ((desc.halFormat == format) &&
+                ((compressType == COMP_TYPE_NONE) || desc.isCompressionSupported(compressType)))
+                return &desc;
+        }
+        return nullptr;
+    };
+
+    std::vector<int> formats = {0, -1, 0x7fffffff, INT32_MIN, 0x100, 0x12345678};
+    for (auto &desc : exynos_format_desc) {
+        formats.push_back(desc.halFormat);
+        formats.push_back(desc.halFormat + 1);
+    }
+
+    for (int format : formats) {
+        const format_description_t *desc = scan(format, COMP_TYPE_NONE);
+        uint32_t type = desc ? desc->type : 0;
+        uint32_t yuvType = type & FORMAT_YUV_MASK;
+        uint32_t sbwcType = type & FORMAT_SBWC_MASK;
+        SCOPED_TRACE(format);
+
+        EXPECT_EQ(getFormatDescIndex(format),
+                  desc ? (uint32_t)(desc - exynos_format_desc) : (uint32_t)FORMAT_MAX_CNT);
+        EXPECT_EQ(formatToBpp(format), desc ? desc->bpp : 0);
+        EXPECT_EQ(isFormatRgb(format), (type & FORMAT_RGB_MASK) != 0);
+        EXPECT_EQ(isFormatYUV(format), (type & FORMAT_RGB_MASK) == 0);
+        EXPECT_EQ(isFormatSBWC(format), sbwcType != 0);
+        EXPECT_EQ(isFormatYUV420(format), desc && ((yuvType == YUV420) || (yuvType == P010)));
+        EXPECT_EQ(isFormatYUV8_2(format), desc && (yuvType == YUV420) && ((type & BIT_MASK) == BIT8_2));
+        EXPECT_EQ(isFormat10BitYUV420(format),
+                  desc && ((yuvType == YUV420) || (yuvType == P010)) && ((type & BIT_MASK) == BIT10));
+        EXPECT_EQ(isFormatYUV422(format), desc && (yuvType == YUV422));
+        EXPECT_EQ(isFormatP010(format), desc && (yuvType == P010));
+        EXPECT_EQ(isFormat10Bit(format), desc && ((type & BIT_MASK) == BIT10));
+        EXPECT_EQ(isFormat8Bit(format), desc && ((type & BIT_MASK) == BIT8));
+        EXPECT_EQ(isFormatLossy(format), sbwcType && (sbwcType != SBWC_LOSSLESS));
+        EXPECT_EQ(formatHasAlphaChannel(format), desc && desc->hasAlpha);
+        EXPECT_EQ(halFormatToDpuFormat(format), desc ? desc->s3cFormat : DECON_PIXEL_FORMAT_MAX);
+        EXPECT_EQ(getBufferNumOfFormat(format), desc ? desc->bufferNum : 0);
+        EXPECT_EQ(getTypeOfFormat(format), type);
+        EXPECT_EQ(getPlaneNumOfFormat(format), desc ? desc->planeNum : 0);
+        if (desc) {
+            EXPECT_STREQ(getFormatStr(format).string(), desc->name.string());
+        }
+
+        for (uint32_t compressType : {COMP_TYPE_NONE, COMP_TYPE_AFBC, COMP_TYPE_SBWC, COMP_TYPE_SAJC}) {
+            const format_description_t *compressed = scan(format, compressType);
+            EXPECT_EQ(halFormatToExynosFormat(format, compressType), compressed);
+
+            ExynosFormat exynosFormat(format, compressType);
+            EXPECT_EQ(&exynosFormat.getFormatDesc(),
+                      compressed ? compressed : &exynos_format_desc[kDefaultFormatIndex]);
+        }
+    }
+
+    /* The index is built at compile time */
+    static_assert(getFormatDescIndex(HAL_PIXEL_FORMAT_RGBA_8888) == 0);
+    static_assert(exynos_format_desc[getFormatDescIndex(HAL_PIXEL_FORMAT_RGB_565,
+                                                        COMP_TYPE_AFBC)].drmFormat ==
+                  DRM_FORMAT_BGR565);
+}
+
+TEST_F(HwcUnitTest, ExynosMPPBufferPool) {
+    std::mutex lock;
+    std::set<buffer_handle_t> allocated;
+    uintptr_t nextHandle = 1;
+    uint32_t failAllocations = 0;
+
+    /* The free can be called by the trim thread */
+    ExynosMPPBufferPool::BufferOps ops;
+    ops.allocate = [&](const ExynosMPPBufferPool::Key &, buffer_handle_t &handle) -> int32_t {
+        std::lock_guard<std::mutex> guard(lock);
+        if (failAllocations) {
+            failAllocations--;
+            return -ENOMEM;
+        }
+        handle = reinterpret_cast<buffer_handle_t>(nextHandle++);
+        allocated.insert(handle);
+        return NO_ERROR;
+    };
+    ops.free = [&](buffer_handle_t handle) {
+        std::lock_guard<std::mutex> guard(lock);
+        EXPECT_EQ(allocated.erase(handle), 1u);
+    };
+    /* A fence is the read end of a pipe, signaled by a write */
+    ops.isFenceSignaled = [](int fence) {
+        struct pollfd pfd = {fence, POLLIN, 0};
+        return poll(&pfd, 1, 0) > 0;
+    };
+    auto isAllocated = [&](buffer_handle_t handle) {
+        std::lock_guard<std::mutex> guard(lock);
+        return allocated.count(handle) != 0;
+    };
+
+    int fence[2];
+    ASSERT_EQ(pipe(fence), 0);
+
+    ExynosMPPBufferPool::Key rgba = {1088, 2400, HAL_PIXEL_FORMAT_RGBA_8888, 0};
+    ExynosMPPBufferPool::Key secure = rgba;
+    secure.usage = GRALLOC_USAGE_PROTECTED;
+    uint64_t rgbaSize = 1088 * 2400 * 4;
+    ExynosMPPBufferPool pool(ops, rgbaSize * 2, seconds(100));
+
+    buffer_handle_t h1, h2, h3, h4, handle;
+
+    /* A returned buffer is reused by its key only */
+    ASSERT_EQ(pool.acquire(rgba, h1), NO_ERROR);
+    pool.release(h1, -1, -1, UINT32_MAX, 0);
+    ASSERT_EQ(pool.acquire(secure, h2), NO_ERROR);
+    EXPECT_NE(h2, h1);
+    ASSERT_EQ(pool.acquire(rgba, handle), NO_ERROR);
+    EXPECT_EQ(handle, h1);
+
+    /* A buffer read by the display or being written is not handed out */
+    pool.release(h1, -1, fence[0], UINT32_MAX, 0);
+    ASSERT_EQ(pool.acquire(rgba, h3), NO_ERROR);
+    EXPECT_NE(h3, h1);
+    pool.release(h3, fence[0], -1, UINT32_MAX, 0);
+    ASSERT_EQ(pool.acquire(rgba, h4), NO_ERROR);
+    EXPECT_NE(h4, h1);
+    EXPECT_NE(h4, h3);
+    ASSERT_EQ(write(fence[1], "x", 1), 1);
+    ASSERT_EQ(pool.acquire(rgba, handle), NO_ERROR);
+    EXPECT_EQ(handle, h3);
+    ASSERT_EQ(pool.acquire(rgba, handle), NO_ERROR);
+    EXPECT_EQ(handle, h1);
+    EXPECT_EQ(pool.getBorrowedCount(), 4u);
+
+    /* The least recently returned buffer is freed beyond the high-water mark */
+    pool.release(h1, -1, fence[0], UINT32_MAX, 0);
+    pool.release(h3, -1, -1, UINT32_MAX, 0);
+    pool.release(h4, -1, -1, UINT32_MAX, 0);
+    EXPECT_EQ(pool.getIdleCount(), 2u);
+    EXPECT_EQ(pool.getIdleBytes(), rgbaSize * 2);
+    pool.trim(seconds(100));
+    EXPECT_FALSE(isAllocated(h1));
+    EXPECT_TRUE(isAllocated(h3));
+
+    /* The idle buffers are freed if an allocation fails */
+    failAllocations = 1;
+    ASSERT_EQ(pool.acquire({1088, 2400, HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN, 0}, handle),
+              NO_ERROR);
+    EXPECT_EQ(pool.getIdleCount(), 0u);
+    EXPECT_FALSE(isAllocated(h3));
+    EXPECT_FALSE(isAllocated(h4));
+    failAllocations = 2;
+    EXPECT_NE(pool.acquire(rgba, h1), NO_ERROR);
+
+    /* The buffers idle for the timeout are trimmed */
+    pool.setMaxIdleBytes(rgbaSize * 4);
+    pool.release(handle, -1, -1, UINT32_MAX, 0);
+    pool.release(h2, -1, -1, UINT32_MAX, 0);
+    pool.trim(seconds(100));
+    EXPECT_EQ(pool.getIdleCount(), 2u);
+    pool.trim(0);
+    EXPECT_EQ(pool.getIdleCount(), 0u);
+    EXPECT_EQ(pool.getBorrowedCount(), 0u);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        EXPECT_TRUE(allocated.empty());
+    }
+
+    /*
+     * A buffer shown by a display is on screen after its release fence signals,
+     * it is held back until the display presents two frames
+     */
+    int present[2];
+    ASSERT_EQ(pipe(present), 0);
+    std::vector<buffer_handle_t> others;
+    auto acquireOther = [&]() {
+        ASSERT_EQ(pool.acquire(rgba, handle), NO_ERROR);
+        EXPECT_NE(handle, h1);
+        others.push_back(handle);
+    };
+    ASSERT_EQ(pool.acquire(rgba, h1), NO_ERROR);
+    pool.release(h1, -1, fence[0], 0, 2);
+    acquireOther();
+    /* The frames of another display do not count */
+    pool.onPresent(1, -1);
+    pool.onPresent(0, -1);
+    acquireOther();
+    pool.onPresent(0, -1);
+    ASSERT_EQ(pool.acquire(rgba, handle), NO_ERROR);
+    EXPECT_EQ(handle, h1);
+
+    /* Or until the present fence of a later frame of the display signals */
+    pool.release(h1, -1, fence[0], 0, 2);
+    pool.onPresent(0, present[0]);
+    acquireOther();
+    ASSERT_EQ(write(present[1], "x", 1), 1);
+    ASSERT_EQ(pool.acquire(rgba, handle), NO_ERROR);
+    EXPECT_EQ(handle, h1);
+
+    /* The buffers on screen are not trimmed */
+    pool.release(h1, -1, -1, 0, 2);
+    for (auto &other : others)
+        pool.release(other, -1, -1, UINT32_MAX, 0);
+    pool.trim(0);
+    EXPECT_EQ(pool.getIdleCount(), 1u);
+    EXPECT_TRUE(isAllocated(h1));
+
+    /* The holds of a display end when it is cleared, powered off or removed */
+    pool.releaseDisplay(1);
+    pool.trim(0);
+    EXPECT_TRUE(isAllocated(h1));
+    pool.releaseDisplay(0);
+    pool.trim(0);
+    EXPECT_EQ(pool.getIdleCount(), 0u);
+    EXPECT_FALSE(isAllocated(h1));
+
+    String8 result;
+    pool.dump(result);
+    printf("%s", result.string());
+
+    close(fence[0]);
+    close(fence[1]);
+    close(present[0]);
+    close(present[1]);
+}
@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <log/log.h>
+#include <algorithm>
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosFenceTracer.h"
@@ -43,214 +45,317 @@ extern uint64_t errorFrameCount;
     }
 ANDROID_SINGLETON_STATIC_INSTANCE(ExynosFenceTracer);
 
-ExynosFenceTracer::ExynosFenceTracer() {
-    mFenceInfo.clear();
+static_assert(sizeof(hwc_fence_state) == sizeof(uint64_t),
+              "hwc_fence_state should be updated by a single compare and swap");
+static_assert((ExynosFenceTracer::EVENT_RING_SIZE & (ExynosFenceTracer::EVENT_RING_SIZE - 1)) == 0,
+              "EVENT_RING_SIZE should be a power of 2");
+
+thread_local ExynosFenceTracer::ThreadEventRing ExynosFenceTracer::sThreadEventRing;
+static std::atomic<uint32_t> sTracerCount = 0;
+
+/* fd(16) | dir(4) | type(4) | ip(4) | reserved(4) | usage(16) | frame(16) */
+static inline uint64_t packEvent(uint32_t fd, uint32_t dir, uint32_t type, uint32_t ip,
+                                 int32_t usage, uint32_t frame) {
+    return (uint64_t)(fd & 0xffff) | ((uint64_t)(dir & 0xf) << 16) |
+           ((uint64_t)(type & 0xf) << 20) | ((uint64_t)(ip & 0xf) << 24) |
+           ((uint64_t)(uint16_t)usage << 32) | ((uint64_t)(frame & 0xffff) << 48);
+}
+
+ExynosFenceTracer::ExynosFenceTracer()
+      : mFenceStates(new std::atomic<hwc_fence_state>[MAX_TRACKED_FDS]),
+        mTracerId(++sTracerCount) {
+    for (int32_t i = 0; i < MAX_TRACKED_FDS; i++)
+        mFenceStates[i].store(hwc_fence_state(), std::memory_order_relaxed);
 }
 
 ExynosFenceTracer::~ExynosFenceTracer() {
 }
 
-void ExynosFenceTracer::writeFenceInfo(uint32_t fd, hwc_fence_info_t *info,
-                                       hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
-                                       uint32_t direction, bool pendingAllowed) {
-    /* Sequnce is ring buffer */
-    /* update last flag, sequence */
-    info->seq[info->seq_no].isLast = false;
-    info->seq_no++;
-    if (info->seq_no >= MAX_FENCE_SEQUENCE)
-        info->seq_no = 0;
-    fenceTrace_t *seq = &info->seq[info->seq_no];
-    seq->isLast = true;
-
-    /* direction, type, ip */
-    seq->dir = direction;
-    seq->type = type;
-    seq->ip = ip;
-    seq->curFlag = 1;
-    info->pendingAllowed = pendingAllowed;
-
-    /* time */
-    struct timeval tv;
-    gettimeofday(&seq->time, NULL);
-    tv = seq->time;
+uint8_t ExynosFenceTracer::getDisplaySlot(uint32_t displayId) {
+    for (uint32_t i = 0; i < MAX_DISPLAY_SLOTS; i++) {
+        uint32_t id = mDisplaySlots[i].displayId.load(std::memory_order_acquire);
+        if (id == displayId)
+            return i;
+        if (id != UINT32_MAX)
+            continue;
+        /* A failed exchange loads the winner, which can claim it for the same display */
+        if (mDisplaySlots[i].displayId.compare_exchange_strong(id, displayId) ||
+            (id == displayId))
+            return i;
+    }
+    return UINT8_MAX;
+}
+
+void ExynosFenceTracer::updateCounters(const hwc_fence_state &prev, const hwc_fence_state &next) {
+    if (isUnbalanced(prev) && (prev.displaySlot < MAX_DISPLAY_SLOTS))
+        mDisplaySlots[prev.displaySlot].unbalanced.fetch_sub(1, std::memory_order_relaxed);
+    if (isUnbalanced(next) && (next.displaySlot < MAX_DISPLAY_SLOTS))
+        mDisplaySlots[next.displaySlot].unbalanced.fetch_add(1, std::memory_order_relaxed);
+
+    if ((prev.usage != 0) != (next.usage != 0))
+        mActiveFences.fetch_add((next.usage != 0) ? 1 : -1, std::memory_order_relaxed);
+}
+
+bool ExynosFenceTracer::updateFenceState(uint32_t fd, const DisplayIdentifier &display,
+                                         hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
+                                         uint32_t direction, bool pendingAllowed,
+                                         bool countUsage, hwc_fence_state &outState) {
+    if (!fence_valid(fd))
+        return false;
+    if (fd >= (uint32_t)MAX_TRACKED_FDS) {
+        mUntrackedEvents.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint8_t slot = getDisplaySlot(display.id);
+    std::atomic<hwc_fence_state> &entry = mFenceStates[fd];
+    hwc_fence_state prev = entry.load(std::memory_order_relaxed);
+    hwc_fence_state next;
+    do {
+        next = prev;
+        next.displaySlot = slot;
+        next.lastDir = direction;
+        next.lastType = type;
+        next.lastIp = ip;
+        if (pendingAllowed)
+            next.flags |= FENCE_FLAG_PENDING_ALLOWED;
+        else
+            next.flags &= ~FENCE_FLAG_PENDING_ALLOWED;
+
+        if (countUsage) {
+            if ((direction == FENCE_FROM) || (direction == FENCE_DUP)) {
+                next.usage++;
+            } else if ((direction == FENCE_TO) || (direction == FENCE_CLOSE)) {
+                next.usage--;
+                if ((direction == FENCE_CLOSE) && (next.usage < 0))
+                    next.usage = 0;
+            }
+            // Fence's usage count shuld be zero at end of frame(present done).
+            // This flag means usage count of the fence can be pended over frame.
+            if (next.usage == 0)
+                next.flags &= ~(FENCE_FLAG_PENDING_ALLOWED | FENCE_FLAG_LEAKING);
+        }
+    } while (!entry.compare_exchange_weak(prev, next, std::memory_order_acq_rel,
+                                          std::memory_order_relaxed));
+
+    updateCounters(prev, next);
+    recordEvent(fd, direction, type, ip, next.usage);
+    outState = next;
+    return true;
 }
 
 void ExynosFenceTracer::changeFenceInfoState(uint32_t fd, const DisplayIdentifier &display,
                                              hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
                                              uint32_t direction, bool pendingAllowed) {
-    if (!fence_valid(fd))
-        return;
-
-    /* init or recevice(from previous) trace info */
-    hwc_fence_info_t info;
-    if (mFenceInfo.count(fd) == 0) {
-        info = {};
-    } else
-        info = mFenceInfo.at(fd);
-
-    info.displayId = display.id;
-    writeFenceInfo(fd, &info, type, ip, direction, pendingAllowed);
-    FT_LOGD("FD : %d, direction : %d, type(%d), ip(%d) (%s)", fd, direction, type, ip, __func__);
-    mFenceInfo[fd] = info;
+    hwc_fence_state state;
+    if (updateFenceState(fd, display, type, ip, direction, pendingAllowed, false, state))
+        FT_LOGD("FD : %d, direction : %d, type(%d), ip(%d) (%s)", fd, direction, type, ip, __func__);
 }
 
 void ExynosFenceTracer::setFenceInfo(uint32_t fd, const DisplayIdentifier &display,
                                      hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
                                      uint32_t direction, bool pendingAllowed) {
-    if (!fence_valid(fd))
+    if (direction >= FENCE_DIR_MAX) {
+        ALOGE("Fence trace : Undefined direction!");
         return;
-
-    /* init or recevice(from previous) trace info */
-    hwc_fence_info_t info;
-    if (mFenceInfo.count(fd) == 0) {
-        info = {};
-    } else {
-        info = mFenceInfo.at(fd);
     }
 
-    info.displayId = display.id;
-    writeFenceInfo(fd, &info, type, ip, direction, pendingAllowed);
-    fenceTrace_t *seq = &info.seq[info.seq_no];
-
-    /* update usage count */
-    if ((seq->dir == FENCE_FROM) || (seq->dir == FENCE_DUP)) {
-        info.usage++;
-    } else if ((seq->dir == FENCE_TO) || (seq->dir == FENCE_CLOSE)) {
-        info.usage--;
-        if ((seq->dir == FENCE_CLOSE) && (info.usage < 0))
-            info.usage = 0;
-    } else
-        ALOGE("Fence trace : Undefined direction!");
+    hwc_fence_state state;
+    if (!updateFenceState(fd, display, type, ip, direction, pendingAllowed, true, state))
+        return;
 
     FT_LOGI("setFenceInfo(%d):: %s, %s, %s, %s usage: %d",
             fd, display.name.string(),
-            getString(fence_dir_map, seq->dir),
-            getString(fence_type_map, seq->type),
-            getString(fence_ip_map, seq->ip),
-            info.usage);
-
-    seq->usage = info.usage;
-    // Fence's usage count shuld be zero at end of frame(present done).
-    // This flag means usage count of the fence can be pended over frame.
-    if (info.usage == 0)
-        info.pendingAllowed = false;
-
-    /* last direction */
-    info.last_dir = direction;
-    mFenceInfo[fd] = info;
+            getString(fence_dir_map, direction),
+            getString(fence_type_map, type),
+            getString(fence_ip_map, ip),
+            state.usage);
 }
 
-void ExynosFenceTracer::printLastFenceInfo(uint32_t fd) {
-    struct timeval tv;
-    if (!fence_valid(fd))
-        return;
-    if (mFenceInfo.count(fd) == 0)
-        return;
+int32_t ExynosFenceTracer::getUnbalancedFenceCount(const DisplayIdentifier &display) {
+    uint8_t slot = getDisplaySlot(display.id);
+    if (slot >= MAX_DISPLAY_SLOTS)
+        return 0;
+    return mDisplaySlots[slot].unbalanced.load(std::memory_order_relaxed);
+}
 
-    hwc_fence_info_t info = mFenceInfo.at(fd);
-    FT_LOGD("---- Fence FD : %d, Display(%d), usage(%d) ----", fd, info.displayId, info.usage);
+hwc_fence_state ExynosFenceTracer::getFenceState(uint32_t fd) {
+    if (fd >= (uint32_t)MAX_TRACKED_FDS)
+        return hwc_fence_state();
+    return mFenceStates[fd].load(std::memory_order_acquire);
+}
 
-    for (int i = 0; i < MAX_FENCE_SEQUENCE; i++) {
-        fenceTrace_t *seq = &info.seq[i];
-        FT_LOGD("fd(%d) %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
-                fd, getString(fence_dir_map, seq->dir),
-                getString(fence_ip_map, seq->ip), getString(fence_type_map, seq->type),
-                seq->curFlag, seq->usage, (int)seq->isLast);
+ExynosFenceTracer::EventRing *ExynosFenceTracer::getEventRing() {
+    ThreadEventRing &local = sThreadEventRing;
+    if ((local.ring != nullptr) && (local.tracerId == mTracerId))
+        return local.ring.get();
 
-        tv = seq->time;
-        struct tm *localTime = getLocalTime(tv);
+    /* The thread records events of another tracer */
+    if (local.ring != nullptr) {
+        local.ring->owned.store(false, std::memory_order_release);
+        local.ring = nullptr;
+    }
 
-        FT_LOGD("time:%02d-%02d %02d:%02d:%02d.%03lu(%lu)",
-                localTime->tm_mon + 1, localTime->tm_mday,
-                localTime->tm_hour, localTime->tm_min,
-                localTime->tm_sec, tv.tv_usec / 1000,
-                ((tv.tv_sec * 1000) + (tv.tv_usec / 1000)));
+    Mutex::Autolock lock(mEventRingsMutex);
+    for (auto &ring : mEventRings) {
+        bool owned = false;
+        if (ring->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+            local.ring = ring;
+            break;
+        }
+    }
+    if (local.ring == nullptr) {
+        local.ring = std::make_shared<EventRing>();
+        mEventRings.push_back(local.ring);
     }
+    local.tracerId = mTracerId;
+    return local.ring.get();
+}
+
+void ExynosFenceTracer::recordEvent(uint32_t fd, uint32_t direction, hwc_fdebug_fence_type type,
+                                    hwc_fdebug_ip_type ip, int32_t usage) {
+    EventRing *ring = getEventRing();
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    RingEvent &event = ring->events[head % EVENT_RING_SIZE];
+
+    event.time.store(systemTime(SYSTEM_TIME_MONOTONIC), std::memory_order_relaxed);
+    event.data.store(packEvent(fd, direction, type, ip, usage,
+                               mFrame.load(std::memory_order_relaxed)),
+                     std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+/*
+ * The dump can read an event while its owner overwrites it, the time and the
+ * data of such an event could be of different events.
+ */
+std::vector<ExynosFenceTracer::Event> ExynosFenceTracer::collectEvents() {
+    std::vector<Event> events;
+    Mutex::Autolock lock(mEventRingsMutex);
+
+    for (auto &ring : mEventRings) {
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        uint32_t count = std::min(head, EVENT_RING_SIZE);
+        for (uint32_t i = head - count; i != head; i++) {
+            const RingEvent &ringEvent = ring->events[i % EVENT_RING_SIZE];
+            uint64_t data = ringEvent.data.load(std::memory_order_relaxed);
+            Event event;
+            event.time = ringEvent.time.load(std::memory_order_relaxed);
+            event.fd = data & 0xffff;
+            event.dir = (data >> 16) & 0xf;
+            event.type = (data >> 20) & 0xf;
+            event.ip = (data >> 24) & 0xf;
+            event.usage = (int16_t)((data >> 32) & 0xffff);
+            event.frame = (data >> 48) & 0xffff;
+            events.push_back(event);
+        }
+    }
+
+    std::sort(events.begin(), events.end(),
+              [](const Event &a, const Event &b) { return a.time < b.time; });
+    return events;
+}
+
+void ExynosFenceTracer::printEvents(String8 &result, const std::vector<Event> &events,
+                                    uint32_t fd) {
+    /* The last MAX_FENCE_SEQUENCE events of the fd in order */
+    const Event *last[MAX_FENCE_SEQUENCE];
+    uint32_t count = 0;
+    for (auto it = events.rbegin(); (it != events.rend()) && (count < MAX_FENCE_SEQUENCE); ++it) {
+        if (it->fd == (int32_t)fd)
+            last[count++] = &(*it);
+    }
+
+    uint32_t curFrame = mFrame.load(std::memory_order_relaxed) & 0xffff;
+    nsecs_t realtimeOffset = systemTime(SYSTEM_TIME_REALTIME) - systemTime(SYSTEM_TIME_MONOTONIC);
+    while (count > 0) {
+        const Event *event = last[--count];
+        result.appendFormat("    %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
+                            getString(fence_dir_map, event->dir),
+                            getString(fence_ip_map, event->ip),
+                            getString(fence_type_map, event->type),
+                            (int)(event->frame == curFrame), event->usage, (int)(count == 0));
+
+        nsecs_t realtime = event->time + realtimeOffset;
+        time_t sec = realtime / s2ns(1);
+        struct tm *localTime = localtime(&sec);
+        unsigned long msec = ns2ms(realtime % s2ns(1));
+        result.appendFormat(" - time:%02d-%02d %02d:%02d:%02d.%03lu(%lu)\n",
+                            localTime->tm_mon + 1, localTime->tm_mday,
+                            localTime->tm_hour, localTime->tm_min,
+                            localTime->tm_sec, msec, (unsigned long)ns2ms(realtime));
+    }
+}
+
+void ExynosFenceTracer::printLastFenceInfo(uint32_t fd, const std::vector<Event> &events) {
+    if (!fence_valid(fd) || (fd >= (uint32_t)MAX_TRACKED_FDS))
+        return;
+
+    hwc_fence_state state = getFenceState(fd);
+    uint32_t displayId = UINT32_MAX;
+    if (state.displaySlot < MAX_DISPLAY_SLOTS)
+        displayId = mDisplaySlots[state.displaySlot].displayId.load(std::memory_order_relaxed);
+    FT_LOGD("---- Fence FD : %d, Display(%d), usage(%d) ----", fd, displayId, state.usage);
+
+    String8 result;
+    printEvents(result, events, fd);
+    FT_LOGD("%s", result.string());
+}
+
+void ExynosFenceTracer::printLastFenceInfo(uint32_t fd) {
+    printLastFenceInfo(fd, collectEvents());
 }
 
 void ExynosFenceTracer::dumpFenceInfo(int32_t depth) {
     FT_LOGD("Dump fence ++");
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if ((info.usage >= 1 || info.usage <= -1) && (!info.pendingAllowed))
-            printLastFenceInfo(i);
+    std::vector<Event> events = collectEvents();
+    for (int32_t i = 0; i < MAX_TRACKED_FDS; i++) {
+        hwc_fence_state state = getFenceState(i);
+        if ((state.usage != 0) && !(state.flags & FENCE_FLAG_PENDING_ALLOWED))
+            printLastFenceInfo(i, events);
     }
     FT_LOGD("Dump fence --");
 }
 
 bool ExynosFenceTracer::fenceWarn(uint32_t threshold) {
-    uint32_t cnt = 0, r_cnt = 0;
-
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.usage >= 1 || info.usage <= -1)
-            cnt++;
-    }
+    uint32_t cnt = mActiveFences.load(std::memory_order_relaxed);
 
     if ((cnt > threshold) || (exynosHWCControl.fenceTracer > 0))
         dumpFenceInfo(0);
 
-    if (r_cnt > threshold)
-        ALOGE("Fence leak somewhare!!");
-
-    FT_LOGD("fence hwc : %d, real : %d", cnt, r_cnt);
+    FT_LOGD("fence hwc : %d, untracked events : %" PRIu64, cnt,
+            mUntrackedEvents.load(std::memory_order_relaxed));
     return (cnt > threshold) ? true : false;
 }
 
 void ExynosFenceTracer::resetFenceCurFlag() {
     FT_LOGD("%s ++", __func__);
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-
-        if (info.usage == 0) {
-            hwc_fence_info_t *info_ = &mFenceInfo[i];
-            for (int j = 0; j < MAX_FENCE_SEQUENCE; j++)
-                info_->seq[j].curFlag = 0;
-        } else if (!info.pendingAllowed)
-            FT_LOGE("usage mismatched fd %d, usage %d, pending %d", i,
-                    info.usage, info.pendingAllowed);
+    /* The events of the next frame are not current anymore */
+    mFrame.fetch_add(1, std::memory_order_relaxed);
+
+    /* Only the log needs the scan */
+    if (exynosHWCControl.fenceTracer > 0) {
+        for (int32_t i = 0; i < MAX_TRACKED_FDS; i++) {
+            hwc_fence_state state = getFenceState(i);
+            if ((state.usage != 0) && !(state.flags & FENCE_FLAG_PENDING_ALLOWED))
+                FT_LOGE("usage mismatched fd %d, usage %d", i, state.usage);
+        }
     }
     FT_LOGD("%s --", __func__);
 }
 
-void ExynosFenceTracer::printFenceTrace(String8 &saveString, struct tm *localTime) {
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-
-        hwc_fence_info_t info = mFenceInfo.at(i);
-
-        if (info.usage >= 1) {
-            saveString.appendFormat("FD hwc : %d, usage %d, pending : %d\n", i, info.usage, (int)info.pendingAllowed);
-            for (int j = 0; j < MAX_FENCE_SEQUENCE; j++) {
-                fenceTrace_t *seq = &info.seq[j];
-                saveString.appendFormat("    %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
-                                        getString(fence_dir_map, seq->dir),
-                                        getString(fence_ip_map, seq->ip), getString(fence_type_map, seq->type),
-                                        seq->curFlag, seq->usage, (int)seq->isLast);
-
-                struct timeval tv = seq->time;
-                localTime = (struct tm *)localtime((time_t *)&tv.tv_sec);
-
-                saveString.appendFormat(" - time:%02d-%02d %02d:%02d:%02d.%03lu(%lu)\n",
-                                        localTime->tm_mon + 1, localTime->tm_mday,
-                                        localTime->tm_hour, localTime->tm_min,
-                                        localTime->tm_sec, tv.tv_usec / 1000,
-                                        ((tv.tv_sec * 1000) + (tv.tv_usec / 1000)));
-            }
+void ExynosFenceTracer::printFenceTrace(String8 &saveString, struct tm *__unused localTime) {
+    std::vector<Event> events = collectEvents();
+    for (int32_t i = 0; i < MAX_TRACKED_FDS; i++) {
+        hwc_fence_state state = getFenceState(i);
+        if (state.usage >= 1) {
+            saveString.appendFormat("FD hwc : %d, usage %d, pending : %d\n", i, state.usage,
+                                    (int)!!(state.flags & FENCE_FLAG_PENDING_ALLOWED));
+            printEvents(saveString, events, i);
         }
     }
+    saveString.appendFormat("untracked fence events : %" PRIu64 "\n",
+                            mUntrackedEvents.load(std::memory_order_relaxed));
 }
 
 void ExynosFenceTracer::printLeakFds() {
@@ -260,12 +365,8 @@ void ExynosFenceTracer::printLeakFds() {
 
     errStringPlus.appendFormat("Leak Fds (1) :\n");
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.usage >= 1) {
+    for (int32_t i = 0; i < MAX_TRACKED_FDS; i++) {
+        if (getFenceState(i).usage >= 1) {
             errStringPlus.appendFormat("%d,", i);
             if (cnt++ % 10 == 0)
                 errStringPlus.appendFormat("\n");
@@ -276,12 +377,8 @@ void ExynosFenceTracer::printLeakFds() {
     errStringMinus.appendFormat("Leak Fds (-1) :\n");
 
     cnt = 1;
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.usage < 0) {
+    for (int32_t i = 0; i < MAX_TRACKED_FDS; i++) {
+        if (getFenceState(i).usage < 0) {
             errStringMinus.appendFormat("%d,", i);
             if (cnt++ % 10 == 0)
                 errStringMinus.appendFormat("\n");
@@ -291,20 +388,7 @@ void ExynosFenceTracer::printLeakFds() {
 }
 
 bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display) {
-    bool ret = true;
-
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.displayId != display.id)
-            continue;
-        if ((info.usage >= 1 || info.usage <= -1) &&
-            (!info.pendingAllowed) && (!info.leaking)) {
-            ret = false;
-        }
-    }
+    bool ret = (getUnbalancedFenceCount(display) == 0);
 
     if (!ret) {
         int priv = exynosHWCControl.fenceTracer;
@@ -318,17 +402,24 @@ bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display)
 
 void ExynosFenceTracer::dumpNCheckLeak(int32_t depth) {
     FT_LOGD("Dump leaking fence ++");
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if ((info.usage >= 1 || info.usage <= -1) && (!info.pendingAllowed))
+    std::vector<Event> events = collectEvents();
+    for (int32_t i = 0; i < MAX_TRACKED_FDS; i++) {
+        std::atomic<hwc_fence_state> &entry = mFenceStates[i];
+        hwc_fence_state prev = entry.load(std::memory_order_relaxed);
+        hwc_fence_state next;
+        do {
+            if (!isUnbalanced(prev))
+                break;
             // leak is occured in this frame first
-            if (!info.leaking) {
-                info.leaking = true;
-                printLastFenceInfo(i);
-            }
+            next = prev;
+            next.flags |= FENCE_FLAG_LEAKING;
+        } while (!entry.compare_exchange_weak(prev, next, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed));
+
+        if (isUnbalanced(prev)) {
+            updateCounters(prev, next);
+            printLastFenceInfo(i, events);
+        }
     }
 
     int priv = exynosHWCControl.fenceTracer;
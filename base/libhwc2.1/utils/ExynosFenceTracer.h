@@ -19,9 +19,12 @@
 
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCTypes.h"
-#include <vector>
-#include <unordered_map>
+#include <utils/Mutex.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 #define MAX_FENCE_NAME 64
 #define MAX_FENCE_THRESHOLD 500
@@ -94,34 +97,41 @@ const std::map<int32_t, String8> fence_dir_map = {
     {FENCE_CLOSE, String8("Close")},
 };
 
-typedef struct fenceTrace {
-    uint32_t dir;
-    hwc_fdebug_fence_type type;
-    hwc_fdebug_ip_type ip;
-    struct timeval time;
-    int32_t curFlag;
-    int32_t usage;
-    bool isLast;
-} fenceTrace_t;
-
-typedef struct hwc_fence_info {
-    uint32_t displayId;
-    fenceTrace_t seq[MAX_FENCE_SEQUENCE];
-    uint32_t seq_no = 0;
-    uint32_t last_dir;
-    int32_t usage;
-    bool pendingAllowed = false;
-    bool leaking = false;
-} hwc_fence_info_t;
+/*
+ * State of a fence fd. It is packed into 8 bytes so that it is updated
+ * with a single compare and swap.
+ */
+struct hwc_fence_state {
+    int16_t usage = 0;
+    uint8_t displaySlot = UINT8_MAX;
+    uint8_t lastDir = FENCE_DIR_MAX;
+    uint8_t lastType = FENCE_TYPE_UNDEFINED;
+    uint8_t lastIp = FENCE_IP_UNDEFINED;
+    uint8_t flags = 0;
+    uint8_t reserved = 0;
+};
 
 extern int hwcFenceDebug[FENCE_IP_MAX];
+
+/*
+ * ExynosFenceTracer tracks the usage count of the fence fds without locks.
+ *  - The state of a fence is kept in an array indexed by fd and
+ *    every event updates it with a compare and swap.
+ *  - Every display counts its unbalanced fences, the fences whose usage is
+ *    not zero at the end of a frame, when the state changes. So the per frame
+ *    validation doesn't scan the fences unless a leak is found.
+ *  - The history of the events is kept in a ring of every thread that
+ *    records events and it is only read by the dumps.
+ * Fds of MAX_TRACKED_FDS or greater are not tracked.
+ */
 class ExynosFenceTracer : public Singleton<ExynosFenceTracer> {
   public:
+    static constexpr int32_t MAX_TRACKED_FDS = 4096;
+    static constexpr uint32_t MAX_DISPLAY_SLOTS = 16;
+    static constexpr uint32_t EVENT_RING_SIZE = 256;
+
     ExynosFenceTracer();
     ~ExynosFenceTracer();
-    void writeFenceInfo(uint32_t fd, hwc_fence_info_t *info,
-                        hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
-                        uint32_t direction, bool pendingAllowed);
     void changeFenceInfoState(uint32_t fd, const DisplayIdentifier &display,
                               hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
                               uint32_t direction, bool pendingAllowed = false);
@@ -156,9 +166,86 @@ class ExynosFenceTracer : public Singleton<ExynosFenceTracer> {
             return fence;
     }
 
-    // Variable for fence tracer
-    std::unordered_map<int32_t, hwc_fence_info> mFenceInfo;
+    /* Returns the number of unbalanced fences of the display */
+    int32_t getUnbalancedFenceCount(const DisplayIdentifier &display);
+    hwc_fence_state getFenceState(uint32_t fd);
+
     uint32_t mFenceLogSize = 0;
+
+  private:
+    enum {
+        FENCE_FLAG_PENDING_ALLOWED = 1 << 0,
+        FENCE_FLAG_LEAKING = 1 << 1,
+    };
+
+    /* An event of the history, the fields are packed into @data */
+    struct RingEvent {
+        std::atomic<nsecs_t> time = 0;
+        std::atomic<uint64_t> data = 0;
+    };
+
+    /* Written only by the thread that owns it */
+    struct EventRing {
+        std::atomic<bool> owned = true;
+        std::atomic<uint32_t> head = 0;
+        RingEvent events[EVENT_RING_SIZE];
+    };
+
+    struct DisplaySlot {
+        std::atomic<uint32_t> displayId = UINT32_MAX;
+        std::atomic<int32_t> unbalanced = 0;
+    };
+
+    struct Event {
+        nsecs_t time;
+        int32_t fd;
+        uint32_t dir;
+        uint32_t type;
+        uint32_t ip;
+        int32_t usage;
+        uint32_t frame;
+    };
+
+    struct ThreadEventRing {
+        uint32_t tracerId = 0;
+        std::shared_ptr<EventRing> ring;
+        ~ThreadEventRing() {
+            /* The ring keeps the history and is reused by a new thread */
+            if (ring != nullptr)
+                ring->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    static bool isUnbalanced(const hwc_fence_state &state) {
+        return (state.usage != 0) &&
+               !(state.flags & (FENCE_FLAG_PENDING_ALLOWED | FENCE_FLAG_LEAKING));
+    }
+    uint8_t getDisplaySlot(uint32_t displayId);
+    void updateCounters(const hwc_fence_state &prev, const hwc_fence_state &next);
+    bool updateFenceState(uint32_t fd, const DisplayIdentifier &display,
+                          hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
+                          uint32_t direction, bool pendingAllowed, bool countUsage,
+                          hwc_fence_state &outState);
+    void recordEvent(uint32_t fd, uint32_t direction, hwc_fdebug_fence_type type,
+                     hwc_fdebug_ip_type ip, int32_t usage);
+    EventRing *getEventRing();
+    std::vector<Event> collectEvents();
+    void printEvents(String8 &result, const std::vector<Event> &events, uint32_t fd);
+    void printLastFenceInfo(uint32_t fd, const std::vector<Event> &events);
+
+    /* Indexed by fd */
+    std::unique_ptr<std::atomic<hwc_fence_state>[]> mFenceStates;
+    DisplaySlot mDisplaySlots[MAX_DISPLAY_SLOTS];
+    /* The number of fences whose usage is not zero */
+    std::atomic<int32_t> mActiveFences = 0;
+    std::atomic<uint64_t> mUntrackedEvents = 0;
+    std::atomic<uint32_t> mFrame = 0;
+    /* Assigned to every tracer, the rings of the threads belong to one tracer */
+    const uint32_t mTracerId;
+
+    static thread_local ThreadEventRing sThreadEventRing;
+    Mutex mEventRingsMutex;
+    std::vector<std::shared_ptr<EventRing>> mEventRings GUARDED_BY(mEventRingsMutex);
 };
 
 #endif
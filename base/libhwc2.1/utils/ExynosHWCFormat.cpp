@@ -21,26 +21,23 @@ ExynosFormat PredefinedFormat::exynosFormatRgba8;
 ExynosFormat PredefinedFormat::exynosFormatRgba10;
 ExynosFormat PredefinedFormat::exynosFormatUnDefined;
 
+static inline const format_description_t *findFormatDesc(int format) {
+    uint32_t index = getFormatDescIndex(format);
+    return (index < FORMAT_MAX_CNT) ? &exynos_format_desc[index] : nullptr;
+}
+
 uint8_t formatToBpp(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].bpp;
-    }
+    const format_description_t *desc = findFormatDesc(format);
+    if (desc)
+        return desc->bpp;
 
     ALOGW("unrecognized pixel format %u", format);
     return 0;
 }
 
 bool isFormatRgb(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & FORMAT_RGB_MASK)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && (desc->type & FORMAT_RGB_MASK);
 }
 
 bool isFormatYUV(int format) {
@@ -50,135 +47,71 @@ bool isFormatYUV(int format) {
 }
 
 bool isFormatSBWC(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if (exynos_format_desc[i].type & FORMAT_SBWC_MASK)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && (desc->type & FORMAT_SBWC_MASK);
 }
 
 bool isFormatYUV420(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            uint32_t yuvType = exynos_format_desc[i].type & FORMAT_YUV_MASK;
-            if ((yuvType == YUV420) || (yuvType == P010))
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    if (desc == nullptr)
+        return false;
+    uint32_t yuvType = desc->type & FORMAT_YUV_MASK;
+    return (yuvType == YUV420) || (yuvType == P010);
 }
 
 bool isFormatYUV8_2(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if (((exynos_format_desc[i].type & FORMAT_YUV_MASK) == YUV420) &&
-                ((exynos_format_desc[i].type & BIT_MASK) == BIT8_2))
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && ((desc->type & FORMAT_YUV_MASK) == YUV420) &&
+            ((desc->type & BIT_MASK) == BIT8_2);
 }
 
 bool isFormat10BitYUV420(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            uint32_t yuvType = exynos_format_desc[i].type & FORMAT_YUV_MASK;
-            if (((yuvType == YUV420) || (yuvType == P010)) &&
-                ((exynos_format_desc[i].type & BIT_MASK) == BIT10))
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    if (desc == nullptr)
+        return false;
+    uint32_t yuvType = desc->type & FORMAT_YUV_MASK;
+    return ((yuvType == YUV420) || (yuvType == P010)) && ((desc->type & BIT_MASK) == BIT10);
 }
 
 bool isFormatYUV422(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & FORMAT_YUV_MASK) == YUV422)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && ((desc->type & FORMAT_YUV_MASK) == YUV422);
 }
 
 bool isFormatP010(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & FORMAT_YUV_MASK) == P010)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && ((desc->type & FORMAT_YUV_MASK) == P010);
 }
 
 bool isFormat10Bit(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & BIT_MASK) == BIT10)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && ((desc->type & BIT_MASK) == BIT10);
 }
 
 bool isFormat8Bit(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            if ((exynos_format_desc[i].type & BIT_MASK) == BIT8)
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && ((desc->type & BIT_MASK) == BIT8);
 }
 
 bool isFormatLossy(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            uint32_t sbwcType = exynos_format_desc[i].type & FORMAT_SBWC_MASK;
-            if (sbwcType && !(sbwcType == SBWC_LOSSLESS))
-                return true;
-            else
-                return false;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    if (desc == nullptr)
+        return false;
+    uint32_t sbwcType = desc->type & FORMAT_SBWC_MASK;
+    return sbwcType && (sbwcType != SBWC_LOSSLESS);
 }
 
 bool formatHasAlphaChannel(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format) {
-            return exynos_format_desc[i].hasAlpha;
-        }
-    }
-    return false;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc && desc->hasAlpha;
 }
 
 enum decon_pixel_format halFormatToDpuFormat(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].s3cFormat;
-    }
-    return DECON_PIXEL_FORMAT_MAX;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc ? desc->s3cFormat : DECON_PIXEL_FORMAT_MAX;
 }
 
+/* The DPU and DRM formats are looked up only at initialization, so they scan the table */
 uint32_t DpuFormatToHalFormat(int format) {
     for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
         if (exynos_format_desc[i].s3cFormat == static_cast<decon_pixel_format>(format))
@@ -189,15 +122,8 @@ uint32_t DpuFormatToHalFormat(int format) {
 
 const format_description_t *halFormatToExynosFormat(int halFormat,
                                                     uint32_t compressType) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        /* If HAL format is binded different DRM format as compressType,
-         * Non compression format should be found first */
-        bool compressionSupport = (compressType == COMP_TYPE_NONE) ? true : exynos_format_desc[i].isCompressionSupported(compressType);
-
-        if ((exynos_format_desc[i].halFormat == halFormat) && compressionSupport)
-            return &exynos_format_desc[i];
-    }
-    return nullptr;
+    uint32_t index = getFormatDescIndex(halFormat, compressType);
+    return (index < FORMAT_MAX_CNT) ? &exynos_format_desc[index] : nullptr;
 }
 
 uint32_t drmFormatToHalFormats(int format, uint32_t *numFormat,
@@ -223,37 +149,27 @@ int drmFormatToHalFormat(int format) {
 }
 
 String8 getFormatStr(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].name;
-    }
+    const format_description_t *desc = findFormatDesc(format);
+    if (desc)
+        return String8(desc->name.string());
     String8 result;
     result.appendFormat("? %08x", format);
     return result;
 }
 
 uint32_t getBufferNumOfFormat(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].bufferNum;
-    }
-    return 0;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc ? desc->bufferNum : 0;
 }
 
 uint32_t getTypeOfFormat(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].type;
-    }
-    return 0;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc ? desc->type : 0;
 }
 
 uint32_t getPlaneNumOfFormat(int format) {
-    for (unsigned int i = 0; i < FORMAT_MAX_CNT; i++) {
-        if (exynos_format_desc[i].halFormat == format)
-            return exynos_format_desc[i].planeNum;
-    }
-    return 0;
+    const format_description_t *desc = findFormatDesc(format);
+    return desc ? desc->planeNum : 0;
 }
 
 uint32_t getBytePerPixelOfPrimaryPlane(int format) {
@@ -276,18 +192,10 @@ ExynosFormat::ExynosFormat(int halFormat, uint32_t compressType) {
 }
 
 void ExynosFormat::init(int halFormat, uint32_t compressType) {
-    uint32_t index = 0;
-    for (auto &formatDesc : exynos_format_desc) {
-        /* If HAL format is binded different DRM format as compressType,
-         * Non compression format should be found first */
-        bool compressionSupport = (compressType == COMP_TYPE_NONE) ? true : formatDesc.isCompressionSupported(compressType);
+    mDescIndex = getFormatDescIndex(halFormat, compressType);
+    if (mDescIndex < FORMAT_MAX_CNT)
+        return;
 
-        if ((formatDesc.halFormat == halFormat) && compressionSupport) {
-            mDescIndex = index;
-            return;
-        }
-        index++;
-    }
     ALOGW("unrecognized pixel halFormat %u", halFormat);
     mDescIndex = kDefaultFormatIndex;
 }
@@ -80,10 +80,19 @@ typedef enum format_type {
 
 } format_type_t;
 
+/* A format name that is usable in constant expressions, unlike String8 */
+typedef struct format_name {
+    constexpr format_name(const char *str) : mStr(str){};
+    constexpr const char *string() const { return mStr; };
+
+  private:
+    const char *mStr;
+} format_name_t;
+
 typedef struct format_description {
     inline uint32_t getFormat() const { return type & FORMAT_MASK; }
     inline uint32_t getBit() const { return type & BIT_MASK; }
-    inline bool isCompressionSupported(uint32_t inType) const {
+    constexpr bool isCompressionSupported(uint32_t inType) const {
         return (type & inType) != 0 ? true : false;
     }
     int halFormat;
@@ -94,139 +103,211 @@ typedef struct format_description {
     uint8_t bpp;
     uint32_t type;
     bool hasAlpha;
-    String8 name;
+    format_name_t name;
     uint32_t reserved;
 } format_description_t;
 
 #define HAL_PIXEL_FORMAT_EXYNOS_UNDEFINED 0
 #define DRM_FORMAT_UNDEFINED 0
 
-const format_description_t exynos_format_desc[] = {
+inline constexpr format_description_t exynos_format_desc[] = {
     /* RGB */
     {HAL_PIXEL_FORMAT_RGBA_8888, DECON_PIXEL_FORMAT_RGBA_8888, DRM_FORMAT_ABGR8888,
-     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, String8("RGBA_8888"), 0},
+     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, "RGBA_8888", 0},
     {HAL_PIXEL_FORMAT_RGBX_8888, DECON_PIXEL_FORMAT_RGBX_8888, DRM_FORMAT_XBGR8888,
-     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, false, String8("RGBx_8888"), 0},
+     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, false, "RGBx_8888", 0},
     {HAL_PIXEL_FORMAT_RGB_888, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_BGR888,
-     1, 1, 24, RGB | BIT8 | COMP_TYPE_AFBC, false, String8("RGB_888"), 0},
+     1, 1, 24, RGB | BIT8 | COMP_TYPE_AFBC, false, "RGB_888", 0},
     /* CAUTION : Don't change the HAL_PIXEL_FORMAT_RGB_565's order
      * If HAL format is binded different DRM format as compressionType,
      * Non compression format should locate first */
     {HAL_PIXEL_FORMAT_RGB_565, DECON_PIXEL_FORMAT_RGB_565, DRM_FORMAT_RGB565,
-     1, 1, 16, RGB | COMP_TYPE_SAJC, false, String8("RGB_565"), 0},
+     1, 1, 16, RGB | COMP_TYPE_SAJC, false, "RGB_565", 0},
     {HAL_PIXEL_FORMAT_RGB_565, DECON_PIXEL_FORMAT_RGB_565, DRM_FORMAT_BGR565,
-     1, 1, 16, RGB | COMP_TYPE_AFBC, false, String8("RGB_565_AFBC"), 0},
+     1, 1, 16, RGB | COMP_TYPE_AFBC, false, "RGB_565_AFBC", 0},
     /************************************/
     {HAL_PIXEL_FORMAT_BGRA_8888, DECON_PIXEL_FORMAT_BGRA_8888, DRM_FORMAT_ARGB8888,
-     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, String8("BGRA_8888"), 0},
+     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, "BGRA_8888", 0},
     {HAL_PIXEL_FORMAT_RGBA_1010102, DECON_PIXEL_FORMAT_ABGR_2101010, DRM_FORMAT_ABGR2101010,
-     1, 1, 32, RGB | BIT10 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, String8("RGBA_1010102"), 0},
+     1, 1, 32, RGB | BIT10 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, "RGBA_1010102", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_ARGB_8888, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_BGRA8888,
-     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC, true, String8("EXYNOS_ARGB_8888"), 0},
+     1, 1, 32, RGB | BIT8 | COMP_TYPE_AFBC, true, "EXYNOS_ARGB_8888", 0},
     {HAL_PIXEL_FORMAT_RGBA_FP16, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_ABGR16161616F,
-     1, 1, 64, RGB | BIT16 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, String8("RGBA_FP16"), 0},
+     1, 1, 64, RGB | BIT16 | COMP_TYPE_AFBC | COMP_TYPE_SAJC, true, "RGBA_FP16", 0},
 
     /* YUV 420 */
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P_M, DECON_PIXEL_FORMAT_YUV420M, DRM_FORMAT_UNDEFINED,
-     3, 3, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_P_M"), 0},
+     3, 3, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_P_M", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M, DECON_PIXEL_FORMAT_NV12M, DRM_FORMAT_NV12,
-     2, 2, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_SP_M"), 0},
+     2, 2, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_SP_M", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_TILED, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     2, 2, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_SP_M_TILED"), 0},
+     2, 2, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_SP_M_TILED", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YV12_M, DECON_PIXEL_FORMAT_YVU420M, DRM_FORMAT_UNDEFINED,
-     3, 3, 12, YUV420 | BIT8, false, String8("EXYNOS_YV12_M"), 0},
+     3, 3, 12, YUV420 | BIT8, false, "EXYNOS_YV12_M", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M, DECON_PIXEL_FORMAT_NV21M, DRM_FORMAT_NV21,
-     2, 2, 12, YUV420 | BIT8, false, String8("EXYNOS_YCrCb_420_SP_M"), 0},
+     2, 2, 12, YUV420 | BIT8, false, "EXYNOS_YCrCb_420_SP_M", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL, DECON_PIXEL_FORMAT_NV21M, DRM_FORMAT_NV21,
-     2, 2, 12, YUV420 | BIT8, false, String8("EXYNOS_YCrCb_420_SP_M_FULL"), 0},
+     2, 2, 12, YUV420 | BIT8, false, "EXYNOS_YCrCb_420_SP_M_FULL", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_P, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     3, 1, 0, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_P"), 0},
+     3, 1, 0, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_P", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     2, 1, 0, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_SP"), 0},
+     2, 1, 0, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_SP", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV, DECON_PIXEL_FORMAT_NV12M, DRM_FORMAT_NV12,
-     2, 2, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_SP_M_PRIV"), 0},
+     2, 2, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_SP_M_PRIV", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_PN, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     3, 1, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_PN"), 0},
+     3, 1, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_PN", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN, DECON_PIXEL_FORMAT_NV12N, DRM_FORMAT_NV12,
-     2, 1, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_SPN"), 0},
+     2, 1, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_SPN", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_420_SPN_SBWC_DECOMP, DECON_PIXEL_FORMAT_NV12N, DRM_FORMAT_NV12,
-     2, 1, 12, YUV420 | BIT8, false, String8("EXYNOS_420_SPN_SBWC_DECOMP"), 0},
+     2, 1, 12, YUV420 | BIT8, false, "EXYNOS_420_SPN_SBWC_DECOMP", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_TILED, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     2, 1, 12, YUV420 | BIT8, false, String8("EXYNOS_YCbCr_420_SPN_TILED"), 0},
+     2, 1, 12, YUV420 | BIT8, false, "EXYNOS_YCbCr_420_SPN_TILED", 0},
     {HAL_PIXEL_FORMAT_YCrCb_420_SP, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     2, 1, 12, YUV420 | BIT8, false, String8("YCrCb_420_SP"), 0},
+     2, 1, 12, YUV420 | BIT8, false, "YCrCb_420_SP", 0},
     {HAL_PIXEL_FORMAT_YV12, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     3, 1, 12, YUV420 | BIT8, false, String8("YV12"), 0},
+     3, 1, 12, YUV420 | BIT8, false, "YV12", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_S10B, DECON_PIXEL_FORMAT_NV12M_S10B, DRM_FORMAT_UNDEFINED,
-     2, 2, 12, YUV420 | BIT10, false, String8("EXYNOS_YCbCr_420_SP_M_S10B"), 0},
+     2, 2, 12, YUV420 | BIT10, false, "EXYNOS_YCbCr_420_SP_M_S10B", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_S10B, DECON_PIXEL_FORMAT_NV12N_10B, DRM_FORMAT_UNDEFINED,
-     2, 1, 12, YUV420 | BIT10, false, String8("EXYNOS_YCbCr_420_SPN_S10B"), 0},
+     2, 1, 12, YUV420 | BIT10, false, "EXYNOS_YCbCr_420_SPN_S10B", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M, DECON_PIXEL_FORMAT_NV12M_P010, DRM_FORMAT_P010,
-     2, 2, 24, P010 | BIT10, false, String8("EXYNOS_YCbCr_P010_M"), 0},
+     2, 2, 24, P010 | BIT10, false, "EXYNOS_YCbCr_P010_M", 0},
     {HAL_PIXEL_FORMAT_YCBCR_P010, DECON_PIXEL_FORMAT_NV12_P010, DRM_FORMAT_P010,
-     2, 1, 24, P010 | BIT10, false, String8("EXYNOS_YCbCr_P010"), 0},
+     2, 1, 24, P010 | BIT10, false, "EXYNOS_YCbCr_P010", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_P010_N_SBWC_DECOMP, DECON_PIXEL_FORMAT_NV12_P010, DRM_FORMAT_P010,
-     2, 1, 24, P010 | BIT10, false, String8("EXYNOS_P010_N_SBWC_DECOMP"), 0},
+     2, 1, 24, P010 | BIT10, false, "EXYNOS_P010_N_SBWC_DECOMP", 0},
 
     /* YUV 422 */
     {HAL_PIXEL_FORMAT_EXYNOS_CbYCrY_422_I, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     0, 0, 0, YUV422 | BIT8, false, String8("EXYNOS_CbYCrY_422_I"), 0},
+     0, 0, 0, YUV422 | BIT8, false, "EXYNOS_CbYCrY_422_I", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_422_SP, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     0, 0, 0, YUV422 | BIT8, false, String8("EXYNOS_YCrCb_422_SP"), 0},
+     0, 0, 0, YUV422 | BIT8, false, "EXYNOS_YCrCb_422_SP", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_422_I, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     0, 0, 0, YUV422 | BIT8, false, String8("EXYNOS_YCrCb_422_I"), 0},
+     0, 0, 0, YUV422 | BIT8, false, "EXYNOS_YCrCb_422_I", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_CrYCbY_422_I, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     0, 0, 0, YUV422 | BIT8, false, String8("EXYNOS_CrYCbY_422_I"), 0},
+     0, 0, 0, YUV422 | BIT8, false, "EXYNOS_CrYCbY_422_I", 0},
 
     /* SBWC formats */
     /* NV12, YCbCr, Multi */
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_SBWC, DECON_PIXEL_FORMAT_NV12M_SBWC_8B, DRM_FORMAT_NV12,
-     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCbCr_420_SP_M_SBWC"), 0},
+     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCbCr_420_SP_M_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_SBWC_L50, DECON_PIXEL_FORMAT_NV12M_SBWC_8B_L50, DRM_FORMAT_NV12,
-     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_50, false, String8("EXYNOS_YCbCr_420_SP_M_SBWC_L50"), 0},
+     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_50, false, "EXYNOS_YCbCr_420_SP_M_SBWC_L50", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_SBWC_L75, DECON_PIXEL_FORMAT_NV12M_SBWC_8B_L75, DRM_FORMAT_NV12,
-     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_75, false, String8("EXYNOS_YCbCr_420_SP_M_SBWC_L75"), 0},
+     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_75, false, "EXYNOS_YCbCr_420_SP_M_SBWC_L75", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC, DECON_PIXEL_FORMAT_NV12M_SBWC_10B, DRM_FORMAT_P010,
-     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCbCr_420_SP_M_10B_SBWC"), 0},
+     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCbCr_420_SP_M_10B_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L40, DECON_PIXEL_FORMAT_NV12M_SBWC_10B_L40, DRM_FORMAT_P010,
-     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_40, false, String8("EXYNOS_YCbCr_420_SP_M_10B_SBWC_L40"), 0},
+     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_40, false, "EXYNOS_YCbCr_420_SP_M_10B_SBWC_L40", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L60, DECON_PIXEL_FORMAT_NV12M_SBWC_10B_L60, DRM_FORMAT_P010,
-     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_60, false, String8("EXYNOS_YCbCr_420_SP_M_10B_SBWC_L60"), 0},
+     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_60, false, "EXYNOS_YCbCr_420_SP_M_10B_SBWC_L60", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L80, DECON_PIXEL_FORMAT_NV12M_SBWC_10B_L80, DRM_FORMAT_P010,
-     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_80, false, String8("EXYNOS_YCbCr_420_SP_M_10B_SBWC_L80"), 0},
+     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_80, false, "EXYNOS_YCbCr_420_SP_M_10B_SBWC_L80", 0},
 
     /* NV12, YCbCr, Single */
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_SBWC, DECON_PIXEL_FORMAT_NV12N_SBWC_8B, DRM_FORMAT_NV12,
-     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCbCr_420_SPN_SBWC"), 0},
+     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCbCr_420_SPN_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_256_SBWC, DECON_PIXEL_FORMAT_NV12N_SBWC_8B, DRM_FORMAT_NV12,
-     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCbCr_420_SPN_256_SBWC"), 0},
+     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCbCr_420_SPN_256_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_SBWC_L50, DECON_PIXEL_FORMAT_NV12N_SBWC_8B_L50, DRM_FORMAT_NV12,
-     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_50, false, String8("EXYNOS_YCbCr_420_SPN_SBWC_L50"), 0},
+     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_50, false, "EXYNOS_YCbCr_420_SPN_SBWC_L50", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_SBWC_L75, DECON_PIXEL_FORMAT_NV12N_SBWC_8B_L75, DRM_FORMAT_NV12,
-     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_75, false, String8("EXYNOS_YCbCr_420_SPN_SBWC_75"), 0},
+     2, 1, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSY_75, false, "EXYNOS_YCbCr_420_SPN_SBWC_75", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_SBWC, DECON_PIXEL_FORMAT_NV12N_SBWC_10B, DRM_FORMAT_P010,
-     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCbCr_420_SPN_10B_SBWC"), 0},
+     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCbCr_420_SPN_10B_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_256_SBWC, DECON_PIXEL_FORMAT_NV12N_SBWC_10B, DRM_FORMAT_P010,
-     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCbCr_420_SPN_10B_256_SBWC"), 0},
+     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCbCr_420_SPN_10B_256_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_SBWC_L40, DECON_PIXEL_FORMAT_NV12N_SBWC_10B_L40, DRM_FORMAT_P010,
-     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_40, false, String8("EXYNOS_YCbCr_420_SPN_10B_SBWC_L40"), 0},
+     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_40, false, "EXYNOS_YCbCr_420_SPN_10B_SBWC_L40", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_SBWC_L60, DECON_PIXEL_FORMAT_NV12N_SBWC_10B_L60, DRM_FORMAT_P010,
-     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_60, false, String8("EXYNOS_YCbCr_420_SPN_10B_SBWC_L60"), 0},
+     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_60, false, "EXYNOS_YCbCr_420_SPN_10B_SBWC_L60", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_SBWC_L80, DECON_PIXEL_FORMAT_NV12N_SBWC_10B_L80, DRM_FORMAT_P010,
-     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_80, false, String8("EXYNOS_YCbCr_420_SPN_10B_SBWC_L80"), 0},
+     2, 1, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSY_80, false, "EXYNOS_YCbCr_420_SPN_10B_SBWC_L80", 0},
 
     /* NV12, YCrCb */
     {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_SBWC, DECON_PIXEL_FORMAT_NV21M_SBWC_8B, DRM_FORMAT_NV12,
-     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCrCb_420_SP_M_SBWC"), 0},
+     2, 2, 12, YUV420 | BIT8 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCrCb_420_SP_M_SBWC", 0},
     {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_10B_SBWC, DECON_PIXEL_FORMAT_NV21M_SBWC_10B, DRM_FORMAT_P010_YVU,
-     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, String8("EXYNOS_YCrbCb_420_SP_M_10B_SBWC"), 0},
+     2, 2, 12, P010 | BIT10 | COMP_TYPE_SBWC | SBWC_LOSSLESS, false, "EXYNOS_YCrbCb_420_SP_M_10B_SBWC", 0},
 
     {HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, DECON_PIXEL_FORMAT_MAX, DRM_FORMAT_UNDEFINED,
-     0, 0, 0, TYPE_UNDEF, false, String8("ImplDef"), 0}};
+     0, 0, 0, TYPE_UNDEF, false, "ImplDef", 0}};
 
-#define FORMAT_MAX_CNT sizeof(exynos_format_desc) / sizeof(format_description)
+#define FORMAT_MAX_CNT (sizeof(exynos_format_desc) / sizeof(format_description))
 
 constexpr uint32_t kDefaultFormatIndex = FORMAT_MAX_CNT - 1;
+
+/*
+ * The index of exynos_format_desc by HAL format is generated at compile time.
+ * It is an open addressing hash table of the first entry of every HAL format,
+ * so a lookup costs a hash and a few probes instead of a scan of the table.
+ * The entries of a HAL format are adjacent, and the one that supports a
+ * compression type is found from the first entry.
+ */
+constexpr uint32_t kFormatIndexBits = 8;
+constexpr uint32_t kFormatIndexSize = 1 << kFormatIndexBits;
+static_assert(FORMAT_MAX_CNT < 0xff, "the format index holds uint8_t");
+static_assert(FORMAT_MAX_CNT * 2 <= kFormatIndexSize, "the format index is too small");
+
+constexpr uint32_t formatIndexHash(int halFormat) {
+    return (static_cast<uint32_t>(halFormat) * 2654435761U) >> (32 - kFormatIndexBits);
+}
+
+typedef struct format_index {
+    /* The index in exynos_format_desc plus 1, 0 if the slot is empty */
+    uint8_t slots[kFormatIndexSize];
+} format_index_t;
+
+constexpr format_index_t buildFormatIndex() {
+    format_index_t index = {};
+    for (uint32_t i = 0; i < FORMAT_MAX_CNT; i++) {
+        uint32_t slot = formatIndexHash(exynos_format_desc[i].halFormat);
+        while ((index.slots[slot] != 0) &&
+               (exynos_format_desc[index.slots[slot] - 1].halFormat != exynos_format_desc[i].halFormat))
+            slot = (slot + 1) & (kFormatIndexSize - 1);
+        if (index.slots[slot] == 0)
+            index.slots[slot] = static_cast<uint8_t>(i + 1);
+    }
+    return index;
+}
+
+constexpr bool isFormatDescGrouped() {
+    for (uint32_t i = 0; i < FORMAT_MAX_CNT; i++) {
+        for (uint32_t j = i + 2; j < FORMAT_MAX_CNT; j++) {
+            if ((exynos_format_desc[i].halFormat == exynos_format_desc[j].halFormat) &&
+                (exynos_format_desc[j - 1].halFormat != exynos_format_desc[i].halFormat))
+                return false;
+        }
+    }
+    return true;
+}
+static_assert(isFormatDescGrouped(), "the entries of a HAL format should be adjacent");
+
+inline constexpr format_index_t exynos_format_index = buildFormatIndex();
+
+/* Returns the first entry of @halFormat, or FORMAT_MAX_CNT if there is none */
+constexpr uint32_t getFormatDescIndex(int halFormat) {
+    for (uint32_t slot = formatIndexHash(halFormat);; slot = (slot + 1) & (kFormatIndexSize - 1)) {
+        uint32_t entry = exynos_format_index.slots[slot];
+        if (entry == 0)
+            return FORMAT_MAX_CNT;
+        if (exynos_format_desc[entry - 1].halFormat == halFormat)
+            return entry - 1;
+    }
+}
+
+/* Returns the entry of @halFormat that supports @compressType, or FORMAT_MAX_CNT */
+constexpr uint32_t getFormatDescIndex(int halFormat, uint32_t compressType) {
+    for (uint32_t i = getFormatDescIndex(halFormat);
+         (i < FORMAT_MAX_CNT) && (exynos_format_desc[i].halFormat == halFormat); i++) {
+        /* If HAL format is binded different DRM format as compressType,
+         * Non compression format should be found first */
+        if ((compressType == COMP_TYPE_NONE) || exynos_format_desc[i].isCompressionSupported(compressType))
+            return i;
+    }
+    return FORMAT_MAX_CNT;
+}
+
 class ExynosFormat {
   public:
     ExynosFormat();
@@ -257,7 +338,7 @@ class ExynosFormat {
     inline uint32_t planeNum() const { return exynos_format_desc[mDescIndex].planeNum; };
     inline decon_pixel_format dpuFormat() const { return exynos_format_desc[mDescIndex].s3cFormat; };
     inline int drmFormat() const { return exynos_format_desc[mDescIndex].drmFormat; };
-    inline const String8 &name() const { return exynos_format_desc[mDescIndex].name; };
+    inline const format_name_t &name() const { return exynos_format_desc[mDescIndex].name; };
     inline bool isRgb() const {
         return (exynos_format_desc[mDescIndex].type & FORMAT_RGB_MASK) ? true : false;
     };
@@ -17,6 +17,7 @@
 #define _EXYNOSHWCTypes_H
 
 #include <hardware/hwcomposer2.h>
+#include <optional>
 #include <vector>
 #include "ExynosMPPType.h"
 
@@ -298,6 +299,29 @@ struct DevicePresentInfo {
     std::vector<DisplayIdentifier> nonPrimaryDisplays;
 };
 
+/*
+ * The properties of a layer that are set at once by
+ * ExynosDevice::setLayerProperties(). Only the present ones are set.
+ * The regions point to the rects of the caller.
+ */
+struct ExynosLayerProperties {
+    hwc2_layer_t layer = 0;
+    bool hasBuffer = false;
+    buffer_handle_t buffer = nullptr;
+    int32_t acquireFence = -1;
+    std::optional<hwc_region_t> surfaceDamage;
+    std::optional<int32_t> blendMode;
+    std::optional<hwc_color_t> color;
+    std::optional<int32_t> compositionType;
+    std::optional<int32_t> dataspace;
+    std::optional<hwc_rect_t> displayFrame;
+    std::optional<float> planeAlpha;
+    std::optional<hwc_frect_t> sourceCrop;
+    std::optional<int32_t> transform;
+    std::optional<hwc_region_t> visibleRegion;
+    std::optional<uint32_t> zOrder;
+};
+
 struct DisplayInfo {
     struct DisplayIdentifier displayIdentifier;
     uint32_t xres = 0;
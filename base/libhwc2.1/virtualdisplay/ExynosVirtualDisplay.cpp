@@ -21,6 +21,7 @@
 
 #include "ExynosHWCHelper.h"
 #include "ExynosGraphicBuffer.h"
+#include "ExynosMPPBufferPool.h"
 
 #include <cutils/properties.h>
 
@@ -109,6 +110,7 @@ void ExynosVirtualDisplay::destroyVirtualDisplay() {
         }
         mDisplayInterface->setPowerMode(HWC_POWER_MODE_OFF);
     }
+    ExynosMPPBufferPool::getInstance().releaseDisplay(mDisplayId);
 
     mPlugState = false;
     mDisplayWidth = 0;
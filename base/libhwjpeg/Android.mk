@@ -28,7 +28,8 @@ LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
 
 LOCAL_SRC_FILES := hwjpeg-base.cpp hwjpeg-v4l2.cpp ExynosJpegEncoder.cpp \
                    LibScalerForJpeg.cpp AppMarkerWriter.cpp ExynosJpegEncoderForCamera.cpp \
-                   libhwjpeg-exynos.cpp ThumbnailScaler.cpp GiantThumbnailScaler.cpp G2dThumbnailScaler.cpp
+                   libhwjpeg-exynos.cpp JpegStreamParser.cpp JpegSoftwareDecompressor.cpp \
+                   ThumbnailScaler.cpp GiantThumbnailScaler.cpp G2dThumbnailScaler.cpp
 
 LOCAL_MODULE := libhwjpeg
 LOCAL_MODULE_TAGS := optional
@@ -36,3 +37,5 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
@@ -0,0 +1,975 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <linux/videodev2.h>
+
+#include "hwjpeg-internal.h"
+#include "JpegSoftwareDecompressor.h"
+
+#define JPEG_MARKER_SOF1 0xC1
+#define JPEG_MARKER_SOF2 0xC2
+
+// The coefficients and the planes of larger images are not affordable
+#define SWJPEG_MAX_PIXELS (64 * 1024 * 1024)
+
+// The precision of the cosines of the inverse DCT
+#define IDCT_CONST_BITS 13
+
+// The natural order index of the coefficients in the zigzag order
+static const unsigned char jpegNaturalOrder[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// cos(k * pi / 16) / 2 in Q13 for k = 0 to 8
+static const int32_t idctCosines[9] = {4096, 4017, 3784, 3406, 2896, 2276, 1567, 799, 0};
+
+/*
+ * The basis of the inverse DCT of @size points: C(u) / 2 * cos((2x + 1) * u * pi / (2 * @size)).
+ * The angle is always a multiple of pi / 16 because @size is one of 1, 2, 4 and 8.
+ */
+static int32_t IdctBasis(unsigned int size, unsigned int x, unsigned int u)
+{
+    if (u == 0)
+        return idctCosines[4]; // 1 / sqrt(2) / 2
+
+    unsigned int angle = ((2 * x + 1) * u * (8 / size)) % 32;
+    if (angle > 16)
+        angle = 32 - angle;
+
+    return (angle <= 8) ? idctCosines[angle] : -idctCosines[16 - angle];
+}
+
+static inline unsigned char ClampPixel(int64_t value)
+{
+    return static_cast<unsigned char>((value < 0) ? 0 : ((value > 255) ? 255 : value));
+}
+
+void CJpegSoftwareDecompressor::Initialize()
+{
+    m_nPosition = 0;
+    m_uiBits = 0;
+    m_nBitCount = 0;
+    m_bMarkerFound = false;
+
+    memset(m_quantTables, 0, sizeof(m_quantTables));
+    memset(m_bQuantDefined, 0, sizeof(m_bQuantDefined));
+    for (int i = 0; i < 4; i++) {
+        m_dcTables[i].defined = false;
+        m_acTables[i].defined = false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        m_components[i].coefs.clear();
+        m_components[i].plane.clear();
+    }
+    m_nComponents = 0;
+    m_nMaxH = 1;
+    m_nMaxV = 1;
+    m_nMcusPerLine = 0;
+    m_nMcuRows = 0;
+    m_nWidth = 0;
+    m_nHeight = 0;
+    m_bProgressive = false;
+    m_bRowByRow = false;
+    m_nRestartInterval = 0;
+    m_nEobRun = 0;
+    m_nBlockSize = 8;
+
+    m_nScanComponents = 0;
+    m_nSs = 0;
+    m_nSe = 63;
+    m_nAh = 0;
+    m_nAl = 0;
+}
+
+bool CJpegSoftwareDecompressor::IsSupportedFormat(unsigned int v4l2_fmt)
+{
+    return GetImageSize(v4l2_fmt, 1, 1) > 0;
+}
+
+size_t CJpegSoftwareDecompressor::GetImageSize(unsigned int v4l2_fmt, unsigned int width, unsigned int height)
+{
+    size_t pixels = static_cast<size_t>(width) * height;
+    size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+
+    switch (v4l2_fmt) {
+    case V4L2_PIX_FMT_RGB32:
+    case V4L2_PIX_FMT_BGR32:
+        return pixels * 4;
+    case V4L2_PIX_FMT_RGB24:
+    case V4L2_PIX_FMT_BGR24:
+        return pixels * 3;
+    case V4L2_PIX_FMT_RGB565:
+        return pixels * 2;
+    case V4L2_PIX_FMT_YUYV:
+        return static_cast<size_t>((width + 1) / 2) * 4 * height;
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_YUV420:
+        return pixels + chroma * 2;
+    case V4L2_PIX_FMT_GREY:
+        return pixels;
+    }
+
+    return 0;
+}
+
+bool CJpegSoftwareDecompressor::IsDecompressible(CJpegStreamParser &parser)
+{
+    unsigned char sof = parser.GetFrameMarker();
+
+    if ((sof != JPEG_MARKER_SOF0) && (sof != JPEG_MARKER_SOF1) && (sof != JPEG_MARKER_SOF2)) {
+        ALOGE("SOF%d is not supported by the software decompressor", sof & 0xF);
+        return false;
+    }
+
+    if (parser.GetPrecision() != 8) {
+        ALOGE("%u bits per sample is not supported by the software decompressor", parser.GetPrecision());
+        return false;
+    }
+
+    if ((parser.GetNumComponents() != 1) && (parser.GetNumComponents() != 3)) {
+        ALOGE("%u components are not supported by the software decompressor", parser.GetNumComponents());
+        return false;
+    }
+
+    // zero height means that the height is defined by DNL
+    if ((parser.GetWidth() == 0) || (parser.GetHeight() == 0) ||
+            (static_cast<size_t>(parser.GetWidth()) * parser.GetHeight() > SWJPEG_MAX_PIXELS)) {
+        ALOGE("Image size %ux%u is not supported by the software decompressor",
+              parser.GetWidth(), parser.GetHeight());
+        return false;
+    }
+
+    unsigned int blocks = 0;
+    for (unsigned int i = 0; i < parser.GetNumComponents(); i++) {
+        const CJpegStreamParser::Component *comp = parser.GetComponent(i);
+        if ((comp->horizontal_factor < 1) || (comp->horizontal_factor > 4) ||
+                (comp->vertical_factor < 1) || (comp->vertical_factor > 4) || (comp->qtable > 3)) {
+            ALOGE("Invalid component %u: sampling factor %ux%u, quantization table %u", i,
+                  comp->horizontal_factor, comp->vertical_factor, comp->qtable);
+            return false;
+        }
+        blocks += comp->horizontal_factor * comp->vertical_factor;
+    }
+
+    if ((parser.GetNumComponents() > 1) && (blocks > 10)) {
+        ALOGE("Too many blocks in an MCU: %u", blocks);
+        return false;
+    }
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::ReadQuantTables(const unsigned char *data, size_t size)
+{
+    while (size > 0) {
+        unsigned int precision = data[0] >> 4;
+        unsigned int idx = data[0] & 0xF;
+        size_t len = (precision == 0) ? 64 : 128;
+
+        if ((precision > 1) || (idx > 3) || (size < 1 + len)) {
+            ALOGE("Invalid DQT: precision %u, table %u, %zu bytes left", precision, idx, size);
+            return false;
+        }
+
+        for (unsigned int k = 0; k < 64; k++) {
+            unsigned int value = (precision == 0) ? data[1 + k] : (data[1 + k * 2] << 8) | data[2 + k * 2];
+            m_quantTables[idx][jpegNaturalOrder[k]] = static_cast<uint16_t>(value);
+        }
+        m_bQuantDefined[idx] = true;
+
+        data += 1 + len;
+        size -= 1 + len;
+    }
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::ReadHuffmanTables(const unsigned char *data, size_t size)
+{
+    while (size > 0) {
+        unsigned int tclass = data[0] >> 4;
+        unsigned int idx = data[0] & 0xF;
+
+        if ((tclass > 1) || (idx > 3) || (size < 17)) {
+            ALOGE("Invalid DHT: class %u, table %u, %zu bytes left", tclass, idx, size);
+            return false;
+        }
+
+        const unsigned char *counts = data + 1;
+        size_t nvalues = 0;
+        for (int i = 0; i < 16; i++)
+            nvalues += counts[i];
+
+        if ((nvalues > 256) || (size < 17 + nvalues)) {
+            ALOGE("Invalid DHT: %zu codes, %zu bytes left", nvalues, size);
+            return false;
+        }
+
+        HuffmanTable &table = (tclass == 0) ? m_dcTables[idx] : m_acTables[idx];
+        int32_t code = 0;
+        unsigned int k = 0;
+
+        memset(table.lookup_length, 0, sizeof(table.lookup_length));
+        memcpy(table.values, data + 17, nvalues);
+
+        // the canonical Huffman code of JPEG Annex C
+        for (unsigned int len = 1; len <= 16; len++) {
+            table.valptr[len] = k;
+            table.mincode[len] = code;
+            for (unsigned int i = 0; i < counts[len - 1]; i++, k++, code++) {
+                if (len <= 8) {
+                    unsigned int first = code << (8 - len);
+                    for (unsigned int fill = 0; fill < (1U << (8 - len)); fill++) {
+                        table.lookup_length[first + fill] = static_cast<unsigned char>(len);
+                        table.lookup_value[first + fill] = table.values[k];
+                    }
+                }
+            }
+            table.maxcode[len] = counts[len - 1] ? code - 1 : -1;
+
+            if (code > (1 << len)) {
+                ALOGE("Invalid DHT: too many codes of %u bits", len);
+                return false;
+            }
+            code <<= 1;
+        }
+        table.defined = true;
+
+        data += 17 + nvalues;
+        size -= 17 + nvalues;
+    }
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::ReadRestartInterval(const unsigned char *data, size_t size)
+{
+    if (size != 2) {
+        ALOGE("Invalid DRI of %zu bytes", size);
+        return false;
+    }
+
+    m_nRestartInterval = (data[0] << 8) | data[1];
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::SetupFrame(CJpegStreamParser &parser, unsigned int scale)
+{
+    m_bProgressive = parser.GetFrameMarker() == JPEG_MARKER_SOF2;
+    m_nWidth = parser.GetWidth();
+    m_nHeight = parser.GetHeight();
+    m_nComponents = parser.GetNumComponents();
+    m_nBlockSize = 8 / scale;
+
+    for (unsigned int i = 0; i < m_nComponents; i++) {
+        const CJpegStreamParser::Component *spec = parser.GetComponent(i);
+        ComponentInfo &comp = m_components[i];
+
+        comp.id = spec->id;
+        // the sampling factors of a single component are meaningless
+        comp.h = (m_nComponents == 1) ? 1 : spec->horizontal_factor;
+        comp.v = (m_nComponents == 1) ? 1 : spec->vertical_factor;
+        comp.qtable = spec->qtable;
+        comp.dc_table = 0;
+        comp.ac_table = 0;
+        comp.dc_pred = 0;
+        comp.quant_latched = false;
+
+        m_nMaxH = std::max(m_nMaxH, comp.h);
+        m_nMaxV = std::max(m_nMaxV, comp.v);
+    }
+
+    for (unsigned int x = 0; x < m_nBlockSize; x++)
+        for (unsigned int u = 0; u < m_nBlockSize; u++)
+            m_idctBasis[x][u] = IdctBasis(m_nBlockSize, x, u);
+
+    m_nMcusPerLine = (m_nWidth + 8 * m_nMaxH - 1) / (8 * m_nMaxH);
+    m_nMcuRows = (m_nHeight + 8 * m_nMaxV - 1) / (8 * m_nMaxV);
+
+    for (unsigned int i = 0; i < m_nComponents; i++) {
+        ComponentInfo &comp = m_components[i];
+        unsigned int width = (m_nWidth * comp.h + m_nMaxH - 1) / m_nMaxH;
+        unsigned int height = (m_nHeight * comp.v + m_nMaxV - 1) / m_nMaxV;
+
+        comp.blocks_width = (width + 7) / 8;
+        comp.blocks_height = (height + 7) / 8;
+        comp.blocks_stride = m_nMcusPerLine * comp.h;
+        comp.blocks_rows = m_nMcuRows * comp.v;
+
+        comp.coefs.assign(static_cast<size_t>(comp.blocks_stride) * (m_bRowByRow ? comp.v : comp.blocks_rows) * 64, 0);
+        comp.plane_stride = comp.blocks_stride * m_nBlockSize;
+        comp.plane.assign(static_cast<size_t>(comp.plane_stride) * comp.blocks_rows * m_nBlockSize, 0);
+    }
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::SetupScan(const unsigned char *data, size_t size)
+{
+    if ((size < 1) || (data[0] < 1) || (data[0] > m_nComponents) || (size != 4 + data[0] * 2U)) {
+        ALOGE("Invalid SOS of %zu bytes", size);
+        return false;
+    }
+
+    m_nScanComponents = data[0];
+    for (unsigned int i = 0; i < m_nScanComponents; i++) {
+        const unsigned char *spec = data + 1 + i * 2;
+        ComponentInfo *comp = NULL;
+
+        for (unsigned int c = 0; c < m_nComponents; c++) {
+            if (m_components[c].id == spec[0])
+                comp = &m_components[c];
+        }
+
+        if (comp == NULL) {
+            ALOGE("Unknown component %u in SOS", spec[0]);
+            return false;
+        }
+
+        comp->dc_table = spec[1] >> 4;
+        comp->ac_table = spec[1] & 0xF;
+        if ((comp->dc_table > 3) || (comp->ac_table > 3)) {
+            ALOGE("Invalid Huffman table selector %#x of component %u", spec[1], spec[0]);
+            return false;
+        }
+        m_pScanComponents[i] = comp;
+    }
+
+    const unsigned char *params = data + 1 + m_nScanComponents * 2;
+    m_nSs = params[0];
+    m_nSe = params[1];
+    m_nAh = params[2] >> 4;
+    m_nAl = params[2] & 0xF;
+
+    if (m_bProgressive) {
+        if ((m_nSe > 63) || (m_nSs > m_nSe) || ((m_nSs == 0) && (m_nSe != 0)) ||
+                ((m_nSs > 0) && (m_nScanComponents != 1)) || (m_nAl > 13) || ((m_nAh != 0) && (m_nAh != m_nAl + 1))) {
+            ALOGE("Invalid progressive scan: Ss %u, Se %u, Ah %u, Al %u with %u components",
+                  m_nSs, m_nSe, m_nAh, m_nAl, m_nScanComponents);
+            return false;
+        }
+    } else {
+        // Ss, Se, Ah and Al are fixed in the sequential mode
+        m_nSs = 0;
+        m_nSe = 63;
+        m_nAh = 0;
+        m_nAl = 0;
+    }
+
+    for (unsigned int i = 0; i < m_nScanComponents; i++) {
+        ComponentInfo *comp = m_pScanComponents[i];
+
+        if ((m_nSs == 0) && (m_nAh == 0) && !m_dcTables[comp->dc_table].defined) {
+            ALOGE("DC Huffman table %u is not defined", comp->dc_table);
+            return false;
+        }
+
+        if ((m_nSe > 0) && !m_acTables[comp->ac_table].defined) {
+            ALOGE("AC Huffman table %u is not defined", comp->ac_table);
+            return false;
+        }
+
+        // The quantization table may be redefined after the first scan of the component
+        if (!comp->quant_latched) {
+            if (!m_bQuantDefined[comp->qtable]) {
+                ALOGE("Quantization table %u is not defined", comp->qtable);
+                return false;
+            }
+            memcpy(comp->quant, m_quantTables[comp->qtable], sizeof(comp->quant));
+            comp->quant_latched = true;
+        }
+
+        comp->dc_pred = 0;
+    }
+
+    m_nEobRun = 0;
+
+    return true;
+}
+
+void CJpegSoftwareDecompressor::ResetBitReader(size_t offset)
+{
+    m_nPosition = offset;
+    m_uiBits = 0;
+    m_nBitCount = 0;
+    m_bMarkerFound = false;
+}
+
+// Zeros are fed after a marker or the end of the stream
+void CJpegSoftwareDecompressor::FillBits(unsigned int count)
+{
+    while (m_nBitCount < count) {
+        unsigned int byte = 0;
+
+        if (!m_bMarkerFound && (m_nPosition < m_nStreamSize)) {
+            byte = m_pStream[m_nPosition];
+            if (byte != 0xFF) {
+                m_nPosition++;
+            } else if ((m_nPosition + 1 < m_nStreamSize) && (m_pStream[m_nPosition + 1] == 0x00)) {
+                m_nPosition += 2;
+            } else {
+                m_bMarkerFound = true;
+                byte = 0;
+            }
+        }
+
+        m_uiBits = (m_uiBits << 8) | byte;
+        m_nBitCount += 8;
+    }
+}
+
+unsigned int CJpegSoftwareDecompressor::GetBits(unsigned int count)
+{
+    if (count == 0)
+        return 0;
+
+    FillBits(count);
+
+    m_nBitCount -= count;
+    unsigned int value = (m_uiBits >> m_nBitCount) & ((1U << count) - 1);
+    m_uiBits &= (1U << m_nBitCount) - 1;
+
+    return value;
+}
+
+int CJpegSoftwareDecompressor::ReceiveExtend(unsigned int count)
+{
+    if (count == 0)
+        return 0;
+
+    int value = static_cast<int>(GetBits(count));
+    if (value < (1 << (count - 1)))
+        value += 1 - (1 << count);
+
+    return value;
+}
+
+int CJpegSoftwareDecompressor::DecodeHuffman(const HuffmanTable &table)
+{
+    FillBits(16);
+
+    unsigned int peek = (m_uiBits >> (m_nBitCount - 8)) & 0xFF;
+    unsigned int len = table.lookup_length[peek];
+    if (len > 0) {
+        GetBits(len);
+        return table.lookup_value[peek];
+    }
+
+    peek = (m_uiBits >> (m_nBitCount - 16)) & 0xFFFF;
+    for (len = 9; len <= 16; len++) {
+        int32_t code = peek >> (16 - len);
+        if (code <= table.maxcode[len]) {
+            GetBits(len);
+            return table.values[table.valptr[len] + code - table.mincode[len]];
+        }
+    }
+
+    ALOGE("Invalid Huffman code %#06x at offset %zu", peek, m_nPosition);
+    return -1;
+}
+
+bool CJpegSoftwareDecompressor::ProcessRestart()
+{
+    // the rest of the current byte is padding
+    m_uiBits = 0;
+    m_nBitCount = 0;
+
+    size_t pos = m_nPosition;
+    while ((pos + 1 < m_nStreamSize) && (m_pStream[pos] == 0xFF) && (m_pStream[pos + 1] == 0xFF))
+        pos++;
+
+    if ((pos + 1 >= m_nStreamSize) || (m_pStream[pos] != 0xFF) ||
+            (m_pStream[pos + 1] < JPEG_MARKER_RST0) || (m_pStream[pos + 1] > JPEG_MARKER_RST7)) {
+        ALOGE("RSTn is not found at offset %zu", pos);
+        return false;
+    }
+
+    ResetBitReader(pos + 2);
+
+    for (unsigned int i = 0; i < m_nScanComponents; i++)
+        m_pScanComponents[i]->dc_pred = 0;
+    m_nEobRun = 0;
+
+    return true;
+}
+
+int16_t *CJpegSoftwareDecompressor::GetBlock(ComponentInfo &comp, unsigned int bx, unsigned int by)
+{
+    if (m_bRowByRow)
+        by %= comp.v;
+
+    return &comp.coefs[(static_cast<size_t>(by) * comp.blocks_stride + bx) * 64];
+}
+
+bool CJpegSoftwareDecompressor::DecodeBlock(ComponentInfo &comp, int16_t *block)
+{
+    if (!m_bProgressive) {
+        memset(block, 0, sizeof(*block) * 64);
+
+        int s = DecodeHuffman(m_dcTables[comp.dc_table]);
+        if (s < 0)
+            return false;
+        comp.dc_pred = static_cast<int16_t>(comp.dc_pred + ReceiveExtend(s & 0xF));
+        block[0] = comp.dc_pred;
+
+        const HuffmanTable &actable = m_acTables[comp.ac_table];
+        for (unsigned int k = 1; k < 64; k++) {
+            int rs = DecodeHuffman(actable);
+            if (rs < 0)
+                return false;
+
+            unsigned int r = rs >> 4;
+            s = rs & 0xF;
+            if (s == 0) {
+                if (r != 15)
+                    break;
+                k += 15;
+                continue;
+            }
+
+            k += r;
+            if (k > 63) {
+                ALOGE("Too many AC coefficients at offset %zu", m_nPosition);
+                return false;
+            }
+            block[jpegNaturalOrder[k]] = static_cast<int16_t>(ReceiveExtend(s));
+        }
+
+        return true;
+    }
+
+    if (m_nSs == 0) {
+        if (m_nAh == 0) {
+            int s = DecodeHuffman(m_dcTables[comp.dc_table]);
+            if (s < 0)
+                return false;
+            comp.dc_pred = static_cast<int16_t>(comp.dc_pred + ReceiveExtend(s & 0xF));
+            block[0] = static_cast<int16_t>(comp.dc_pred * (1 << m_nAl));
+        } else if (GetBit()) {
+            block[0] |= static_cast<int16_t>(1 << m_nAl);
+        }
+
+        return true;
+    }
+
+    const HuffmanTable &actable = m_acTables[comp.ac_table];
+    unsigned int k = m_nSs;
+
+    if (m_nAh == 0) {
+        // the first scan of the spectral band
+        if (m_nEobRun > 0) {
+            m_nEobRun--;
+            return true;
+        }
+
+        for (; k <= m_nSe; k++) {
+            int rs = DecodeHuffman(actable);
+            if (rs < 0)
+                return false;
+
+            unsigned int r = rs >> 4;
+            int s = rs & 0xF;
+            if (s == 0) {
+                if (r != 15) {
+                    m_nEobRun = (1U << r) - 1 + GetBits(r);
+                    break;
+                }
+                k += 15;
+                continue;
+            }
+
+            k += r;
+            if (k > 63) {
+                ALOGE("Too many AC coefficients at offset %zu", m_nPosition);
+                return false;
+            }
+            block[jpegNaturalOrder[k]] = static_cast<int16_t>(ReceiveExtend(s) * (1 << m_nAl));
+        }
+
+        return true;
+    }
+
+    // the refinement of the coefficients by one bit: G.1.2.3
+    int p1 = 1 << m_nAl;
+    int m1 = -p1;
+
+    if (m_nEobRun == 0) {
+        for (; k <= m_nSe; k++) {
+            int rs = DecodeHuffman(actable);
+            if (rs < 0)
+                return false;
+
+            int r = rs >> 4;
+            int s = rs & 0xF;
+            if (s != 0) {
+                // the size of a newly nonzero coefficient is always 1
+                s = GetBit() ? p1 : m1;
+            } else if (r != 15) {
+                m_nEobRun = (1U << r) + GetBits(r);
+                break;
+            }
+
+            // skip r zero coefficients while refining the nonzero coefficients on the way
+            for (; k <= m_nSe; k++) {
+                int16_t *coef = &block[jpegNaturalOrder[k]];
+                if (*coef != 0) {
+                    if (GetBit() && ((*coef & p1) == 0))
+                        *coef = static_cast<int16_t>(*coef + ((*coef >= 0) ? p1 : m1));
+                } else if (--r < 0) {
+                    break;
+                }
+            }
+
+            if (s != 0) {
+                if (k > m_nSe) {
+                    ALOGE("No room for a new coefficient at offset %zu", m_nPosition);
+                    return false;
+                }
+                block[jpegNaturalOrder[k]] = static_cast<int16_t>(s);
+            }
+        }
+    }
+
+    if (m_nEobRun > 0) {
+        for (; k <= m_nSe; k++) {
+            int16_t *coef = &block[jpegNaturalOrder[k]];
+            if ((*coef != 0) && GetBit() && ((*coef & p1) == 0))
+                *coef = static_cast<int16_t>(*coef + ((*coef >= 0) ? p1 : m1));
+        }
+        m_nEobRun--;
+    }
+
+    return true;
+}
+
+// Processes RSTn if @restarts_left MCUs are decoded since the last restart
+bool CJpegSoftwareDecompressor::CheckRestart(unsigned int &restarts_left)
+{
+    if (m_nRestartInterval == 0)
+        return true;
+
+    if (restarts_left == 0) {
+        if (!ProcessRestart())
+            return false;
+        restarts_left = m_nRestartInterval;
+    }
+    restarts_left--;
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::DecodeScan(size_t offset)
+{
+    unsigned int restarts_left = m_nRestartInterval;
+
+    ResetBitReader(offset);
+
+    if (m_nScanComponents == 1) {
+        // A non-interleaved scan covers only the blocks in the image
+        ComponentInfo &comp = *m_pScanComponents[0];
+
+        for (unsigned int by = 0; by < comp.blocks_height; by++) {
+            for (unsigned int bx = 0; bx < comp.blocks_width; bx++) {
+                if (!CheckRestart(restarts_left) || !DecodeBlock(comp, GetBlock(comp, bx, by)))
+                    return false;
+            }
+
+            // single component in a single scan: an MCU row is a block row
+            if (m_bRowByRow)
+                TransformMcuRows(by, 1);
+        }
+
+        return true;
+    }
+
+    for (unsigned int mcuy = 0; mcuy < m_nMcuRows; mcuy++) {
+        for (unsigned int mcux = 0; mcux < m_nMcusPerLine; mcux++) {
+            if (!CheckRestart(restarts_left))
+                return false;
+
+            for (unsigned int i = 0; i < m_nScanComponents; i++) {
+                ComponentInfo &comp = *m_pScanComponents[i];
+
+                for (unsigned int y = 0; y < comp.v; y++) {
+                    for (unsigned int x = 0; x < comp.h; x++) {
+                        if (!DecodeBlock(comp, GetBlock(comp, mcux * comp.h + x, mcuy * comp.v + y)))
+                            return false;
+                    }
+                }
+            }
+        }
+
+        if (m_bRowByRow)
+            TransformMcuRows(mcuy, 1);
+    }
+
+    return true;
+}
+
+/*
+ * The inverse DCT of the lowest m_nBlockSize x m_nBlockSize coefficients of @block into
+ * m_nBlockSize x m_nBlockSize pixels. It is the 8x8 inverse DCT if m_nBlockSize is 8.
+ */
+void CJpegSoftwareDecompressor::TransformBlock(const ComponentInfo &comp, const int16_t *block,
+                                               unsigned char *dst, unsigned int stride)
+{
+    const unsigned int size = m_nBlockSize;
+    int64_t tmp[8][8];
+
+    // rows
+    for (unsigned int v = 0; v < size; v++) {
+        int32_t coefs[8];
+
+        for (unsigned int u = 0; u < size; u++)
+            coefs[u] = block[v * 8 + u] * comp.quant[v * 8 + u];
+
+        for (unsigned int x = 0; x < size; x++) {
+            int64_t sum = 0;
+            for (unsigned int u = 0; u < size; u++)
+                sum += static_cast<int64_t>(coefs[u]) * m_idctBasis[x][u];
+            tmp[v][x] = sum;
+        }
+    }
+
+    // columns
+    const int64_t rounding = static_cast<int64_t>(1) << (IDCT_CONST_BITS * 2 - 1);
+    for (unsigned int y = 0; y < size; y++) {
+        for (unsigned int x = 0; x < size; x++) {
+            int64_t sum = rounding;
+            for (unsigned int v = 0; v < size; v++)
+                sum += tmp[v][x] * m_idctBasis[y][v];
+            dst[y * stride + x] = ClampPixel((sum >> (IDCT_CONST_BITS * 2)) + 128);
+        }
+    }
+}
+
+void CJpegSoftwareDecompressor::TransformMcuRows(unsigned int first_row, unsigned int rows)
+{
+    for (unsigned int i = 0; i < m_nComponents; i++) {
+        ComponentInfo &comp = m_components[i];
+        unsigned int first = first_row * comp.v;
+        unsigned int last = std::min((first_row + rows) * comp.v, comp.blocks_rows);
+
+        for (unsigned int by = first; by < last; by++) {
+            unsigned char *dst = &comp.plane[static_cast<size_t>(by) * m_nBlockSize * comp.plane_stride];
+
+            for (unsigned int bx = 0; bx < comp.blocks_stride; bx++)
+                TransformBlock(comp, GetBlock(comp, bx, by), dst + bx * m_nBlockSize, comp.plane_stride);
+        }
+    }
+}
+
+bool CJpegSoftwareDecompressor::WriteImage(unsigned int v4l2_fmt, unsigned char *buffer,
+                                           unsigned int width, unsigned int height)
+{
+    // the position of the samples of each component for the pixels in a row
+    std::vector<unsigned int> columns[3];
+    for (unsigned int i = 0; i < m_nComponents; i++) {
+        columns[i].resize(width);
+        for (unsigned int x = 0; x < width; x++)
+            columns[i][x] = x * m_components[i].h / m_nMaxH;
+    }
+
+    const unsigned char *rows[3];
+    const unsigned char neutral = 128;
+    unsigned int chroma_width = (width + 1) / 2;
+    unsigned char *chroma = buffer + static_cast<size_t>(width) * height;
+
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int i = 0; i < m_nComponents; i++)
+            rows[i] = &m_components[i].plane[static_cast<size_t>(y * m_components[i].v / m_nMaxV) *
+                                             m_components[i].plane_stride];
+
+        for (unsigned int x = 0; x < width; x++) {
+            int luma = rows[0][columns[0][x]];
+            int cb = (m_nComponents == 3) ? rows[1][columns[1][x]] : neutral;
+            int cr = (m_nComponents == 3) ? rows[2][columns[2][x]] : neutral;
+
+            switch (v4l2_fmt) {
+            case V4L2_PIX_FMT_GREY:
+            case V4L2_PIX_FMT_NV12:
+            case V4L2_PIX_FMT_NV21:
+            case V4L2_PIX_FMT_YUV420:
+                buffer[static_cast<size_t>(y) * width + x] = static_cast<unsigned char>(luma);
+                // the chroma of the top-left pixel of every 2x2 pixels
+                if (((x | y) & 1) == 0) {
+                    size_t offset = static_cast<size_t>(y / 2) * chroma_width + x / 2;
+
+                    if (v4l2_fmt == V4L2_PIX_FMT_NV12) {
+                        chroma[offset * 2] = static_cast<unsigned char>(cb);
+                        chroma[offset * 2 + 1] = static_cast<unsigned char>(cr);
+                    } else if (v4l2_fmt == V4L2_PIX_FMT_NV21) {
+                        chroma[offset * 2] = static_cast<unsigned char>(cr);
+                        chroma[offset * 2 + 1] = static_cast<unsigned char>(cb);
+                    } else if (v4l2_fmt == V4L2_PIX_FMT_YUV420) {
+                        size_t plane = static_cast<size_t>(chroma_width) * ((height + 1) / 2);
+                        chroma[offset] = static_cast<unsigned char>(cb);
+                        chroma[plane + offset] = static_cast<unsigned char>(cr);
+                    }
+                }
+                continue;
+            case V4L2_PIX_FMT_YUYV: {
+                unsigned char *pixel = buffer + (static_cast<size_t>(y) * chroma_width + x / 2) * 4;
+                if ((x & 1) == 0) {
+                    pixel[0] = pixel[2] = static_cast<unsigned char>(luma);
+                    pixel[1] = static_cast<unsigned char>(cb);
+                    pixel[3] = static_cast<unsigned char>(cr);
+                } else {
+                    pixel[2] = static_cast<unsigned char>(luma);
+                }
+                continue;
+            }
+            }
+
+            // JFIF YCbCr to RGB in 16-bit fixed point
+            cb -= 128;
+            cr -= 128;
+            unsigned char r = ClampPixel(luma + ((91881 * cr + 32768) >> 16));
+            unsigned char g = ClampPixel(luma + ((-22554 * cb - 46802 * cr + 32768) >> 16));
+            unsigned char b = ClampPixel(luma + ((116130 * cb + 32768) >> 16));
+            size_t offset = static_cast<size_t>(y) * width + x;
+
+            switch (v4l2_fmt) {
+            case V4L2_PIX_FMT_RGB32: // A, R, G, B in memory
+                buffer[offset * 4] = 0xFF;
+                buffer[offset * 4 + 1] = r;
+                buffer[offset * 4 + 2] = g;
+                buffer[offset * 4 + 3] = b;
+                break;
+            case V4L2_PIX_FMT_BGR32: // B, G, R, A in memory
+                buffer[offset * 4] = b;
+                buffer[offset * 4 + 1] = g;
+                buffer[offset * 4 + 2] = r;
+                buffer[offset * 4 + 3] = 0xFF;
+                break;
+            case V4L2_PIX_FMT_RGB24:
+                buffer[offset * 3] = r;
+                buffer[offset * 3 + 1] = g;
+                buffer[offset * 3 + 2] = b;
+                break;
+            case V4L2_PIX_FMT_BGR24:
+                buffer[offset * 3] = b;
+                buffer[offset * 3 + 1] = g;
+                buffer[offset * 3 + 2] = r;
+                break;
+            case V4L2_PIX_FMT_RGB565: { // little endian
+                unsigned int rgb = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+                buffer[offset * 2] = static_cast<unsigned char>(rgb);
+                buffer[offset * 2 + 1] = static_cast<unsigned char>(rgb >> 8);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool CJpegSoftwareDecompressor::Decompress(const unsigned char *stream, size_t len, unsigned int scale,
+                                           unsigned int v4l2_fmt, unsigned char *buffer, size_t buflen)
+{
+    CJpegStreamParser parser;
+
+    Initialize();
+
+    if ((scale != 1) && (scale != 2) && (scale != 4) && (scale != 8)) {
+        ALOGE("Invalid downscaling factor %u", scale);
+        return false;
+    }
+
+    if (!parser.Parse(stream, len, true) || !IsDecompressible(parser))
+        return false;
+
+    unsigned int width = (parser.GetWidth() + scale - 1) / scale;
+    unsigned int height = (parser.GetHeight() + scale - 1) / scale;
+    size_t required = GetImageSize(v4l2_fmt, width, height);
+    if (required == 0) {
+        ALOGE("Image format %08X is not supported by the software decompressor", v4l2_fmt);
+        return false;
+    }
+
+    if (buflen < required) {
+        ALOGE("Too small buffer of %zu bytes for %ux%u image of %08X (%zu bytes)",
+              buflen, width, height, v4l2_fmt, required);
+        return false;
+    }
+
+    m_pStream = stream;
+    m_nStreamSize = len;
+
+    size_t scans = 0;
+    for (size_t idx = parser.FindSegment(JPEG_MARKER_SOS); idx < parser.GetSegmentCount();
+            idx = parser.FindSegment(JPEG_MARKER_SOS, idx + 1))
+        scans++;
+    m_bRowByRow = !(parser.GetFrameMarker() == JPEG_MARKER_SOF2) && (scans == 1);
+
+    if (!SetupFrame(parser, scale))
+        return false;
+
+    bool decoded = true;
+    for (size_t idx = 0; decoded && (idx < parser.GetSegmentCount()); idx++) {
+        const CJpegStreamParser::Segment &segment = parser.GetSegment(idx);
+        size_t size;
+        const unsigned char *data = parser.GetSegmentData(segment, &size);
+
+        switch (segment.marker) {
+        case JPEG_MARKER_DQT:
+            decoded = ReadQuantTables(data, size);
+            break;
+        case JPEG_MARKER_DHT:
+            decoded = ReadHuffmanTables(data, size);
+            break;
+        case JPEG_MARKER_DRI:
+            decoded = ReadRestartInterval(data, size);
+            break;
+        case JPEG_MARKER_SOS:
+            decoded = SetupScan(data, size);
+            if (decoded && m_bRowByRow && (m_nScanComponents != m_nComponents)) {
+                ALOGE("The single scan has %u of %u components", m_nScanComponents, m_nComponents);
+                decoded = false;
+            }
+            if (decoded)
+                decoded = DecodeScan(segment.offset + 2 + segment.length);
+            break;
+        }
+    }
+
+    if (!decoded) {
+        ALOGE("Failed to decompress %ux%u JPEG stream of %zu bytes by software",
+              parser.GetWidth(), parser.GetHeight(), len);
+        return false;
+    }
+
+    if (!m_bRowByRow)
+        TransformMcuRows(0, m_nMcuRows);
+
+    return WriteImage(v4l2_fmt, buffer, width, height);
+}
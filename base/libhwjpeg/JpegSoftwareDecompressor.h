@@ -0,0 +1,144 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HARDWARE_SAMSUNG_SLSI_EXYNOS_JPEG_SOFTWARE_DECOMPRESSOR_H__
+#define __HARDWARE_SAMSUNG_SLSI_EXYNOS_JPEG_SOFTWARE_DECOMPRESSOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "JpegStreamParser.h"
+
+/*
+ * CJpegSoftwareDecompressor - The decompressor of the streams that HWJPEG rejects
+ *
+ * It decodes 8-bit Huffman coded sequential (SOF0, SOF1) and progressive (SOF2)
+ * streams of one or three components with any sampling factors and restart
+ * intervals. Downscaling by 2, 4 and 8 is done in DCT domain: only the lowest
+ * 4x4, 2x2 and 1x1 coefficients of a block are transformed by the inverse DCT
+ * of that size. The chroma is upsampled by replication and converted with the
+ * JFIF (BT.601 full range) equation. All arithmetic is in integer so that the
+ * output is identical on every CPU.
+ * The output image is a single buffer of the formats in IsSupportedFormat() and
+ * the size is the size of the stream divided by the downscaling factor rounded up.
+ */
+class CJpegSoftwareDecompressor {
+    struct HuffmanTable {
+        bool defined;
+        int32_t maxcode[17];    // the largest code of each length. -1 if no code
+        int32_t valptr[17];     // the index in @values of the smallest code of each length
+        int32_t mincode[17];
+        unsigned char lookup_length[256]; // the length of the code of 8 bits or less. 0 if longer
+        unsigned char lookup_value[256];
+        unsigned char values[256];
+    };
+
+    struct ComponentInfo {
+        unsigned char id;
+        unsigned int h, v;      // sampling factors
+        unsigned int qtable;
+        bool quant_latched;     // @quant is copied from the table at the first scan
+        uint16_t quant[64];     // in natural order
+        unsigned int blocks_width, blocks_height; // the blocks in the component
+        unsigned int blocks_stride, blocks_rows;  // the blocks allocated by MCU
+        unsigned int dc_table, ac_table;
+        int16_t dc_pred;
+        std::vector<int16_t> coefs;     // in natural order
+        std::vector<unsigned char> plane;
+        unsigned int plane_stride;
+    };
+
+    const unsigned char *m_pStream;
+    size_t m_nStreamSize;
+    // the entropy-coded data under decoding
+    size_t m_nPosition;
+    uint32_t m_uiBits;
+    unsigned int m_nBitCount;
+    bool m_bMarkerFound;
+
+    uint16_t m_quantTables[4][64];
+    bool m_bQuantDefined[4];
+    HuffmanTable m_dcTables[4];
+    HuffmanTable m_acTables[4];
+
+    ComponentInfo m_components[3];
+    unsigned int m_nComponents;
+    unsigned int m_nMaxH, m_nMaxV;
+    unsigned int m_nMcusPerLine, m_nMcuRows;
+    unsigned int m_nWidth, m_nHeight;
+    bool m_bProgressive;
+    // the coefficients of only one MCU row are kept if the stream is of a single scan
+    bool m_bRowByRow;
+    unsigned int m_nRestartInterval;
+    unsigned int m_nEobRun;
+    unsigned int m_nBlockSize;  // 8 / scale factor
+    int32_t m_idctBasis[8][8];  // the basis of the inverse DCT of m_nBlockSize points
+
+    // the scan under decoding
+    ComponentInfo *m_pScanComponents[3];
+    unsigned int m_nScanComponents;
+    unsigned int m_nSs, m_nSe, m_nAh, m_nAl;
+
+    bool ReadQuantTables(const unsigned char *data, size_t size);
+    bool ReadHuffmanTables(const unsigned char *data, size_t size);
+    bool ReadRestartInterval(const unsigned char *data, size_t size);
+    bool SetupFrame(CJpegStreamParser &parser, unsigned int scale);
+    bool SetupScan(const unsigned char *data, size_t size);
+    bool DecodeScan(size_t offset);
+    bool CheckRestart(unsigned int &restarts_left);
+
+    void ResetBitReader(size_t offset);
+    void FillBits(unsigned int count);
+    unsigned int GetBits(unsigned int count);
+    int GetBit() { return GetBits(1); }
+    int ReceiveExtend(unsigned int count);
+    int DecodeHuffman(const HuffmanTable &table);
+    bool ProcessRestart();
+
+    int16_t *GetBlock(ComponentInfo &comp, unsigned int bx, unsigned int by);
+    bool DecodeBlock(ComponentInfo &comp, int16_t *block);
+    void TransformMcuRows(unsigned int first_row, unsigned int rows);
+    void TransformBlock(const ComponentInfo &comp, const int16_t *block, unsigned char *dst, unsigned int stride);
+    bool WriteImage(unsigned int v4l2_fmt, unsigned char *buffer, unsigned int width, unsigned int height);
+
+    void Initialize();
+public:
+    CJpegSoftwareDecompressor() : m_pStream(NULL), m_nStreamSize(0) { Initialize(); }
+    ~CJpegSoftwareDecompressor() { }
+
+    static bool IsSupportedFormat(unsigned int v4l2_fmt);
+    // the number of bytes of the image of @v4l2_fmt. 0 if the format is not supported
+    static size_t GetImageSize(unsigned int v4l2_fmt, unsigned int width, unsigned int height);
+    // Returns true if the parsed stream is decodable by Decompress()
+    static bool IsDecompressible(CJpegStreamParser &parser);
+
+    /*
+     * Decompress - decompress the stream into the image
+     * @stream[in]  : the compressed stream
+     * @len[in]     : the number of bytes of @stream
+     * @scale[in]   : the downscaling factor: one of 1, 2, 4 and 8
+     * @v4l2_fmt[in]: the format of the image
+     * @buffer[out] : the image of (width / @scale) x (height / @scale), rounded up
+     * @buflen[in]  : the number of bytes of @buffer
+     * @return      : false if the stream is not supported or is corrupted or @buffer
+     *                is not large enough. @buffer is not written on failure.
+     */
+    bool Decompress(const unsigned char *stream, size_t len, unsigned int scale,
+                    unsigned int v4l2_fmt, unsigned char *buffer, size_t buflen);
+};
+
+#endif //__HARDWARE_SAMSUNG_SLSI_EXYNOS_JPEG_SOFTWARE_DECOMPRESSOR_H__
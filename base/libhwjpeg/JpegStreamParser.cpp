@@ -0,0 +1,397 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hwjpeg-internal.h"
+#include "JpegStreamParser.h"
+
+#define JPEG_MARKER_SIZE           2
+#define JPEG_SEGMENT_LENFIELD_SIZE 2
+
+#define EXIF_IDENTIFIER_SIZE   6
+#define TIFF_HEADER_SIZE       8
+#define IFD_FIELDCOUNT_SIZE    2
+#define IFD_FIELD_SIZE         12
+#define IFD_NEXTIFDOFFSET_SIZE 4
+
+#define IFD_TYPE_SHORT 3
+#define IFD_TYPE_LONG  4
+
+#define IFD_TAG_JPEG_INTERCHANGE_FORMAT     0x0201
+#define IFD_TAG_JPEG_INTERCHANGE_FORMAT_LEN 0x0202
+
+void CJpegStreamParser::Initialize()
+{
+    m_segments.clear();
+
+    m_nFrameMarker = 0;
+    m_nPrecision = 0;
+    m_nComponents = 0;
+    m_nWidth = 0;
+    m_nHeight = 0;
+    memset(m_components, 0, sizeof(m_components));
+    m_iHorizontalFactor = 1;
+    m_iVerticalFactor = 1;
+
+    m_nRestartInterval = 0;
+    m_nScanOffset = 0;
+    m_nEntropyOffset = 0;
+    m_nEndOffset = 0;
+
+    m_nThumbnailOffset = 0;
+    m_nThumbnailSize = 0;
+}
+
+bool CJpegStreamParser::Parse(const unsigned char *streambase, size_t length, bool index_entropy)
+{
+    Initialize();
+
+    m_pStreamBase = streambase;
+    m_nStreamSize = length;
+
+    if ((m_nStreamSize < JPEG_MARKER_SIZE) || (m_pStreamBase[0] != 0xFF) || (m_pStreamBase[1] != JPEG_MARKER_SOI)) {
+        ALOGE("Not a valid JPEG stream (len %zu)", m_nStreamSize);
+        return false;
+    }
+
+    Segment soi = {JPEG_MARKER_SOI, 0, 0};
+    m_segments.push_back(soi);
+
+    size_t offset = JPEG_MARKER_SIZE;
+
+    while (true) {
+        // Any number of 0xFF can be filled before a marker
+        while ((m_nStreamSize - offset >= JPEG_MARKER_SIZE) &&
+                (m_pStreamBase[offset] == 0xFF) && (m_pStreamBase[offset + 1] == 0xFF))
+            offset++;
+
+        if (m_nStreamSize - offset < JPEG_MARKER_SIZE) {
+            ALOGE("Incomplete JPEG stream: no marker at offset %zu", offset);
+            return false;
+        }
+
+        if (m_pStreamBase[offset] != 0xFF) {
+            ALOGE("Corrupted JPEG stream: no marker at offset %zu", offset);
+            return false;
+        }
+
+        Segment segment = {m_pStreamBase[offset + 1], offset, 0};
+
+        if (segment.marker == JPEG_MARKER_EOI) {
+            if (m_nEntropyOffset == 0) {
+                ALOGE("Unexpected EOI found at %zu", offset);
+                return false;
+            }
+
+            m_segments.push_back(segment);
+            m_nEndOffset = offset;
+
+            return true;
+        }
+
+        if ((segment.marker == 0x00) || (segment.marker == JPEG_MARKER_SOI)) {
+            ALOGE("Corrupted JPEG stream: unexpected marker 0xFF%02X at offset %zu", segment.marker, offset);
+            return false;
+        }
+
+        bool standalone = (segment.marker == JPEG_MARKER_TEM) ||
+                ((segment.marker >= JPEG_MARKER_RST0) && (segment.marker <= JPEG_MARKER_RST7));
+        if (!standalone) {
+            if (m_nStreamSize - offset < JPEG_MARKER_SIZE + JPEG_SEGMENT_LENFIELD_SIZE) {
+                ALOGE("Incomplete JPEG stream: no length of marker 0xFF%02X at offset %zu", segment.marker, offset);
+                return false;
+            }
+
+            segment.length = GetLength(offset + JPEG_MARKER_SIZE);
+            if (segment.length < JPEG_SEGMENT_LENFIELD_SIZE) {
+                ALOGE("Invalid length %zu of marker 0xFF%02X at offset %zu", segment.length, segment.marker, offset);
+                return false;
+            }
+
+            if (segment.length > m_nStreamSize - offset - JPEG_MARKER_SIZE) {
+                ALOGE("Incomplete JPEG stream: %zu bytes of marker 0xFF%02X at offset %zu exceeds the stream",
+                      segment.length, segment.marker, offset);
+                return false;
+            }
+        }
+
+        m_segments.push_back(segment);
+        offset += JPEG_MARKER_SIZE + segment.length;
+
+        if (((segment.marker & 0xF0) == JPEG_MARKER_SOF0) && (segment.marker != JPEG_MARKER_DHT) &&
+                (segment.marker != JPEG_MARKER_JPG) && (segment.marker != JPEG_MARKER_DAC)) { // SOFn
+            if (!ParseFrame(segment))
+                return false;
+        } else if (segment.marker == JPEG_MARKER_DRI) {
+            if (segment.length != JPEG_SEGMENT_LENFIELD_SIZE + 2) {
+                ALOGE("Invalid length %zu of DRI at offset %zu", segment.length, segment.offset);
+                return false;
+            }
+            m_nRestartInterval = static_cast<unsigned short>(GetLength(segment.offset + 4));
+        } else if ((segment.marker == JPEG_MARKER_APP1) && !HasThumbnail()) {
+            ParseExif(segment);
+        } else if (segment.marker == JPEG_MARKER_SOS) {
+            if (!ParseScan(segment))
+                return false;
+
+            if (m_nEntropyOffset == 0) {
+                m_nScanOffset = segment.offset;
+                m_nEntropyOffset = offset;
+            }
+
+            if (!index_entropy)
+                return true; // this is the successful exit point of the header parsing
+
+            offset = SkipEntropyCodedData(offset);
+        }
+    }
+}
+
+bool CJpegStreamParser::ParseFrame(const Segment &segment)
+{
+    if (m_nFrameMarker != 0) {
+        ALOGE("Multiple frame headers: SOF%d at offset %zu", segment.marker & 0xF, segment.offset);
+        return false;
+    }
+
+    size_t size;
+    const unsigned char *data = GetSegmentData(segment, &size);
+
+    // 1 byte of bits per sample
+    // 2 bytes of height
+    // 2 bytes of width
+    // 1 byte of number of components
+    // n * 3 byte component specifications
+    if ((size < 6) || (data[5] == 0) || (data[5] > JPEG_MAX_COMPONENTS) || (size < 6 + data[5] * 3U)) {
+        ALOGE("Invalid SOF%d segment of %zu bytes at offset %zu", segment.marker & 0xF, size, segment.offset);
+        return false;
+    }
+
+    m_nFrameMarker = segment.marker;
+    m_nPrecision = data[0];
+    m_nHeight = static_cast<unsigned short>((data[1] << 8) | data[2]);
+    m_nWidth = static_cast<unsigned short>((data[3] << 8) | data[4]);
+    m_nComponents = data[5];
+
+    for (unsigned int i = 0; i < m_nComponents; i++) {
+        const unsigned char *spec = data + 6 + i * 3;
+        m_components[i].id = spec[0];
+        m_components[i].horizontal_factor = spec[1] >> 4;
+        m_components[i].vertical_factor = spec[1] & 0xF;
+        m_components[i].qtable = spec[2];
+    }
+
+    m_iHorizontalFactor = m_components[0].horizontal_factor;
+    m_iVerticalFactor = m_components[0].vertical_factor;
+
+    return true;
+}
+
+bool CJpegStreamParser::ParseScan(const Segment &segment)
+{
+    if (m_nFrameMarker == 0) {
+        ALOGE("SOS at offset %zu is ahead of the frame header", segment.offset);
+        return false;
+    }
+
+    size_t size;
+    const unsigned char *data = GetSegmentData(segment, &size);
+
+    // 1 byte of number of components, n * 2 bytes of component selectors
+    // and 3 bytes of spectral selection and successive approximation
+    if ((size < 1) || (data[0] == 0) || (data[0] > JPEG_MAX_COMPONENTS) || (size < 4 + data[0] * 2U)) {
+        ALOGE("Invalid SOS segment of %zu bytes at offset %zu", size, segment.offset);
+        return false;
+    }
+
+    return true;
+}
+
+size_t CJpegStreamParser::SkipEntropyCodedData(size_t offset)
+{
+    while (m_nStreamSize - offset >= JPEG_MARKER_SIZE) {
+        const void *found = memchr(m_pStreamBase + offset, 0xFF, m_nStreamSize - offset - 1);
+        if (found == NULL)
+            break;
+
+        offset = PTR_DIFF(m_pStreamBase, found);
+
+        unsigned char marker = m_pStreamBase[offset + 1];
+        if (marker == 0x00) { // stuffed zero
+            offset += JPEG_MARKER_SIZE;
+        } else if (marker == 0xFF) { // fill byte
+            offset++;
+        } else if ((marker >= JPEG_MARKER_RST0) && (marker <= JPEG_MARKER_RST7)) {
+            Segment rst = {marker, offset, 0};
+            m_segments.push_back(rst);
+            offset += JPEG_MARKER_SIZE;
+        } else {
+            return offset;
+        }
+    }
+
+    return m_nStreamSize;
+}
+
+static unsigned int ReadTiff16(const unsigned char *p, bool little)
+{
+    return little ? (p[0] | (p[1] << 8)) : ((p[0] << 8) | p[1]);
+}
+
+static size_t ReadTiff32(const unsigned char *p, bool little)
+{
+    return little ? (static_cast<size_t>(ReadTiff16(p + 2, true)) << 16) | ReadTiff16(p, true)
+                  : (static_cast<size_t>(ReadTiff16(p, false)) << 16) | ReadTiff16(p + 2, false);
+}
+
+// Returns the number of fields of the IFD at @ifd or 0 if the IFD exceeds the TIFF
+static size_t GetIFDFieldCount(const unsigned char *tiff, size_t tiffsize, size_t ifd, bool little)
+{
+    if ((ifd > tiffsize) || (tiffsize - ifd < IFD_FIELDCOUNT_SIZE + IFD_NEXTIFDOFFSET_SIZE))
+        return 0;
+
+    size_t count = ReadTiff16(tiff + ifd, little);
+    if ((tiffsize - ifd - IFD_FIELDCOUNT_SIZE - IFD_NEXTIFDOFFSET_SIZE) / IFD_FIELD_SIZE < count)
+        return 0;
+
+    return count;
+}
+
+void CJpegStreamParser::ParseExif(const Segment &segment)
+{
+    size_t size;
+    const unsigned char *data = GetSegmentData(segment, &size);
+
+    if ((size < EXIF_IDENTIFIER_SIZE + TIFF_HEADER_SIZE) || (memcmp(data, "Exif\0\0", EXIF_IDENTIFIER_SIZE) != 0))
+        return;
+
+    const unsigned char *tiff = data + EXIF_IDENTIFIER_SIZE;
+    size_t tiffsize = size - EXIF_IDENTIFIER_SIZE;
+    bool little;
+
+    if ((tiff[0] == 'I') && (tiff[1] == 'I'))
+        little = true;
+    else if ((tiff[0] == 'M') && (tiff[1] == 'M'))
+        little = false;
+    else
+        return;
+
+    if (ReadTiff16(tiff + 2, little) != 42)
+        return;
+
+    // The thumbnail is described by the 1st IFD that the 0th IFD links to
+    size_t ifd = ReadTiff32(tiff + 4, little);
+    size_t count = GetIFDFieldCount(tiff, tiffsize, ifd, little);
+    if (count == 0)
+        return;
+
+    ifd = ReadTiff32(tiff + ifd + IFD_FIELDCOUNT_SIZE + count * IFD_FIELD_SIZE, little);
+    count = GetIFDFieldCount(tiff, tiffsize, ifd, little);
+
+    size_t thumboffset = 0;
+    size_t thumbsize = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char *field = tiff + ifd + IFD_FIELDCOUNT_SIZE + i * IFD_FIELD_SIZE;
+        unsigned int tag = ReadTiff16(field, little);
+        unsigned int type = ReadTiff16(field + 2, little);
+        size_t value;
+
+        if (type == IFD_TYPE_LONG)
+            value = ReadTiff32(field + 8, little);
+        else if (type == IFD_TYPE_SHORT)
+            value = ReadTiff16(field + 8, little);
+        else
+            continue;
+
+        if (tag == IFD_TAG_JPEG_INTERCHANGE_FORMAT)
+            thumboffset = value;
+        else if (tag == IFD_TAG_JPEG_INTERCHANGE_FORMAT_LEN)
+            thumbsize = value;
+    }
+
+    if ((thumbsize == 0) || (thumboffset > tiffsize) || (thumbsize > tiffsize - thumboffset)) {
+        ALOGW_IF(thumbsize > 0, "Thumbnail of %zu bytes at %zu exceeds %zu bytes of Exif",
+                 thumbsize, thumboffset, tiffsize);
+        return;
+    }
+
+    m_nThumbnailOffset = PTR_DIFF(m_pStreamBase, tiff) + thumboffset;
+    m_nThumbnailSize = thumbsize;
+}
+
+bool CJpegStreamParser::IsDecompressible()
+{
+    if (m_nFrameMarker != JPEG_MARKER_SOF0) {
+        ALOGE("SOF%d is not supported", m_nFrameMarker & 0xF);
+        return false;
+    }
+
+    if ((FindSegment(JPEG_MARKER_DAC) < GetSegmentCount()) || (FindSegment(JPEG_MARKER_DNL) < GetSegmentCount())) {
+        ALOGE("Unsupported JPEG stream: found DAC or DNL marker");
+        return false;
+    }
+
+    if (m_nPrecision != 8) {
+        ALOGE("Bits Per Sample should be 8 but it is %d", m_nPrecision);
+        return false;
+    }
+
+    if ((m_nHeight < 8) || (m_nHeight > 16383)) {
+        ALOGE("Height %d is not supported", m_nHeight);
+        return false;
+    }
+
+    if ((m_nWidth < 8) || (m_nWidth > 16383)) {
+        ALOGE("Width %d is not supported", m_nWidth);
+        return false;
+    }
+
+    if (m_nComponents != 3) {
+        ALOGE("Number of components should be 3 but it is %d", m_nComponents);
+        return false;
+    }
+
+    // Only the first component is needed to find chroma subsampling factor
+    unsigned char factor = (m_iHorizontalFactor << 4) | m_iVerticalFactor;
+    if ((factor != 0x11) && (factor != 0x21) && (factor != 0x12) && (factor != 0x22)) {
+        ALOGE("Invalid Luma sampling factor %#02x", factor);
+        return false;
+    }
+
+    return true;
+}
+
+size_t CJpegStreamParser::FindSegment(unsigned char marker, size_t from)
+{
+    for (size_t i = from; i < m_segments.size(); i++) {
+        if (m_segments[i].marker == marker)
+            return i;
+    }
+
+    return m_segments.size();
+}
+
+const unsigned char *CJpegStreamParser::GetSegmentData(const Segment &segment, size_t *size)
+{
+    if (segment.length < JPEG_SEGMENT_LENFIELD_SIZE) {
+        *size = 0;
+        return NULL;
+    }
+
+    *size = segment.length - JPEG_SEGMENT_LENFIELD_SIZE;
+    return m_pStreamBase + segment.offset + JPEG_MARKER_SIZE + JPEG_SEGMENT_LENFIELD_SIZE;
+}
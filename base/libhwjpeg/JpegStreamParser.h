@@ -0,0 +1,141 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __HARDWARE_SAMSUNG_SLSI_EXYNOS_JPEG_STREAM_PARSER_H__
+#define __HARDWARE_SAMSUNG_SLSI_EXYNOS_JPEG_STREAM_PARSER_H__
+
+#include <cstddef>
+#include <vector>
+
+#define JPEG_MARKER_SOF0 0xC0
+#define JPEG_MARKER_DHT  0xC4
+#define JPEG_MARKER_JPG  0xC8
+#define JPEG_MARKER_DAC  0xCC
+#define JPEG_MARKER_RST0 0xD0
+#define JPEG_MARKER_RST7 0xD7
+#define JPEG_MARKER_SOI  0xD8
+#define JPEG_MARKER_EOI  0xD9
+#define JPEG_MARKER_SOS  0xDA
+#define JPEG_MARKER_DQT  0xDB
+#define JPEG_MARKER_DNL  0xDC
+#define JPEG_MARKER_DRI  0xDD
+#define JPEG_MARKER_APP0 0xE0
+#define JPEG_MARKER_APP1 0xE1
+#define JPEG_MARKER_COM  0xFE
+#define JPEG_MARKER_TEM  0x01
+
+#define JPEG_MAX_COMPONENTS 4
+
+/*
+ * CJpegStreamParser - The index of the segments in a JPEG stream
+ *
+ * Parse() reads the markers from SOI to the first SOS once and records the offset
+ * and the length of every segment on the way. Nothing is copied from the stream:
+ * the stream should not be released while the index is in use.
+ * If @index_entropy is true, Parse() continues through the entropy-coded data to
+ * EOI and also records RSTn markers and the segments between the scans.
+ * Every access to the stream is checked against the length of the stream. A
+ * corrupted stream fails Parse() but a corrupted Exif of APP1 just means that no
+ * thumbnail is found.
+ */
+class CJpegStreamParser {
+public:
+    struct Segment {
+        unsigned char marker; // the second byte of the marker
+        size_t offset;        // the offset of the marker from SOI
+        size_t length;        // the value of the length field. 0 if the marker has no segment
+    };
+
+    struct Component {
+        unsigned char id;
+        unsigned char horizontal_factor;
+        unsigned char vertical_factor;
+        unsigned char qtable;
+    };
+
+private:
+    const unsigned char *m_pStreamBase;
+    size_t m_nStreamSize;
+
+    std::vector<Segment> m_segments;
+
+    unsigned char m_nFrameMarker; // 0 if no SOFn is found
+    unsigned char m_nPrecision;
+    unsigned char m_nComponents;
+    unsigned short m_nWidth;
+    unsigned short m_nHeight;
+    Component m_components[JPEG_MAX_COMPONENTS];
+
+    unsigned short m_nRestartInterval;
+    size_t m_nScanOffset;    // the offset of the first SOS marker
+    size_t m_nEntropyOffset; // the offset of the entropy-coded data of the first scan
+    size_t m_nEndOffset;     // the offset of EOI if the entropy-coded data is indexed
+
+    size_t m_nThumbnailOffset;
+    size_t m_nThumbnailSize;
+
+    void Initialize();
+    size_t GetLength(size_t offset) {
+        return static_cast<size_t>(m_pStreamBase[offset]) * 0x100 + m_pStreamBase[offset + 1];
+    }
+    bool ParseFrame(const Segment &segment);
+    bool ParseScan(const Segment &segment);
+    void ParseExif(const Segment &segment);
+    size_t SkipEntropyCodedData(size_t offset);
+
+public:
+    unsigned char m_iHorizontalFactor;
+    unsigned char m_iVerticalFactor;
+
+    CJpegStreamParser() : m_pStreamBase(NULL), m_nStreamSize(0) { Initialize(); }
+    ~CJpegStreamParser() { }
+
+    bool Parse(const unsigned char *streambase, size_t length, bool index_entropy = false);
+
+    // Returns true if HWJPEG is able to decompress the parsed stream
+    bool IsDecompressible();
+
+    unsigned int GetWidth() { return m_nWidth; }
+    unsigned int GetHeight() { return m_nHeight; }
+    unsigned int GetNumComponents() { return m_nComponents; }
+    unsigned int GetPrecision() { return m_nPrecision; }
+    unsigned char GetFrameMarker() { return m_nFrameMarker; }
+    const Component *GetComponent(unsigned int idx) { return (idx < m_nComponents) ? &m_components[idx] : NULL; }
+    unsigned int GetRestartInterval() { return m_nRestartInterval; }
+
+    size_t GetScanOffset() { return m_nScanOffset; }
+    size_t GetEntropyCodedOffset() { return m_nEntropyOffset; }
+    size_t GetEndOffset() { return m_nEndOffset; }
+
+    size_t GetSegmentCount() { return m_segments.size(); }
+    const Segment &GetSegment(size_t idx) { return m_segments[idx]; }
+    /*
+     * FindSegment - Find the segment of @marker
+     * @marker[in] : the second byte of the marker
+     * @from[in]   : the index of the segment to start the search
+     * @return     : the index of the segment. GetSegmentCount() if not found.
+     */
+    size_t FindSegment(unsigned char marker, size_t from = 0);
+    // The payload of @segment after the length field and its size
+    const unsigned char *GetSegmentData(const Segment &segment, size_t *size);
+
+    // The compressed stream of the thumbnail in Exif of APP1
+    bool HasThumbnail() { return m_nThumbnailSize > 0; }
+    size_t GetThumbnailOffset() { return m_nThumbnailOffset; }
+    size_t GetThumbnailSize() { return m_nThumbnailSize; }
+};
+
+#endif //__HARDWARE_SAMSUNG_SLSI_EXYNOS_JPEG_STREAM_PARSER_H__
@@ -767,6 +767,13 @@ CHWJpegV4L2Decompressor::CHWJpegV4L2Decompressor() : CHWJpegDecompressor("/dev/v
     memset(&m_v4l2DstBuffer, 0, sizeof(m_v4l2DstBuffer));
     m_v4l2DstBuffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
+    memset(&m_queuedStreams, 0, sizeof(m_queuedStreams));
+    m_uiCaptureBuffers = HWJPEG_MAX_QUEUED_STREAMS;
+    m_uiStreamBuffers = HWJPEG_MAX_QUEUED_STREAMS;
+    m_uiCaptureMemory = 0;
+    m_uiQueueHead = 0;
+    m_uiQueued = 0;
+
     if (Okay()) {
         v4l2_capability cap;
         memset(&cap, 0, sizeof(cap));
@@ -793,13 +800,23 @@ bool CHWJpegV4L2Decompressor::PrepareCapture()
         return false;
     }
 
-    if (TestFlag(HWJPEG_FLAG_CAPTURE_READY))
-        return true;
+    if (TestFlag(HWJPEG_FLAG_CAPTURE_READY)) {
+        if (m_uiCaptureMemory == m_v4l2DstBuffer.memory)
+            return true;
+
+        if (m_uiQueued > 0) {
+            ALOGE("Unable to change the type of the image buffer while %u decompressions are queued",
+                  m_uiQueued);
+            return false;
+        }
+
+        CancelCapture();
+    }
 
     v4l2_requestbuffers reqbufs;
 
     memset(&reqbufs, 0, sizeof(reqbufs));
-    reqbufs.count = 1;
+    reqbufs.count = HWJPEG_MAX_QUEUED_STREAMS;
     reqbufs.memory = m_v4l2DstBuffer.memory;
     reqbufs.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
@@ -815,6 +832,10 @@ bool CHWJpegV4L2Decompressor::PrepareCapture()
         return false;
     }
 
+    // The driver may allocate less buffers than requested
+    m_uiCaptureBuffers = min(max(reqbufs.count, 1U), static_cast<unsigned int>(HWJPEG_MAX_QUEUED_STREAMS));
+    m_uiCaptureMemory = reqbufs.memory;
+
     SetFlag(HWJPEG_FLAG_CAPTURE_READY);
 
     return true;
@@ -825,15 +846,19 @@ void CHWJpegV4L2Decompressor::CancelCapture()
     if (!TestFlag(HWJPEG_FLAG_CAPTURE_READY))
         return;
 
+    CancelDecompressions();
+
     v4l2_requestbuffers reqbufs;
 
     memset(&reqbufs, 0, sizeof(reqbufs));
     reqbufs.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    reqbufs.memory = m_v4l2DstBuffer.memory;
+    reqbufs.memory = m_uiCaptureMemory;
 
     ioctl(GetDeviceFD(), VIDIOC_STREAMOFF, &reqbufs.type);
     ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &reqbufs);
 
+    m_uiCaptureBuffers = HWJPEG_MAX_QUEUED_STREAMS;
+
     ClearFlag(HWJPEG_FLAG_CAPTURE_READY);
 }
 
@@ -848,6 +873,12 @@ bool CHWJpegV4L2Decompressor::SetImageFormat(unsigned int v4l2_fmt,
             return true;
     }
 
+    if (m_uiQueued > 0) {
+        ALOGE("Unable to change the image format to %08X,%ux%u while %u decompressions are queued",
+              v4l2_fmt, width, height, m_uiQueued);
+        return false;
+    }
+
     CancelCapture();
 
     memset(&m_v4l2Format, 0, sizeof(m_v4l2Format));
@@ -900,7 +931,7 @@ bool CHWJpegV4L2Decompressor::PrepareStream()
     v4l2_requestbuffers rb;
     memset(&rb, 0, sizeof(rb));
 
-    rb.count = 1;
+    rb.count = HWJPEG_MAX_QUEUED_STREAMS;
     rb.memory = V4L2_MEMORY_USERPTR;
     rb.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
 
@@ -920,6 +951,8 @@ bool CHWJpegV4L2Decompressor::PrepareStream()
         return false;
     }
 
+    m_uiStreamBuffers = min(max(rb.count, 1U), static_cast<unsigned int>(HWJPEG_MAX_QUEUED_STREAMS));
+
     SetFlag(HWJPEG_FLAG_OUTPUT_READY);
 
     return true;
@@ -930,6 +963,8 @@ void CHWJpegV4L2Decompressor::CancelStream()
     if (!TestFlag(HWJPEG_FLAG_OUTPUT_READY))
         return;
 
+    CancelDecompressions();
+
     v4l2_requestbuffers rb;
     memset(&rb, 0, sizeof(rb));
     rb.count = 0;
@@ -940,13 +975,67 @@ void CHWJpegV4L2Decompressor::CancelStream()
     ioctl(GetDeviceFD(), VIDIOC_STREAMOFF, &rb.type);
     ioctl(GetDeviceFD(), VIDIOC_REQBUFS, &rb);
 
+    m_uiStreamBuffers = HWJPEG_MAX_QUEUED_STREAMS;
+
     ClearFlag(HWJPEG_FLAG_OUTPUT_READY);
 }
 
-bool CHWJpegV4L2Decompressor::QBufAndWait(const char *buffer, size_t len)
+// STREAMOFF of either queue drops all queued buffers of the queue
+void CHWJpegV4L2Decompressor::CancelDecompressions()
 {
+    ALOGW_IF(m_uiQueued > 0, "Canceling %u queued decompressions", m_uiQueued);
+
+    m_uiQueueHead = 0;
+    m_uiQueued = 0;
+}
+
+static unsigned long GetMonotonicTime()
+{
+    timespec tp;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &tp) != 0)
+        return 0;
+
+    return tp.tv_sec * 1000000UL + tp.tv_nsec / 1000;
+}
+
+bool CHWJpegV4L2Decompressor::Decompress(const char *buffer, size_t len)
+{
+    if (m_uiQueued > 0) {
+        ALOGE("Unable to decompress while %u decompressions are queued", m_uiQueued);
+        return false;
+    }
+
+    return QueueDecompression(buffer, len) && WaitForDecompression();
+}
+
+bool CHWJpegV4L2Decompressor::QueueDecompression(const char *buffer, size_t len, void *priv)
+{
+    if (m_v4l2Format.type == 0) {
+        ALOGE("Decompressed image format is not specified");
+        return false;
+    }
+
+    if (m_v4l2DstBuffer.length == 0) {
+        ALOGE("Decompressed image buffer is not specified");
+        return false;
+    }
+
+    // Do not change the order of PrepareCapture() and PrepareStream().
+    // Otherwise, decompression will fail.
+    if (!PrepareCapture() || !PrepareStream())
+        return false;
+
+    if (m_uiQueued >= GetMaxQueuedDecompressions()) {
+        ALOGE("Unable to queue more than %u decompressions", m_uiQueued);
+        return false;
+    }
+
+    unsigned int index = (m_uiQueueHead + m_uiQueued) % GetMaxQueuedDecompressions();
+
     v4l2_buffer buf;
     memset(&buf, 0, sizeof(buf));
+    buf.index = index;
     buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
     buf.memory = V4L2_MEMORY_USERPTR;
     buf.bytesused = len;
@@ -958,12 +1047,42 @@ bool CHWJpegV4L2Decompressor::QBufAndWait(const char *buffer, size_t len)
         return false;
     }
 
+    m_v4l2DstBuffer.index = index;
+
     if (ioctl(GetDeviceFD(), VIDIOC_QBUF, &m_v4l2DstBuffer) < 0) {
+        // The stream is not able to be dequeued without the image.
+        // Both queues are restarted because it also drops the streams queued before.
         CancelStream();
+        CancelCapture();
         ALOGERR("Failed to QBUF for the decompressed image");
         return false;
     }
 
+    m_queuedStreams[index].priv = priv;
+    m_queuedStreams[index].queued = GetMonotonicTime();
+    m_uiQueued++;
+
+    return true;
+}
+
+bool CHWJpegV4L2Decompressor::WaitForDecompression(void **priv, unsigned int *hw_delay,
+                                                   unsigned int *latency)
+{
+    if (m_uiQueued == 0) {
+        ALOGE("No decompression is queued");
+        return false;
+    }
+
+    unsigned int index = m_uiQueueHead;
+
+    if (priv)
+        *priv = m_queuedStreams[index].priv;
+
+    v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    buf.memory = V4L2_MEMORY_USERPTR;
+
     bool ret = true;
 
     if (ioctl(GetDeviceFD(), VIDIOC_DQBUF, &buf) < 0) {
@@ -972,37 +1091,36 @@ bool CHWJpegV4L2Decompressor::QBufAndWait(const char *buffer, size_t len)
     }
 
     buf.type = m_v4l2DstBuffer.type;
-    buf.memory = m_v4l2DstBuffer.memory;
+    buf.memory = m_uiCaptureMemory;
 
     if (ioctl(GetDeviceFD(), VIDIOC_DQBUF, &buf) < 0) {
         ALOGERR("Failed to DQBUF of the image buffer");
         ret = false;
     }
 
-    m_uiHWDelay = buf.reserved2;
-
-    return ret;
-}
-
-bool CHWJpegV4L2Decompressor::Decompress(const char *buffer, size_t len)
-{
-    if (m_v4l2Format.type == 0) {
-        ALOGE("Decompressed image format is not specified");
+    if (!ret) {
+        // The buffers in the queues are unknown. Start over with empty queues.
+        CancelStream();
+        CancelCapture();
         return false;
     }
 
-    if (m_v4l2DstBuffer.length == 0) {
-        ALOGE("Decompressed image buffer is not specified");
-        return false;
-    }
+    ALOGW_IF(buf.index != index, "Decompressed buffer %u but expected %u", buf.index, index);
 
-    // Do not change the order of PrepareCapture() and PrepareStream().
-    // Otherwise, decompression will fail.
-    if (!PrepareCapture() || !PrepareStream())
-        return false;
+    m_uiQueueHead = (m_uiQueueHead + 1) % GetMaxQueuedDecompressions();
+    m_uiQueued--;
+
+    m_uiHWDelay = buf.reserved2;
 
-    if (!QBufAndWait(buffer, len))
+    if (hw_delay)
+        *hw_delay = m_uiHWDelay;
+    if (latency)
+        *latency = static_cast<unsigned int>(GetMonotonicTime() - m_queuedStreams[index].queued);
+
+    if (!!(buf.flags & V4L2_BUF_FLAG_ERROR)) {
+        ALOGE("Failed to decompress the JPEG stream of buffer %u", index);
         return false;
+    }
 
     return true;
 }
@@ -482,6 +482,40 @@ public:
      * SetChromaSampFactor(), respectively.
      */
     virtual bool Decompress(const char *buffer, size_t len) = 0;
+
+    /*
+     * QueueDecompression - Start decompression of the given JPEG stream without waiting
+     * @buffer[in] : The buffer of JPEG stream. It should not be released until the
+     *               decompression finishes.
+     * @len[in]    : The length of the JPEG stream. It includes EOI marker.
+     * @priv[in]   : The user data that WaitForDecompression() returns for this stream
+     * @return : true if the stream is queued to HWJPEG. false, otherwise.
+     *
+     * The image is written to the image buffer configured by SetImageBuffer() before
+     * QueueDecompression(). Up to GetMaxQueuedDecompressions() streams can be queued
+     * ahead while the image format is unchanged and they finish in the queued order.
+     * The image format cannot be changed while a decompression is queued.
+     * Decompress() fails while a decompression is queued.
+     */
+    virtual bool QueueDecompression(const char __unused *buffer, size_t __unused len, void __unused *priv = NULL) { return false; }
+
+    /*
+     * WaitForDecompression - Wait for the oldest queued decompression finishes
+     * @priv[out]     : @priv given to QueueDecompression() with the stream
+     * @hw_delay[out] : The time that HWJPEG took to decompress the stream in usec
+     * @latency[out]  : The time from QueueDecompression() to the finish in usec
+     * @return : true if the image is decompressed successfully. false, otherwise.
+     *
+     * @priv is valid even if the decompression fails unless no decompression is queued.
+     */
+    virtual bool WaitForDecompression(void __unused **priv = NULL, unsigned int __unused *hw_delay = NULL,
+                                      unsigned int __unused *latency = NULL) { return false; }
+
+    /*
+     * GetMaxQueuedDecompressions - The number of decompressions that can be queued ahead
+     */
+    virtual unsigned int GetMaxQueuedDecompressions() { return 0; }
+    virtual unsigned int GetQueuedDecompressions() { return 0; }
 };
 
 class CHWJpegFlagManager {
@@ -597,17 +631,34 @@ class CHWJpegV4L2Decompressor : public CHWJpegDecompressor, private CHWJpegFlagM
         HWJPEG_FLAG_CAPTURE_READY = 0x20, /* the capture stream is ready */
     };
 
+    enum {
+        HWJPEG_MAX_QUEUED_STREAMS = 4, /* the number of buffers requested to both queues */
+    };
+
     unsigned int m_uiHWDelay;
 
     v4l2_format m_v4l2Format;
     v4l2_buffer m_v4l2DstBuffer; /* multi-planar foramt is not supported */
 
+    /* the numbers of buffers allocated by the driver while streaming */
+    unsigned int m_uiCaptureBuffers;
+    unsigned int m_uiStreamBuffers;
+    unsigned int m_uiCaptureMemory;
+
+    /* the queued decompressions indexed by the v4l2 buffer index */
+    struct {
+        void *priv;
+        unsigned long queued; /* usec of CLOCK_MONOTONIC */
+    } m_queuedStreams[HWJPEG_MAX_QUEUED_STREAMS];
+    unsigned int m_uiQueueHead; /* the buffer index of the oldest decompression */
+    unsigned int m_uiQueued;
+
     bool PrepareCapture();
     void CancelCapture();
 
     bool PrepareStream();
     void CancelStream();
-    bool QBufAndWait(const char *buffer, size_t len);
+    void CancelDecompressions();
 public:
     CHWJpegV4L2Decompressor();
     virtual ~CHWJpegV4L2Decompressor();
@@ -615,6 +666,13 @@ public:
     virtual bool SetImageBuffer(char *buffer, size_t len_buffer);
     virtual bool SetImageBuffer(int buffer, size_t len_buffer);
     virtual bool Decompress(const char *buffer, size_t len);
+    virtual bool QueueDecompression(const char *buffer, size_t len, void *priv = NULL);
+    virtual bool WaitForDecompression(void **priv = NULL, unsigned int *hw_delay = NULL,
+                                      unsigned int *latency = NULL);
+    virtual unsigned int GetMaxQueuedDecompressions() {
+        return (m_uiCaptureBuffers < m_uiStreamBuffers) ? m_uiCaptureBuffers : m_uiStreamBuffers;
+    }
+    virtual unsigned int GetQueuedDecompressions() { return m_uiQueued; }
 
     unsigned int GetHWDelay() { return m_uiHWDelay; }
 };
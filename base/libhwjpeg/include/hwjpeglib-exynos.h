@@ -128,7 +128,9 @@ bool hwjpeg_dmabuf_dst(hwjpeg_decompress_ptr cinfo, int outfd[], size_t outsize[
  * Note that both of @cinfo->image_width / @factor and @cinfo->image_height / @factor
  * should be also integers. The results should be also even number according to the
  * output image format configured by hwjpeg_config_image_format().
- * Otherwise, the decompression will fail.
+ * Otherwise, the stream is decompressed by software and the output size is rounded up.
+ * The software decompression is also chosen for the streams that H/W does not support
+ * like progressive JPEG or when the H/W is not available.
  */
 void hwjpeg_set_downscale_factor(hwjpeg_decompress_ptr cinfo, unsigned int factor);
 
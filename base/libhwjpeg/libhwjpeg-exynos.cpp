@@ -26,11 +26,14 @@
 #include <fcntl.h>
 
 #include <linux/videodev2.h>
+#include <linux/dma-buf.h>
 
 #include <exynos-hwjpeg.h>
 #include <hwjpeglib-exynos.h>
 
 #include "hwjpeg-internal.h"
+#include "JpegStreamParser.h"
+#include "JpegSoftwareDecompressor.h"
 
 #define ALOGERR(fmt, args...) ((void)ALOG(LOG_ERROR, LOG_TAG, fmt " [%s]", ##args, strerror(errno)))
 
@@ -38,185 +41,6 @@
 #define ROUND_UP(val, denom)  ROUND_DOWN((val) + (denom) - 1, denom)
 #define TO_MASK(val) ((val) - 1)
 
-class CJpegStreamParser {
-private:
-    unsigned char *m_pStreamBase;
-    size_t m_nStreamSize;
-
-    unsigned char m_nComponents;
-    unsigned short m_nWidth;
-    unsigned short m_nHeight;
-
-    void Initialize();
-    size_t GetLength(unsigned char *addr);
-    bool ParseFrame(unsigned char *addr);
-
-    off_t GetOffset(unsigned char *addr) {
-        unsigned long beg = reinterpret_cast<unsigned long>(m_pStreamBase);
-        unsigned long cur = reinterpret_cast<unsigned long>(addr);
-        return static_cast<off_t>(cur - beg);
-    }
-
-public:
-    unsigned char m_iHorizontalFactor;
-    unsigned char m_iVerticalFactor;
-
-    CJpegStreamParser() : m_pStreamBase(NULL), m_nStreamSize(0) { }
-    ~CJpegStreamParser() { }
-
-    bool Parse(unsigned char *streambase, size_t length);
-
-    int GetImageFormat();
-    unsigned int GetWidth() { return m_nWidth; }
-    unsigned int GetHeight() { return m_nHeight; }
-    unsigned int GetNumComponents() { return m_nComponents; }
-};
-
-void CJpegStreamParser::Initialize()
-{
-    m_nComponents = 0;
-    m_nWidth = 0;
-    m_nHeight = 0;
-    m_iHorizontalFactor = 1;
-    m_iVerticalFactor = 1;
-}
-
-size_t CJpegStreamParser::GetLength(unsigned char *addr)
-{
-    size_t len = static_cast<size_t>(*addr++) * 0x100;
-    return len + *addr;
-}
-
-bool CJpegStreamParser::Parse(unsigned char *streambase, size_t length)
-{
-    Initialize();
-
-    m_pStreamBase = streambase;
-    m_nStreamSize = length;
-
-    unsigned char *addr = m_pStreamBase;
-    size_t filelen = m_nStreamSize;
-
-    // Finding SOI (xFFD8)
-    if ((filelen < 2) || (addr[0] != 0xFF) || (addr[1] != 0xD8)) {
-        ALOGE("Not a valid JPEG stream (len %zu, marker %02x%02x", filelen, addr[0], addr[1]);
-        return false;
-    }
-    addr += 2;
-    filelen -= 2;
-
-    while (true) { // DHT, DQT, SOF, SOS
-        if (filelen < 2) {
-            ALOGE("Incomplete JPEG Stream");
-            return false;
-        }
-
-        if (*addr++ != 0xFF) {
-            ALOGE("Corrupted JPEG stream");
-            return false;
-        }
-
-        unsigned char marker = *addr++;
-
-        if ((marker != 0xC4) && ((marker & 0xF0) == 0xC0)) { // SOFn
-            if (marker != 0xC0) {
-                ALOGE("SOF%d is not supported (offset %zu)", marker & 0xF, m_nStreamSize - filelen);
-                return false;
-            }
-
-            if (filelen < GetLength(addr)) {
-                ALOGE("Too small SOF0 segment");
-                return false;
-            }
-
-            if (!ParseFrame(addr))
-                return false;
-
-            return true; // this is the successful exit point
-        } else if (marker == 0xD9) { // EOI
-            // This will not meet.
-            ALOGE("Unexpected EOI found at %lu\n", GetOffset(addr - 2));
-            return false;
-        } else {
-            if ((marker == 0xCC) || (marker == 0xDC)) { // DAC and DNL
-                ALOGE("Unsupported JPEG stream: found marker 0xFF%02X", marker);
-                return false;
-            }
-
-            if (filelen < GetLength(addr)) {
-                ALOGE("Corrupted JPEG stream");
-                return false;
-            }
-        }
-
-        if (GetLength(addr) == 0) {
-            ALOGE("Invalid length 0 is read at offset %lu", GetOffset(addr));
-            return false;
-        }
-
-        filelen -= GetLength(addr);
-        addr += GetLength(addr);
-    }
-
-    // NEVER REACH HERE
-
-    ALOGE("Unable to find the frame header");
-
-    return false;
-}
-
-bool CJpegStreamParser::ParseFrame(unsigned char *addr)
-{ // 2 bytes of length
-    // 1 byte of bits per sample
-    // 2 bytes of height
-    // 2 bytes of width
-    // 1 byte of number of components
-    // n * 3 byte component specifications
-    if (GetLength(addr) < 17) {
-        ALOGE("SOF0 should include all three components");
-        return false;
-    }
-    addr += 2; // skip length
-
-    if (*addr != 8) { // bits per sample
-        ALOGE("Bits Per Sample should be 8 but it is %d", *addr);
-        return false;
-    }
-    addr++;
-
-    m_nHeight = static_cast<unsigned short>(GetLength(addr));
-    if ((m_nHeight < 8) || (m_nHeight > 16383)) {
-        ALOGE("Height %d is not supported", m_nHeight);
-        return false;
-    }
-    addr += 2;
-
-    m_nWidth = static_cast<unsigned short>(GetLength(addr));
-    if ((m_nWidth < 8) || (m_nWidth > 16383)) {
-        ALOGE("Width %d is not supported", m_nWidth);
-        return false;
-    }
-    addr += 2;
-
-    m_nComponents = *addr;
-    if (m_nComponents != 3) {
-        ALOGE("Number of components should be 3 but it is %d", m_nComponents);
-        return false;
-    }
-    addr++;
-
-    // Only the first component is needed to find chroma subsampling factor
-    addr++; // skip component identifier
-    if ((*addr != 0x11) && (*addr != 0x21) && (*addr != 0x12) && (*addr != 0x22)) {
-        ALOGE("Invalid Luma sampling factor %#02x", *addr);
-        return false;
-    }
-    m_iHorizontalFactor = *addr >> 4;
-    m_iVerticalFactor = *addr & 0xF;
-
-    return true;
-}
-
 class CLibhwjpegDecompressor: public hwjpeg_decompressor_struct {
     enum {
         HWJPG_FLAG_NEED_MUNMAP = 1,
@@ -225,6 +49,13 @@ class CLibhwjpegDecompressor: public hwjpeg_decompressor_struct {
     unsigned int m_flags;
     bool m_bPrepared;
     CHWJpegDecompressor *m_hwjpeg;
+    // The streams that HWJPEG is not able to decompress are decompressed by m_swjpeg
+    bool m_bSoftware;
+    CJpegSoftwareDecompressor m_swjpeg;
+
+    unsigned char *m_pImageBuffer;
+    int m_iImageBufferFd;
+    size_t m_nImageBufferLength;
 
     unsigned char *m_pStreamBuffer;
     size_t m_nStreamLength;
@@ -244,6 +75,10 @@ public:
         output_height = 0;
         m_bPrepared = false;
 	m_pStreamBuffer = NULL;
+        m_bSoftware = false;
+        m_pImageBuffer = NULL;
+        m_iImageBufferFd = -1;
+        m_nImageBufferLength = 0;
 
         output_format = V4L2_PIX_FMT_RGB32;
 
@@ -253,8 +88,9 @@ public:
 
         m_hwjpeg = new CHWJpegV4L2Decompressor;
         if (!m_hwjpeg || !*m_hwjpeg) {
-            ALOGE("Failed to create HWJPEG decompressor");
+            ALOGE("Failed to create HWJPEG decompressor: decompressing by software");
             delete m_hwjpeg;
+            m_hwjpeg = NULL;
         }
     }
 
@@ -353,7 +189,11 @@ public:
             return false;
         }
 
-        return m_hwjpeg->SetImageBuffer(reinterpret_cast<char *>(buffer[0]), len[0]);
+        m_pImageBuffer = buffer[0];
+        m_iImageBufferFd = -1;
+        m_nImageBufferLength = len[0];
+
+        return !m_hwjpeg || m_hwjpeg->SetImageBuffer(reinterpret_cast<char *>(buffer[0]), len[0]);
     }
 
     bool SetImageBuffer(int buffer[3], size_t len[3], unsigned int num_bufs) {
@@ -362,24 +202,25 @@ public:
             return false;
         }
 
-        return m_hwjpeg->SetImageBuffer(buffer[0], len[0]);
+        m_pImageBuffer = NULL;
+        m_iImageBufferFd = buffer[0];
+        m_nImageBufferLength = len[0];
+
+        return !m_hwjpeg || m_hwjpeg->SetImageBuffer(buffer[0], len[0]);
     }
 
     void SetDownscaleFactor(unsigned int factor) { scale_factor = factor; }
 
     bool PrepareDecompression();
+    bool PrepareSoftwareDecompression();
     bool Decompress();
+    bool DecompressBySoftware();
 
     bool IsEnoughStreamBuffer() { return true; }
 };
 
 bool CLibhwjpegDecompressor::PrepareDecompression()
 {
-    if (!m_hwjpeg) {
-        ALOGE("device node is not opened!");
-        return false;
-    }
-
     if ((scale_factor != 1) && (scale_factor != 2) &&
             (scale_factor != 4) && (scale_factor != 8)) {
         ALOGE("Invalid downscaling factor %d", scale_factor);
@@ -391,6 +232,9 @@ bool CLibhwjpegDecompressor::PrepareDecompression()
         return false;
     }
 
+    m_bPrepared = false;
+    m_bSoftware = false;
+
     if (!m_jpegStreamParser.Parse(m_pStreamBuffer, m_nStreamLength))
         return false;
 
@@ -400,11 +244,14 @@ bool CLibhwjpegDecompressor::PrepareDecompression()
     chroma_h_samp_factor = m_jpegStreamParser.m_iHorizontalFactor;
     chroma_v_samp_factor = m_jpegStreamParser.m_iVerticalFactor;
 
+    if (!m_hwjpeg || !m_jpegStreamParser.IsDecompressible())
+        return PrepareSoftwareDecompression();
+
     if (((image_width % (chroma_h_samp_factor * scale_factor)) != 0) ||
             ((image_height % (chroma_v_samp_factor * scale_factor)) != 0)) {
-        ALOGE("Downscaling by factor %d of compressed image size %dx%d(chroma %d:%d) is not supported",
+        ALOGD("Downscaling by factor %d of compressed image size %dx%d(chroma %d:%d) is not supported by HWJPEG",
                 scale_factor, image_width, image_height, chroma_h_samp_factor, chroma_v_samp_factor);
-        return false;
+        return PrepareSoftwareDecompression();
     }
 
     output_width = image_width / scale_factor;
@@ -412,19 +259,91 @@ bool CLibhwjpegDecompressor::PrepareDecompression()
 
     if (!m_hwjpeg->SetStreamPixelSize(image_width, image_height)) {
         ALOGE("Failed to configure stream pixel size (%ux%u)", image_width, image_height);
-        return false;
+        return PrepareSoftwareDecompression();
     }
 
     if (!m_hwjpeg->SetImageFormat(output_format, output_width, output_height)) {
         ALOGE("Failed to configure image format (%ux%u/%08X)", output_width, output_height, output_format);
+        return PrepareSoftwareDecompression();
+    }
+
+    m_bPrepared = true;
+
+    return true;
+}
+
+bool CLibhwjpegDecompressor::PrepareSoftwareDecompression()
+{
+    if (!CJpegSoftwareDecompressor::IsSupportedFormat(output_format)) {
+        ALOGE("Image format %08X is not supported by the software decompressor", output_format);
         return false;
     }
 
+    if (!CJpegSoftwareDecompressor::IsDecompressible(m_jpegStreamParser))
+        return false;
+
+    // The software decompressor does not require the image size aligned to the downscaling factor
+    output_width = (image_width + scale_factor - 1) / scale_factor;
+    output_height = (image_height + scale_factor - 1) / scale_factor;
+
+    ALOGD("Decompressing %ux%u JPEG stream into %ux%u image by software",
+          image_width, image_height, output_width, output_height);
+
+    m_bSoftware = true;
     m_bPrepared = true;
 
     return true;
 }
 
+static bool SyncDmabuf(int fd, __u64 flags)
+{
+    struct dma_buf_sync sync;
+
+    sync.flags = flags;
+    if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0) {
+        ALOGERR("Failed to sync dmabuf fd %d with flags %#llx", fd, static_cast<unsigned long long>(flags));
+        return false;
+    }
+
+    return true;
+}
+
+bool CLibhwjpegDecompressor::DecompressBySoftware()
+{
+    unsigned char *buffer = m_pImageBuffer;
+
+    if (m_iImageBufferFd >= 0) {
+        buffer = reinterpret_cast<unsigned char *>(
+                mmap(NULL, m_nImageBufferLength, PROT_READ | PROT_WRITE, MAP_SHARED, m_iImageBufferFd, 0));
+        if (buffer == MAP_FAILED) {
+            ALOGERR("Failed to mmap %zu bytes of dmabuf fd %d", m_nImageBufferLength, m_iImageBufferFd);
+            return false;
+        }
+    }
+
+    if (buffer == NULL) {
+        ALOGE("No image buffer is configured");
+        return false;
+    }
+
+    // The image buffer can be cached, so the CPU writes are flushed before a device reads it
+    if ((m_iImageBufferFd >= 0) && !SyncDmabuf(m_iImageBufferFd, DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE)) {
+        munmap(buffer, m_nImageBufferLength);
+        return false;
+    }
+
+    bool success = m_swjpeg.Decompress(m_pStreamBuffer, m_nStreamLength, scale_factor,
+                                       output_format, buffer, m_nImageBufferLength);
+
+    if (m_iImageBufferFd >= 0) {
+        if (!SyncDmabuf(m_iImageBufferFd, DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE))
+            success = false;
+        munmap(buffer, m_nImageBufferLength);
+    }
+
+    return success;
+}
+
 bool CLibhwjpegDecompressor::Decompress()
 {
     if (!m_bPrepared) {
@@ -439,9 +358,13 @@ bool CLibhwjpegDecompressor::Decompress()
 
     m_bPrepared = false;
 
+    if (m_bSoftware)
+        return DecompressBySoftware();
+
     if (!m_hwjpeg->Decompress(reinterpret_cast<char *>(m_pStreamBuffer), m_nStreamLength)) {
-        ALOGE("Failed to decompress");
-        return false;
+        ALOGE("Failed to decompress by HWJPEG: retrying by software");
+        // The output size of HWJPEG is not changed by the software decompressor
+        return CJpegSoftwareDecompressor::IsSupportedFormat(output_format) && DecompressBySoftware();
     }
 
     return true;
@@ -0,0 +1,35 @@
+# Copyright (C) 2015 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -DLOG_TAG=\"libhwjpeg-test\"
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_SRC_FILES := jpeg_stream_parser_test.cpp ../JpegStreamParser.cpp
+LOCAL_SANITIZE := address
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := libhwjpeg_stream_parser_test
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -DLOG_TAG=\"libhwjpeg-test\"
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_SRC_FILES := jpeg_software_decompressor_test.cpp ../JpegSoftwareDecompressor.cpp ../JpegStreamParser.cpp
+LOCAL_SANITIZE := address
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := libhwjpeg_software_decompressor_test
+include $(BUILD_HOST_NATIVE_TEST)
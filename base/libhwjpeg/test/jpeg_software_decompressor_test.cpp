@@ -0,0 +1,869 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <linux/videodev2.h>
+
+#include "JpegSoftwareDecompressor.h"
+
+typedef std::vector<unsigned char> Stream;
+
+static const unsigned char naturalOrder[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+struct HuffmanSpec {
+    unsigned char bits[16];
+    std::vector<unsigned char> values;
+    unsigned int code[256];
+    unsigned char size[256];
+};
+
+static HuffmanSpec MakeHuffmanSpec(const unsigned char bits[16], const std::vector<unsigned char> &values)
+{
+    HuffmanSpec spec;
+    unsigned int code = 0;
+    size_t k = 0;
+
+    memcpy(spec.bits, bits, sizeof(spec.bits));
+    spec.values = values;
+    memset(spec.code, 0, sizeof(spec.code));
+    memset(spec.size, 0, sizeof(spec.size));
+
+    for (unsigned int len = 1; len <= 16; len++) {
+        for (unsigned int i = 0; i < bits[len - 1]; i++, k++) {
+            spec.code[values[k]] = code++;
+            spec.size[values[k]] = static_cast<unsigned char>(len);
+        }
+        code <<= 1;
+    }
+
+    return spec;
+}
+
+// Annex K.3 of ITU-T T.81
+static HuffmanSpec StandardDcTable()
+{
+    static const unsigned char bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+    return MakeHuffmanSpec(bits, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+}
+
+static HuffmanSpec StandardAcTable()
+{
+    static const unsigned char bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+    return MakeHuffmanSpec(bits, {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA,
+    });
+}
+
+// Every symbol including EOBn of the progressive mode: 255 codes of 9 bits and one of 10 bits
+static HuffmanSpec FlatTable()
+{
+    static const unsigned char bits[16] = {0, 0, 0, 0, 0, 0, 0, 0, 255, 1, 0, 0, 0, 0, 0, 0};
+    std::vector<unsigned char> values(256);
+
+    for (unsigned int i = 0; i < 256; i++)
+        values[i] = static_cast<unsigned char>(i);
+
+    return MakeHuffmanSpec(bits, values);
+}
+
+class BitWriter {
+    Stream &m_stream;
+    unsigned int m_bits;
+    unsigned int m_count;
+public:
+    explicit BitWriter(Stream &stream) : m_stream(stream), m_bits(0), m_count(0) { }
+
+    void Put(unsigned int value, unsigned int size) {
+        for (int i = static_cast<int>(size) - 1; i >= 0; i--) {
+            m_bits = (m_bits << 1) | ((value >> i) & 1);
+            if (++m_count == 8) {
+                m_stream.push_back(static_cast<unsigned char>(m_bits));
+                if (m_bits == 0xFF)
+                    m_stream.push_back(0);
+                m_bits = 0;
+                m_count = 0;
+            }
+        }
+    }
+
+    void PutSymbol(const HuffmanSpec &table, unsigned int symbol) {
+        ASSERT_GT(table.size[symbol], 0) << "no code for symbol " << symbol;
+        Put(table.code[symbol], table.size[symbol]);
+    }
+
+    void PutValue(int value, unsigned int size) {
+        Put(static_cast<unsigned int>((value < 0) ? value + (1 << size) - 1 : value), size);
+    }
+
+    void Flush() {
+        while (m_count != 0)
+            Put(1, 1);
+    }
+};
+
+static unsigned int BitSize(int value)
+{
+    unsigned int size = 0;
+
+    for (value = std::abs(value); value != 0; value >>= 1)
+        size++;
+
+    return size;
+}
+
+struct TestComponent {
+    unsigned int h, v;
+    unsigned int qtable;
+    unsigned int blocks_width, blocks_height;
+    unsigned int blocks_stride, blocks_rows;
+    std::vector<int16_t> coefs; // 64 coefficients of a block in natural order
+    int16_t *Block(unsigned int bx, unsigned int by) { return &coefs[(by * blocks_stride + bx) * 64]; }
+};
+
+struct TestImage {
+    unsigned int width, height;
+    unsigned int max_h, max_v;
+    unsigned int mcus_per_line, mcu_rows;
+    std::vector<TestComponent> comps;
+    uint16_t quant[2][64]; // in natural order
+};
+
+typedef std::vector<std::pair<unsigned int, unsigned int>> Factors;
+
+static double Basis(unsigned int size, unsigned int x, unsigned int u)
+{
+    return ((u == 0) ? std::sqrt(0.5) : 1.0) / 2 * std::cos((2 * x + 1) * u * M_PI / (2 * size));
+}
+
+/*
+ * An image of smooth waves and noise transformed and quantized to the coefficients.
+ * Only DC is kept if @dc_only is true. The blocks padded to fill the MCUs are zero.
+ */
+static TestImage MakeImage(unsigned int width, unsigned int height, const Factors &factors, bool dc_only)
+{
+    TestImage image;
+    uint32_t seed = width * 131 + height;
+
+    image.width = width;
+    image.height = height;
+    image.max_h = 1;
+    image.max_v = 1;
+    for (auto &factor : factors) {
+        image.max_h = std::max(image.max_h, factor.first);
+        image.max_v = std::max(image.max_v, factor.second);
+    }
+    image.mcus_per_line = (width + 8 * image.max_h - 1) / (8 * image.max_h);
+    image.mcu_rows = (height + 8 * image.max_v - 1) / (8 * image.max_v);
+
+    for (unsigned int k = 0; k < 64; k++) {
+        image.quant[0][k] = static_cast<uint16_t>((k == 0) ? 8 : 2 + k % 7 + k / 8);
+        image.quant[1][k] = static_cast<uint16_t>((k == 0) ? 8 : 3 + k / 4);
+    }
+
+    for (unsigned int c = 0; c < factors.size(); c++) {
+        TestComponent comp;
+
+        comp.h = factors[c].first;
+        comp.v = factors[c].second;
+        comp.qtable = (c == 0) ? 0 : 1;
+        comp.blocks_width = ((width * comp.h + image.max_h - 1) / image.max_h + 7) / 8;
+        comp.blocks_height = ((height * comp.v + image.max_v - 1) / image.max_v + 7) / 8;
+        comp.blocks_stride = image.mcus_per_line * comp.h;
+        comp.blocks_rows = image.mcu_rows * comp.v;
+        comp.coefs.assign(comp.blocks_stride * comp.blocks_rows * 64, 0);
+
+        for (unsigned int by = 0; by < comp.blocks_height; by++) {
+            for (unsigned int bx = 0; bx < comp.blocks_width; bx++) {
+                double pixels[8][8];
+
+                for (unsigned int y = 0; y < 8; y++) {
+                    for (unsigned int x = 0; x < 8; x++) {
+                        seed = seed * 1103515245 + 12345;
+                        double X = bx * 8 + x, Y = by * 8 + y;
+                        double value = 128 + 90 * std::cos(X * 0.13 + c) * std::sin(Y * 0.21 - c * 0.5) +
+                                       static_cast<int>((seed >> 16) % 41) - 20;
+                        pixels[y][x] = std::min(255.0, std::max(0.0, value)) - 128;
+                    }
+                }
+
+                int16_t *block = comp.Block(bx, by);
+                for (unsigned int v = 0; v < 8; v++) {
+                    for (unsigned int u = 0; u < 8; u++) {
+                        double sum = 0;
+                        for (unsigned int y = 0; y < 8; y++)
+                            for (unsigned int x = 0; x < 8; x++)
+                                sum += pixels[y][x] * Basis(8, x, u) * Basis(8, y, v);
+                        block[v * 8 + u] = static_cast<int16_t>(std::lround(sum / image.quant[comp.qtable][v * 8 + u]));
+                    }
+                }
+
+                if (dc_only)
+                    std::fill(block + 1, block + 64, 0);
+            }
+        }
+
+        image.comps.push_back(comp);
+    }
+
+    return image;
+}
+
+struct ScanSpec {
+    std::vector<unsigned int> comps;
+    unsigned int ss, se, ah, al;
+};
+
+class ScanEncoder {
+    TestImage &m_image;
+    Stream &m_stream;
+    BitWriter m_writer;
+    const HuffmanSpec *m_dcTables[2];
+    const HuffmanSpec *m_acTables[2];
+    const ScanSpec &m_scan;
+    bool m_progressive;
+    int m_preds[3];
+    unsigned int m_eobRun;
+    std::vector<unsigned char> m_eobBits; // correction bits of the blocks in EOB run
+    const HuffmanSpec *m_eobTable;
+
+    void EmitEobRun() {
+        if (m_eobRun == 0)
+            return;
+
+        unsigned int nbits = BitSize(static_cast<int>(m_eobRun)) - 1;
+        m_writer.PutSymbol(*m_eobTable, nbits << 4);
+        m_writer.Put(m_eobRun & ((1U << nbits) - 1), nbits);
+        for (unsigned char bit : m_eobBits)
+            m_writer.Put(bit, 1);
+
+        m_eobRun = 0;
+        m_eobBits.clear();
+    }
+
+    void EncodeSequential(unsigned int c, const int16_t *block) {
+        const HuffmanSpec &ac = *m_acTables[m_image.comps[c].qtable];
+        int diff = block[0] - m_preds[c];
+        unsigned int run = 0;
+
+        m_preds[c] = block[0];
+        m_writer.PutSymbol(*m_dcTables[m_image.comps[c].qtable], BitSize(diff));
+        m_writer.PutValue(diff, BitSize(diff));
+
+        for (unsigned int k = 1; k < 64; k++) {
+            int value = block[naturalOrder[k]];
+            if (value == 0) {
+                run++;
+                continue;
+            }
+
+            for (; run > 15; run -= 16)
+                m_writer.PutSymbol(ac, 0xF0);
+            m_writer.PutSymbol(ac, (run << 4) | BitSize(value));
+            m_writer.PutValue(value, BitSize(value));
+            run = 0;
+        }
+
+        if (run > 0)
+            m_writer.PutSymbol(ac, 0x00);
+    }
+
+    void EncodeDc(unsigned int c, const int16_t *block) {
+        int value = block[0] >> m_scan.al;
+
+        if (m_scan.ah != 0) {
+            m_writer.Put(value & 1, 1);
+            return;
+        }
+
+        int diff = value - m_preds[c];
+        m_preds[c] = value;
+        m_writer.PutSymbol(*m_dcTables[m_image.comps[c].qtable], BitSize(diff));
+        m_writer.PutValue(diff, BitSize(diff));
+    }
+
+    void EncodeAcFirst(const int16_t *block) {
+        unsigned int run = 0;
+
+        for (unsigned int k = m_scan.ss; k <= m_scan.se; k++) {
+            int value = block[naturalOrder[k]];
+            int magnitude = std::abs(value) >> m_scan.al;
+            if (magnitude == 0) {
+                run++;
+                continue;
+            }
+
+            EmitEobRun();
+            for (; run > 15; run -= 16)
+                m_writer.PutSymbol(*m_eobTable, 0xF0);
+            m_writer.PutSymbol(*m_eobTable, (run << 4) | BitSize(magnitude));
+            m_writer.PutValue((value < 0) ? -magnitude : magnitude, BitSize(magnitude));
+            run = 0;
+        }
+
+        if ((run > 0) && (++m_eobRun == 0x7FFF))
+            EmitEobRun();
+    }
+
+    // G.1.2.3 in the way of jcphuff.c of IJG
+    void EncodeAcRefine(const int16_t *block) {
+        int magnitudes[64];
+        unsigned int eob = 0;
+
+        for (unsigned int k = m_scan.ss; k <= m_scan.se; k++) {
+            magnitudes[k] = std::abs(block[naturalOrder[k]]) >> m_scan.al;
+            if (magnitudes[k] == 1)
+                eob = k;
+        }
+
+        std::vector<unsigned char> corrections;
+        unsigned int run = 0;
+
+        for (unsigned int k = m_scan.ss; k <= m_scan.se; k++) {
+            if (magnitudes[k] == 0) {
+                run++;
+                continue;
+            }
+
+            while ((run > 15) && (k <= eob)) {
+                EmitEobRun();
+                m_writer.PutSymbol(*m_eobTable, 0xF0);
+                run -= 16;
+                for (unsigned char bit : corrections)
+                    m_writer.Put(bit, 1);
+                corrections.clear();
+            }
+
+            if (magnitudes[k] > 1) {
+                corrections.push_back(magnitudes[k] & 1);
+                continue;
+            }
+
+            EmitEobRun();
+            m_writer.PutSymbol(*m_eobTable, (run << 4) | 1);
+            m_writer.Put((block[naturalOrder[k]] < 0) ? 0 : 1, 1);
+            for (unsigned char bit : corrections)
+                m_writer.Put(bit, 1);
+            corrections.clear();
+            run = 0;
+        }
+
+        if ((run > 0) || !corrections.empty()) {
+            m_eobRun++;
+            m_eobBits.insert(m_eobBits.end(), corrections.begin(), corrections.end());
+            if ((m_eobRun == 0x7FFF) || (m_eobBits.size() > 900))
+                EmitEobRun();
+        }
+    }
+
+    void EncodeBlock(unsigned int c, const int16_t *block) {
+        if (!m_progressive)
+            EncodeSequential(c, block);
+        else if (m_scan.ss == 0)
+            EncodeDc(c, block);
+        else if (m_scan.ah == 0)
+            EncodeAcFirst(block);
+        else
+            EncodeAcRefine(block);
+    }
+
+public:
+    ScanEncoder(TestImage &image, Stream &stream, const HuffmanSpec *dc[2], const HuffmanSpec *ac[2],
+                const ScanSpec &scan, bool progressive)
+        : m_image(image), m_stream(stream), m_writer(stream), m_scan(scan), m_progressive(progressive),
+          m_eobRun(0) {
+        for (int i = 0; i < 2; i++) {
+            m_dcTables[i] = dc[i];
+            m_acTables[i] = ac[i];
+        }
+        m_eobTable = ac[image.comps[scan.comps[0]].qtable];
+    }
+
+    void Encode(unsigned int restart_interval) {
+        unsigned int mcus = 0, restarts = 0;
+
+        memset(m_preds, 0, sizeof(m_preds));
+
+        auto restart = [&]() {
+            if ((restart_interval == 0) || (mcus == 0) || (mcus % restart_interval != 0))
+                return;
+            EmitEobRun();
+            m_writer.Flush();
+            m_stream.push_back(0xFF);
+            m_stream.push_back(static_cast<unsigned char>(0xD0 + (restarts++ & 7)));
+            memset(m_preds, 0, sizeof(m_preds));
+        };
+
+        if (m_scan.comps.size() == 1) {
+            unsigned int c = m_scan.comps[0];
+            TestComponent &comp = m_image.comps[c];
+
+            for (unsigned int by = 0; by < comp.blocks_height; by++) {
+                for (unsigned int bx = 0; bx < comp.blocks_width; bx++, mcus++) {
+                    restart();
+                    EncodeBlock(c, comp.Block(bx, by));
+                }
+            }
+        } else {
+            for (unsigned int my = 0; my < m_image.mcu_rows; my++) {
+                for (unsigned int mx = 0; mx < m_image.mcus_per_line; mx++, mcus++) {
+                    restart();
+                    for (unsigned int c : m_scan.comps) {
+                        TestComponent &comp = m_image.comps[c];
+                        for (unsigned int y = 0; y < comp.v; y++)
+                            for (unsigned int x = 0; x < comp.h; x++)
+                                EncodeBlock(c, comp.Block(mx * comp.h + x, my * comp.v + y));
+                    }
+                }
+            }
+        }
+
+        EmitEobRun();
+        m_writer.Flush();
+    }
+};
+
+static void AppendSegment(Stream &stream, unsigned char marker, const Stream &payload)
+{
+    stream.push_back(0xFF);
+    stream.push_back(marker);
+    stream.push_back(static_cast<unsigned char>((payload.size() + 2) >> 8));
+    stream.push_back(static_cast<unsigned char>(payload.size() + 2));
+    stream.insert(stream.end(), payload.begin(), payload.end());
+}
+
+static void AppendHuffmanTable(Stream &stream, unsigned char id, const HuffmanSpec &table)
+{
+    Stream payload = {id};
+
+    payload.insert(payload.end(), table.bits, table.bits + 16);
+    payload.insert(payload.end(), table.values.begin(), table.values.end());
+    AppendSegment(stream, 0xC4, payload);
+}
+
+enum EncodingMode {
+    ENCODING_BASELINE,   // SOF0 of a single interleaved scan
+    ENCODING_MULTISCAN,  // SOF1 of a scan per component
+    ENCODING_PROGRESSIVE,
+};
+
+static void AppendScan(Stream &stream, TestImage &image, const HuffmanSpec *dc[2], const HuffmanSpec *ac[2],
+                       const ScanSpec &scan, bool progressive, unsigned int restart_interval)
+{
+    Stream sos = {static_cast<unsigned char>(scan.comps.size())};
+
+    for (unsigned int c : scan.comps) {
+        sos.push_back(static_cast<unsigned char>(c + 1));
+        sos.push_back((image.comps[c].qtable == 0) ? 0x00 : 0x11);
+    }
+    sos.insert(sos.end(), {static_cast<unsigned char>(scan.ss), static_cast<unsigned char>(scan.se),
+                           static_cast<unsigned char>((scan.ah << 4) | scan.al)});
+    AppendSegment(stream, 0xDA, sos);
+
+    ScanEncoder encoder(image, stream, dc, ac, scan, progressive);
+    encoder.Encode(restart_interval);
+}
+
+static Stream Encode(TestImage &image, EncodingMode mode, unsigned int restart_interval)
+{
+    static const HuffmanSpec standardDc = StandardDcTable();
+    static const HuffmanSpec standardAc = StandardAcTable();
+    static const HuffmanSpec flat = FlatTable();
+    Stream stream = {0xFF, 0xD8};
+    unsigned int ncomps = static_cast<unsigned int>(image.comps.size());
+
+    // 8-bit table 0 and 16-bit table 1
+    Stream dqt = {0x00};
+    for (unsigned int k = 0; k < 64; k++)
+        dqt.push_back(static_cast<unsigned char>(image.quant[0][naturalOrder[k]]));
+    dqt.push_back(0x11);
+    for (unsigned int k = 0; k < 64; k++) {
+        dqt.push_back(static_cast<unsigned char>(image.quant[1][naturalOrder[k]] >> 8));
+        dqt.push_back(static_cast<unsigned char>(image.quant[1][naturalOrder[k]]));
+    }
+    AppendSegment(stream, 0xDB, dqt);
+
+    Stream sof = {8, static_cast<unsigned char>(image.height >> 8), static_cast<unsigned char>(image.height),
+                  static_cast<unsigned char>(image.width >> 8), static_cast<unsigned char>(image.width),
+                  static_cast<unsigned char>(ncomps)};
+    for (unsigned int c = 0; c < ncomps; c++)
+        sof.insert(sof.end(), {static_cast<unsigned char>(c + 1),
+                               static_cast<unsigned char>((image.comps[c].h << 4) | image.comps[c].v),
+                               static_cast<unsigned char>(image.comps[c].qtable)});
+    unsigned char sofmarker = (mode == ENCODING_BASELINE) ? 0xC0 : ((mode == ENCODING_MULTISCAN) ? 0xC1 : 0xC2);
+    AppendSegment(stream, sofmarker, sof);
+
+    if (restart_interval > 0)
+        AppendSegment(stream, 0xDD, {static_cast<unsigned char>(restart_interval >> 8),
+                                     static_cast<unsigned char>(restart_interval)});
+
+    std::vector<unsigned int> all;
+    for (unsigned int c = 0; c < ncomps; c++)
+        all.push_back(c);
+
+    if (mode != ENCODING_PROGRESSIVE) {
+        const HuffmanSpec *dc[2] = {&standardDc, &flat};
+        const HuffmanSpec *ac[2] = {&standardAc, &flat};
+
+        AppendHuffmanTable(stream, 0x00, standardDc);
+        AppendHuffmanTable(stream, 0x10, standardAc);
+        AppendHuffmanTable(stream, 0x01, flat);
+        AppendHuffmanTable(stream, 0x11, flat);
+
+        if (mode == ENCODING_BASELINE) {
+            AppendScan(stream, image, dc, ac, {all, 0, 63, 0, 0}, false, restart_interval);
+        } else {
+            for (unsigned int c : all)
+                AppendScan(stream, image, dc, ac, {{c}, 0, 63, 0, 0}, false, restart_interval);
+        }
+    } else {
+        const HuffmanSpec *dc[2] = {&standardDc, &flat};
+        const HuffmanSpec *ac[2] = {&flat, &flat};
+
+        AppendHuffmanTable(stream, 0x00, standardDc);
+        AppendHuffmanTable(stream, 0x01, flat);
+        AppendScan(stream, image, dc, ac, {all, 0, 0, 0, 1}, true, restart_interval);
+
+        // the AC tables are defined between the scans
+        AppendHuffmanTable(stream, 0x10, flat);
+        AppendHuffmanTable(stream, 0x11, flat);
+        for (unsigned int c : all)
+            AppendScan(stream, image, dc, ac, {{c}, 1, 5, 0, 2}, true, restart_interval);
+        for (unsigned int c : all)
+            AppendScan(stream, image, dc, ac, {{c}, 6, 63, 0, 2}, true, restart_interval);
+        for (unsigned int c : all)
+            AppendScan(stream, image, dc, ac, {{c}, 1, 63, 2, 1}, true, restart_interval);
+        AppendScan(stream, image, dc, ac, {all, 0, 0, 1, 0}, true, restart_interval);
+        for (unsigned int c : all)
+            AppendScan(stream, image, dc, ac, {{c}, 1, 63, 1, 0}, true, restart_interval);
+    }
+
+    stream.insert(stream.end(), {0xFF, 0xD9});
+
+    return stream;
+}
+
+// The reduced inverse DCT in double of the sample at (@px, @py) of the downscaled component
+static int ReferenceSample(TestImage &image, unsigned int c, unsigned int scale, unsigned int px, unsigned int py)
+{
+    TestComponent &comp = image.comps[c];
+    unsigned int size = 8 / scale;
+    const int16_t *block = comp.Block(px / size, py / size);
+    const uint16_t *quant = image.quant[comp.qtable];
+    double sum = 0;
+
+    for (unsigned int v = 0; v < size; v++)
+        for (unsigned int u = 0; u < size; u++)
+            sum += block[v * 8 + u] * quant[v * 8 + u] * Basis(size, px % size, u) * Basis(size, py % size, v);
+
+    return std::min(255L, std::max(0L, std::lround(sum) + 128));
+}
+
+struct Geometry {
+    unsigned int width, height;
+    Factors factors;
+};
+
+static const Geometry geometries[] = {
+    {64, 48, {{2, 2}, {1, 1}, {1, 1}}},
+    {37, 23, {{2, 2}, {1, 1}, {1, 1}}},
+    {50, 30, {{2, 1}, {1, 1}, {1, 1}}},
+    {29, 31, {{1, 2}, {1, 1}, {1, 1}}},
+    {33, 17, {{1, 1}, {1, 1}, {1, 1}}},
+    {41, 19, {{4, 1}, {1, 1}, {1, 1}}},
+    {35, 26, {{2, 2}, {1, 2}, {2, 1}}},
+    {45, 27, {{1, 1}}},
+    {19, 13, {{2, 2}}},
+};
+
+static const unsigned int scales[] = {1, 2, 4, 8};
+
+static Stream Decompress(const Stream &stream, unsigned int scale, unsigned int format,
+                         unsigned int width, unsigned int height)
+{
+    unsigned int outw = (width + scale - 1) / scale;
+    unsigned int outh = (height + scale - 1) / scale;
+    // exactly sized so that the sanitizer catches writing beyond the image
+    Stream image(CJpegSoftwareDecompressor::GetImageSize(format, outw, outh));
+    CJpegSoftwareDecompressor decompressor;
+
+    if (!decompressor.Decompress(stream.data(), stream.size(), scale, format, image.data(), image.size()))
+        image.clear();
+
+    return image;
+}
+
+// The samples of the components at the positions that the decompressor samples for I420 or GREY
+static void CompareWithReference(TestImage &image, unsigned int scale, const Stream &output)
+{
+    unsigned int width = (image.width + scale - 1) / scale;
+    unsigned int height = (image.height + scale - 1) / scale;
+    unsigned int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    int maxdiff = 0;
+
+    for (unsigned int c = 0; c < image.comps.size(); c++) {
+        TestComponent &comp = image.comps[c];
+        bool chroma = c > 0;
+        unsigned int w = chroma ? cw : width, h = chroma ? ch : height;
+        const unsigned char *plane = output.data() + (chroma ? width * height + (c - 1) * cw * ch : 0);
+        unsigned int hs = (image.comps.size() == 1) ? 1 : comp.h;
+        unsigned int vs = (image.comps.size() == 1) ? 1 : comp.v;
+        unsigned int max_h = (image.comps.size() == 1) ? 1 : image.max_h;
+        unsigned int max_v = (image.comps.size() == 1) ? 1 : image.max_v;
+
+        for (unsigned int y = 0; y < h; y++) {
+            for (unsigned int x = 0; x < w; x++) {
+                unsigned int X = chroma ? x * 2 : x, Y = chroma ? y * 2 : y;
+                int expected = ReferenceSample(image, c, scale, X * hs / max_h, Y * vs / max_v);
+                int diff = std::abs(expected - plane[y * w + x]);
+                maxdiff = std::max(maxdiff, diff);
+                ASSERT_LE(diff, 1) << "component " << c << " at " << x << "," << y;
+            }
+        }
+    }
+}
+
+TEST(JpegSoftwareDecompressorTest, MatchesReducedInverseDctWithinRounding)
+{
+    for (const Geometry &geometry : geometries) {
+        TestImage image = MakeImage(geometry.width, geometry.height, geometry.factors, false);
+        Stream stream = Encode(image, ENCODING_BASELINE, 0);
+        unsigned int format = (image.comps.size() == 1) ? V4L2_PIX_FMT_GREY : V4L2_PIX_FMT_YUV420;
+
+        for (unsigned int scale : scales) {
+            SCOPED_TRACE(testing::Message() << geometry.width << "x" << geometry.height << " components "
+                         << image.comps.size() << " h " << image.max_h << " v " << image.max_v << " scale " << scale);
+
+            Stream output = Decompress(stream, scale, format, image.width, image.height);
+            ASSERT_FALSE(output.empty());
+            CompareWithReference(image, scale, output);
+        }
+    }
+}
+
+TEST(JpegSoftwareDecompressorTest, EncodingsDecodeIdentically)
+{
+    const struct {
+        EncodingMode mode;
+        unsigned int restart_interval;
+    } encodings[] = {
+        {ENCODING_BASELINE, 3},
+        {ENCODING_MULTISCAN, 0},
+        {ENCODING_MULTISCAN, 2},
+        {ENCODING_PROGRESSIVE, 0},
+        {ENCODING_PROGRESSIVE, 2},
+    };
+
+    for (const Geometry &geometry : geometries) {
+        TestImage image = MakeImage(geometry.width, geometry.height, geometry.factors, false);
+        Stream baseline = Encode(image, ENCODING_BASELINE, 0);
+
+        for (auto &encoding : encodings) {
+            Stream stream = Encode(image, encoding.mode, encoding.restart_interval);
+
+            for (unsigned int scale : scales) {
+                for (unsigned int format : {V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_RGB24}) {
+                    SCOPED_TRACE(testing::Message() << geometry.width << "x" << geometry.height << " mode "
+                                 << encoding.mode << " restart " << encoding.restart_interval << " scale " << scale);
+
+                    Stream expected = Decompress(baseline, scale, format, image.width, image.height);
+                    Stream output = Decompress(stream, scale, format, image.width, image.height);
+                    ASSERT_FALSE(expected.empty());
+                    ASSERT_EQ(output, expected);
+                }
+            }
+        }
+    }
+}
+
+// A block of DC only is flat and the DC of 8 times the quantization step is exact at every scale
+TEST(JpegSoftwareDecompressorTest, FlatBlocksAreExact)
+{
+    for (const Geometry &geometry : geometries) {
+        TestImage image = MakeImage(geometry.width, geometry.height, geometry.factors, true);
+        Stream stream = Encode(image, ENCODING_PROGRESSIVE, 1);
+        unsigned int ncomps = static_cast<unsigned int>(image.comps.size());
+
+        for (unsigned int scale : scales) {
+            SCOPED_TRACE(testing::Message() << geometry.width << "x" << geometry.height << " scale " << scale);
+
+            unsigned int width = (image.width + scale - 1) / scale;
+            unsigned int height = (image.height + scale - 1) / scale;
+            unsigned int size = 8 / scale;
+            Stream grey = Decompress(stream, scale, V4L2_PIX_FMT_GREY, image.width, image.height);
+            Stream rgb = Decompress(stream, scale, V4L2_PIX_FMT_RGB24, image.width, image.height);
+            ASSERT_FALSE(rgb.empty());
+            ASSERT_FALSE(grey.empty());
+
+            for (unsigned int y = 0; y < height; y++) {
+                for (unsigned int x = 0; x < width; x++) {
+                    int samples[3] = {128, 128, 128};
+
+                    for (unsigned int c = 0; c < ncomps; c++) {
+                        TestComponent &comp = image.comps[c];
+                        unsigned int px = (ncomps == 1) ? x : x * comp.h / image.max_h;
+                        unsigned int py = (ncomps == 1) ? y : y * comp.v / image.max_v;
+                        samples[c] = std::min(255, std::max(0, comp.Block(px / size, py / size)[0] + 128));
+                    }
+
+                    const unsigned char *pixel = &rgb[(y * width + x) * 3];
+                    double cb = samples[1] - 128, cr = samples[2] - 128;
+                    double expected[3] = {samples[0] + 1.402 * cr, samples[0] - 0.344136 * cb - 0.714136 * cr,
+                                          samples[0] + 1.772 * cb};
+                    for (int i = 0; i < 3; i++)
+                        ASSERT_NEAR(pixel[i], std::min(255.0, std::max(0.0, expected[i])), 0.51)
+                            << x << "," << y << " channel " << i;
+
+                    ASSERT_EQ(grey[y * width + x], samples[0]) << x << "," << y;
+                }
+            }
+        }
+    }
+}
+
+TEST(JpegSoftwareDecompressorTest, OutputFormatsAreConsistent)
+{
+    TestImage image = MakeImage(37, 23, {{2, 2}, {1, 1}, {1, 1}}, false);
+    Stream stream = Encode(image, ENCODING_BASELINE, 0);
+    const unsigned int width = 37, height = 23, cw = 19, ch = 12;
+
+    Stream rgb24 = Decompress(stream, 1, V4L2_PIX_FMT_RGB24, width, height);
+    Stream bgr24 = Decompress(stream, 1, V4L2_PIX_FMT_BGR24, width, height);
+    Stream rgb32 = Decompress(stream, 1, V4L2_PIX_FMT_RGB32, width, height);
+    Stream bgr32 = Decompress(stream, 1, V4L2_PIX_FMT_BGR32, width, height);
+    Stream rgb565 = Decompress(stream, 1, V4L2_PIX_FMT_RGB565, width, height);
+    Stream grey = Decompress(stream, 1, V4L2_PIX_FMT_GREY, width, height);
+    Stream nv12 = Decompress(stream, 1, V4L2_PIX_FMT_NV12, width, height);
+    Stream nv21 = Decompress(stream, 1, V4L2_PIX_FMT_NV21, width, height);
+    Stream i420 = Decompress(stream, 1, V4L2_PIX_FMT_YUV420, width, height);
+    Stream yuyv = Decompress(stream, 1, V4L2_PIX_FMT_YUYV, width, height);
+
+    ASSERT_EQ(rgb24.size(), width * height * 3);
+    ASSERT_EQ(nv12.size(), width * height + cw * ch * 2);
+    ASSERT_EQ(yuyv.size(), cw * 4 * height);
+
+    for (unsigned int i = 0; i < width * height; i++) {
+        const unsigned char *rgb = &rgb24[i * 3];
+
+        ASSERT_EQ(bgr24[i * 3], rgb[2]);
+        ASSERT_EQ(bgr24[i * 3 + 1], rgb[1]);
+        ASSERT_EQ(bgr24[i * 3 + 2], rgb[0]);
+        ASSERT_EQ(rgb32[i * 4], 0xFF);
+        ASSERT_EQ(memcmp(&rgb32[i * 4 + 1], rgb, 3), 0);
+        ASSERT_EQ(bgr32[i * 4], rgb[2]);
+        ASSERT_EQ(bgr32[i * 4 + 1], rgb[1]);
+        ASSERT_EQ(bgr32[i * 4 + 2], rgb[0]);
+        ASSERT_EQ(bgr32[i * 4 + 3], 0xFF);
+        ASSERT_EQ(rgb565[i * 2] | (rgb565[i * 2 + 1] << 8), ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+    }
+
+    ASSERT_EQ(memcmp(nv12.data(), grey.data(), width * height), 0);
+    ASSERT_EQ(memcmp(nv21.data(), grey.data(), width * height), 0);
+    ASSERT_EQ(memcmp(i420.data(), grey.data(), width * height), 0);
+    for (unsigned int i = 0; i < cw * ch; i++) {
+        ASSERT_EQ(nv12[width * height + i * 2], i420[width * height + i]);
+        ASSERT_EQ(nv12[width * height + i * 2 + 1], i420[width * height + cw * ch + i]);
+        ASSERT_EQ(nv21[width * height + i * 2], nv12[width * height + i * 2 + 1]);
+        ASSERT_EQ(nv21[width * height + i * 2 + 1], nv12[width * height + i * 2]);
+    }
+
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++)
+            ASSERT_EQ(yuyv[y * cw * 4 + (x / 2) * 4 + (x & 1) * 2], grey[y * width + x]);
+        // 4:2:0 has the same chroma in the 2x2 pixels
+        for (unsigned int x = 0; x < cw; x++) {
+            ASSERT_EQ(yuyv[y * cw * 4 + x * 4 + 1], i420[width * height + (y / 2) * cw + x]);
+            ASSERT_EQ(yuyv[y * cw * 4 + x * 4 + 3], i420[width * height + cw * ch + (y / 2) * cw + x]);
+        }
+    }
+}
+
+TEST(JpegSoftwareDecompressorTest, RejectsUnsupportedStreams)
+{
+    TestImage image = MakeImage(32, 16, {{2, 1}, {1, 1}, {1, 1}}, false);
+    Stream stream = Encode(image, ENCODING_BASELINE, 0);
+    size_t sof = 0;
+    Stream buffer(CJpegSoftwareDecompressor::GetImageSize(V4L2_PIX_FMT_RGB32, 32, 16), 0xA5);
+    CJpegSoftwareDecompressor decompressor;
+
+    while ((stream[sof] != 0xFF) || (stream[sof + 1] != 0xC0))
+        sof++;
+
+    EXPECT_TRUE(decompressor.Decompress(stream.data(), stream.size(), 1, V4L2_PIX_FMT_RGB32,
+                                        buffer.data(), buffer.size()));
+    EXPECT_FALSE(CJpegSoftwareDecompressor::IsSupportedFormat(V4L2_PIX_FMT_NV16));
+
+    Stream untouched(buffer.size(), 0xA5);
+    buffer = untouched;
+
+    EXPECT_FALSE(decompressor.Decompress(stream.data(), stream.size(), 3, V4L2_PIX_FMT_RGB32,
+                                         buffer.data(), buffer.size()));
+    EXPECT_FALSE(decompressor.Decompress(stream.data(), stream.size(), 1, V4L2_PIX_FMT_NV16,
+                                         buffer.data(), buffer.size()));
+    EXPECT_FALSE(decompressor.Decompress(stream.data(), stream.size(), 1, V4L2_PIX_FMT_RGB32,
+                                         buffer.data(), buffer.size() - 1));
+
+    for (unsigned char marker : {0xC3, 0xC9, 0xCA}) { // lossless and arithmetic
+        Stream modified = stream;
+        modified[sof + 1] = marker;
+        EXPECT_FALSE(decompressor.Decompress(modified.data(), modified.size(), 1, V4L2_PIX_FMT_RGB32,
+                                             buffer.data(), buffer.size())) << std::hex << marker;
+    }
+
+    Stream precision = stream;
+    precision[sof + 4] = 12;
+    EXPECT_FALSE(decompressor.Decompress(precision.data(), precision.size(), 1, V4L2_PIX_FMT_RGB32,
+                                         buffer.data(), buffer.size()));
+
+    EXPECT_EQ(buffer, untouched);
+}
+
+// Random corruptions of valid streams should fail or give an image without any memory error
+TEST(JpegSoftwareDecompressorTest, SurvivesCorruptedStreams)
+{
+    TestImage image = MakeImage(35, 26, {{2, 2}, {1, 2}, {2, 1}}, false);
+    Stream streams[] = {Encode(image, ENCODING_BASELINE, 2), Encode(image, ENCODING_PROGRESSIVE, 3)};
+    uint32_t seed = 1;
+
+    for (int i = 0; i < 4000; i++) {
+        Stream stream = streams[i % 2];
+        int mutations = 1 + i % 4;
+
+        for (int m = 0; m < mutations; m++) {
+            seed = seed * 1103515245 + 12345;
+            size_t pos = (seed >> 8) % stream.size();
+            unsigned char value = static_cast<unsigned char>(seed >> 24);
+
+            switch ((seed >> 4) % 4) {
+            case 0: stream[pos] = value; break;
+            case 1: stream[pos] ^= 1 << (value & 7); break;
+            case 2: stream.insert(stream.begin() + pos, value); break;
+            default: stream.erase(stream.begin() + pos); break;
+            }
+        }
+
+        Decompress(stream, 1 << (i % 4), V4L2_PIX_FMT_NV12, image.width, image.height);
+    }
+}
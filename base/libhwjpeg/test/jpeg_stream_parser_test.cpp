@@ -0,0 +1,273 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "JpegStreamParser.h"
+
+typedef std::vector<unsigned char> Stream;
+
+static void AppendMarker(Stream &stream, unsigned char marker)
+{
+    stream.push_back(0xFF);
+    stream.push_back(marker);
+}
+
+static void AppendSegment(Stream &stream, unsigned char marker, const Stream &payload)
+{
+    AppendMarker(stream, marker);
+    stream.push_back(static_cast<unsigned char>((payload.size() + 2) >> 8));
+    stream.push_back(static_cast<unsigned char>(payload.size() + 2));
+    stream.insert(stream.end(), payload.begin(), payload.end());
+}
+
+static void Append16(Stream &stream, unsigned int value, bool little)
+{
+    if (little) {
+        stream.push_back(value & 0xFF);
+        stream.push_back((value >> 8) & 0xFF);
+    } else {
+        stream.push_back((value >> 8) & 0xFF);
+        stream.push_back(value & 0xFF);
+    }
+}
+
+static void Append32(Stream &stream, unsigned int value, bool little)
+{
+    Append16(stream, little ? (value & 0xFFFF) : (value >> 16), little);
+    Append16(stream, little ? (value >> 16) : (value & 0xFFFF), little);
+}
+
+static void AppendIFDField(Stream &stream, unsigned int tag, unsigned int value, bool little)
+{
+    Append16(stream, tag, little);
+    Append16(stream, 4, little); // LONG
+    Append32(stream, 1, little);
+    Append32(stream, value, little);
+}
+
+// Exif with the 0th IFD of one field and the 1st IFD of the thumbnail
+static Stream MakeExif(const Stream &thumbnail, bool little)
+{
+    Stream exif = {'E', 'x', 'i', 'f', 0, 0};
+
+    exif.push_back(little ? 'I' : 'M');
+    exif.push_back(little ? 'I' : 'M');
+    Append16(exif, 42, little);
+    Append32(exif, 8, little);        // the 0th IFD
+    Append16(exif, 1, little);
+    AppendIFDField(exif, 0x0112, 1, little); // Orientation
+    Append32(exif, 8 + 18, little);   // the 1st IFD
+    Append16(exif, 2, little);
+    AppendIFDField(exif, 0x0201, 8 + 18 + 30, little);
+    AppendIFDField(exif, 0x0202, thumbnail.size(), little);
+    Append32(exif, 0, little);
+    exif.insert(exif.end(), thumbnail.begin(), thumbnail.end());
+
+    return exif;
+}
+
+static Stream MakeFrame(unsigned int width, unsigned int height, unsigned char luma_factor)
+{
+    Stream frame = {8};
+
+    Append16(frame, height, false);
+    Append16(frame, width, false);
+    frame.push_back(3);
+    frame.insert(frame.end(), {1, luma_factor, 0, 2, 0x11, 1, 3, 0x11, 1});
+
+    return frame;
+}
+
+struct TestStream {
+    Stream stream;
+    size_t thumbnail_offset;
+    size_t thumbnail_size;
+    size_t scan_offset;
+    size_t entropy_offset;
+    size_t end_offset;
+    std::vector<size_t> restart_offsets;
+};
+
+static TestStream MakeStream(unsigned char sof = 0xC0, bool little = true)
+{
+    TestStream test;
+    Stream &stream = test.stream;
+    Stream thumbnail;
+
+    AppendMarker(thumbnail, 0xD8);
+    thumbnail.insert(thumbnail.end(), {0x12, 0x34});
+    AppendMarker(thumbnail, 0xD9);
+
+    AppendMarker(stream, 0xD8);
+    AppendSegment(stream, 0xE0, {'J', 'F', 'I', 'F', 0, 1, 2, 0, 0, 1, 0, 1, 0, 0});
+
+    Stream exif = MakeExif(thumbnail, little);
+    test.thumbnail_offset = stream.size() + 4 + exif.size() - thumbnail.size();
+    test.thumbnail_size = thumbnail.size();
+    AppendSegment(stream, 0xE1, exif);
+
+    AppendSegment(stream, 0xDB, Stream(65, 1));
+    AppendSegment(stream, sof, MakeFrame(64, 32, 0x21));
+    AppendSegment(stream, 0xC4, Stream(29, 0));
+    AppendSegment(stream, 0xDD, {0, 4});
+    stream.insert(stream.end(), {0xFF, 0xFF}); // fill bytes
+
+    test.scan_offset = stream.size();
+    AppendSegment(stream, 0xDA, {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0});
+    test.entropy_offset = stream.size();
+
+    for (unsigned char rst = 0; rst < 3; rst++) {
+        stream.insert(stream.end(), {0x12, 0xFF, 0x00, 0x34});
+        test.restart_offsets.push_back(stream.size());
+        AppendMarker(stream, 0xD0 + rst);
+    }
+    stream.insert(stream.end(), {0x56, 0xFF, 0xFF});
+
+    test.end_offset = stream.size();
+    AppendMarker(stream, 0xD9);
+
+    return test;
+}
+
+TEST(JpegStreamParserTest, IndexesHeaderSegments)
+{
+    for (bool little : {true, false}) {
+        TestStream test = MakeStream(0xC0, little);
+        CJpegStreamParser parser;
+
+        ASSERT_TRUE(parser.Parse(test.stream.data(), test.stream.size()));
+        EXPECT_TRUE(parser.IsDecompressible());
+
+        EXPECT_EQ(parser.GetWidth(), 64U);
+        EXPECT_EQ(parser.GetHeight(), 32U);
+        EXPECT_EQ(parser.GetNumComponents(), 3U);
+        EXPECT_EQ(parser.m_iHorizontalFactor, 2);
+        EXPECT_EQ(parser.m_iVerticalFactor, 1);
+        EXPECT_EQ(parser.GetRestartInterval(), 4U);
+        EXPECT_EQ(parser.GetScanOffset(), test.scan_offset);
+        EXPECT_EQ(parser.GetEntropyCodedOffset(), test.entropy_offset);
+        EXPECT_EQ(parser.GetEndOffset(), 0U);
+
+        ASSERT_TRUE(parser.HasThumbnail());
+        EXPECT_EQ(parser.GetThumbnailOffset(), test.thumbnail_offset);
+        EXPECT_EQ(parser.GetThumbnailSize(), test.thumbnail_size);
+        EXPECT_EQ(test.stream[parser.GetThumbnailOffset()], 0xFF);
+        EXPECT_EQ(test.stream[parser.GetThumbnailOffset() + 1], 0xD8);
+
+        const unsigned char markers[] = {0xD8, 0xE0, 0xE1, 0xDB, 0xC0, 0xC4, 0xDD, 0xDA};
+        ASSERT_EQ(parser.GetSegmentCount(), sizeof(markers));
+        for (size_t i = 0; i < sizeof(markers); i++)
+            EXPECT_EQ(parser.GetSegment(i).marker, markers[i]);
+
+        size_t idx = parser.FindSegment(0xDB);
+        ASSERT_LT(idx, parser.GetSegmentCount());
+        size_t size;
+        const unsigned char *dqt = parser.GetSegmentData(parser.GetSegment(idx), &size);
+        EXPECT_EQ(size, 65U);
+        EXPECT_EQ(dqt[0], 1);
+        EXPECT_EQ(parser.FindSegment(0xFE), parser.GetSegmentCount());
+    }
+}
+
+TEST(JpegStreamParserTest, IndexesEntropyCodedData)
+{
+    TestStream test = MakeStream();
+    CJpegStreamParser parser;
+
+    ASSERT_TRUE(parser.Parse(test.stream.data(), test.stream.size(), true));
+    EXPECT_EQ(parser.GetEndOffset(), test.end_offset);
+
+    std::vector<size_t> restarts;
+    for (size_t idx = parser.FindSegment(0xD0); idx < parser.GetSegmentCount(); idx++) {
+        const CJpegStreamParser::Segment &segment = parser.GetSegment(idx);
+        if ((segment.marker >= 0xD0) && (segment.marker <= 0xD7))
+            restarts.push_back(segment.offset);
+    }
+    EXPECT_EQ(restarts, test.restart_offsets);
+    EXPECT_EQ(parser.GetSegment(parser.GetSegmentCount() - 1).marker, 0xD9);
+
+    // Without EOI
+    EXPECT_FALSE(parser.Parse(test.stream.data(), test.stream.size() - 2, true));
+}
+
+TEST(JpegStreamParserTest, RejectsUnsupportedFrames)
+{
+    CJpegStreamParser parser;
+
+    TestStream progressive = MakeStream(0xC2);
+    ASSERT_TRUE(parser.Parse(progressive.stream.data(), progressive.stream.size(), true));
+    EXPECT_EQ(parser.GetFrameMarker(), 0xC2);
+    EXPECT_FALSE(parser.IsDecompressible());
+
+    TestStream arithmetic = MakeStream();
+    Stream dac;
+    AppendSegment(dac, 0xCC, {0x00, 0x10});
+    arithmetic.stream.insert(arithmetic.stream.begin() + arithmetic.scan_offset, dac.begin(), dac.end());
+    ASSERT_TRUE(parser.Parse(arithmetic.stream.data(), arithmetic.stream.size()));
+    EXPECT_FALSE(parser.IsDecompressible());
+}
+
+TEST(JpegStreamParserTest, RejectsTruncatedStreams)
+{
+    TestStream test = MakeStream();
+    CJpegStreamParser parser;
+
+    for (size_t len = 0; len < test.stream.size(); len++) {
+        // exactly sized so that the sanitizer catches reading beyond the stream
+        Stream truncated(test.stream.begin(), test.stream.begin() + len);
+
+        EXPECT_EQ(parser.Parse(truncated.data(), truncated.size()), len >= test.entropy_offset) << len;
+        EXPECT_FALSE(parser.Parse(truncated.data(), truncated.size(), true)) << len;
+    }
+}
+
+static bool CheckIndex(CJpegStreamParser &parser, size_t size)
+{
+    for (size_t i = 0; i < parser.GetSegmentCount(); i++) {
+        const CJpegStreamParser::Segment &segment = parser.GetSegment(i);
+        if ((segment.offset > size) || (size - segment.offset < 2 + segment.length))
+            return false;
+    }
+
+    if (parser.HasThumbnail() && (parser.GetThumbnailOffset() + parser.GetThumbnailSize() > size))
+        return false;
+
+    return (parser.GetEntropyCodedOffset() <= size) && (parser.GetEndOffset() <= size);
+}
+
+// Random corruptions of a valid stream should fail or give an index inside the stream
+TEST(JpegStreamParserTest, SurvivesCorruptedStreams)
+{
+    TestStream test = MakeStream();
+    CJpegStreamParser parser;
+    uint32_t seed = 1;
+
+    for (int i = 0; i < 20000; i++) {
+        Stream stream = test.stream;
+        int mutations = 1 + i % 4;
+
+        for (int m = 0; m < mutations; m++) {
+            seed = seed * 1103515245 + 12345;
+            size_t pos = (seed >> 8) % stream.size();
+            unsigned char value = static_cast<unsigned char>(seed >> 24);
+
+            switch ((seed >> 4) % 4) {
+            case 0: stream[pos] = value; break;
+            case 1: stream[pos] = 0xFF; break;
+            case 2: stream.insert(stream.begin() + pos, value); break;
+            default: stream.resize(pos); break;
+            }
+
+            if (stream.empty())
+                break;
+        }
+
+        for (bool index_entropy : {false, true}) {
+            if (parser.Parse(stream.data(), stream.size(), index_entropy)) {
+                EXPECT_TRUE(CheckIndex(parser, stream.size())) << "iteration " << i;
+                parser.IsDecompressible();
+            }
+        }
+    }
+}